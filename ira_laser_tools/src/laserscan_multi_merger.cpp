@@ -11,6 +11,9 @@
 #include <sensor_msgs/point_cloud_conversion.h>
 #include "sensor_msgs/LaserScan.h"
 #include "pcl_ros/point_cloud.h"
+#include <nav_msgs/Odometry.h>
+#include <diagnostic_msgs/DiagnosticArray.h>
+#include <deque>
 #include <Eigen/Dense>
 #include <dynamic_reconfigure/server.h>
 #include <ira_laser_tools/laserscan_multi_mergerConfig.h>
@@ -19,12 +22,68 @@ using namespace std;
 using namespace pcl;
 using namespace laserscan_multi_merger;
 
+// Branch-free atan2 approximation (max error ~1e-5 rad, far below any useful
+// angle_increment) written so the compiler can vectorize loops calling it.
+static inline float fast_atan2(float y, float x)
+{
+	float ax = std::fabs(x);
+	float ay = std::fabs(y);
+	float mx = std::max(ax, ay);
+	float mn = std::min(ax, ay);
+	float a = mn / (mx + 1e-30f);
+	float s = a * a;
+	float r = a * (0.99986600f + s * (-0.33029950f + s * (0.18014100f + s * (-0.08513300f + s * 0.02083510f))));
+	r = (ay > ax) ? 1.57079637f - r : r;
+	r = (x < 0.0f) ? 3.14159274f - r : r;
+	r = (y < 0.0f) ? -r : r;
+	return r;
+}
+
+// When to publish a merged scan
+enum MergePolicy
+{
+	MERGE_ALL,         // every input has a new scan (original behaviour)
+	MERGE_RATE,        // fixed rate with the freshest scans that are not stale
+	MERGE_APPROX_TIME, // every input has a new scan and their stamps lie within max_skew
+	MERGE_ANY          // any input has a new scan, stale inputs are left out
+};
+
+// Odometry pose of the base at a given time, used for motion compensation
+struct OdomSample
+{
+	ros::Time stamp;
+	double x;
+	double y;
+	double yaw;
+};
+
+// Per-input beam direction table for the direct merge path. The static
+// extrinsic of the lidar is looked up once and folded into the per-beam
+// unit vectors, so a beam endpoint in the destination frame is simply
+// (r * dir_x[i] + tx, r * dir_y[i] + ty).
+struct BeamTable
+{
+	BeamTable() : valid(false), angle_min(0.0f), angle_increment(0.0f), tx(0.0f), ty(0.0f) {}
+
+	bool valid;
+	string frame_id;
+	float angle_min;
+	float angle_increment;
+	float tx;
+	float ty;
+	float rot[2][2];
+	vector<float> dir_x;
+	vector<float> dir_y;
+};
+
 class LaserscanMerger
 {
 	public:
 		LaserscanMerger();
 		void scanCallback(const sensor_msgs::LaserScan::ConstPtr &scan, std::string topic);
-		void pointcloud_to_laserscan(Eigen::MatrixXf points, pcl::PCLPointCloud2 *merged_cloud);
+		void odomCallback(const nav_msgs::Odometry::ConstPtr &odom);
+		void timerCallback(const ros::TimerEvent &event);
+		void pointcloud_to_laserscan(const Eigen::MatrixXf &points, pcl::PCLPointCloud2 *merged_cloud);
 		void reconfigureCallback(laserscan_multi_mergerConfig &config, uint32_t level);
 
 	private:
@@ -34,13 +93,35 @@ class LaserscanMerger
 
 		ros::Publisher point_cloud_publisher_;
 		ros::Publisher laser_scan_publisher_;
+		ros::Publisher stats_publisher_;
 		vector<ros::Subscriber> scan_subscribers;
+		ros::Subscriber odom_subscriber_;
+		ros::Timer publish_timer_;
 		vector<bool> clouds_modified;
+		vector<ros::Time> stamps;
+		vector<int> merge_inputs;
+		deque<OdomSample> odom_history;
+		diagnostic_msgs::DiagnosticArray stats;
 
 		vector<pcl::PCLPointCloud2> clouds;
 		vector<string> input_topics;
 
+		// direct merge path
+		vector<sensor_msgs::LaserScan::ConstPtr> scans;
+		vector<BeamTable> beam_tables;
+		vector<float> beam_x;
+		vector<float> beam_y;
+		vector<float> beam_angle;
+
 		void laserscan_topic_parser();
+		bool updateBeamTable(BeamTable &table, const sensor_msgs::LaserScan &scan);
+		void tryMerge();
+		void mergeInputs(const ros::Time &stamp);
+		void cloudMerge(const ros::Time &stamp);
+		void directMerge(const ros::Time &stamp);
+		bool odomPoseAt(const ros::Time &stamp, OdomSample &pose);
+		bool motionCompensation(const ros::Time &from, const ros::Time &to, float &c, float &s, float &ox, float &oy);
+		void publishStats(const ros::Time &stamp);
 
 		double angle_min;
 		double angle_max;
@@ -54,6 +135,14 @@ class LaserscanMerger
 		string cloud_destination_topic;
 		string scan_destination_topic;
 		string laserscan_topics;
+		bool direct_merge;
+
+		MergePolicy merge_policy;
+		string merge_policy_name;
+		double publish_rate;
+		double max_skew;
+		double stale_timeout;
+		string odom_topic;
 };
 
 void LaserscanMerger::reconfigureCallback(laserscan_multi_mergerConfig &config, uint32_t level)
@@ -111,6 +200,9 @@ void LaserscanMerger::laserscan_topic_parser()
 			scan_subscribers.resize(input_topics.size());
 			clouds_modified.resize(input_topics.size());
 			clouds.resize(input_topics.size());
+			scans.resize(input_topics.size());
+			stamps.assign(input_topics.size(), ros::Time());
+			beam_tables.assign(input_topics.size(), BeamTable());
 			ROS_INFO("Subscribing to topics\t%ld", scan_subscribers.size());
 			for (int i = 0; i < input_topics.size(); ++i)
 			{
@@ -138,73 +230,307 @@ LaserscanMerger::LaserscanMerger()
 	nh.param("scan_time", scan_time, 0.08801);
 	nh.param("range_min", range_min, 0.15);
 	nh.param("range_max", range_max, 11.0);
+	nh.param("direct_merge", direct_merge, false);
+	nh.param<std::string>("merge_policy", merge_policy_name, "all");
+	nh.param("publish_rate", publish_rate, 10.0);
+	nh.param("max_skew", max_skew, 0.05);
+	nh.param("stale_timeout", stale_timeout, 0.3);
+	nh.param<std::string>("odom_topic", odom_topic, "");
+
+	if (merge_policy_name == "rate")
+		merge_policy = MERGE_RATE;
+	else if (merge_policy_name == "approx_time")
+		merge_policy = MERGE_APPROX_TIME;
+	else if (merge_policy_name == "any")
+		merge_policy = MERGE_ANY;
+	else
+	{
+		if (merge_policy_name != "all")
+			ROS_WARN("Unknown merge_policy '%s', using 'all'", merge_policy_name.c_str());
+		merge_policy_name = "all";
+		merge_policy = MERGE_ALL;
+	}
 
 	this->laserscan_topic_parser();
 
 	point_cloud_publisher_ = node_.advertise<sensor_msgs::PointCloud2>(cloud_destination_topic.c_str(), 1, false);
 	laser_scan_publisher_ = node_.advertise<sensor_msgs::LaserScan>(scan_destination_topic.c_str(), 1, false);
+	stats_publisher_ = nh.advertise<diagnostic_msgs::DiagnosticArray>("merge_stats", 1, false);
+
+	// Motion compensation needs the base pose over time; it is only applied on the direct merge path
+	if (!odom_topic.empty())
+	{
+		if (direct_merge)
+			odom_subscriber_ = node_.subscribe(odom_topic, 50, &LaserscanMerger::odomCallback, this);
+		else
+			ROS_WARN("Motion compensation requires direct_merge, ignoring odom_topic");
+	}
+
+	if (merge_policy == MERGE_RATE)
+		publish_timer_ = node_.createTimer(ros::Duration(1.0 / publish_rate), &LaserscanMerger::timerCallback, this);
+
+	stats.status.resize(1);
+	stats.status[0].name = ros::this_node::getName();
+	stats.status[0].message = merge_policy_name;
+	stats.status[0].values.resize(3 * input_topics.size());
+	for (int i = 0; i < input_topics.size(); i++)
+	{
+		stats.status[0].values[3 * i].key = input_topics[i] + " age";
+		stats.status[0].values[3 * i + 1].key = input_topics[i] + " skew";
+		stats.status[0].values[3 * i + 2].key = input_topics[i] + " used";
+	}
 }
 
 void LaserscanMerger::scanCallback(const sensor_msgs::LaserScan::ConstPtr &scan, std::string topic)
 {
-	sensor_msgs::PointCloud tmpCloud1, tmpCloud2;
-	sensor_msgs::PointCloud2 tmpCloud3;
+	int index = -1;
+	for (int i = 0; i < input_topics.size(); i++)
+		if (topic.compare(input_topics[i]) == 0)
+			index = i;
+	if (index < 0 || scan->ranges.empty())
+		return;
 
-	// refer to http://wiki.ros.org/tf/Tutorials/tf%20and%20Time%20%28C%2B%2B%29
-	try
+	if (direct_merge)
 	{
-		// Verify that TF knows how to transform from the received scan to the destination scan frame
-		tfListener_.waitForTransform(scan->header.frame_id.c_str(), destination_frame.c_str(), scan->header.stamp, ros::Duration(1));
-		projector_.transformLaserScanToPointCloud(scan->header.frame_id, *scan, tmpCloud1, tfListener_, laser_geometry::channel_option::Distance);
-		tfListener_.transformPointCloud(destination_frame.c_str(), tmpCloud1, tmpCloud2);
+		if (!updateBeamTable(beam_tables[index], *scan))
+			return;
+		scans[index] = scan;
 	}
-	catch (tf::TransformException ex)
+	else
 	{
-		return;
+		sensor_msgs::PointCloud tmpCloud1, tmpCloud2;
+		sensor_msgs::PointCloud2 tmpCloud3;
+
+		// Never wait for TF on the subscriber thread: if the transform for the end
+		// of this scan is not there yet, drop the scan and use the next one
+		ros::Time end_time = scan->header.stamp + ros::Duration(scan->time_increment * (scan->ranges.size() - 1));
+		if (!tfListener_.canTransform(destination_frame, scan->header.frame_id, end_time))
+		{
+			ROS_DEBUG_THROTTLE(1.0, "Transform from %s to %s not available yet, dropping scan", scan->header.frame_id.c_str(), destination_frame.c_str());
+			return;
+		}
+
+		try
+		{
+			projector_.transformLaserScanToPointCloud(scan->header.frame_id, *scan, tmpCloud1, tfListener_, laser_geometry::channel_option::Distance);
+			tfListener_.transformPointCloud(destination_frame.c_str(), tmpCloud1, tmpCloud2);
+		}
+		catch (tf::TransformException ex)
+		{
+			return;
+		}
+
+		sensor_msgs::convertPointCloudToPointCloud2(tmpCloud2, tmpCloud3);
+		pcl_conversions::toPCL(tmpCloud3, clouds[index]);
 	}
 
-	for (int i = 0; i < input_topics.size(); i++)
+	stamps[index] = scan->header.stamp;
+	clouds_modified[index] = true;
+
+	if (merge_policy != MERGE_RATE)
+		tryMerge();
+}
+
+void LaserscanMerger::tryMerge()
+{
+	merge_inputs.clear();
+	ros::Time newest;
+
+	switch (merge_policy)
 	{
-		if (topic.compare(input_topics[i]) == 0)
+	case MERGE_ALL:
+		for (int i = 0; i < clouds_modified.size(); i++)
+			if (!clouds_modified[i])
+				return;
+		for (int i = 0; i < clouds_modified.size(); i++)
 		{
-			sensor_msgs::convertPointCloudToPointCloud2(tmpCloud2, tmpCloud3);
-			pcl_conversions::toPCL(tmpCloud3, clouds[i]);
-			clouds_modified[i] = true;
+			merge_inputs.push_back(i);
+			newest = std::max(newest, stamps[i]);
 		}
+		break;
+
+	case MERGE_APPROX_TIME:
+		{
+			for (int i = 0; i < clouds_modified.size(); i++)
+				if (!clouds_modified[i])
+					return;
+			int oldest = 0;
+			for (int i = 0; i < stamps.size(); i++)
+			{
+				newest = std::max(newest, stamps[i]);
+				if (stamps[i] < stamps[oldest])
+					oldest = i;
+			}
+			// The oldest scan is too far behind the others, wait for its successor
+			if ((newest - stamps[oldest]).toSec() > max_skew)
+			{
+				clouds_modified[oldest] = false;
+				return;
+			}
+			for (int i = 0; i < stamps.size(); i++)
+				merge_inputs.push_back(i);
+		}
+		break;
+
+	case MERGE_ANY:
+		for (int i = 0; i < stamps.size(); i++)
+			newest = std::max(newest, stamps[i]);
+		for (int i = 0; i < stamps.size(); i++)
+			if (!stamps[i].isZero() && (newest - stamps[i]).toSec() <= stale_timeout)
+				merge_inputs.push_back(i);
+		break;
+
+	default:
+		return;
 	}
 
-	// Count how many scans we have
-	int totalClouds = 0;
+	if (!merge_inputs.empty())
+		mergeInputs(newest);
+}
+
+void LaserscanMerger::timerCallback(const ros::TimerEvent &event)
+{
+	bool modified = false;
 	for (int i = 0; i < clouds_modified.size(); i++)
-		if (clouds_modified[i])
-			totalClouds++;
+		modified = modified || clouds_modified[i];
+	if (!modified)
+		return;
 
-	// Go ahead only if all subscribed scans have arrived
-	if (totalClouds == clouds_modified.size())
+	ros::Time now = ros::Time::now();
+	ros::Time newest;
+	merge_inputs.clear();
+	for (int i = 0; i < stamps.size(); i++)
 	{
-		pcl::PCLPointCloud2 merged_cloud = clouds[0];
-		clouds_modified[0] = false;
-
-		for (int i = 1; i < clouds_modified.size(); i++)
+		if (!stamps[i].isZero() && (now - stamps[i]).toSec() <= stale_timeout)
 		{
-			#if PCL_VERSION_COMPARE(>=, 1, 10, 0)
-				pcl::concatenate(merged_cloud, clouds[i], merged_cloud);
-			#else
-				pcl::concatenatePointCloud(merged_cloud, clouds[i], merged_cloud);
-			#endif
-				clouds_modified[i] = false;
+			merge_inputs.push_back(i);
+			newest = std::max(newest, stamps[i]);
 		}
+	}
+
+	if (!merge_inputs.empty())
+		mergeInputs(newest);
+}
 
-		point_cloud_publisher_.publish(merged_cloud);
+void LaserscanMerger::mergeInputs(const ros::Time &stamp)
+{
+	if (direct_merge)
+		directMerge(stamp);
+	else
+		cloudMerge(stamp);
 
-		Eigen::MatrixXf points;
-		getPointCloudAsEigen(merged_cloud, points);
+	publishStats(stamp);
 
-		pointcloud_to_laserscan(points, &merged_cloud);
+	for (int i = 0; i < clouds_modified.size(); i++)
+		clouds_modified[i] = false;
+}
+
+void LaserscanMerger::cloudMerge(const ros::Time &stamp)
+{
+	pcl::PCLPointCloud2 merged_cloud = clouds[merge_inputs[0]];
+
+	for (int k = 1; k < merge_inputs.size(); k++)
+	{
+		#if PCL_VERSION_COMPARE(>=, 1, 10, 0)
+			pcl::concatenate(merged_cloud, clouds[merge_inputs[k]], merged_cloud);
+		#else
+			pcl::concatenatePointCloud(merged_cloud, clouds[merge_inputs[k]], merged_cloud);
+		#endif
 	}
+
+	// PCL stamps are in microseconds
+	merged_cloud.header.stamp = stamp.toNSec() / 1000ull;
+
+	point_cloud_publisher_.publish(merged_cloud);
+
+	Eigen::MatrixXf points;
+	getPointCloudAsEigen(merged_cloud, points);
+
+	pointcloud_to_laserscan(points, &merged_cloud);
 }
 
-void LaserscanMerger::pointcloud_to_laserscan(Eigen::MatrixXf points, pcl::PCLPointCloud2 *merged_cloud)
+void LaserscanMerger::publishStats(const ros::Time &stamp)
+{
+	if (stats_publisher_.getNumSubscribers() == 0)
+		return;
+
+	ros::Time now = ros::Time::now();
+	vector<diagnostic_msgs::KeyValue> &values = stats.status[0].values;
+	for (int i = 0; i < stamps.size(); i++)
+	{
+		bool used = std::find(merge_inputs.begin(), merge_inputs.end(), i) != merge_inputs.end();
+		values[3 * i].value = std::to_string((now - stamps[i]).toSec());
+		values[3 * i + 1].value = std::to_string((stamp - stamps[i]).toSec());
+		values[3 * i + 2].value = used ? "true" : "false";
+	}
+	stats.header.stamp = now;
+	stats_publisher_.publish(stats);
+}
+
+void LaserscanMerger::odomCallback(const nav_msgs::Odometry::ConstPtr &odom)
+{
+	OdomSample sample;
+	sample.stamp = odom->header.stamp;
+	sample.x = odom->pose.pose.position.x;
+	sample.y = odom->pose.pose.position.y;
+	sample.yaw = tf::getYaw(odom->pose.pose.orientation);
+
+	if (!odom_history.empty() && sample.stamp < odom_history.back().stamp)
+		odom_history.clear();
+	odom_history.push_back(sample);
+
+	// Only keep as much history as a scan may lag behind the newest one
+	while (odom_history.size() > 2 && (sample.stamp - odom_history.front().stamp).toSec() > 2.0 * stale_timeout + 1.0)
+		odom_history.pop_front();
+}
+
+bool LaserscanMerger::odomPoseAt(const ros::Time &stamp, OdomSample &pose)
+{
+	if (odom_history.size() < 2 || stamp < odom_history.front().stamp || stamp > odom_history.back().stamp)
+		return false;
+
+	deque<OdomSample>::const_iterator next = odom_history.begin() + 1;
+	while (next->stamp < stamp)
+		++next;
+	const OdomSample &a = *(next - 1);
+	const OdomSample &b = *next;
+
+	double span = (b.stamp - a.stamp).toSec();
+	double t = (span > 0.0) ? (stamp - a.stamp).toSec() / span : 0.0;
+	pose.stamp = stamp;
+	pose.x = a.x + t * (b.x - a.x);
+	pose.y = a.y + t * (b.y - a.y);
+	pose.yaw = a.yaw + t * atan2(sin(b.yaw - a.yaw), cos(b.yaw - a.yaw));
+	return true;
+}
+
+// Rigid motion taking points expressed in the base frame at time `from` into
+// the base frame at time `to`: p' = R(c, s) p + (ox, oy). Assumes
+// destination_frame is the frame tracked by odometry.
+bool LaserscanMerger::motionCompensation(const ros::Time &from, const ros::Time &to, float &c, float &s, float &ox, float &oy)
+{
+	c = 1.0f;
+	s = 0.0f;
+	ox = 0.0f;
+	oy = 0.0f;
+
+	OdomSample pf, pt;
+	if (from == to || !odomPoseAt(from, pf) || !odomPoseAt(to, pt))
+		return false;
+
+	double dyaw = pf.yaw - pt.yaw;
+	double ct = cos(pt.yaw);
+	double st = sin(pt.yaw);
+	double dx = pf.x - pt.x;
+	double dy = pf.y - pt.y;
+	c = cos(dyaw);
+	s = sin(dyaw);
+	ox = ct * dx + st * dy;
+	oy = -st * dx + ct * dy;
+	return true;
+}
+
+void LaserscanMerger::pointcloud_to_laserscan(const Eigen::MatrixXf &points, pcl::PCLPointCloud2 *merged_cloud)
 {
 	sensor_msgs::LaserScanPtr output(new sensor_msgs::LaserScan());
 	output->header = pcl_conversions::fromPCL(merged_cloud->header);
@@ -254,6 +580,138 @@ void LaserscanMerger::pointcloud_to_laserscan(Eigen::MatrixXf points, pcl::PCLPo
 	laser_scan_publisher_.publish(output);
 }
 
+bool LaserscanMerger::updateBeamTable(BeamTable &table, const sensor_msgs::LaserScan &scan)
+{
+	// The lidars are rigidly mounted, so the extrinsic is looked up once
+	// (without waiting) and reused for every following scan
+	if (!table.valid || table.frame_id != scan.header.frame_id)
+	{
+		tf::StampedTransform transform;
+		try
+		{
+			tfListener_.lookupTransform(destination_frame, scan.header.frame_id, ros::Time(0), transform);
+		}
+		catch (tf::TransformException ex)
+		{
+			ROS_WARN_THROTTLE(1.0, "No transform from %s to %s yet: %s", scan.header.frame_id.c_str(), destination_frame.c_str(), ex.what());
+			return false;
+		}
+
+		const tf::Matrix3x3 &basis = transform.getBasis();
+		table.rot[0][0] = basis[0][0];
+		table.rot[0][1] = basis[0][1];
+		table.rot[1][0] = basis[1][0];
+		table.rot[1][1] = basis[1][1];
+		table.tx = transform.getOrigin().x();
+		table.ty = transform.getOrigin().y();
+		table.frame_id = scan.header.frame_id;
+		table.dir_x.clear();
+		table.valid = true;
+	}
+
+	// Rebuild the direction table only when the scan geometry changes
+	if (table.dir_x.size() != scan.ranges.size() || table.angle_min != scan.angle_min || table.angle_increment != scan.angle_increment)
+	{
+		size_t n = scan.ranges.size();
+		table.dir_x.resize(n);
+		table.dir_y.resize(n);
+		for (size_t j = 0; j < n; j++)
+		{
+			double a = scan.angle_min + j * scan.angle_increment;
+			double c = cos(a);
+			double s = sin(a);
+			table.dir_x[j] = table.rot[0][0] * c + table.rot[0][1] * s;
+			table.dir_y[j] = table.rot[1][0] * c + table.rot[1][1] * s;
+		}
+		table.angle_min = scan.angle_min;
+		table.angle_increment = scan.angle_increment;
+	}
+
+	return true;
+}
+
+void LaserscanMerger::directMerge(const ros::Time &stamp)
+{
+	sensor_msgs::LaserScanPtr output(new sensor_msgs::LaserScan());
+	output->header = scans[merge_inputs[0]]->header;
+	output->header.stamp = stamp;
+	output->header.frame_id = destination_frame;
+	output->angle_min = this->angle_min;
+	output->angle_max = this->angle_max;
+	output->angle_increment = this->angle_increment;
+	output->time_increment = this->time_increment;
+	output->scan_time = this->scan_time;
+	output->range_min = this->range_min;
+	output->range_max = this->range_max;
+
+	uint32_t ranges_size = std::ceil((output->angle_max - output->angle_min) / output->angle_increment);
+	output->ranges.assign(ranges_size, output->range_max + 1.0);
+
+	const float out_angle_min = output->angle_min;
+	const float out_angle_max = output->angle_max;
+	const float inv_increment = 1.0f / output->angle_increment;
+	const float range_min_sq = output->range_min * output->range_min;
+	float *out = output->ranges.data();
+
+	for (int k = 0; k < merge_inputs.size(); k++)
+	{
+		const int i = merge_inputs[k];
+		const sensor_msgs::LaserScan &scan = *scans[i];
+		const BeamTable &table = beam_tables[i];
+		const size_t n = scan.ranges.size();
+		const float *ranges = scan.ranges.data();
+		const float *dir_x = table.dir_x.data();
+		const float *dir_y = table.dir_y.data();
+		const float tx = table.tx;
+		const float ty = table.ty;
+
+		// Move older scans to where the base is at the output stamp
+		float mc, ms, mx, my;
+		motionCompensation(stamps[i], stamp, mc, ms, mx, my);
+
+		beam_x.resize(n);
+		beam_y.resize(n);
+		beam_angle.resize(n);
+		float *x = beam_x.data();
+		float *y = beam_y.data();
+		float *angle = beam_angle.data();
+
+		// Project beams into the destination frame (straight-line, vectorizable)
+		for (size_t j = 0; j < n; j++)
+		{
+			const float px = ranges[j] * dir_x[j] + tx;
+			const float py = ranges[j] * dir_y[j] + ty;
+			x[j] = mc * px - ms * py + mx;
+			y[j] = ms * px + mc * py + my;
+			angle[j] = fast_atan2(y[j], x[j]);
+		}
+
+		// Bin into the output scan, keeping the closest return per bin
+		for (size_t j = 0; j < n; j++)
+		{
+			const float r = ranges[j];
+			// same validity test as laser_geometry's projection
+			if (!(r >= scan.range_min && r < scan.range_max))
+				continue;
+
+			const float range_sq = x[j] * x[j] + y[j] * y[j];
+			if (range_sq < range_min_sq)
+				continue;
+
+			if (angle[j] < out_angle_min || angle[j] > out_angle_max)
+				continue;
+			uint32_t index = (angle[j] - out_angle_min) * inv_increment;
+			if (index >= ranges_size)
+				continue;
+
+			if (out[index] * out[index] > range_sq)
+				out[index] = sqrtf(range_sq);
+		}
+	}
+
+	laser_scan_publisher_.publish(output);
+}
+
 int main(int argc, char **argv)
 {
 	ros::init(argc, argv, "laser_multi_merger");
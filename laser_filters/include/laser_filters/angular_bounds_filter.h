@@ -37,12 +37,12 @@
 #ifndef LASER_SCAN_ANGULAR_BOUNDS_FILTER_H
 #define LASER_SCAN_ANGULAR_BOUNDS_FILTER_H
 
-#include <filters/filter_base.h>
+#include <laser_filters/in_place_filter.h>
 #include <sensor_msgs/LaserScan.h>
 
 namespace laser_filters
 {
-  class LaserScanAngularBoundsFilter : public filters::FilterBase<sensor_msgs::LaserScan>
+  class LaserScanAngularBoundsFilter : public InPlaceLaserFilter
   {
     public:
       double lower_angle_;
@@ -63,7 +63,14 @@ namespace laser_filters
 
       virtual ~LaserScanAngularBoundsFilter(){}
 
+      // Beam i is read before beam count <= i is written, so input_scan and
+      // filtered_scan may be the same scan.
+      bool updateInPlace(sensor_msgs::LaserScan& scan){
+        return update(scan, scan);
+      }
+
       bool update(const sensor_msgs::LaserScan& input_scan, sensor_msgs::LaserScan& filtered_scan){
+        const size_t input_size = input_scan.ranges.size();
         filtered_scan.ranges.resize(input_scan.ranges.size());
         filtered_scan.intensities.resize(input_scan.intensities.size());
 
@@ -139,7 +146,7 @@ namespace laser_filters
         if(input_scan.intensities.size() >= count)
           filtered_scan.intensities.resize(count);
 
-        ROS_DEBUG("Filtered out %d points from the laser scan.", (int)input_scan.ranges.size() - (int)count);
+        ROS_DEBUG("Filtered out %d points from the laser scan.", (int)input_size - (int)count);
 
         return true;
 
@@ -37,12 +37,14 @@
 #ifndef LASER_SCAN_ANGULAR_BOUNDS_FILTER_IN_PLACE_H
 #define LASER_SCAN_ANGULAR_BOUNDS_FILTER_IN_PLACE_H
 
-#include <filters/filter_base.h>
+#include <laser_filters/fusable_filter.h>
 #include <sensor_msgs/LaserScan.h>
 
+#include <algorithm>
+
 namespace laser_filters
 {
-  class LaserScanAngularBoundsFilterInPlace : public filters::FilterBase<sensor_msgs::LaserScan>
+  class LaserScanAngularBoundsFilterInPlace : public FusableLaserFilter
   {
     public:
       double lower_angle_;
@@ -61,30 +63,59 @@ namespace laser_filters
         return true;
       }
 
-      virtual ~LaserScanAngularBoundsFilterInPlace(){}
+      LaserScanAngularBoundsFilterInPlace()
+        : first_(0), last_(0), replacement_(0), cached_angle_min_(0), cached_angle_increment_(0),
+          cached_size_(0), cached_lower_(0), cached_upper_(0){}
 
-      bool update(const sensor_msgs::LaserScan& input_scan, sensor_msgs::LaserScan& filtered_scan){
-        filtered_scan = input_scan; //copy entire message
+      virtual ~LaserScanAngularBoundsFilterInPlace(){}
 
-        double current_angle = input_scan.angle_min;
-        unsigned int count = 0;
-        //loop through the scan and remove ranges at angles between lower_angle_ and upper_angle_
-        for(unsigned int i = 0; i < input_scan.ranges.size(); ++i){
-          if((current_angle > lower_angle_) && (current_angle < upper_angle_)){
-            filtered_scan.ranges[i] = input_scan.range_max + 1.0;
-            if(i < filtered_scan.intensities.size()){
-              filtered_scan.intensities[i] = 0.0;
+      // The angles only grow (or only shrink) along the scan, so the beams
+      // between lower_angle_ and upper_angle_ are one run, found from the
+      // header and kept for as long as the scan geometry stays the same.
+      bool beginScan(const sensor_msgs::LaserScan& scan){
+        if(scan.angle_min != cached_angle_min_ || scan.angle_increment != cached_angle_increment_ ||
+           scan.ranges.size() != cached_size_ || lower_angle_ != cached_lower_ || upper_angle_ != cached_upper_){
+          double current_angle = scan.angle_min;
+          first_ = last_ = 0;
+          for(unsigned int i = 0; i < scan.ranges.size(); ++i){
+            if((current_angle > lower_angle_) && (current_angle < upper_angle_)){
+              if(first_ == last_)
+                first_ = i;
+              last_ = i + 1;
             }
-            count++;
+            current_angle += scan.angle_increment;
           }
-          current_angle += input_scan.angle_increment;
+          cached_angle_min_ = scan.angle_min;
+          cached_angle_increment_ = scan.angle_increment;
+          cached_size_ = scan.ranges.size();
+          cached_lower_ = lower_angle_;
+          cached_upper_ = upper_angle_;
         }
+        replacement_ = scan.range_max + 1.0;
 
-        ROS_DEBUG("Filtered out %u points from the laser scan.", count);
-
+        ROS_DEBUG("Filtered out %u points from the laser scan.", (unsigned int)(last_ - first_));
         return true;
+      }
 
+      //remove ranges at angles between lower_angle_ and upper_angle_
+      void filterBeams(sensor_msgs::LaserScan& filtered_scan, size_t begin, size_t end){
+        const size_t from = std::max(begin, first_);
+        const size_t to = std::min(end, last_);
+        for(size_t i = from; i < to; ++i){
+          filtered_scan.ranges[i] = replacement_;
+        }
+        for(size_t i = from; i < to && i < filtered_scan.intensities.size(); ++i){
+          filtered_scan.intensities[i] = 0.0;
+        }
       }
+
+    private:
+      size_t first_, last_;  // beams in the bounds
+      float replacement_;
+
+      float cached_angle_min_, cached_angle_increment_;
+      size_t cached_size_;
+      double cached_lower_, cached_upper_;
   };
 };
 #endif
@@ -42,6 +42,7 @@
 #include "filters/mean.h"
 #include "filters/filter_chain.h"
 #include "boost/thread/mutex.hpp"
+#include "laser_filters/temporal_median_filter.h"
 
 namespace laser_filters{
 
@@ -76,6 +77,10 @@ private:
   
   filters::MultiChannelFilterChain<float> * range_filter_;
   filters::MultiChannelFilterChain<float> * intensity_filter_;
+
+  // used instead of a chain that is just a median filter
+  TemporalMedian range_median_;
+  TemporalMedian intensity_median_;
   
 };
 
@@ -47,35 +47,35 @@
 #ifndef BOXFILTER_H
 #define BOXFILTER_H
 
-#include <filters/filter_base.h>
+#include <laser_filters/fusable_filter.h>
 
 #include <sensor_msgs/LaserScan.h>
-#include <sensor_msgs/point_cloud_conversion.h>
-#include <laser_geometry/laser_geometry.h>
 
 #include <tf/transform_datatypes.h>
 #include <tf/transform_listener.h>
 
+#include <vector>
+
 
 namespace laser_filters
 {
 /**
  * @brief This is a filter that removes points in a laser scan inside of a cartesian box.
+ *
+ * Each beam is taken to the box frame with the transform at its own time,
+ * interpolated between the transforms at the first and the last beam.
  */
-class LaserScanBoxFilter : public filters::FilterBase<sensor_msgs::LaserScan>
+class LaserScanBoxFilter : public FusableLaserFilter
 {
   public:
     LaserScanBoxFilter();
     bool configure();
 
-    bool update(
-      const sensor_msgs::LaserScan& input_scan,
-      sensor_msgs::LaserScan& filtered_scan);
+    bool beginScan(const sensor_msgs::LaserScan& scan);
+    void filterBeams(sensor_msgs::LaserScan& scan, size_t begin, size_t end);
 
   private:
-    bool inBox(tf::Point &point);
     std::string box_frame_;
-    laser_geometry::LaserProjection projector_;
     
     // tf listener to transform scans into the box_frame
     tf::TransformListener tf_; 
@@ -84,6 +84,16 @@ class LaserScanBoxFilter : public filters::FilterBase<sensor_msgs::LaserScan>
     tf::Point min_, max_; 
     bool invert_filter;
     bool up_and_running_;
+
+    // this scan: rows of the laser to box frame transform at the first
+    // beam, their change per beam, and whether to keep the scan as it is
+    float start_[3][3];
+    float step_[3][3];
+    bool skip_;
+
+    // beam directions, cached for the last scan geometry
+    std::vector<float> cos_, sin_;
+    float cached_angle_min_, cached_angle_increment_;
 };
 
 }
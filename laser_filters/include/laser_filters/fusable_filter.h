@@ -0,0 +1,84 @@
+/*********************************************************************
+* Software License Agreement (BSD License)
+*
+*  Copyright (c) 2008, Willow Garage, Inc.
+*  All rights reserved.
+*
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions
+*  are met:
+*
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of the Willow Garage nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+*
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+*  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+*  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+*  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+*  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+*  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+*  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+*  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+*  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+*  POSSIBILITY OF SUCH DAMAGE.
+*
+*********************************************************************/
+#ifndef LASER_FILTERS_FUSABLE_FILTER_H
+#define LASER_FILTERS_FUSABLE_FILTER_H
+
+#include <laser_filters/in_place_filter.h>
+#include <sensor_msgs/LaserScan.h>
+
+namespace laser_filters
+{
+/**
+ * @b A laser scan filter that works on consecutive blocks of beams.
+ *
+ * A FusedFilterGroup runs several of these over a scan in a single pass:
+ * each block of beams goes through every filter of the group while it is
+ * still in cache. A filter whose result for a beam depends on the beams
+ * after it says how many it needs with lookahead(), and gets each block
+ * only once the filters before it are done with those beams too.
+ */
+class FusableLaserFilter : public InPlaceLaserFilter
+{
+public:
+  virtual ~FusableLaserFilter(){}
+
+  /** Number of beams past the end of a block that filterBeams() reads. */
+  virtual size_t lookahead() const { return 0; }
+
+  /**
+   * Per scan setup, before the first filterBeams() for scan. In a group this
+   * runs before the filters ahead have touched the beams, so it may only use
+   * the header and the array sizes. Returning false fails the scan.
+   */
+  virtual bool beginScan(const sensor_msgs::LaserScan& scan) { return true; }
+
+  /**
+   * Filter beams [begin, end) of scan. Blocks come in order and cover the
+   * scan. Beams [begin, end + lookahead()) hold this filter's input; beams
+   * before begin may already have been changed by the filters after it.
+   */
+  virtual void filterBeams(sensor_msgs::LaserScan& scan, size_t begin, size_t end) = 0;
+
+  bool updateInPlace(sensor_msgs::LaserScan& scan)
+  {
+    if (!beginScan(scan))
+      return false;
+    filterBeams(scan, 0, scan.ranges.size());
+    return true;
+  }
+};
+}
+
+#endif // LASER_FILTERS_FUSABLE_FILTER_H
@@ -0,0 +1,73 @@
+/*********************************************************************
+* Software License Agreement (BSD License)
+*
+*  Copyright (c) 2008, Willow Garage, Inc.
+*  All rights reserved.
+*
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions
+*  are met:
+*
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of the Willow Garage nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+*
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+*  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+*  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+*  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+*  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+*  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+*  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+*  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+*  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+*  POSSIBILITY OF SUCH DAMAGE.
+*
+*********************************************************************/
+#ifndef LASER_FILTERS_FUSED_FILTER_GROUP_H
+#define LASER_FILTERS_FUSED_FILTER_GROUP_H
+
+#include <laser_filters/fusable_filter.h>
+#include <sensor_msgs/LaserScan.h>
+
+#include <vector>
+
+namespace laser_filters
+{
+/**
+ * @b Consecutive fusable filters run as one pass over the scan.
+ *
+ * The scan is cut into blocks of kBlockSize beams and each block goes through
+ * all the filters before the next one is loaded, instead of every filter
+ * walking the whole scan in turn. A filter with a lookahead lags the one
+ * before it by that many beams. The result is the same as running the
+ * filters one after the other.
+ */
+class FusedFilterGroup
+{
+public:
+  static const size_t kBlockSize = 256;
+
+  /** Append filter; the group does not own it. */
+  void add(FusableLaserFilter* filter);
+
+  bool empty() const { return filters_.empty(); }
+  size_t size() const { return filters_.size(); }
+
+  bool update(sensor_msgs::LaserScan& scan);
+
+private:
+  std::vector<FusableLaserFilter*> filters_;
+  std::vector<size_t> done_;  // beams each filter has finished this scan
+};
+}
+
+#endif // LASER_FILTERS_FUSED_FILTER_GROUP_H
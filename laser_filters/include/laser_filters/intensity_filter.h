@@ -39,22 +39,24 @@
 #pragma once
 
 #include <dynamic_reconfigure/server.h>
-#include <filters/filter_base.h>
+#include <laser_filters/fusable_filter.h>
 #include <laser_filters/IntensityFilterConfig.h>
 #include <sensor_msgs/LaserScan.h>
 
 namespace laser_filters
 {
-class LaserScanIntensityFilter : public filters::FilterBase<sensor_msgs::LaserScan>
+class LaserScanIntensityFilter : public FusableLaserFilter
 {
 public:
   LaserScanIntensityFilter();
   bool configure();
-  bool update(const sensor_msgs::LaserScan& input_scan, sensor_msgs::LaserScan& output_scan);
+  void filterBeams(sensor_msgs::LaserScan& scan, size_t begin, size_t end);
+
+protected:
+  void reconfigureCB(IntensityFilterConfig& config, uint32_t level);
 
 private:
   std::shared_ptr<dynamic_reconfigure::Server<IntensityFilterConfig>> dyn_server_;
-  void reconfigureCB(IntensityFilterConfig& config, uint32_t level);
   boost::recursive_mutex own_mutex_;
 
   IntensityFilterConfig config_ = IntensityFilterConfig::__getDefault__();
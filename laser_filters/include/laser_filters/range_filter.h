@@ -40,13 +40,13 @@
 **/
 
 
-#include "filters/filter_base.h"
+#include "laser_filters/fusable_filter.h"
 #include "sensor_msgs/LaserScan.h"
 
 namespace laser_filters
 {
 
-class LaserScanRangeFilter : public filters::FilterBase<sensor_msgs::LaserScan>
+class LaserScanRangeFilter : public FusableLaserFilter
 {
 public:
 
@@ -84,31 +84,27 @@ public:
 
   }
 
-  bool update(const sensor_msgs::LaserScan& input_scan, sensor_msgs::LaserScan& filtered_scan)
+  bool beginScan(const sensor_msgs::LaserScan& scan)
   {
     if (use_message_range_limits_)
     {
-      lower_threshold_ = input_scan.range_min;
-      upper_threshold_ = input_scan.range_max;
+      lower_threshold_ = scan.range_min;
+      upper_threshold_ = scan.range_max;
     }
-    filtered_scan = input_scan;
-    for (unsigned int i=0;
-         i < input_scan.ranges.size();
-         i++) // Need to check ever reading in the current scan
-    {
-
-      if (filtered_scan.ranges[i] <= lower_threshold_)
-      {
-        filtered_scan.ranges[i] = lower_replacement_value_;
+    return true;
+  }
 
-      }
-      else if (filtered_scan.ranges[i] >= upper_threshold_)
-      {
-        filtered_scan.ranges[i] = upper_replacement_value_;
-      }
+  void filterBeams(sensor_msgs::LaserScan& filtered_scan, size_t begin, size_t end)
+  {
+    // selects rather than branches, so the loop vectorizes
+    const double lower = lower_threshold_, upper = upper_threshold_;
+    const float lower_value = lower_replacement_value_, upper_value = upper_replacement_value_;
+    float* ranges = filtered_scan.ranges.data();
+    for (size_t i = begin; i < end; i++)
+    {
+      const float range = ranges[i];
+      ranges[i] = range <= lower ? lower_value : range >= upper ? upper_value : range;
     }
-
-    return true;
   }
 } ;
 
@@ -0,0 +1,98 @@
+/*********************************************************************
+* Software License Agreement (BSD License)
+*
+*  Copyright (c) 2008, Willow Garage, Inc.
+*  All rights reserved.
+*
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions
+*  are met:
+*
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of the Willow Garage nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+*
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+*  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+*  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+*  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+*  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+*  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+*  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+*  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+*  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+*  POSSIBILITY OF SUCH DAMAGE.
+*
+*********************************************************************/
+#ifndef LASER_FILTERS_SCAN_FILTER_CHAIN_H
+#define LASER_FILTERS_SCAN_FILTER_CHAIN_H
+
+#include <filters/filter_base.h>
+#include <laser_filters/fused_filter_group.h>
+#include <laser_filters/in_place_filter.h>
+#include <pluginlib/class_loader.h>
+#include <ros/ros.h>
+#include <sensor_msgs/LaserScan.h>
+
+#include <boost/shared_ptr.hpp>
+
+#include <string>
+#include <vector>
+
+namespace laser_filters
+{
+/**
+ * @b A chain of laser scan filters that filters one scan in place.
+ *
+ * Takes the same configuration as filters::FilterChain<sensor_msgs::LaserScan>.
+ * Filters derived from InPlaceLaserFilter modify the scan directly; any
+ * other filter writes into a scratch scan that is then swapped with the
+ * caller's, so the chain itself never copies a scan between filters.
+ *
+ * In fused mode, runs of consecutive FusableLaserFilter filters (range,
+ * angular bounds in place, intensity, box, speckle) are each run as one
+ * FusedFilterGroup pass over the scan; the others run on their own as above.
+ */
+class ScanFilterChain
+{
+public:
+  ScanFilterChain();
+  ~ScanFilterChain();
+
+  /** Load the filters listed under param_name in node's namespace. */
+  bool configure(const std::string& param_name, ros::NodeHandle node = ros::NodeHandle(), bool fuse = false);
+
+  /** Run every filter on scan, stopping at the first one that fails. */
+  bool update(sensor_msgs::LaserScan& scan);
+
+  void clear();
+
+private:
+  typedef filters::FilterBase<sensor_msgs::LaserScan> Filter;
+
+  // A filter on its own, or a fused group of filters when filter is NULL.
+  struct Stage
+  {
+    Filter* filter;
+    InPlaceLaserFilter* in_place;
+    FusedFilterGroup fused;
+  };
+
+  // declared first so it outlives the filters it loaded
+  pluginlib::ClassLoader<Filter> loader_;
+  std::vector<boost::shared_ptr<Filter> > filters_;
+  std::vector<Stage> stages_;
+  sensor_msgs::LaserScan scratch_;
+  bool configured_;
+};
+}
+
+#endif // LASER_FILTERS_SCAN_FILTER_CHAIN_H
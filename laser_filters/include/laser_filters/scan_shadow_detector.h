@@ -39,6 +39,8 @@
 #ifndef SCAN_SHADOW_DETECTOR_H
 #define SCAN_SHADOW_DETECTOR_H
 
+#include <cmath>
+
 namespace laser_filters
 {
 class ScanShadowDetector
@@ -59,21 +61,34 @@ public:
   }
   bool isShadow(const float r1, const float r2, const float included_angle)
   {
-    const float perpendicular_y_ = r2 * sinf(included_angle);
-    const float perpendicular_x_ = r1 - r2 * cosf(included_angle);
-    const float perpendicular_tan_ = fabs(perpendicular_y_) / perpendicular_x_;
+    return isShadow(r1, r2, sinf(included_angle), cosf(included_angle));
+  }
 
-    if (perpendicular_tan_ > 0)
-    {
-      if (perpendicular_tan_ < min_angle_tan_)
-        return true;
-    }
-    else
+  /** Same test with the sine and cosine of the included angle given. */
+  bool isShadow(const float r1, const float r2, const float included_angle_sin, const float included_angle_cos) const
+  {
+    const float perpendicular_y_ = r2 * included_angle_sin;
+    const float perpendicular_x_ = r1 - r2 * included_angle_cos;
+    const float perpendicular_tan_ = fabsf(perpendicular_y_) / perpendicular_x_;
+
+    // no branches, so that the loop below vectorizes
+    const bool positive = perpendicular_tan_ > 0;
+    return (positive & (perpendicular_tan_ < min_angle_tan_)) | (!positive & (perpendicular_tan_ > max_angle_tan_));
+  }
+
+  /** Mark shadow[i] for every i in [begin, end) where beam i is shadowed
+   * against beam i + offset, the two being included_angle apart. Leaves
+   * the other entries of shadow as they are.
+   */
+  void markShadows(const float* ranges, int begin, int end, int offset,
+                   const float included_angle_sin, const float included_angle_cos,
+                   unsigned char* shadow) const
+  {
+    const float* neighbors = ranges + offset;
+    for (int i = begin; i < end; i++)
     {
-      if (perpendicular_tan_ > max_angle_tan_)
-        return true;
+      shadow[i] |= isShadow(ranges[i], neighbors[i], included_angle_sin, included_angle_cos);
     }
-    return false;
   }
 };
 }
@@ -37,9 +37,11 @@
 #ifndef LASER_SCAN_SHADOWS_FILTER_H
 #define LASER_SCAN_SHADOWS_FILTER_H
 
-#include <set>
+#include <algorithm>
+#include <limits>
+#include <vector>
 
-#include "filters/filter_base.h"
+#include "laser_filters/in_place_filter.h"
 #include "laser_filters/scan_shadow_detector.h"
 #include <sensor_msgs/LaserScan.h>
 #include <angles/angles.h>
@@ -52,7 +54,7 @@ namespace laser_filters
 /** @b ScanShadowsFilter is a simple filter that filters shadow points in a laser scan line 
  */
 
-class ScanShadowsFilter : public filters::FilterBase<sensor_msgs::LaserScan>
+class ScanShadowsFilter : public InPlaceLaserFilter
 {
 public:
   double laser_max_range_;        // Used in laser scan projection
@@ -161,56 +163,102 @@ public:
    * and window. {min,max}_angle specify the allowed angle interval (in degrees)
    * between the created lines (see getAngleWithViewPoint). Window specifies how many
    * consecutive measurements to take into account for one point.
-   * \param scan_in the input LaserScan message
-   * \param scan_out the output LaserScan message
+   *
+   * Runs in O(N * window): the shadow test is evaluated one neighbor offset
+   * at a time over the whole scan with the sine and cosine of that offset
+   * precomputed, and a farther neighbor of a shadow point is removed when
+   * the closest shadow point within neighbors of it is closer than it,
+   * found with a running minimum instead of visiting every pair.
+   * \param scan the LaserScan message to filter
    */
-  bool update(const sensor_msgs::LaserScan& scan_in, sensor_msgs::LaserScan& scan_out)
+  bool updateInPlace(sensor_msgs::LaserScan& scan)
   {
     boost::recursive_mutex::scoped_lock lock(own_mutex_);
 
-    // copy across all data first
-    scan_out = scan_in;
+    const int size = scan.ranges.size();
+    float* ranges = scan.ranges.data();
+    const int window = std::min(window_, size - 1);
+    const int neighbors = std::min(neighbors_, size - 1);
 
-    std::set<int> indices_to_delete;
-    // For each point in the current line scan
-    for (unsigned int i = 0; i < scan_in.ranges.size(); i++)
+    if (angle_increment_ != scan.angle_increment || (int)offset_sin_.size() <= window)
     {
-      for (int y = -window_; y < window_ + 1; y++)
+      angle_increment_ = scan.angle_increment;
+      offset_sin_.resize(window + 1);
+      offset_cos_.resize(window + 1);
+      for (int y = 1; y <= window; y++)
       {
-        int j = i + y;
-        if (j < 0 || j >= (int)scan_in.ranges.size() || (int)i == j)
-        {  // Out of scan bounds or itself
-          continue;
-        }
-
-        if (shadow_detector_.isShadow(
-                scan_in.ranges[i], scan_in.ranges[j], y * scan_in.angle_increment))
-        {
-          for (int index = std::max<int>(i - neighbors_, 0); index <= std::min<int>(i + neighbors_, (int)scan_in.ranges.size() - 1); index++)
-          {
-            if (scan_in.ranges[i] < scan_in.ranges[index])
-            {  // delete neighbor if they are farther away (note not self)
-              indices_to_delete.insert(index);
-            }
-          }
-          if (remove_shadow_start_point_)
-          {
-            indices_to_delete.insert(i);
-          }
-        }
+        offset_sin_[y] = sinf(y * scan.angle_increment);
+        offset_cos_[y] = cosf(y * scan.angle_increment);
       }
     }
 
-    ROS_DEBUG("ScanShadowsFilter removing %d Points from scan with min angle: %.2f, max angle: %.2f, neighbors: %d, and window: %d",
-              (int)indices_to_delete.size(), min_angle_, max_angle_, neighbors_, window_);
-    for (std::set<int>::iterator it = indices_to_delete.begin(); it != indices_to_delete.end(); ++it)
+    // The test only uses the magnitude of the sine, so the neighbors on
+    // either side at the same offset share it.
+    shadow_.assign(size, 0);
+    for (int y = 1; y <= window; y++)
+    {
+      shadow_detector_.markShadows(ranges, 0, size - y, y, offset_sin_[y], offset_cos_[y], shadow_.data());
+      shadow_detector_.markShadows(ranges, y, size, -y, offset_sin_[y], offset_cos_[y], shadow_.data());
+    }
+
+    // Closest shadow point within neighbors of each beam. A shadow point is
+    // never NaN, beams that are not shadow points do not count.
+    closest_shadow_.assign(size, std::numeric_limits<float>::infinity());
+    if (neighbors > 0)
+      closestShadows(ranges, size, neighbors);
+
+    int removed = 0;
+    const float nan = std::numeric_limits<float>::quiet_NaN();
+    for (int i = 0; i < size; i++)
     {
-      scan_out.ranges[*it] = std::numeric_limits<float>::quiet_NaN();  // Failed test to set the ranges to invalid value
+      // delete neighbor if they are farther away (note not self)
+      const bool remove = (closest_shadow_[i] < ranges[i]) | (remove_shadow_start_point_ & (shadow_[i] != 0));
+      removed += remove;
+      ranges[i] = remove ? nan : ranges[i];
     }
+
+    ROS_DEBUG("ScanShadowsFilter removing %d Points from scan with min angle: %.2f, max angle: %.2f, neighbors: %d, and window: %d",
+              removed, min_angle_, max_angle_, neighbors_, window_);
     return true;
   }
 
-  ////////////////////////////////////////////////////////////////////////////////
+private:
+  float angle_increment_ = 0.0f;
+  std::vector<float> offset_sin_, offset_cos_;
+  std::vector<unsigned char> shadow_;
+  std::vector<float> closest_shadow_;
+  std::vector<float> block_min_, block_suffix_min_;
+
+  /** Running minimum of the shadow point ranges over the window
+   * [i - neighbors, i + neighbors], in O(size) with the van Herk/Gil-Werman
+   * block decomposition.
+   */
+  void closestShadows(const float* ranges, const int size, const int neighbors)
+  {
+    const int width = 2 * neighbors + 1;
+    const int padded = size + 2 * neighbors;
+    const float inf = std::numeric_limits<float>::infinity();
+
+    // block_min_ holds the minimum from the start of the block, block_suffix_min_
+    // the minimum to its end, over the shadow ranges padded with inf
+    block_min_.resize(padded);
+    block_suffix_min_.resize(padded);
+    for (int k = 0; k < padded; k++)
+    {
+      const int i = k - neighbors;
+      const float value = (i >= 0 && i < size && shadow_[i]) ? ranges[i] : inf;
+      block_min_[k] = (k % width == 0) ? value : std::min(block_min_[k - 1], value);
+      block_suffix_min_[k] = value;
+    }
+    for (int k = padded - 2; k >= 0; k--)
+    {
+      if ((k + 1) % width != 0)
+        block_suffix_min_[k] = std::min(block_suffix_min_[k], block_suffix_min_[k + 1]);
+    }
+
+    for (int i = 0; i < size; i++)
+      closest_shadow_[i] = std::min(block_suffix_min_[i], block_min_[i + width - 1]);
+  }
 };
 }
 
@@ -0,0 +1,88 @@
+/*
+ * Copyright (c) 2008, Willow Garage, Inc.
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef LASER_FILTERS_SCAN_TO_SCAN_FILTER_CHAIN_H
+#define LASER_FILTERS_SCAN_TO_SCAN_FILTER_CHAIN_H
+
+#include "ros/ros.h"
+#include "sensor_msgs/LaserScan.h"
+#include "message_filters/subscriber.h"
+#include "tf/message_filter.h"
+#include "tf/transform_listener.h"
+#include "laser_filters/scan_filter_chain.h"
+
+namespace laser_filters
+{
+/**
+ * @b Filters scan into scan_filtered, as the scan_to_scan_filter_chain node
+ * and the laser_filters/ScanToScanFilterChain nodelet.
+ *
+ * Each scan is copied once into a message the chain filters in place, and
+ * that message is published by pointer.
+ */
+class ScanToScanFilterChain
+{
+protected:
+  // Our NodeHandle
+  ros::NodeHandle nh_;
+  ros::NodeHandle private_nh_;
+
+  // Components for tf::MessageFilter
+  tf::TransformListener *tf_;
+  message_filters::Subscriber<sensor_msgs::LaserScan> scan_sub_;
+  tf::MessageFilter<sensor_msgs::LaserScan> *tf_filter_;
+  double tf_filter_tolerance_;
+
+  // Filter Chain
+  ScanFilterChain filter_chain_;
+
+  // Components for publishing
+  sensor_msgs::LaserScanPtr msg_;
+  ros::Publisher output_pub_;
+
+  // Deprecation helpers
+  ros::Timer deprecation_timer_;
+  bool  using_filter_chain_deprecated_;
+
+public:
+  // Constructor
+  ScanToScanFilterChain(ros::NodeHandle nh = ros::NodeHandle(), ros::NodeHandle private_nh = ros::NodeHandle("~"));
+
+  // Destructor
+  ~ScanToScanFilterChain();
+
+  // Deprecation warning callback
+  void deprecation_warn(const ros::TimerEvent& e);
+
+  // Callback
+  void callback(const sensor_msgs::LaserScan::ConstPtr& msg_in);
+};
+}
+
+#endif // LASER_FILTERS_SCAN_TO_SCAN_FILTER_CHAIN_H
@@ -41,7 +41,7 @@
 #define SPECKLE_FILTER_H
 
 #include <dynamic_reconfigure/server.h>
-#include <filters/filter_base.h>
+#include <laser_filters/fusable_filter.h>
 #include <laser_filters/SpeckleFilterConfig.h>
 #include <sensor_msgs/LaserScan.h>
 
@@ -92,12 +92,11 @@ class RadiusOutlierWindowValidator : public WindowValidator
     for (int y = -(int)window; y < (int)window + 1 && num_neighbors < (int)window; y++)
     {
       int j = idx + y;
-      r2 = scan.ranges[j];
-
-      if (j < 0 || j >= static_cast<int>(scan.ranges.size()) || idx == j || std::isnan(r2))
+      if (j < 0 || j >= static_cast<int>(scan.ranges.size()) || idx == j || std::isnan(scan.ranges[j]))
       {  // Out of scan bounds or itself or infinity
         continue;
       }
+      r2 = scan.ranges[j];
 
       // Explanation:
       //
@@ -151,22 +150,39 @@ class RadiusOutlierWindowValidator : public WindowValidator
 
 /**
  * @brief This is a filter that removes speckle points in a laser scan based on consecutive ranges
+ *
+ * A point is kept when one of the windows of filter_window points it is in
+ * is valid. The windows of the beams in a block reach up to filter_window
+ * beams past it, and the radius outlier windows as far before it, so the
+ * filter keeps its own copy of its input to look back at.
  */
-class LaserScanSpeckleFilter : public filters::FilterBase<sensor_msgs::LaserScan>
+class LaserScanSpeckleFilter : public FusableLaserFilter
 {
 public:
   LaserScanSpeckleFilter();
   ~LaserScanSpeckleFilter();
   bool configure();
-  bool update(const sensor_msgs::LaserScan& input_scan, sensor_msgs::LaserScan& output_scan);
+
+  size_t lookahead() const;
+  bool beginScan(const sensor_msgs::LaserScan& scan);
+  void filterBeams(sensor_msgs::LaserScan& scan, size_t begin, size_t end);
+
+protected:
+  void reconfigureCB(laser_filters::SpeckleFilterConfig& config, uint32_t level);
 
 private:
   std::shared_ptr<dynamic_reconfigure::Server<laser_filters::SpeckleFilterConfig>> dyn_server_;
-  void reconfigureCB(laser_filters::SpeckleFilterConfig& config, uint32_t level);
   boost::recursive_mutex own_mutex_;
 
   SpeckleFilterConfig config_ = SpeckleFilterConfig::__getDefault__();
   WindowValidator* validator_;
+
+  // this scan
+  size_t window_;
+  size_t windows_;           // number of window start points
+  long last_valid_window_;   // start of the last valid window so far
+  sensor_msgs::LaserScan input_;
+  size_t copied_;            // beams of the scan copied into input_
 };
 }
 #endif /* speckle_filter.h */
@@ -0,0 +1,107 @@
+/*********************************************************************
+* Software License Agreement (BSD License)
+*
+*  Copyright (c) 2008, Willow Garage, Inc.
+*  All rights reserved.
+*
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions
+*  are met:
+*
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of the Willow Garage nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+*
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+*  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+*  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+*  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+*  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+*  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+*  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+*  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+*  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+*  POSSIBILITY OF SUCH DAMAGE.
+*
+*********************************************************************/
+#ifndef LASER_FILTERS_TEMPORAL_MEDIAN_FILTER_H
+#define LASER_FILTERS_TEMPORAL_MEDIAN_FILTER_H
+
+#include <laser_filters/in_place_filter.h>
+#include <sensor_msgs/LaserScan.h>
+
+#include <stdint.h>
+#include <vector>
+
+namespace laser_filters
+{
+/**
+ * @b Median of each channel over its last few observations, kept up to date
+ * one observation at a time.
+ *
+ * Every channel keeps its window sorted. A new observation takes the place of
+ * the one leaving the window and is moved into order, which for successive
+ * scans of the same scene is a move of a place or two, instead of sorting the
+ * whole window again. Until the window is full the median is over the
+ * observations so far; for an even count it is the lower of the two middle
+ * values, as with filters::MultiChannelMedianFilter. NaN sorts above +inf.
+ */
+class TemporalMedian
+{
+public:
+  explicit TemporalMedian(size_t window = 0);
+
+  /** Use the last window observations, forgetting the ones so far. 0 turns the median off. */
+  void configure(size_t window);
+
+  /** Forget the observations so far. */
+  void reset();
+
+  size_t window() const { return window_; }
+
+  /**
+   * Add values as the newest observation and replace each by the median of
+   * its channel. A different number of channels than last time starts over.
+   */
+  void update(std::vector<float>& values);
+
+private:
+  size_t window_;
+  size_t channels_;
+  size_t count_;   // observations in the window
+  size_t oldest_;  // history slot of the oldest once the window is full
+
+  // float bits mapped so that integer order is float order
+  std::vector<int32_t> sorted_;   // channels_ x window_, the first count_ in order
+  std::vector<int32_t> history_;  // window_ x channels_, by arrival
+};
+
+/**
+ * @b Median of each range and intensity over the last number_of_observations scans.
+ *
+ * The streaming counterpart of a LaserArrayFilter with median filter chains.
+ */
+class LaserScanTemporalMedianFilter : public InPlaceLaserFilter
+{
+public:
+  bool configure();
+  bool updateInPlace(sensor_msgs::LaserScan& scan);
+
+private:
+  TemporalMedian ranges_;
+  TemporalMedian intensities_;
+};
+
+/** True when config is a filter chain of just a multi channel median filter, with its window. */
+bool isMedianFilterChain(XmlRpc::XmlRpcValue& config, int& window);
+}
+
+#endif // LASER_FILTERS_TEMPORAL_MEDIAN_FILTER_H
@@ -52,18 +52,34 @@ bool LaserArrayFilter::configure()
   
   if (range_filter_)
     delete range_filter_;
+  range_filter_ = NULL;
 
   if (intensity_filter_)
     delete intensity_filter_;
-  
-  if (found_range_config)
+  intensity_filter_ = NULL;
+
+  // A median filter alone runs as a streaming median, which does not sort
+  // every beam's window again for each scan
+  int window = 0;
+  range_median_.configure(0);
+  intensity_median_.configure(0);
+
+  if (found_range_config && isMedianFilterChain(range_config_, window))
+  {
+    range_median_.configure(window);
+  }
+  else if (found_range_config)
   {
     range_filter_ = new filters::MultiChannelFilterChain<float>("float");
     if (!range_filter_->configure(num_ranges_, range_config_))
       return false;
   }
 
-  if (found_intensity_config)
+  if (found_intensity_config && isMedianFilterChain(intensity_config_, window))
+  {
+    intensity_median_.configure(window);
+  }
+  else if (found_intensity_config)
   {
     intensity_filter_ = new filters::MultiChannelFilterChain<float>("float");
     if (!intensity_filter_->configure(num_ranges_, intensity_config_))
@@ -103,8 +119,15 @@ bool LaserArrayFilter::update(const sensor_msgs::LaserScan& scan_in, sensor_msgs
   }
 
   /** \todo check for length of intensities too */
-  range_filter_->update(scan_in.ranges, scan_out.ranges);
-  intensity_filter_->update(scan_in.intensities, scan_out.intensities);
+  if (range_median_.window())
+    range_median_.update(scan_out.ranges);
+  else if (range_filter_)
+    range_filter_->update(scan_in.ranges, scan_out.ranges);
+
+  if (intensity_median_.window())
+    intensity_median_.update(scan_out.intensities);
+  else if (intensity_filter_)
+    intensity_filter_->update(scan_in.intensities, scan_out.intensities);
 
 
   return true;
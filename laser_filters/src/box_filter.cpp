@@ -45,7 +45,12 @@
 #include "laser_filters/box_filter.h"
 #include <ros/ros.h>
 
-laser_filters::LaserScanBoxFilter::LaserScanBoxFilter(){
+#include <cmath>
+#include <limits>
+
+laser_filters::LaserScanBoxFilter::LaserScanBoxFilter()
+  : skip_(false), cached_angle_min_(0), cached_angle_increment_(0)
+{
 
 }
 
@@ -102,12 +107,10 @@ bool laser_filters::LaserScanBoxFilter::configure(){
 
 }
 
-bool laser_filters::LaserScanBoxFilter::update(
-    const sensor_msgs::LaserScan& input_scan,
-    sensor_msgs::LaserScan &output_scan)
+bool laser_filters::LaserScanBoxFilter::beginScan(const sensor_msgs::LaserScan& input_scan)
 {
-  output_scan = input_scan;
-  sensor_msgs::PointCloud2 laser_cloud;
+  skip_ = false;
+  const size_t count = input_scan.ranges.size();
   
   std::string error_msg;
 
@@ -124,12 +127,17 @@ bool laser_filters::LaserScanBoxFilter::update(
     return false;
   }
 
+  tf::StampedTransform start, end;
   try{
-    projector_.transformLaserScanToPointCloud(box_frame_, input_scan, laser_cloud, tf_);
+    const ros::Time end_time = input_scan.header.stamp +
+      ros::Duration().fromSec(count > 1 ? (count - 1) * input_scan.time_increment : 0.0);
+    tf_.lookupTransform(box_frame_, input_scan.header.frame_id, input_scan.header.stamp, start);
+    tf_.lookupTransform(box_frame_, input_scan.header.frame_id, end_time, end);
   }
   catch(tf::TransformException& ex){
     if(up_and_running_){
       ROS_WARN_THROTTLE(1, "Dropping Scan: Tansform unavailable %s", ex.what());
+      skip_ = true;
       return true;
     }
     else
@@ -138,70 +146,74 @@ bool laser_filters::LaserScanBoxFilter::update(
     }
     return false;
   }
-  const int i_idx_c = sensor_msgs::getPointCloud2FieldIndex(laser_cloud, "index");
-  const int x_idx_c = sensor_msgs::getPointCloud2FieldIndex(laser_cloud, "x");
-  const int y_idx_c = sensor_msgs::getPointCloud2FieldIndex(laser_cloud, "y");
-  const int z_idx_c = sensor_msgs::getPointCloud2FieldIndex(laser_cloud, "z");
-
-  if(i_idx_c == -1 || x_idx_c == -1 || y_idx_c == -1 || z_idx_c == -1){
-      ROS_INFO_THROTTLE(.3, "x, y, z and index fields are required, skipping scan");
 
+  // A beam in the laser frame is (r cos a, r sin a, 0), so each box frame
+  // coordinate needs two columns of the rotation and the translation.
+  const double beams = count > 1 ? count - 1 : 1;
+  for(int row = 0; row < 3; row++){
+    const double first[3] = {start.getBasis()[row][0], start.getBasis()[row][1], start.getOrigin()[row]};
+    const double last[3] = {end.getBasis()[row][0], end.getBasis()[row][1], end.getOrigin()[row]};
+    for(int col = 0; col < 3; col++){
+      start_[row][col] = first[col];
+      step_[row][col] = (last[col] - first[col]) / beams;
+    }
   }
 
-
-  const int i_idx_offset = laser_cloud.fields[i_idx_c].offset;
-  const int x_idx_offset = laser_cloud.fields[x_idx_c].offset;
-  const int y_idx_offset = laser_cloud.fields[y_idx_c].offset;
-  const int z_idx_offset = laser_cloud.fields[z_idx_c].offset;
-
-  const int pstep = laser_cloud.point_step;
-  const long int pcount = laser_cloud.width * laser_cloud.height;
-  const long int limit = pstep * pcount;
-
-  int i_idx, x_idx, y_idx, z_idx;  
-  for(
-    i_idx = i_idx_offset,
-    x_idx = x_idx_offset,
-    y_idx = y_idx_offset,
-    z_idx = z_idx_offset;
-
-    x_idx < limit;
-
-    i_idx += pstep,
-    x_idx += pstep,
-    y_idx += pstep,
-    z_idx += pstep)
-  {
-
-    // TODO works only for float data types and with an index field
-    // I'm working on it, see https://github.com/ros/common_msgs/pull/78 
-    float x = *((float*)(&laser_cloud.data[x_idx]));
-    float y = *((float*)(&laser_cloud.data[y_idx]));
-    float z = *((float*)(&laser_cloud.data[z_idx]));
-    int index = *((int*)(&laser_cloud.data[i_idx]));
-
-    tf::Point point(x, y, z);
-
-    if(!invert_filter){
-      if(inBox(point)){
-        output_scan.ranges[index] = std::numeric_limits<float>::quiet_NaN();
-      }
+  if(cos_.size() != count || cached_angle_min_ != input_scan.angle_min ||
+     cached_angle_increment_ != input_scan.angle_increment){
+    cos_.resize(count);
+    sin_.resize(count);
+    for(size_t i = 0; i < count; i++){
+      const double angle = input_scan.angle_min + i * input_scan.angle_increment;
+      cos_[i] = cos(angle);
+      sin_[i] = sin(angle);
     }
-    else{
-      if(!inBox(point)){
-        output_scan.ranges[index] = std::numeric_limits<float>::quiet_NaN();
-      }
-    }
-
+    cached_angle_min_ = input_scan.angle_min;
+    cached_angle_increment_ = input_scan.angle_increment;
   }
-  up_and_running_ = true;
   return true;
 }
 
-bool laser_filters::LaserScanBoxFilter::inBox(tf::Point &point){
-  return
-    point.x() < max_.x() && point.x() > min_.x() && 
-    point.y() < max_.y() && point.y() > min_.y() &&
-    point.z() < max_.z() && point.z() > min_.z();
-}
+void laser_filters::LaserScanBoxFilter::filterBeams(
+    sensor_msgs::LaserScan& scan, size_t begin, size_t end)
+{
+  if(skip_)
+    return;
+
+  const float min_x = min_.x(), min_y = min_.y(), min_z = min_.z();
+  const float max_x = max_.x(), max_y = max_.y(), max_z = max_.z();
+  const float range_min = scan.range_min, range_max = scan.range_max;
+  const bool invert = invert_filter;
+  const float nan = std::numeric_limits<float>::quiet_NaN();
+  float transform[3][3], step[3][3];
+  for(int row = 0; row < 3; row++){
+    for(int col = 0; col < 3; col++){
+      transform[row][col] = start_[row][col];
+      step[row][col] = step_[row][col];
+    }
+  }
 
+  float* ranges = scan.ranges.data();
+  const float* cos_a = cos_.data();
+  const float* sin_a = sin_.data();
+  for(size_t i = begin; i < end; i++){
+    const float range = ranges[i];
+    const float lx = range * cos_a[i];
+    const float ly = range * sin_a[i];
+    float p[3];
+    for(int row = 0; row < 3; row++){
+      p[row] = (transform[row][0] + i * step[row][0]) * lx +
+               (transform[row][1] + i * step[row][1]) * ly +
+               (transform[row][2] + i * step[row][2]);
+    }
+    const bool in_box =
+      (p[0] < max_x) & (p[0] > min_x) &
+      (p[1] < max_y) & (p[1] > min_y) &
+      (p[2] < max_z) & (p[2] > min_z);
+
+    // beams out of the sensor's range were never points of the scan
+    const bool valid = (range < range_max) & (range >= range_min);
+    ranges[i] = valid & (in_box != invert) ? nan : range;
+  }
+  up_and_running_ = true;
+}
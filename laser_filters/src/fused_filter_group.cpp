@@ -0,0 +1,86 @@
+/*********************************************************************
+* Software License Agreement (BSD License)
+*
+*  Copyright (c) 2008, Willow Garage, Inc.
+*  All rights reserved.
+*
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions
+*  are met:
+*
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of the Willow Garage nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+*
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+*  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+*  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+*  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+*  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+*  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+*  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+*  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+*  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+*  POSSIBILITY OF SUCH DAMAGE.
+*
+*********************************************************************/
+
+#include <laser_filters/fused_filter_group.h>
+
+#include <algorithm>
+
+namespace laser_filters
+{
+const size_t FusedFilterGroup::kBlockSize;
+
+void FusedFilterGroup::add(FusableLaserFilter* filter)
+{
+  filters_.push_back(filter);
+  done_.push_back(0);
+}
+
+bool FusedFilterGroup::update(sensor_msgs::LaserScan& scan)
+{
+  // every filter sets up against the incoming header; none of them changes it
+  for (size_t k = 0; k < filters_.size(); ++k)
+  {
+    if (!filters_[k]->beginScan(scan))
+      return false;
+  }
+  std::fill(done_.begin(), done_.end(), 0);
+
+  const size_t n = scan.ranges.size();
+  size_t loaded = 0;
+  while (!done_.empty() && done_.back() < n)
+  {
+    loaded = std::min(n, loaded + kBlockSize);
+
+    // beams before ready are final input for filter k
+    size_t ready = loaded;
+    for (size_t k = 0; k < filters_.size(); ++k)
+    {
+      size_t stop = ready;
+      if (ready < n)
+      {
+        const size_t lookahead = filters_[k]->lookahead();
+        stop = ready > lookahead ? ready - lookahead : 0;
+      }
+      if (stop > done_[k])
+      {
+        filters_[k]->filterBeams(scan, done_[k], stop);
+        done_[k] = stop;
+      }
+      ready = done_[k];
+    }
+  }
+  return true;
+}
+}
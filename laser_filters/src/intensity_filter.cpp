@@ -39,6 +39,9 @@
 #include <laser_filters/intensity_filter.h>
 #include <ros/node_handle.h>
 
+#include <algorithm>
+#include <limits>
+
 namespace laser_filters
 {
 LaserScanIntensityFilter::LaserScanIntensityFilter()
@@ -63,46 +66,30 @@ bool LaserScanIntensityFilter::configure()
   return true;
 }
 
-bool LaserScanIntensityFilter::update(const sensor_msgs::LaserScan& input_scan, sensor_msgs::LaserScan& filtered_scan)
+void LaserScanIntensityFilter::filterBeams(sensor_msgs::LaserScan& filtered_scan, size_t begin, size_t end)
 {
-  filtered_scan = input_scan;
+  const double lower_threshold = config_.lower_threshold;
+  const double upper_threshold = config_.upper_threshold;
+  const bool invert = config_.invert;
+  const bool override_range = config_.filter_override_range;
+  const bool override_intensity = config_.filter_override_intensity;
+  const float nan = std::numeric_limits<float>::quiet_NaN();
 
   // Need to check ever reading in the current scan
-  for (unsigned int i=0; i < input_scan.ranges.size() && i < input_scan.intensities.size(); i++)
+  end = std::min(end, std::min(filtered_scan.ranges.size(), filtered_scan.intensities.size()));
+  float* ranges = filtered_scan.ranges.data();
+  float* intensities = filtered_scan.intensities.data();
+  for (size_t i = begin; i < end; i++)
   {
-    float& range = filtered_scan.ranges[i];
-    float& intensity = filtered_scan.intensities[i];
-
     // Is this reading below our lower threshold?
     // Is this reading above our upper threshold?
-    bool filter = intensity <= config_.lower_threshold || intensity >= config_.upper_threshold;
-    if (config_.invert)
-    {
-      filter = !filter;
-    }
+    const float intensity = intensities[i];
+    const bool filter = ((intensity <= lower_threshold) | (intensity >= upper_threshold)) != invert;
 
-    if (filter)
-    {
-      if (config_.filter_override_range)
-      {
-        // If so, then make it an invalid value (NaN)
-        range = std::numeric_limits<float>::quiet_NaN();
-      }
-      if (config_.filter_override_intensity)
-      {
-        intensity = 0.0;  // Not intense
-      }
-    }
-    else
-    {
-      if (config_.filter_override_intensity)
-      {
-        intensity = 1.0;  // Intense
-      }
-    }
+    // If so, then make it an invalid value (NaN), and not intense
+    ranges[i] = filter & override_range ? nan : ranges[i];
+    intensities[i] = override_intensity ? (filter ? 0.0f : 1.0f) : intensity;
   }
-
-  return true;
 }
 
 void LaserScanIntensityFilter::reconfigureCB(IntensityFilterConfig& config, uint32_t level)
@@ -47,6 +47,15 @@ bool LaserMedianFilter::configure()
     return false;
   }
   
+  // a median filter alone runs as a streaming median
+  int window = 0;
+  if (isMedianFilterChain(xmlrpc_value_, window))
+  {
+    range_median_.configure(window);
+    intensity_median_.configure(window);
+    return true;
+  }
+
   if (range_filter_) delete range_filter_;
   range_filter_ = new filters::MultiChannelFilterChain<float>("float");
   if (!range_filter_->configure(num_ranges_, xmlrpc_value_)) return false;
@@ -73,6 +82,13 @@ bool LaserMedianFilter::update(const sensor_msgs::LaserScan& scan_in, sensor_msg
   boost::mutex::scoped_lock lock(data_lock);
   scan_out = scan_in; ///Quickly pass through all data \todo don't copy data too
 
+  if (range_median_.window())
+  {
+    // starts over by itself when the scan size changes
+    range_median_.update(scan_out.ranges);
+    intensity_median_.update(scan_out.intensities);
+    return true;
+  }
 
   if (scan_in.ranges.size() != num_ranges_) //Reallocating
   {
@@ -0,0 +1,172 @@
+/*********************************************************************
+* Software License Agreement (BSD License)
+*
+*  Copyright (c) 2008, Willow Garage, Inc.
+*  All rights reserved.
+*
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions
+*  are met:
+*
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of the Willow Garage nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+*
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+*  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+*  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+*  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+*  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+*  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+*  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+*  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+*  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+*  POSSIBILITY OF SUCH DAMAGE.
+*
+*********************************************************************/
+
+#include <laser_filters/fusable_filter.h>
+#include <laser_filters/scan_filter_chain.h>
+
+#include <set>
+
+namespace laser_filters
+{
+ScanFilterChain::ScanFilterChain()
+  : loader_("filters", "filters::FilterBase<sensor_msgs::LaserScan>"), configured_(false)
+{
+}
+
+ScanFilterChain::~ScanFilterChain()
+{
+  clear();
+}
+
+void ScanFilterChain::clear()
+{
+  configured_ = false;
+  stages_.clear();
+  filters_.clear();
+}
+
+bool ScanFilterChain::configure(const std::string& param_name, ros::NodeHandle node, bool fuse)
+{
+  clear();
+
+  XmlRpc::XmlRpcValue config;
+  if (!node.getParam(param_name + "/filter_chain", config) && !node.getParam(param_name, config))
+  {
+    ROS_DEBUG("Could not load the filter chain configuration from parameter %s in namespace %s",
+              param_name.c_str(), node.getNamespace().c_str());
+    return false;
+  }
+
+  if (config.getType() != XmlRpc::XmlRpcValue::TypeArray)
+  {
+    ROS_ERROR("%s: the filter chain must be a list", param_name.c_str());
+    return false;
+  }
+
+  std::set<std::string> names;
+  for (int i = 0; i < config.size(); ++i)
+  {
+    if (config[i].getType() != XmlRpc::XmlRpcValue::TypeStruct ||
+        !config[i].hasMember("name") || !config[i].hasMember("type"))
+    {
+      ROS_ERROR("%s: filter %d needs a name and a type", param_name.c_str(), i);
+      return false;
+    }
+
+    std::string name = config[i]["name"];
+    std::string type = config[i]["type"];
+    if (!names.insert(name).second)
+    {
+      ROS_ERROR("%s: the filter name %s is used more than once", param_name.c_str(), name.c_str());
+      return false;
+    }
+
+    boost::shared_ptr<Filter> filter;
+    try
+    {
+      filter = loader_.createInstance(type);
+    }
+    catch (pluginlib::PluginlibException& ex)
+    {
+      ROS_ERROR("%s: could not load filter %s of type %s: %s", param_name.c_str(), name.c_str(), type.c_str(), ex.what());
+      return false;
+    }
+
+    if (!filter || !filter->configure(config[i]))
+    {
+      ROS_ERROR("%s: could not configure filter %s of type %s", param_name.c_str(), name.c_str(), type.c_str());
+      return false;
+    }
+
+    filters_.push_back(filter);
+    FusableLaserFilter* fusable = fuse ? dynamic_cast<FusableLaserFilter*>(filter.get()) : NULL;
+    if (fusable)
+    {
+      if (stages_.empty() || stages_.back().filter)
+      {
+        stages_.push_back(Stage());
+        stages_.back().filter = NULL;
+        stages_.back().in_place = NULL;
+      }
+      stages_.back().fused.add(fusable);
+    }
+    else
+    {
+      stages_.push_back(Stage());
+      stages_.back().filter = filter.get();
+      stages_.back().in_place = dynamic_cast<InPlaceLaserFilter*>(filter.get());
+    }
+    ROS_DEBUG("%s: loaded %s (%s)%s", param_name.c_str(), name.c_str(), type.c_str(),
+              fusable ? ", fused" : stages_.back().in_place ? ", in place" : "");
+  }
+
+  ROS_DEBUG("%s: %zu filters in %zu passes", param_name.c_str(), filters_.size(), stages_.size());
+
+  configured_ = true;
+  return true;
+}
+
+bool ScanFilterChain::update(sensor_msgs::LaserScan& scan)
+{
+  if (!configured_)
+  {
+    ROS_ERROR("ScanFilterChain not configured");
+    return false;
+  }
+
+  for (size_t i = 0; i < stages_.size(); ++i)
+  {
+    Stage& stage = stages_[i];
+    if (!stage.filter)
+    {
+      if (!stage.fused.update(scan))
+        return false;
+    }
+    else if (stage.in_place)
+    {
+      if (!stage.in_place->updateInPlace(scan))
+        return false;
+    }
+    else
+    {
+      if (!stage.filter->update(scan, scratch_))
+        return false;
+      // the scratch scan keeps the previous buffers for the next filter
+      std::swap(scan, scratch_);
+    }
+  }
+  return true;
+}
+}
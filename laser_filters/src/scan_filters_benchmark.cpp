@@ -0,0 +1,388 @@
+/*********************************************************************
+* Software License Agreement (BSD License)
+*
+*  Copyright (c) 2008, Willow Garage, Inc.
+*  All rights reserved.
+*
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions
+*  are met:
+*
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of the Willow Garage nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+*
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+*  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+*  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+*  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+*  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+*  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+*  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+*  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+*  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+*  POSSIBILITY OF SUCH DAMAGE.
+*
+*********************************************************************/
+
+// Microbenchmark of the laser scan filters on synthetic scans.
+//
+//   rosrun laser_filters scan_filters_benchmark [beams] [scans]
+//
+// Runs ScanShadowsFilter and the std::set based implementation it replaced
+// on the same scans, checks that they remove the same points, and reports
+// the time per scan against the budget of two lidars at 10 Hz.
+//
+// Then runs chains of stateless filters three ways, on single and on merged
+// (twice as long) scans: copying the scan for every filter as
+// filters::FilterChain does, in place one filter after the other as
+// ScanFilterChain does, and fused into one FusedFilterGroup pass.
+//
+// Last, compares the streaming TemporalMedian with the
+// filters::MultiChannelMedianFilter that LaserArrayFilter used for it.
+
+#include <laser_filters/angular_bounds_filter_in_place.h>
+#include <laser_filters/fused_filter_group.h>
+#include <laser_filters/intensity_filter.h>
+#include <laser_filters/range_filter.h>
+#include <laser_filters/scan_shadows_filter.h>
+#include <laser_filters/speckle_filter.h>
+#include <laser_filters/temporal_median_filter.h>
+#include <filters/median.h>
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <limits>
+#include <random>
+#include <set>
+#include <utility>
+#include <vector>
+
+namespace
+{
+
+// Rooms with walls, table legs and glass doors: piecewise smooth ranges with
+// jumps, mixed-pixel veiling points in between and some missing returns.
+std::vector<sensor_msgs::LaserScan> makeScans(int beams, int count)
+{
+  std::mt19937 rng(42);
+  std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+  std::normal_distribution<float> noise(0.0f, 0.01f);
+
+  std::vector<sensor_msgs::LaserScan> scans(count);
+  for (int s = 0; s < count; s++)
+  {
+    sensor_msgs::LaserScan& scan = scans[s];
+    scan.angle_min = -M_PI;
+    scan.angle_increment = 2 * M_PI / beams;
+    scan.angle_max = scan.angle_min + (beams - 1) * scan.angle_increment;
+    scan.range_min = 0.15;
+    scan.range_max = 12.0;
+    scan.ranges.resize(beams);
+    scan.intensities.resize(beams);
+
+    float wall = 1.0f + 4.0f * uniform(rng);
+    for (int i = 0; i < beams; i++)
+    {
+      if (uniform(rng) < 0.02f)
+        wall = 0.5f + 6.0f * uniform(rng);  // jump to another surface
+      float range = wall + noise(rng);
+      if (uniform(rng) < 0.03f)
+        range = wall + (6.0f - wall) * uniform(rng);  // veiling point
+      if (uniform(rng) < 0.01f)
+        range = std::numeric_limits<float>::quiet_NaN();
+      scan.ranges[i] = range;
+      scan.intensities[i] = range < 3.0f ? 100.0f : 20.0f;  // far returns are dark
+    }
+  }
+  return scans;
+}
+
+// ScanShadowsFilter::update as it was before the windowed implementation.
+void legacyShadows(laser_filters::ScanShadowDetector& detector, int window, int neighbors, bool remove_start,
+                   const sensor_msgs::LaserScan& scan_in, sensor_msgs::LaserScan& scan_out)
+{
+  scan_out = scan_in;
+
+  std::set<int> indices_to_delete;
+  for (unsigned int i = 0; i < scan_in.ranges.size(); i++)
+  {
+    for (int y = -window; y < window + 1; y++)
+    {
+      int j = i + y;
+      if (j < 0 || j >= (int)scan_in.ranges.size() || (int)i == j)
+        continue;
+
+      if (detector.isShadow(scan_in.ranges[i], scan_in.ranges[j], y * scan_in.angle_increment))
+      {
+        for (int index = std::max<int>(i - neighbors, 0); index <= std::min<int>(i + neighbors, (int)scan_in.ranges.size() - 1); index++)
+        {
+          if (scan_in.ranges[i] < scan_in.ranges[index])
+            indices_to_delete.insert(index);
+        }
+        if (remove_start)
+          indices_to_delete.insert(i);
+      }
+    }
+  }
+
+  for (std::set<int>::iterator it = indices_to_delete.begin(); it != indices_to_delete.end(); ++it)
+    scan_out.ranges[*it] = std::numeric_limits<float>::quiet_NaN();
+}
+
+// The dynamic reconfigure callback sets the configuration without a ROS master.
+struct IntensityFilter : laser_filters::LaserScanIntensityFilter
+{
+  explicit IntensityFilter(laser_filters::IntensityFilterConfig config) { reconfigureCB(config, 0); }
+};
+
+struct SpeckleFilter : laser_filters::LaserScanSpeckleFilter
+{
+  explicit SpeckleFilter(laser_filters::SpeckleFilterConfig config) { reconfigureCB(config, 0); }
+};
+
+bool sameRanges(const sensor_msgs::LaserScan& a, const sensor_msgs::LaserScan& b)
+{
+  for (size_t i = 0; i < a.ranges.size(); i++)
+  {
+    if (std::isnan(a.ranges[i]) != std::isnan(b.ranges[i]))
+      return false;
+    if (!std::isnan(a.ranges[i]) && a.ranges[i] != b.ranges[i])
+      return false;
+  }
+  return a.ranges.size() == b.ranges.size();
+}
+
+template <typename F>
+double usPerScan(const std::vector<sensor_msgs::LaserScan>& scans, int repeats, F filter)
+{
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  for (int r = 0; r < repeats; r++)
+    for (size_t s = 0; s < scans.size(); s++)
+      filter(scans[s]);
+  std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+  return elapsed.count() / (repeats * scans.size());
+}
+
+void report(const char* name, double us)
+{
+  // two lidars at 10 Hz: 20 scans per second
+  std::printf("  %-12s %10.1f us/scan  %6.3f%% of one core at 2 x 10 Hz\n", name, us, us * 20 / 1e6 * 100);
+}
+
+int benchmarkShadows(const std::vector<sensor_msgs::LaserScan>& scans, int beams, int repeats)
+{
+  const int windows[] = {1, 3, 5};
+  const int neighbors[] = {1, 20};
+  for (int w = 0; w < 3; w++)
+  {
+    for (int n = 0; n < 2; n++)
+    {
+      laser_filters::ScanShadowsFilter filter;
+      filter.min_angle_ = 10;
+      filter.max_angle_ = 170;
+      filter.window_ = windows[w];
+      filter.neighbors_ = neighbors[n];
+      filter.remove_shadow_start_point_ = false;
+      filter.shadow_detector_.configure(angles::from_degrees(10.0), angles::from_degrees(170.0));
+      laser_filters::ScanShadowDetector detector = filter.shadow_detector_;
+
+      sensor_msgs::LaserScan expected, out;
+      for (size_t s = 0; s < scans.size(); s++)
+      {
+        legacyShadows(detector, windows[w], neighbors[n], false, scans[s], expected);
+        filter.update(scans[s], out);
+        if (!sameRanges(expected, out))
+        {
+          std::fprintf(stderr, "ScanShadowsFilter differs from the legacy filter on scan %zu\n", s);
+          return 1;
+        }
+      }
+
+      std::printf("ScanShadowsFilter, %d beams, window %d, neighbors %d\n", beams, windows[w], neighbors[n]);
+      report("std::set", usPerScan(scans, repeats, [&](const sensor_msgs::LaserScan& scan) {
+        legacyShadows(detector, windows[w], neighbors[n], false, scan, expected);
+      }));
+      report("windowed", usPerScan(scans, repeats, [&](const sensor_msgs::LaserScan& scan) {
+        out = scan;
+        filter.updateInPlace(out);
+      }));
+    }
+  }
+  return 0;
+}
+
+int benchmarkChain(const char* name, const std::vector<laser_filters::FusableLaserFilter*>& filters,
+                   const std::vector<sensor_msgs::LaserScan>& scans, int repeats)
+{
+  laser_filters::FusedFilterGroup fused;
+  for (size_t f = 0; f < filters.size(); f++)
+    fused.add(filters[f]);
+
+  sensor_msgs::LaserScan in, copied, chained, out;
+  for (size_t s = 0; s < scans.size(); s++)
+  {
+    chained = scans[s];
+    for (size_t f = 0; f < filters.size(); f++)
+      filters[f]->updateInPlace(chained);
+    out = scans[s];
+    fused.update(out);
+    if (!sameRanges(chained, out) || chained.intensities != out.intensities)
+    {
+      std::fprintf(stderr, "%s: the fused pass differs from the chain on scan %zu\n", name, s);
+      return 1;
+    }
+  }
+
+  std::printf("%s, %zu beams\n", name, scans[0].ranges.size());
+  report("copying", usPerScan(scans, repeats, [&](const sensor_msgs::LaserScan& scan) {
+    in = scan;
+    for (size_t f = 0; f < filters.size(); f++)
+    {
+      filters[f]->update(in, copied);
+      std::swap(in, copied);
+    }
+  }));
+  report("in place", usPerScan(scans, repeats, [&](const sensor_msgs::LaserScan& scan) {
+    chained = scan;
+    for (size_t f = 0; f < filters.size(); f++)
+      filters[f]->updateInPlace(chained);
+  }));
+  report("fused", usPerScan(scans, repeats, [&](const sensor_msgs::LaserScan& scan) {
+    out = scan;
+    fused.update(out);
+  }));
+  return 0;
+}
+
+int benchmarkChains(const std::vector<sensor_msgs::LaserScan>& scans, int repeats)
+{
+  // the front lidar chain of the wheelchair
+  laser_filters::LaserScanAngularBoundsFilterInPlace bounds;
+  bounds.lower_angle_ = -1.099;
+  bounds.upper_angle_ = 0.349;
+
+  laser_filters::LaserScanRangeFilter range;
+  range.use_message_range_limits_ = false;
+  range.lower_threshold_ = 0.2;
+  range.upper_threshold_ = 8.0;
+  range.lower_replacement_value_ = -std::numeric_limits<float>::infinity();
+  range.upper_replacement_value_ = std::numeric_limits<float>::infinity();
+
+  laser_filters::IntensityFilterConfig intensity_config = laser_filters::IntensityFilterConfig::__getDefault__();
+  intensity_config.lower_threshold = 50;
+  intensity_config.upper_threshold = 100000;
+  intensity_config.invert = false;
+  intensity_config.filter_override_range = true;
+  intensity_config.filter_override_intensity = false;
+  IntensityFilter intensity(intensity_config);
+
+  laser_filters::SpeckleFilterConfig speckle_config = laser_filters::SpeckleFilterConfig::__getDefault__();
+  speckle_config.filter_type = laser_filters::SpeckleFilter_Distance;
+  speckle_config.max_range = 8.0;
+  speckle_config.max_range_difference = 0.05;
+  speckle_config.filter_window = 2;
+  SpeckleFilter speckle(speckle_config);
+
+  std::vector<laser_filters::FusableLaserFilter*> front;
+  front.push_back(&bounds);
+  front.push_back(&range);
+
+  std::vector<laser_filters::FusableLaserFilter*> all(front);
+  all.push_back(&intensity);
+  all.push_back(&speckle);
+
+  if (benchmarkChain("Bounds and range", front, scans, repeats))
+    return 1;
+  return benchmarkChain("Bounds, range, intensity and speckle", all, scans, repeats);
+}
+
+int benchmarkMedian(const std::vector<sensor_msgs::LaserScan>& scans, int window, int repeats)
+{
+  XmlRpc::XmlRpcValue config;
+  config["name"] = "median";
+  config["type"] = "filters/MultiChannelMedianFilterFloat";
+  config["params"]["number_of_observations"] = window;
+
+  const size_t beams = scans[0].ranges.size();
+  filters::MultiChannelMedianFilter<float> chain;
+  if (!chain.configure(beams, config))
+  {
+    std::fprintf(stderr, "could not configure MultiChannelMedianFilter\n");
+    return 1;
+  }
+  laser_filters::TemporalMedian streaming(window);
+
+  // NaN has no place in the order MultiChannelMedianFilter sorts by
+  std::vector<std::vector<float> > ranges(scans.size());
+  for (size_t s = 0; s < scans.size(); s++)
+  {
+    ranges[s] = scans[s].ranges;
+    for (size_t i = 0; i < beams; i++)
+      if (std::isnan(ranges[s][i]))
+        ranges[s][i] = std::numeric_limits<float>::infinity();
+  }
+
+  std::vector<float> expected(beams), out;
+  for (size_t s = 0; s < ranges.size(); s++)
+  {
+    chain.update(ranges[s], expected);
+    out = ranges[s];
+    streaming.update(out);
+    if (out != expected)
+    {
+      std::fprintf(stderr, "TemporalMedian differs from MultiChannelMedianFilter on scan %zu\n", s);
+      return 1;
+    }
+  }
+
+  std::printf("Temporal median of %d scans, %zu beams\n", window, beams);
+  size_t next = 0;
+  std::vector<sensor_msgs::LaserScan> one(1);
+  report("multichannel", usPerScan(one, repeats * scans.size(), [&](const sensor_msgs::LaserScan&) {
+    chain.update(ranges[next], expected);
+    next = (next + 1) % ranges.size();
+  }));
+  report("streaming", usPerScan(one, repeats * scans.size(), [&](const sensor_msgs::LaserScan&) {
+    out = ranges[next];
+    streaming.update(out);
+    next = (next + 1) % ranges.size();
+  }));
+  return 0;
+}
+
+}
+
+int main(int argc, char** argv)
+{
+  const int beams = argc > 1 ? std::atoi(argv[1]) : 720;
+  const int count = argc > 2 ? std::atoi(argv[2]) : 100;
+  const int repeats = 10;
+  std::vector<sensor_msgs::LaserScan> scans = makeScans(beams, count);
+  std::vector<sensor_msgs::LaserScan> merged = makeScans(2 * beams, count);
+
+  if (benchmarkShadows(scans, beams, repeats))
+    return 1;
+  if (benchmarkChains(scans, repeats))
+    return 1;
+  if (benchmarkChains(merged, repeats))
+    return 1;
+
+  const int median_windows[] = {3, 5, 9};
+  for (int w = 0; w < 3; w++)
+  {
+    if (benchmarkMedian(merged, median_windows[w], repeats))
+      return 1;
+  }
+  return 0;
+}
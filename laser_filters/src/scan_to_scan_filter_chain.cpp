@@ -27,121 +27,88 @@
  * POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include "laser_filters/scan_to_scan_filter_chain.h"
 
-#include "ros/ros.h"
-#include "sensor_msgs/LaserScan.h"
-#include "message_filters/subscriber.h"
-#include "tf/message_filter.h"
-#include "tf/transform_listener.h"
-#include "filters/filter_chain.h"
-
-class ScanToScanFilterChain
+namespace laser_filters
 {
-protected:
-  // Our NodeHandle
-  ros::NodeHandle nh_;
-  ros::NodeHandle private_nh_;
-
-  // Components for tf::MessageFilter
-  tf::TransformListener *tf_;
-  message_filters::Subscriber<sensor_msgs::LaserScan> scan_sub_;
-  tf::MessageFilter<sensor_msgs::LaserScan> *tf_filter_;
-  double tf_filter_tolerance_;
-
-  // Filter Chain
-  filters::FilterChain<sensor_msgs::LaserScan> filter_chain_;
+ScanToScanFilterChain::ScanToScanFilterChain(ros::NodeHandle nh, ros::NodeHandle private_nh) :
+  nh_(nh),
+  private_nh_(private_nh),
+  scan_sub_(nh_, "scan", 50),
+  tf_(NULL),
+  tf_filter_(NULL)
+{
+  // Configure filter chain
+  
+  using_filter_chain_deprecated_ = private_nh_.hasParam("filter_chain");
 
-  // Components for publishing
-  sensor_msgs::LaserScan msg_;
-  ros::Publisher output_pub_;
+  // run consecutive stateless filters as one pass over the scan
+  bool fuse_filters;
+  private_nh_.param("fuse_filters", fuse_filters, false);
 
-  // Deprecation helpers
-  ros::Timer deprecation_timer_;
-  bool  using_filter_chain_deprecated_;
+  if (using_filter_chain_deprecated_)
+    filter_chain_.configure("filter_chain", private_nh_, fuse_filters);
+  else
+    filter_chain_.configure("scan_filter_chain", private_nh_, fuse_filters);
+  
+  std::string tf_message_filter_target_frame;
 
-public:
-  // Constructor
-  ScanToScanFilterChain() :
-    private_nh_("~"),
-    scan_sub_(nh_, "scan", 50),
-    tf_(NULL),
-    tf_filter_(NULL),
-    filter_chain_("sensor_msgs::LaserScan")
+  if (private_nh_.hasParam("tf_message_filter_target_frame"))
   {
-    // Configure filter chain
-    
-    using_filter_chain_deprecated_ = private_nh_.hasParam("filter_chain");
-
-    if (using_filter_chain_deprecated_)
-      filter_chain_.configure("filter_chain", private_nh_);
-    else
-      filter_chain_.configure("scan_filter_chain", private_nh_);
-    
-    std::string tf_message_filter_target_frame;
+    private_nh_.getParam("tf_message_filter_target_frame", tf_message_filter_target_frame);
 
-    if (private_nh_.hasParam("tf_message_filter_target_frame"))
-    {
-      private_nh_.getParam("tf_message_filter_target_frame", tf_message_filter_target_frame);
+    private_nh_.param("tf_message_filter_tolerance", tf_filter_tolerance_, 0.03);
 
-      private_nh_.param("tf_message_filter_tolerance", tf_filter_tolerance_, 0.03);
+    tf_ = new tf::TransformListener();
+    tf_filter_ = new tf::MessageFilter<sensor_msgs::LaserScan>(scan_sub_, *tf_, "", 50);
+    tf_filter_->setTargetFrame(tf_message_filter_target_frame);
+    tf_filter_->setTolerance(ros::Duration(tf_filter_tolerance_));
 
-      tf_ = new tf::TransformListener();
-      tf_filter_ = new tf::MessageFilter<sensor_msgs::LaserScan>(scan_sub_, *tf_, "", 50);
-      tf_filter_->setTargetFrame(tf_message_filter_target_frame);
-      tf_filter_->setTolerance(ros::Duration(tf_filter_tolerance_));
-
-      // Setup tf::MessageFilter generates callback
-      tf_filter_->registerCallback(boost::bind(&ScanToScanFilterChain::callback, this, _1));
-    }
-    else 
-    {
-      // Pass through if no tf_message_filter_target_frame
-      scan_sub_.registerCallback(boost::bind(&ScanToScanFilterChain::callback, this, _1));
-    }
-    
-    // Advertise output
-    output_pub_ = nh_.advertise<sensor_msgs::LaserScan>("scan_filtered", 1000);
-
-    // Set up deprecation printout
-    deprecation_timer_ = nh_.createTimer(ros::Duration(5.0), boost::bind(&ScanToScanFilterChain::deprecation_warn, this, _1));
+    // Setup tf::MessageFilter generates callback
+    tf_filter_->registerCallback(boost::bind(&ScanToScanFilterChain::callback, this, _1));
   }
-
-  // Destructor
-  ~ScanToScanFilterChain()
+  else 
   {
-    if (tf_filter_)
-      delete tf_filter_;
-    if (tf_)
-      delete tf_;
+    // Pass through if no tf_message_filter_target_frame
+    scan_sub_.registerCallback(boost::bind(&ScanToScanFilterChain::callback, this, _1));
   }
   
-  // Deprecation warning callback
-  void deprecation_warn(const ros::TimerEvent& e)
-  {
-    if (using_filter_chain_deprecated_)
-      ROS_WARN("Use of '~filter_chain' parameter in scan_to_scan_filter_chain has been deprecated. Please replace with '~scan_filter_chain'.");
-  }
+  // Advertise output
+  output_pub_ = nh_.advertise<sensor_msgs::LaserScan>("scan_filtered", 1000);
 
-  // Callback
-  void callback(const sensor_msgs::LaserScan::ConstPtr& msg_in)
-  {
-    // Run the filter chain
-    if (filter_chain_.update(*msg_in, msg_))
-    {
-      //only publish result if filter succeeded
-      output_pub_.publish(msg_);
-    } else {
-      ROS_ERROR_THROTTLE(1, "Filtering the scan from time %i.%i failed.", msg_in->header.stamp.sec, msg_in->header.stamp.nsec);
-    }
-  }
-};
+  // Set up deprecation printout
+  deprecation_timer_ = nh_.createTimer(ros::Duration(5.0), boost::bind(&ScanToScanFilterChain::deprecation_warn, this, _1));
+}
 
-int main(int argc, char **argv)
+ScanToScanFilterChain::~ScanToScanFilterChain()
 {
-  ros::init(argc, argv, "scan_to_scan_filter_chain");
-  
-  ScanToScanFilterChain t;
-  ros::spin();
-  
-  return 0;
+  if (tf_filter_)
+    delete tf_filter_;
+  if (tf_)
+    delete tf_;
+}
+
+void ScanToScanFilterChain::deprecation_warn(const ros::TimerEvent& e)
+{
+  if (using_filter_chain_deprecated_)
+    ROS_WARN("Use of '~filter_chain' parameter in scan_to_scan_filter_chain has been deprecated. Please replace with '~scan_filter_chain'.");
+}
+
+void ScanToScanFilterChain::callback(const sensor_msgs::LaserScan::ConstPtr& msg_in)
+{
+  // The last output may still be held by a subscriber, and the input may be
+  // shared with other subscribers, so filter a copy we own.
+  if (!msg_.unique())
+    msg_.reset(new sensor_msgs::LaserScan);
+  *msg_ = *msg_in;
+
+  // Run the filter chain
+  if (filter_chain_.update(*msg_))
+  {
+    //only publish result if filter succeeded
+    output_pub_.publish(msg_);
+  } else {
+    ROS_ERROR_THROTTLE(1, "Filtering the scan from time %i.%i failed.", msg_in->header.stamp.sec, msg_in->header.stamp.nsec);
+  }
+}
 }
@@ -40,19 +40,20 @@
 #include <laser_filters/speckle_filter.h>
 #include <ros/node_handle.h>
 
+#include <algorithm>
+#include <limits>
+
 namespace laser_filters
 {
 LaserScanSpeckleFilter::LaserScanSpeckleFilter()
+  : window_(0), windows_(0), last_valid_window_(-1), copied_(0)
 {
   validator_ = 0;
 }
 
 LaserScanSpeckleFilter::~LaserScanSpeckleFilter()
 {
-  if (!validator_)
-  {
-    delete validator_;
-  }
+  delete validator_;
 }
 
 bool LaserScanSpeckleFilter::configure()
@@ -71,36 +72,50 @@ bool LaserScanSpeckleFilter::configure()
   return true;
 }
 
-bool LaserScanSpeckleFilter::update(const sensor_msgs::LaserScan& input_scan, sensor_msgs::LaserScan& output_scan)
+size_t LaserScanSpeckleFilter::lookahead() const
 {
-  output_scan = input_scan;
-  std::vector<bool> valid_ranges(output_scan.ranges.size(), false);
-  for (size_t idx = 0; idx < output_scan.ranges.size() - config_.filter_window + 1; ++idx)
-  {
-    bool window_valid = validator_->checkWindowValid(
-          output_scan, idx, config_.filter_window, config_.max_range_difference);
+  return window_;
+}
+
+bool LaserScanSpeckleFilter::beginScan(const sensor_msgs::LaserScan& scan)
+{
+  const size_t size = scan.ranges.size();
+  window_ = std::max(config_.filter_window, 0);
+  windows_ = size + 1 > window_ ? size + 1 - window_ : 0;
+  last_valid_window_ = -1;
+
+  input_.angle_increment = scan.angle_increment;
+  input_.ranges.resize(size);
+  copied_ = 0;
+  return true;
+}
 
-    // Actually set the valid ranges (do not set to false if it was already valid or out of range)
-    for (size_t neighbor_idx_or_self_nr = 0; neighbor_idx_or_self_nr < config_.filter_window; ++neighbor_idx_or_self_nr)
+void LaserScanSpeckleFilter::filterBeams(sensor_msgs::LaserScan& output_scan, size_t begin, size_t end)
+{
+  const size_t size = output_scan.ranges.size();
+  const size_t copy_end = std::min(size, end + window_);
+  std::copy(output_scan.ranges.begin() + copied_, output_scan.ranges.begin() + copy_end, input_.ranges.begin() + copied_);
+  copied_ = std::max(copied_, copy_end);
+
+  for (size_t idx = begin; idx < end; ++idx)
+  {
+    // the window starting here is the last one this point is in
+    if (window_ > 0 && idx < windows_ &&
+        validator_->checkWindowValid(input_, idx, window_, config_.max_range_difference))
     {
-      size_t neighbor_idx_or_self = idx + neighbor_idx_or_self_nr;
-      if (neighbor_idx_or_self < output_scan.ranges.size())  // Out of bound check
-      {
-        bool out_of_range = output_scan.ranges[neighbor_idx_or_self] > config_.max_range;
-        valid_ranges[neighbor_idx_or_self] = valid_ranges[neighbor_idx_or_self] || window_valid || out_of_range;
-      }
+      last_valid_window_ = idx;
     }
-  }
 
-  for (size_t idx = 0; idx < valid_ranges.size(); ++idx)
-  {
-    if (!valid_ranges[idx])
+    // Keep the point if a window it is in is valid or it is out of range,
+    // as long as some window covers it at all
+    bool covered = window_ > 0 && windows_ > 0;
+    bool window_valid = last_valid_window_ >= 0 && last_valid_window_ + (long)window_ > (long)idx;
+    bool out_of_range = input_.ranges[idx] > config_.max_range;
+    if (!(covered && (window_valid || out_of_range)))
     {
       output_scan.ranges[idx] = std::numeric_limits<float>::quiet_NaN();
     }
   }
-
-  return true;
 }
 
 void LaserScanSpeckleFilter::reconfigureCB(laser_filters::SpeckleFilterConfig& config, uint32_t level)
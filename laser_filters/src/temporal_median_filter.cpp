@@ -0,0 +1,185 @@
+/*********************************************************************
+* Software License Agreement (BSD License)
+*
+*  Copyright (c) 2008, Willow Garage, Inc.
+*  All rights reserved.
+*
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions
+*  are met:
+*
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of the Willow Garage nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+*
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+*  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+*  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+*  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+*  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+*  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+*  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+*  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+*  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+*  POSSIBILITY OF SUCH DAMAGE.
+*
+*********************************************************************/
+
+#include <laser_filters/temporal_median_filter.h>
+#include <ros/ros.h>
+
+#include <cstring>
+#include <limits>
+#include <string>
+
+namespace laser_filters
+{
+namespace
+{
+// Flipping the magnitude bits of negative floats makes signed integer order
+// the float order; NaNs all become the positive quiet NaN, above +inf.
+inline int32_t toKey(float value)
+{
+  int32_t bits;
+  if (value != value)
+    value = std::numeric_limits<float>::quiet_NaN();
+  std::memcpy(&bits, &value, sizeof(bits));
+  return bits ^ ((bits >> 31) & 0x7fffffff);
+}
+
+inline float fromKey(int32_t key)
+{
+  const int32_t bits = key ^ ((key >> 31) & 0x7fffffff);
+  float value;
+  std::memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+}
+
+TemporalMedian::TemporalMedian(size_t window)
+  : window_(window), channels_(0), count_(0), oldest_(0)
+{
+}
+
+void TemporalMedian::configure(size_t window)
+{
+  window_ = window;
+  channels_ = 0;
+  reset();
+}
+
+void TemporalMedian::reset()
+{
+  count_ = 0;
+  oldest_ = 0;
+}
+
+void TemporalMedian::update(std::vector<float>& values)
+{
+  if (window_ == 0)
+    return;
+
+  if (values.size() != channels_)
+  {
+    channels_ = values.size();
+    sorted_.resize(channels_ * window_);
+    history_.resize(channels_ * window_);
+    reset();
+  }
+
+  const size_t filled = count_ < window_ ? count_ + 1 : window_;
+  const size_t slot = count_ < window_ ? count_ : oldest_;
+  const size_t middle = (filled - 1) / 2;
+  int32_t* history = &history_[slot * channels_];
+
+  for (size_t c = 0; c < channels_; ++c)
+  {
+    int32_t* window = &sorted_[c * window_];
+    const int32_t key = toKey(values[c]);
+
+    // start from the place of the leaving observation, or past the end
+    size_t i = count_;
+    if (count_ == window_)
+    {
+      const int32_t old = history[c];
+      i = 0;
+      while (window[i] != old)
+        ++i;
+
+      while (i + 1 < window_ && window[i + 1] < key)
+      {
+        window[i] = window[i + 1];
+        ++i;
+      }
+    }
+    while (i > 0 && window[i - 1] > key)
+    {
+      window[i] = window[i - 1];
+      --i;
+    }
+    window[i] = key;
+
+    history[c] = key;
+    values[c] = fromKey(window[middle]);
+  }
+
+  if (count_ < window_)
+    ++count_;
+  else
+    oldest_ = (oldest_ + 1) % window_;
+}
+
+bool LaserScanTemporalMedianFilter::configure()
+{
+  int window = 5;
+  getParam("number_of_observations", window);
+  if (window < 1)
+  {
+    ROS_ERROR("LaserScanTemporalMedianFilter: number_of_observations must be at least 1, not %d", window);
+    return false;
+  }
+  ranges_.configure(window);
+  intensities_.configure(window);
+  return true;
+}
+
+bool LaserScanTemporalMedianFilter::updateInPlace(sensor_msgs::LaserScan& scan)
+{
+  ranges_.update(scan.ranges);
+  intensities_.update(scan.intensities);
+  return true;
+}
+
+bool isMedianFilterChain(XmlRpc::XmlRpcValue& config, int& window)
+{
+  if (config.getType() != XmlRpc::XmlRpcValue::TypeArray || config.size() != 1)
+    return false;
+
+  XmlRpc::XmlRpcValue& filter = config[0];
+  if (filter.getType() != XmlRpc::XmlRpcValue::TypeStruct || !filter.hasMember("type") ||
+      !filter.hasMember("params") || filter["type"].getType() != XmlRpc::XmlRpcValue::TypeString)
+    return false;
+
+  // with or without the filters/ package prefix
+  const std::string type = filter["type"];
+  const std::string median = "MultiChannelMedianFilterFloat";
+  if (type != median && type != "filters/" + median)
+    return false;
+
+  XmlRpc::XmlRpcValue& params = filter["params"];
+  if (params.getType() != XmlRpc::XmlRpcValue::TypeStruct || !params.hasMember("number_of_observations") ||
+      params["number_of_observations"].getType() != XmlRpc::XmlRpcValue::TypeInt)
+    return false;
+
+  window = params["number_of_observations"];
+  return window > 0;
+}
+}
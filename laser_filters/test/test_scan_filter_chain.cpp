@@ -32,6 +32,9 @@
 #include <ros/ros.h>
 #include "sensor_msgs/LaserScan.h"
 #include <pluginlib/class_loader.h>
+#include "laser_filters/fused_filter_group.h"
+#include "laser_filters/scan_filter_chain.h"
+#include <random>
 
 
 sensor_msgs::LaserScan gen_msg(){
@@ -193,6 +196,127 @@ TEST(ScanToScanFilterChain, MaskFilter)
   filter_chain_.clear();
 }
 
+TEST(ScanToScanFilterChain, InPlaceChain)
+{
+  sensor_msgs::LaserScan msg_in, msg_out;
+  filters::FilterChain<sensor_msgs::LaserScan> filter_chain_("sensor_msgs::LaserScan");
+  laser_filters::ScanFilterChain in_place_chain;
+
+  EXPECT_TRUE(filter_chain_.configure("in_place_filter_chain"));
+  EXPECT_TRUE(in_place_chain.configure("in_place_filter_chain"));
+
+  msg_in = gen_msg();
+  EXPECT_TRUE(filter_chain_.update(msg_in, msg_out));
+
+  // twice, so the second run reuses the chain's scratch scan
+  for (int run = 0; run < 2; run++)
+  {
+    sensor_msgs::LaserScan msg = gen_msg();
+    EXPECT_TRUE(in_place_chain.update(msg));
+
+    ASSERT_EQ(msg_out.ranges.size(), msg.ranges.size());
+    EXPECT_NEAR(msg_out.angle_min, msg.angle_min, 1e-6);
+    EXPECT_NEAR(msg_out.angle_max, msg.angle_max, 1e-6);
+    expect_ranges_eq(msg_out.ranges, msg.ranges);
+  }
+
+  filter_chain_.clear();
+}
+
+TEST(ScanToScanFilterChain, FusedChain)
+{
+  sensor_msgs::LaserScan msg_in, msg_out;
+  filters::FilterChain<sensor_msgs::LaserScan> filter_chain_("sensor_msgs::LaserScan");
+  laser_filters::ScanFilterChain fused_chain;
+
+  EXPECT_TRUE(filter_chain_.configure("fused_filter_chain"));
+  EXPECT_TRUE(fused_chain.configure("fused_filter_chain", ros::NodeHandle(), true));
+
+  msg_in = gen_msg();
+  EXPECT_TRUE(filter_chain_.update(msg_in, msg_out));
+
+  for (int run = 0; run < 2; run++)
+  {
+    sensor_msgs::LaserScan msg = gen_msg();
+    EXPECT_TRUE(fused_chain.update(msg));
+
+    ASSERT_EQ(msg_out.ranges.size(), msg.ranges.size());
+    expect_ranges_eq(msg_out.ranges, msg.ranges);
+    for (size_t i = 0; i < msg.intensities.size(); i++)
+      EXPECT_EQ(msg_out.intensities[i], msg.intensities[i]);
+  }
+
+  filter_chain_.clear();
+}
+
+/** A scan of several blocks of the fused chain: walls with jumps, speckles
+ * and missing returns, with a speckle and a jump on each block boundary so
+ * that the lookahead of the fused filters crosses blocks.
+ */
+sensor_msgs::LaserScan gen_long_msg(size_t beams){
+  sensor_msgs::LaserScan msg;
+  std::mt19937 rng(7);
+  std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+
+  msg.header.stamp = ros::Time::now();
+  msg.header.frame_id = "laser";
+  msg.angle_min = -M_PI;
+  msg.angle_increment = 2 * M_PI / beams;
+  msg.angle_max = msg.angle_min + (beams - 1) * msg.angle_increment;
+  msg.time_increment = 0.0001;
+  msg.scan_time = 0.1;
+  msg.range_min = 0.1;
+  msg.range_max = 10.0;
+  msg.ranges.resize(beams);
+  msg.intensities.resize(beams);
+
+  float wall = 2.0f;
+  for (size_t i = 0; i < beams; i++)
+  {
+    if (uniform(rng) < 0.03f || i % laser_filters::FusedFilterGroup::kBlockSize == 0)
+      wall = 0.5f + 6.0f * uniform(rng);
+    float range = wall + 0.01f * uniform(rng);
+    if (uniform(rng) < 0.05f || i % laser_filters::FusedFilterGroup::kBlockSize == laser_filters::FusedFilterGroup::kBlockSize - 2)
+      range = wall + 2.0f;
+    if (uniform(rng) < 0.01f)
+      range = std::numeric_limits<float>::quiet_NaN();
+    msg.ranges[i] = range;
+    msg.intensities[i] = range < 3.0f ? 100.0f : 20.0f;
+  }
+  return msg;
+}
+
+TEST(ScanToScanFilterChain, FusedChainBlocks)
+{
+  const size_t beams = 2 * laser_filters::FusedFilterGroup::kBlockSize + 100;
+  sensor_msgs::LaserScan msg_in, msg_out;
+  filters::FilterChain<sensor_msgs::LaserScan> filter_chain_("sensor_msgs::LaserScan");
+  laser_filters::ScanFilterChain fused_chain;
+
+  EXPECT_TRUE(filter_chain_.configure("fused_long_filter_chain"));
+  EXPECT_TRUE(fused_chain.configure("fused_long_filter_chain", ros::NodeHandle(), true));
+
+  msg_in = gen_long_msg(beams);
+  EXPECT_TRUE(filter_chain_.update(msg_in, msg_out));
+
+  for (int run = 0; run < 2; run++)
+  {
+    sensor_msgs::LaserScan msg = gen_long_msg(beams);
+    EXPECT_TRUE(fused_chain.update(msg));
+
+    ASSERT_EQ(msg_out.ranges.size(), msg.ranges.size());
+    for (size_t i = 0; i < msg.ranges.size(); i++)
+    {
+      if (std::isnan(msg_out.ranges[i]))
+        EXPECT_TRUE(std::isnan(msg.ranges[i])) << "beam " << i;
+      else
+        EXPECT_EQ(msg_out.ranges[i], msg.ranges[i]) << "beam " << i;
+      EXPECT_EQ(msg_out.intensities[i], msg.intensities[i]) << "beam " << i;
+    }
+  }
+
+  filter_chain_.clear();
+}
 
 int main(int argc, char **argv){
   testing::InitGoogleTest(&argc, argv);
@@ -81,6 +81,32 @@ TEST(ScanShadowDetector, ShadowDetectionGeometry)
   }
 }
 
+TEST(ScanShadowDetector, MarkShadows)
+{
+  laser_filters::ScanShadowDetector detector;
+  detector.configure(angles::from_degrees(10.0), angles::from_degrees(170.0));
+
+  const float nanval = std::numeric_limits<float>::quiet_NaN();
+  const float ranges[] = {1.0, 1.0, 3.0, 1.1, nanval, 0.5, 5.0, 5.1, 0.2, 0.2};
+  const int size = sizeof(ranges) / sizeof(ranges[0]);
+  const float inc = 0.05;
+
+  for (int y = -3; y <= 3; y++)
+  {
+    if (y == 0)
+      continue;
+    unsigned char shadow[size] = {0};
+    const int begin = std::max(0, -y), end = std::min(size, size - y);
+    detector.markShadows(ranges, begin, end, y, sinf(y * inc), cosf(y * inc), shadow);
+
+    for (int i = 0; i < size; i++)
+    {
+      const bool expected = i >= begin && i < end && detector.isShadow(ranges[i], ranges[i + y], y * inc);
+      EXPECT_EQ(expected, shadow[i] != 0);
+    }
+  }
+}
+
 int main(int argc, char **argv)
 {
   testing::InitGoogleTest(&argc, argv);
@@ -0,0 +1,123 @@
+/*********************************************************************
+* Software License Agreement (BSD License)
+*
+*  Copyright (c) 2008, Willow Garage, Inc.
+*  All rights reserved.
+*
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions
+*  are met:
+*
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of the Willow Garage nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+*
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+*  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+*  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+*  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+*  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+*  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+*  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+*  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+*  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+*  POSSIBILITY OF SUCH DAMAGE.
+*
+*********************************************************************/
+
+#include <gtest/gtest.h>
+
+#include "laser_filters/temporal_median_filter.h"
+
+#include <algorithm>
+#include <cmath>
+#include <deque>
+#include <limits>
+#include <random>
+
+// lower median, NaN above everything
+float medianPureImpl(const std::deque<float>& window)
+{
+  std::vector<float> sorted(window.begin(), window.end());
+  std::sort(sorted.begin(), sorted.end(), [](float a, float b) {
+    return std::isnan(b) ? !std::isnan(a) : a < b;
+  });
+  return sorted[(sorted.size() - 1) / 2];
+}
+
+TEST(TemporalMedian, MatchesSortedWindow)
+{
+  std::mt19937 rng(7);
+  std::uniform_int_distribution<int> value(-5, 5);
+  const float nan = std::numeric_limits<float>::quiet_NaN();
+  const float inf = std::numeric_limits<float>::infinity();
+
+  for (size_t window = 1; window <= 9; window++)
+  {
+    laser_filters::TemporalMedian median(window);
+    std::vector<std::deque<float> > history(20);
+    for (int scan = 0; scan < 50; scan++)
+    {
+      std::vector<float> values(history.size());
+      for (size_t c = 0; c < values.size(); c++)
+      {
+        const int v = value(rng);
+        values[c] = v == 5 ? nan : v == -5 ? inf : v * 0.1f;
+        history[c].push_back(values[c]);
+        if (history[c].size() > window)
+          history[c].pop_front();
+      }
+
+      median.update(values);
+      for (size_t c = 0; c < values.size(); c++)
+      {
+        const float expected = medianPureImpl(history[c]);
+        if (std::isnan(expected))
+          EXPECT_TRUE(std::isnan(values[c]));
+        else
+          EXPECT_EQ(expected, values[c]);
+      }
+    }
+  }
+}
+
+TEST(TemporalMedian, StartsOverOnSizeChange)
+{
+  laser_filters::TemporalMedian median(3);
+  std::vector<float> values(4, 1.0f);
+  median.update(values);
+  median.update(values);
+
+  values.assign(5, 2.0f);
+  median.update(values);
+  for (size_t c = 0; c < values.size(); c++)
+    EXPECT_EQ(2.0f, values[c]);
+}
+
+TEST(TemporalMedian, RecognizesMedianChain)
+{
+  XmlRpc::XmlRpcValue chain;
+  chain[0]["name"] = "median_5";
+  chain[0]["type"] = "MultiChannelMedianFilterFloat";
+  chain[0]["params"]["number_of_observations"] = 5;
+
+  int window = 0;
+  EXPECT_TRUE(laser_filters::isMedianFilterChain(chain, window));
+  EXPECT_EQ(5, window);
+
+  chain[0]["type"] = "filters/MultiChannelMeanFilterFloat";
+  EXPECT_FALSE(laser_filters::isMedianFilterChain(chain, window));
+}
+
+int main(int argc, char **argv){
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
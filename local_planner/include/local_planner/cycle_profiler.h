@@ -0,0 +1,128 @@
+#ifndef LOCAL_PLANNER_CYCLE_PROFILER_H_
+#define LOCAL_PLANNER_CYCLE_PROFILER_H_
+
+#include <ros/ros.h>
+#include <diagnostic_msgs/DiagnosticArray.h>
+#include <std_srvs/Trigger.h>
+
+#include <atomic>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+namespace local_planner{
+
+// Log-linear latency histogram in nanoseconds. Each power of two is split
+// into 16 buckets, so a reported percentile is at most 1/16 above the true
+// value; values of 2^32 ns and more go into the last bucket.
+class LatencyHistogram{
+public:
+
+    LatencyHistogram() { reset(); }
+
+    void reset();
+
+    void record(uint64_t ns);
+
+    uint64_t count() const { return count_; }
+    uint64_t max() const { return max_; }
+
+    // Upper edge of the bucket holding the p-quantile, 0 <= p <= 1.
+    uint64_t percentile(double p) const;
+
+private:
+    static const int kSubBits = 4;
+    static const int kSub = 1 << kSubBits;
+    static const int kBuckets = (32 - kSubBits + 1) * kSub;
+
+    static int bucketOf(uint64_t ns);
+    static uint64_t upperEdge(int bucket);
+
+    uint32_t buckets_[kBuckets];
+    uint64_t count_;
+    uint64_t max_;
+};
+
+// Per-stage timing of the planner cycle.
+//
+// Stage durations go into fixed-size histograms that are published as a
+// diagnostic_msgs/DiagnosticArray on ~cycle_stats every publish period and then
+// reset, and optionally into a binary trace ring that ~dump_cycle_trace writes
+// to a file. Recording happens on the planner thread only and never allocates;
+// the ring is read by the service without locking the planner out.
+class CycleProfiler{
+public:
+
+    enum Stage
+    {
+        SCAN_COPY,
+        GAP_DETECTION,
+        MEMORY_UPDATE,
+        GAP_SELECTION,
+        COMMAND_SHAPING,
+        CYCLE,
+        STAGE_COUNT
+    };
+
+    // One record of the binary trace file, after an 8 byte "LPTRACE1" magic
+    // and a uint32 record count.
+    struct TraceRecord
+    {
+        uint64_t stamp_ns;      // steady clock at the end of the stage
+        uint32_t duration_ns;
+        uint32_t stage;
+    };
+
+    // Times consecutive stages: each next() or the destructor records the
+    // time since the previous mark. next() into the current stage is a no-op.
+    class Timer
+    {
+    public:
+        Timer(CycleProfiler& profiler, Stage stage);
+        ~Timer();
+        void next(Stage stage);
+
+    private:
+        CycleProfiler& profiler_;
+        Stage stage_;
+        uint64_t start_;
+    };
+
+    CycleProfiler();
+
+    // Reads profiler_* params from nh and advertises the topic and service.
+    void initialize(ros::NodeHandle& nh);
+
+    // Recording the CYCLE stage closes the cycle and publishes when due.
+    void record(Stage stage, uint64_t ns, uint64_t stamp);
+
+    // Average cycle time over the whole run, in seconds.
+    double meanCycleTime() const;
+
+    static uint64_t now();
+
+    static const char* stageName(Stage stage);
+
+private:
+    void publish();
+    bool dumpTrace(std_srvs::Trigger::Request& req, std_srvs::Trigger::Response& res);
+
+    LatencyHistogram histograms_[STAGE_COUNT];
+    uint64_t overruns_;
+    uint64_t budgetNs_;
+    uint64_t totalCycles_;
+    double totalCycleTime_;
+
+    std::vector<TraceRecord> trace_;
+    std::atomic<uint64_t> traceHead_;
+    std::string traceFile_;
+
+    ros::Publisher statsPub_;
+    ros::ServiceServer dumpSrv_;
+    ros::WallDuration publishPeriod_;
+    ros::WallTime lastPublish_;
+    diagnostic_msgs::DiagnosticArray stats_;
+};
+};
+
+#endif
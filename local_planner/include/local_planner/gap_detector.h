@@ -0,0 +1,58 @@
+#ifndef LOCAL_PLANNER_GAP_DETECTOR_H_
+#define LOCAL_PLANNER_GAP_DETECTOR_H_
+
+#include <vector>
+#include <cstddef>
+
+namespace local_planner{
+
+// Range discontinuity (gap) extraction on a laser scan.
+//
+// The planner looks at the scan reversed, left to right. The detector works
+// directly on the scan's float ranges and maps indices instead of copying and
+// reversing them; the jump flags and the minimum are computed in branch-free,
+// vectorizable passes, and the sparse flags are then compacted into the start
+// and end lists. All buffers are owned by the detector and reused every cycle.
+class GapDetector{
+public:
+
+    GapDetector();
+
+    // Preallocate for scans of up to n beams.
+    void reserve(size_t n);
+
+    // ranges must stay valid until the next call. A start is an index i with
+    // r[i + 1] > r[i] + jump, an end an index i + 1 with r[i] > r[i + 1] + jump,
+    // in reversed order. Indices that are both a start and an end (one beam
+    // dips) are moved to common().
+    void detect(const std::vector<float>& ranges, double jump);
+
+    size_t size() const { return n_; }
+
+    // Range at reversed index i, throws std::out_of_range like vector::at.
+    double at(size_t i) const;
+
+    // Smallest range and its first reversed index.
+    double minRange() const { return min_; }
+    int minIndex() const { return minIdx_; }
+
+    std::vector<int>& starts() { return starts_; }
+    std::vector<int>& ends() { return ends_; }
+    std::vector<int>& common() { return common_; }
+
+private:
+    void splitCommon();
+
+    const float* ranges_;
+    size_t n_;
+    double min_;
+    int minIdx_;
+
+    std::vector<unsigned char> flags_;
+    std::vector<int> starts_;
+    std::vector<int> ends_;
+    std::vector<int> common_;
+};
+};
+
+#endif
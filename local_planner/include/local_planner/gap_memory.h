@@ -0,0 +1,97 @@
+#ifndef LOCAL_PLANNER_GAP_MEMORY_H_
+#define LOCAL_PLANNER_GAP_MEMORY_H_
+
+#include <vector>
+
+namespace local_planner{
+
+// Memory of gap midpoints seen by the planner, clustered into gaps.
+//
+// Midpoints are kept in a fixed-size ring buffer in insertion order and
+// indexed by a hashed uniform grid whose cell size is the merge radius, so
+// neighbours are found by looking at the 3x3 surrounding cells. Midpoints
+// closer than the merge radius belong to the same gap; the connected
+// components are maintained with a union-find that is updated on insertion
+// and only rebuilt for the component a midpoint is evicted from.
+class GapMemory{
+public:
+
+    struct Cluster
+    {
+        double x;
+        double y;
+        double width;
+    };
+
+    GapMemory();
+
+    // Reset the memory. max_age and max_distance disable the respective
+    // eviction when <= 0.
+    void configure(int capacity, double merge_radius, double max_age, double max_distance);
+
+    void clear();
+
+    // Add a midpoint, evicting the oldest one if the memory is full.
+    void insert(double x, double y, double width, double stamp);
+
+    // Drop midpoints older than max_age, and amortized, midpoints farther
+    // than max_distance from the robot.
+    void evict(double now, double robot_x, double robot_y);
+
+    bool empty() const { return alive_ == 0; }
+
+    int size() const { return alive_; }
+
+    // One entry per gap, ordered by its oldest midpoint. Coordinates and
+    // width are averaged with weights growing by 0.4 per newer midpoint.
+    void clusters(std::vector<Cluster>& out);
+
+private:
+    struct Entry
+    {
+        double x;
+        double y;
+        double width;
+        double stamp;
+        bool alive;
+        int parent;
+        int rank;
+        int next_member;    // circular list of the members of a component
+        int bucket;
+        int next_in_bucket;
+        int prev_in_bucket;
+    };
+
+    struct Accumulator
+    {
+        int count;
+        double weight;
+        double x;
+        double y;
+        double width;
+    };
+
+    int find(int i);
+    void unite(int a, int b);
+    void link(int i);
+    void remove(int i);
+    int bucketOf(double x, double y, int dx, int dy) const;
+
+    std::vector<Entry> entries_;
+    std::vector<int> buckets_;
+    std::vector<Accumulator> accum_;
+    std::vector<int> scratch_;
+
+    int capacity_;
+    int tail_;      // oldest slot
+    int span_;      // slots in use from tail_, including evicted holes
+    int alive_;
+    int cursor_;    // round-robin position of the distance eviction
+    int bucketMask_;
+    double radius_;
+    double maxAge_;
+    double maxDistance_;
+};
+};
+
+#endif
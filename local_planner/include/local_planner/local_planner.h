@@ -3,6 +3,7 @@
 
 // abstract class from which our plugin inherits
 #include <ros/ros.h>
+#include <ros/callback_queue.h>
 #include <nav_core/base_local_planner.h>
 
 #include <visualization_msgs/Marker.h>
@@ -27,6 +28,11 @@
 #include <boost/shared_ptr.hpp>
 #include <base_local_planner/goal_functions.h>
 
+#include "local_planner/cycle_profiler.h"
+#include "local_planner/gap_detector.h"
+#include "local_planner/gap_memory.h"
+#include "local_planner/plan_cursor.h"
+
 #include <vector>
 #include <deque>
 #include <string>
@@ -34,6 +40,7 @@
 #include <algorithm>
 #include <exception>
 #include <deque>
+#include <atomic>
 
 using namespace std;
 
@@ -84,6 +91,9 @@ public:
     ~LocalPlanner();
 
 private:
+    // Take this cycle's scan and pose, false if one is missing or stale
+    bool takeSnapshot();
+
     bool initialized_;
     costmap_2d::Costmap2D* costmap_;
     costmap_2d::Costmap2DROS* costmapROS_;
@@ -97,7 +107,12 @@ private:
     tf::Stamped<tf::tfMessage> currentPoseTF1_;
     geometry_msgs::PoseStamped currentPoseTF2_;
     
-    // Sensor subscriptions
+    // Sensor subscriptions, served by their own queue and spinner. The callbacks
+    // only swap the shared_ptrs below atomically, the planner reads them once
+    // per cycle into scan_ / pose_.
+    ros::NodeHandle sensorNh_;
+    ros::CallbackQueue sensorQueue_;
+    boost::shared_ptr<ros::AsyncSpinner> sensorSpinner_;
     ros::Subscriber odomSub_;
     ros::Subscriber multiScanSub_;
     ros::Subscriber scanSub_;
@@ -110,7 +125,13 @@ private:
     boost::shared_ptr<sensor_msgs::LaserScan const> scanMultiPtr_;
     boost::shared_ptr<geometry_msgs::PoseWithCovarianceStamped const> posePtr_;
     boost::shared_ptr<nav_msgs::OccupancyGrid const> costmapPtr_;
-    double cmdPtr_;
+    std::atomic<double> cmdPtr_;
+
+    // Inputs of the current cycle
+    boost::shared_ptr<sensor_msgs::LaserScan const> scan_;
+    boost::shared_ptr<geometry_msgs::PoseWithCovarianceStamped const> pose_;
+    double scanTimeout_;
+    double poseTimeout_;
 
     // Publishers
     ros::Publisher globalPlanPub_;
@@ -119,7 +140,8 @@ private:
     ros::Publisher marker_pub_;
     ros::Publisher virtual_lidar_pub_;
 
-    double lookAheadDist_ = 1.1;
+    double lookAheadDist_ = 10.0;   // m along the global plan
+    PlanCursor planCursor_;
     int collision_counter = 0;
     double dist_travelled = 0.0;
     double goalDistTolerance_;
@@ -129,6 +151,17 @@ private:
 
     double lastCallbackTime_;
 
+    // Per-stage cycle timing
+    CycleProfiler profiler_;
+
+    // Gap extraction on the current scan and its reused workspace
+    GapDetector gapDetector_;
+    std::vector<int> gapIndices_;
+
+    // Gap midpoint memory and its per-cycle clustering output
+    GapMemory gapMemory_;
+    std::vector<GapMemory::Cluster> gapsInMemory_;
+
 };
 };
 
@@ -0,0 +1,44 @@
+#ifndef LOCAL_PLANNER_PLAN_CURSOR_H_
+#define LOCAL_PLANNER_PLAN_CURSOR_H_
+
+#include <geometry_msgs/PoseStamped.h>
+
+#include <vector>
+
+namespace local_planner{
+
+// Tracks the robot along the global plan.
+//
+// The cumulative arc length of the plan is computed once per plan. Each cycle
+// the closest waypoint is searched only in a bounded window ahead of the
+// previous one, and the lookahead goal is the first waypoint at least the
+// lookahead distance further along the plan. Both indices only move forward,
+// so a cycle costs O(window) regardless of the plan size.
+class PlanCursor{
+public:
+
+    PlanCursor();
+
+    void configure(double lookahead, int search_window);
+
+    void setPlan(const std::vector<geometry_msgs::PoseStamped>& plan);
+
+    // Advance to the robot position and return the lookahead goal index,
+    // or -1 for an empty plan.
+    int update(double x, double y);
+
+    int closest() const { return closest_; }
+
+private:
+    std::vector<double> x_;
+    std::vector<double> y_;
+    std::vector<double> s_;     // arc length from the first waypoint
+
+    double lookahead_;
+    int window_;
+    int closest_;
+    int goal_;
+};
+};
+
+#endif
@@ -0,0 +1,244 @@
+#include "local_planner/cycle_profiler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+namespace local_planner
+{
+    void LatencyHistogram::reset()
+    {
+        std::memset(buckets_, 0, sizeof(buckets_));
+        count_ = 0;
+        max_ = 0;
+    }
+
+    int LatencyHistogram::bucketOf(uint64_t ns)
+    {
+        if (ns < (uint64_t)kSub)
+            return (int)ns;
+        if (ns >> 32)
+            return kBuckets - 1;
+        int e = 63 - __builtin_clzll(ns);
+        int sub = (int)(ns >> (e - kSubBits)) - kSub;
+        return (e - kSubBits + 1) * kSub + sub;
+    }
+
+    uint64_t LatencyHistogram::upperEdge(int bucket)
+    {
+        if (bucket < kSub)
+            return bucket;
+        int e = bucket / kSub + kSubBits - 1;
+        int sub = bucket % kSub;
+        return ((uint64_t)(kSub + sub + 1) << (e - kSubBits)) - 1;
+    }
+
+    void LatencyHistogram::record(uint64_t ns)
+    {
+        buckets_[bucketOf(ns)]++;
+        count_++;
+        max_ = std::max(max_, ns);
+    }
+
+    uint64_t LatencyHistogram::percentile(double p) const
+    {
+        if (count_ == 0)
+            return 0;
+        uint64_t target = std::max<uint64_t>(1, (uint64_t)std::ceil(p * count_));
+        uint64_t seen = 0;
+        for (int i = 0; i < kBuckets; i++)
+        {
+            seen += buckets_[i];
+            if (seen >= target)
+                return std::min(upperEdge(i), max_);
+        }
+        return max_;
+    }
+
+    CycleProfiler::Timer::Timer(CycleProfiler& profiler, Stage stage)
+        : profiler_(profiler), stage_(stage), start_(CycleProfiler::now())
+    {
+    }
+
+    CycleProfiler::Timer::~Timer()
+    {
+        uint64_t t = CycleProfiler::now();
+        profiler_.record(stage_, t - start_, t);
+    }
+
+    void CycleProfiler::Timer::next(Stage stage)
+    {
+        if (stage == stage_)
+            return;
+        uint64_t t = CycleProfiler::now();
+        profiler_.record(stage_, t - start_, t);
+        stage_ = stage;
+        start_ = t;
+    }
+
+    CycleProfiler::CycleProfiler()
+        : overruns_(0), budgetNs_(0), totalCycles_(0), totalCycleTime_(0.0), traceHead_(0)
+    {
+    }
+
+    void CycleProfiler::initialize(ros::NodeHandle& nh)
+    {
+        double publishPeriod, cycleBudget;
+        int traceSize;
+        nh.param("profiler_publish_period", publishPeriod, 1.0);
+        nh.param("profiler_cycle_budget", cycleBudget, 0.1);
+        nh.param("profiler_trace_size", traceSize, 4096);
+        nh.param("profiler_trace_file", traceFile_, std::string("/tmp/local_planner_trace.bin"));
+
+        publishPeriod_ = ros::WallDuration(publishPeriod);
+        lastPublish_ = ros::WallTime::now();
+        budgetNs_ = cycleBudget > 0.0 ? (uint64_t)(cycleBudget * 1e9) : 0;
+        trace_.assign(std::max(traceSize, 0), TraceRecord());
+        traceHead_.store(0);
+
+        // the stats message is built once, only the values change
+        stats_.status.resize(STAGE_COUNT);
+        for (int i = 0; i < STAGE_COUNT; i++)
+        {
+            diagnostic_msgs::DiagnosticStatus &status = stats_.status[i];
+            status.name = std::string("local_planner: ") + stageName((Stage)i);
+            status.values.resize(i == CYCLE ? 5 : 4);
+            status.values[0].key = "count";
+            status.values[1].key = "p50 (ms)";
+            status.values[2].key = "p99 (ms)";
+            status.values[3].key = "max (ms)";
+            if (i == CYCLE)
+                status.values[4].key = "overruns";
+        }
+
+        statsPub_ = nh.advertise<diagnostic_msgs::DiagnosticArray>("cycle_stats", 1);
+        if (!trace_.empty())
+            dumpSrv_ = nh.advertiseService("dump_cycle_trace", &CycleProfiler::dumpTrace, this);
+    }
+
+    uint64_t CycleProfiler::now()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    const char* CycleProfiler::stageName(Stage stage)
+    {
+        switch (stage)
+        {
+        case SCAN_COPY:         return "scan copy";
+        case GAP_DETECTION:     return "gap detection";
+        case MEMORY_UPDATE:     return "memory update";
+        case GAP_SELECTION:     return "gap selection";
+        case COMMAND_SHAPING:   return "command shaping";
+        case CYCLE:             return "cycle";
+        default:                return "unknown";
+        }
+    }
+
+    void CycleProfiler::record(Stage stage, uint64_t ns, uint64_t stamp)
+    {
+        histograms_[stage].record(ns);
+
+        if (!trace_.empty())
+        {
+            uint64_t head = traceHead_.load(std::memory_order_relaxed);
+            TraceRecord &r = trace_[head % trace_.size()];
+            r.stamp_ns = stamp;
+            r.duration_ns = (uint32_t)std::min<uint64_t>(ns, UINT32_MAX);
+            r.stage = stage;
+            traceHead_.store(head + 1, std::memory_order_release);
+        }
+
+        if (stage != CYCLE)
+            return;
+
+        totalCycles_++;
+        totalCycleTime_ += ns * 1e-9;
+        if (budgetNs_ > 0 && ns > budgetNs_)
+        {
+            overruns_++;
+            ROS_WARN_THROTTLE(1.0, "Local planner cycle took %.1f ms, budget is %.1f ms", ns * 1e-6, budgetNs_ * 1e-6);
+        }
+
+        ros::WallTime t = ros::WallTime::now();
+        if (t - lastPublish_ >= publishPeriod_)
+        {
+            lastPublish_ = t;
+            publish();
+        }
+    }
+
+    double CycleProfiler::meanCycleTime() const
+    {
+        return totalCycles_ > 0 ? totalCycleTime_ / totalCycles_ : 0.0;
+    }
+
+    // Publish the window since the last publish and start a new one.
+    void CycleProfiler::publish()
+    {
+        stats_.header.stamp = ros::Time::now();
+        for (int i = 0; i < STAGE_COUNT; i++)
+        {
+            LatencyHistogram &h = histograms_[i];
+            diagnostic_msgs::DiagnosticStatus &status = stats_.status[i];
+            status.level = diagnostic_msgs::DiagnosticStatus::OK;
+            status.message = "";
+            status.values[0].value = std::to_string(h.count());
+            status.values[1].value = std::to_string(h.percentile(0.5) * 1e-6);
+            status.values[2].value = std::to_string(h.percentile(0.99) * 1e-6);
+            status.values[3].value = std::to_string(h.max() * 1e-6);
+            if (i == CYCLE)
+            {
+                status.values[4].value = std::to_string(overruns_);
+                if (overruns_ > 0)
+                {
+                    status.level = diagnostic_msgs::DiagnosticStatus::WARN;
+                    status.message = "cycle budget exceeded";
+                }
+            }
+            h.reset();
+        }
+        overruns_ = 0;
+        statsPub_.publish(stats_);
+    }
+
+    // Runs on the callback thread while the planner keeps recording. Records
+    // the planner may have overwritten during the copy are dropped.
+    bool CycleProfiler::dumpTrace(std_srvs::Trigger::Request& req, std_srvs::Trigger::Response& res)
+    {
+        const uint64_t size = trace_.size();
+        uint64_t head = traceHead_.load(std::memory_order_acquire);
+        uint64_t first = head > size ? head - size : 0;
+
+        std::vector<TraceRecord> copy;
+        copy.reserve(head - first);
+        for (uint64_t i = first; i < head; i++)
+            copy.push_back(trace_[i % size]);
+
+        // the slot at index head may be in the middle of a write
+        uint64_t after = traceHead_.load(std::memory_order_acquire);
+        uint64_t valid = after + 1 > size ? after + 1 - size : 0;
+        size_t skip = valid > first ? std::min<uint64_t>(valid - first, copy.size()) : 0;
+
+        std::ofstream out(traceFile_.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+        uint32_t count = (uint32_t)(copy.size() - skip);
+        out.write("LPTRACE1", 8);
+        out.write(reinterpret_cast<const char*>(&count), sizeof(count));
+        if (count > 0)
+            out.write(reinterpret_cast<const char*>(&copy[skip]), count * sizeof(TraceRecord));
+        out.close();
+
+        std::ostringstream msg;
+        res.success = !out.fail();
+        if (res.success)
+            msg << "wrote " << count << " records to " << traceFile_;
+        else
+            msg << "could not write " << traceFile_;
+        res.message = msg.str();
+        return true;
+    }
+};
@@ -0,0 +1,138 @@
+#include "local_planner/gap_detector.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdint.h>
+#include <limits>
+#include <stdexcept>
+
+namespace local_planner
+{
+    static const unsigned char kStartFlag = 1;
+    static const unsigned char kEndFlag = 2;
+    static const int kLanes = 8;
+    static const int kWord = sizeof(uint64_t);
+
+    GapDetector::GapDetector()
+        : ranges_(NULL), n_(0), min_(std::numeric_limits<double>::infinity()), minIdx_(0)
+    {
+    }
+
+    void GapDetector::reserve(size_t n)
+    {
+        // whole words, see detect()
+        flags_.resize(std::max(flags_.size(), (n + kWord - 1) / kWord * kWord));
+        // the planner appends the common indices and a closing end back onto
+        // the lists, which stays within n + 1
+        starts_.reserve(n + 2);
+        ends_.reserve(n + 2);
+        common_.reserve(n + 2);
+    }
+
+    double GapDetector::at(size_t i) const
+    {
+        if (i >= n_)
+            throw std::out_of_range("GapDetector::at");
+        return ranges_[n_ - 1 - i];
+    }
+
+    void GapDetector::detect(const std::vector<float>& ranges, double jump)
+    {
+        if (ranges.size() > flags_.size())
+            reserve(ranges.size());
+
+        ranges_ = ranges.data();
+        n_ = ranges.size();
+        starts_.clear();
+        ends_.clear();
+        common_.clear();
+        min_ = std::numeric_limits<double>::infinity();
+        minIdx_ = 0;
+
+        if (n_ == 0)
+            return;
+
+        // Sensor order j maps to reversed index n - 1 - j. Both passes are
+        // branch-free with no dependency between iterations; the minimum is
+        // kept in kLanes independent lanes so the compiler can map it onto
+        // packed min instructions. The first reversed minimum is the last one
+        // in sensor order.
+        const float* r = ranges_;
+        unsigned char* flags = flags_.data();
+        const int last = (int)n_ - 1;
+        for (int j = 0; j < last; j++)
+        {
+            const double a = r[j];
+            const double b = r[j + 1];
+            flags[j] = (unsigned char)((a > b + jump) * kStartFlag + (b > a + jump) * kEndFlag);
+        }
+
+        float lanes[kLanes];
+        for (int k = 0; k < kLanes; k++)
+            lanes[k] = r[last];
+        int i = 0;
+        for (; i + kLanes <= last; i += kLanes)
+        {
+            for (int k = 0; k < kLanes; k++)
+                lanes[k] = r[i + k] < lanes[k] ? r[i + k] : lanes[k];
+        }
+        for (; i < last; i++)
+            lanes[0] = r[i] < lanes[0] ? r[i] : lanes[0];
+        float m = lanes[0];
+        for (int k = 1; k < kLanes; k++)
+            m = lanes[k] < m ? lanes[k] : m;
+        int mj = last;
+        while (mj > 0 && !(r[mj] == m))
+            mj--;
+        minIdx_ = last - mj;
+        min_ = r[mj];
+
+        // Walk sensor order backwards so both lists come out ascending. Jumps
+        // are rare, so the flags are tested a word at a time; the pad after
+        // the last flag is kept zero.
+        const int words = (last + kWord - 1) / kWord;
+        std::fill(flags + last, flags + words * kWord, 0);
+        for (int w = words - 1; w >= 0; w--)
+        {
+            uint64_t word;
+            std::memcpy(&word, flags + w * kWord, kWord);
+            if (word == 0)
+                continue;
+            for (int j = w * kWord + kWord - 1; j >= w * kWord; j--)
+            {
+                if (flags[j] & kStartFlag)
+                    starts_.push_back(last - 1 - j);
+                if (flags[j] & kEndFlag)
+                    ends_.push_back(last - j);
+            }
+        }
+
+        splitCommon();
+    }
+
+    // Move indices present in both sorted lists to common_, compacting the
+    // lists in place.
+    void GapDetector::splitCommon()
+    {
+        size_t s = 0, e = 0, sw = 0, ew = 0;
+        while (s < starts_.size() && e < ends_.size())
+        {
+            if (starts_[s] < ends_[e])
+                starts_[sw++] = starts_[s++];
+            else if (ends_[e] < starts_[s])
+                ends_[ew++] = ends_[e++];
+            else
+            {
+                common_.push_back(starts_[s]);
+                s++;
+                e++;
+            }
+        }
+        while (s < starts_.size())
+            starts_[sw++] = starts_[s++];
+        while (e < ends_.size())
+            ends_[ew++] = ends_[e++];
+        starts_.resize(sw);
+        ends_.resize(ew);
+    }
+};
@@ -0,0 +1,147 @@
+// Microbenchmark of the gap extraction kernel on recorded scans.
+//
+//   rosrun local_planner gap_detector_benchmark <bag> [topic] [repeats]
+//
+// Every scan of the topic is run through the copy/reverse/intersect steps the
+// planner used before and through GapDetector. Reports time per cycle and the
+// heap allocations made once the detector is warmed up.
+
+#include "local_planner/gap_detector.h"
+
+#include <rosbag/bag.h>
+#include <rosbag/view.h>
+#include <sensor_msgs/LaserScan.h>
+
+#include <boost/foreach.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iterator>
+#include <new>
+#include <string>
+#include <vector>
+
+static unsigned long g_allocations = 0;
+
+void* operator new(size_t size)
+{
+    g_allocations++;
+    void* p = std::malloc(size ? size : 1);
+    if (!p)
+        throw std::bad_alloc();
+    return p;
+}
+
+void operator delete(void* p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+    std::free(p);
+}
+
+// The extraction as LocalPlanner::LLCallback did it before GapDetector.
+static int legacyExtract(const sensor_msgs::LaserScan& scan, double& dmin)
+{
+    std::vector<double> laserRanges;
+    for (unsigned int i = 0; i < scan.ranges.size(); i++)
+        laserRanges.push_back(scan.ranges[i]);
+    std::vector<double> currRange = laserRanges;
+    std::reverse(currRange.begin(), currRange.end());
+    dmin = *std::min_element(currRange.begin(), currRange.end());
+
+    std::vector<int> starts, ends, common;
+    for (unsigned int i = 0; i + 1 < currRange.size(); i++)
+    {
+        if (currRange[i + 1] > currRange[i] + 1.0)
+            starts.push_back(i);
+        if (currRange[i] > currRange[i + 1] + 1.0)
+            ends.push_back(i + 1);
+    }
+    std::set_intersection(starts.begin(), starts.end(), ends.begin(), ends.end(), std::back_inserter(common));
+    for (size_t k = 0; k < common.size(); k++)
+    {
+        starts.erase(std::find(starts.begin(), starts.end(), common[k]));
+        ends.erase(std::find(ends.begin(), ends.end(), common[k]));
+    }
+    return starts.size() + ends.size() + common.size();
+}
+
+static double nsPerCycle(std::chrono::steady_clock::duration d, size_t cycles)
+{
+    return cycles ? std::chrono::duration<double, std::nano>(d).count() / cycles : 0.0;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2)
+    {
+        std::fprintf(stderr, "usage: %s <bag> [topic] [repeats]\n", argv[0]);
+        return 1;
+    }
+    std::string topic = argc > 2 ? argv[2] : "/scan";
+    int repeats = argc > 3 ? std::atoi(argv[3]) : 100;
+
+    std::vector<sensor_msgs::LaserScan::ConstPtr> scans;
+    rosbag::Bag bag;
+    bag.open(argv[1], rosbag::bagmode::Read);
+    rosbag::View view(bag, rosbag::TopicQuery(topic));
+    BOOST_FOREACH(const rosbag::MessageInstance& m, view)
+    {
+        sensor_msgs::LaserScan::ConstPtr scan = m.instantiate<sensor_msgs::LaserScan>();
+        if (scan && !scan->ranges.empty())
+            scans.push_back(scan);
+    }
+    bag.close();
+
+    if (scans.empty())
+    {
+        std::fprintf(stderr, "no sensor_msgs/LaserScan on %s\n", topic.c_str());
+        return 1;
+    }
+
+    const size_t cycles = scans.size() * repeats;
+    volatile double sink = 0.0;
+
+    unsigned long allocations = g_allocations;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int r = 0; r < repeats; r++)
+    {
+        for (size_t i = 0; i < scans.size(); i++)
+        {
+            double dmin;
+            sink = sink + legacyExtract(*scans[i], dmin) + dmin;
+        }
+    }
+    std::chrono::steady_clock::duration legacyTime = std::chrono::steady_clock::now() - start;
+    unsigned long legacyAllocations = g_allocations - allocations;
+
+    local_planner::GapDetector detector;
+    detector.reserve(1024);
+    for (size_t i = 0; i < scans.size(); i++)
+        detector.detect(scans[i]->ranges, 1.0);
+
+    allocations = g_allocations;
+    start = std::chrono::steady_clock::now();
+    for (int r = 0; r < repeats; r++)
+    {
+        for (size_t i = 0; i < scans.size(); i++)
+        {
+            detector.detect(scans[i]->ranges, 1.0);
+            sink = sink + detector.starts().size() + detector.ends().size() + detector.common().size() + detector.minRange();
+        }
+    }
+    std::chrono::steady_clock::duration detectorTime = std::chrono::steady_clock::now() - start;
+    unsigned long detectorAllocations = g_allocations - allocations;
+
+    std::printf("%zu scans of %zu beams, %zu cycles\n", scans.size(), scans[0]->ranges.size(), cycles);
+    std::printf("legacy:   %9.1f ns/cycle  %8.2f allocations/cycle\n",
+                nsPerCycle(legacyTime, cycles), (double)legacyAllocations / cycles);
+    std::printf("detector: %9.1f ns/cycle  %8.2f allocations/cycle (%lu total)\n",
+                nsPerCycle(detectorTime, cycles), (double)detectorAllocations / cycles, detectorAllocations);
+    return 0;
+}
@@ -0,0 +1,238 @@
+#include "local_planner/gap_memory.h"
+
+#include <cmath>
+#include <algorithm>
+
+namespace local_planner
+{
+    // Number of slots checked against max_distance per evict() call
+    static const int kDistanceChecksPerCycle = 8;
+
+    GapMemory::GapMemory()
+    {
+        configure(100, 0.5, 0.0, 0.0);
+    }
+
+    void GapMemory::configure(int capacity, double merge_radius, double max_age, double max_distance)
+    {
+        capacity_ = std::max(capacity, 1);
+        radius_ = merge_radius;
+        maxAge_ = max_age;
+        maxDistance_ = max_distance;
+
+        int buckets = 1;
+        while (buckets < 2 * capacity_)
+            buckets <<= 1;
+        bucketMask_ = buckets - 1;
+
+        entries_.assign(capacity_, Entry());
+        buckets_.assign(buckets, -1);
+        accum_.assign(capacity_, Accumulator());
+        scratch_.clear();
+        scratch_.reserve(capacity_);
+        clear();
+    }
+
+    void GapMemory::clear()
+    {
+        for (int i = 0; i < capacity_; i++)
+        {
+            entries_[i].alive = false;
+            accum_[i].count = 0;
+        }
+        std::fill(buckets_.begin(), buckets_.end(), -1);
+        tail_ = 0;
+        span_ = 0;
+        alive_ = 0;
+        cursor_ = 0;
+    }
+
+    int GapMemory::bucketOf(double x, double y, int dx, int dy) const
+    {
+        long ix = (long)std::floor(x / radius_) + dx;
+        long iy = (long)std::floor(y / radius_) + dy;
+        return (int)(((unsigned long)(ix * 73856093L) ^ (unsigned long)(iy * 19349663L)) & bucketMask_);
+    }
+
+    int GapMemory::find(int i)
+    {
+        while (entries_[i].parent != i)
+        {
+            entries_[i].parent = entries_[entries_[i].parent].parent;
+            i = entries_[i].parent;
+        }
+        return i;
+    }
+
+    void GapMemory::unite(int a, int b)
+    {
+        int ra = find(a);
+        int rb = find(b);
+        if (ra == rb)
+            return;
+
+        if (entries_[ra].rank < entries_[rb].rank)
+            std::swap(ra, rb);
+        entries_[rb].parent = ra;
+        if (entries_[ra].rank == entries_[rb].rank)
+            entries_[ra].rank++;
+
+        // splice the two circular member lists
+        std::swap(entries_[a].next_member, entries_[b].next_member);
+    }
+
+    // Join midpoint i with every live midpoint within the merge radius.
+    void GapMemory::link(int i)
+    {
+        const Entry &e = entries_[i];
+        const double r2 = radius_ * radius_;
+
+        for (int dx = -1; dx <= 1; dx++)
+        {
+            for (int dy = -1; dy <= 1; dy++)
+            {
+                for (int j = buckets_[bucketOf(e.x, e.y, dx, dy)]; j >= 0; j = entries_[j].next_in_bucket)
+                {
+                    if (j == i)
+                        continue;
+                    double ddx = entries_[j].x - e.x;
+                    double ddy = entries_[j].y - e.y;
+                    if (ddx * ddx + ddy * ddy < r2)
+                        unite(i, j);
+                }
+            }
+        }
+    }
+
+    void GapMemory::insert(double x, double y, double width, double stamp)
+    {
+        if (span_ == capacity_)
+        {
+            if (entries_[tail_].alive)
+                remove(tail_);
+            tail_ = (tail_ + 1) % capacity_;
+            span_--;
+        }
+
+        int i = (tail_ + span_) % capacity_;
+        Entry &e = entries_[i];
+        e.x = x;
+        e.y = y;
+        e.width = width;
+        e.stamp = stamp;
+        e.alive = true;
+        e.parent = i;
+        e.rank = 0;
+        e.next_member = i;
+
+        e.bucket = bucketOf(x, y, 0, 0);
+        e.prev_in_bucket = -1;
+        e.next_in_bucket = buckets_[e.bucket];
+        if (e.next_in_bucket >= 0)
+            entries_[e.next_in_bucket].prev_in_bucket = i;
+        buckets_[e.bucket] = i;
+
+        span_++;
+        alive_++;
+
+        link(i);
+    }
+
+    // Remove midpoint i. Its component may fall apart, so the remaining
+    // members are reset to singletons and relinked with their neighbours.
+    void GapMemory::remove(int i)
+    {
+        Entry &e = entries_[i];
+
+        if (e.prev_in_bucket >= 0)
+            entries_[e.prev_in_bucket].next_in_bucket = e.next_in_bucket;
+        else
+            buckets_[e.bucket] = e.next_in_bucket;
+        if (e.next_in_bucket >= 0)
+            entries_[e.next_in_bucket].prev_in_bucket = e.prev_in_bucket;
+
+        scratch_.clear();
+        for (int m = e.next_member; m != i; m = entries_[m].next_member)
+            scratch_.push_back(m);
+
+        e.alive = false;
+        alive_--;
+
+        for (size_t k = 0; k < scratch_.size(); k++)
+        {
+            Entry &m = entries_[scratch_[k]];
+            m.parent = scratch_[k];
+            m.rank = 0;
+            m.next_member = scratch_[k];
+        }
+        for (size_t k = 0; k < scratch_.size(); k++)
+            link(scratch_[k]);
+    }
+
+    void GapMemory::evict(double now, double robot_x, double robot_y)
+    {
+        // the ring is in insertion order, so old midpoints are at the tail
+        while (span_ > 0 && (!entries_[tail_].alive || (maxAge_ > 0.0 && now - entries_[tail_].stamp > maxAge_)))
+        {
+            if (entries_[tail_].alive)
+                remove(tail_);
+            tail_ = (tail_ + 1) % capacity_;
+            span_--;
+        }
+
+        if (maxDistance_ <= 0.0 || span_ == 0)
+            return;
+
+        const double d2 = maxDistance_ * maxDistance_;
+        for (int k = 0; k < kDistanceChecksPerCycle && k < span_; k++)
+        {
+            cursor_ = (cursor_ + 1) % span_;
+            int i = (tail_ + cursor_) % capacity_;
+            if (!entries_[i].alive)
+                continue;
+            double dx = entries_[i].x - robot_x;
+            double dy = entries_[i].y - robot_y;
+            if (dx * dx + dy * dy > d2)
+                remove(i);
+        }
+    }
+
+    void GapMemory::clusters(std::vector<Cluster> &out)
+    {
+        out.clear();
+        scratch_.clear();
+
+        for (int k = 0; k < span_; k++)
+        {
+            int i = (tail_ + k) % capacity_;
+            const Entry &e = entries_[i];
+            if (!e.alive)
+                continue;
+
+            int r = find(i);
+            Accumulator &a = accum_[r];
+            if (a.count == 0)
+            {
+                scratch_.push_back(r);
+                a.weight = a.x = a.y = a.width = 0.0;
+            }
+            double w = 1.0 + 0.4 * a.count;
+            a.x += e.x * w;
+            a.y += e.y * w;
+            a.width += e.width * w;
+            a.weight += w;
+            a.count++;
+        }
+
+        for (size_t k = 0; k < scratch_.size(); k++)
+        {
+            Accumulator &a = accum_[scratch_[k]];
+            Cluster c;
+            c.x = a.x / a.weight;
+            c.y = a.y / a.weight;
+            c.width = a.width / a.weight;
+            out.push_back(c);
+            a.count = 0;
+        }
+    }
+};
@@ -1,7 +1,6 @@
 #include <pluginlib/class_list_macros.h>
 #include "local_planner/local_planner.h"
 #include <ros/console.h>
-#include <fstream>
 
 
 PLUGINLIB_EXPORT_CLASS(local_planner::LocalPlanner, nav_core::BaseLocalPlanner)
@@ -10,14 +9,7 @@ double x_buf[2] = {0.0, 0.0};
 double y_buf[2] = {0.0, 0.0};
 double xx_buf[2] = {0.0, 0.0};
 double yy_buf[2] = {0.0, 0.0};
-ros::Time startTime;
-ros::Time endTime;
-ros::Time totalTimeEnd;
-ros::Duration totalExecutionTime;
-std::vector<ros::Duration> executionTimes;
 int dminIdx;
-double averageExecTime;
-ofstream myfile;
 namespace local_planner
 {
     LocalPlanner::LocalPlanner() : costmapROS_(NULL), tf_(NULL), initialized_(false) {}
@@ -34,6 +26,8 @@ namespace local_planner
     LocalPlanner::~LocalPlanner()
 
     {
+        if (sensorSpinner_)
+            sensorSpinner_->stop();
         ROS_INFO("Local planner out.");
     }
 
@@ -52,15 +46,51 @@ namespace local_planner
             costmap_ = costmapROS_->getCostmap();
 
             // Subscribers
-            odomSub_ = nh_.subscribe("/odom", 100, &LocalPlanner::odomCallback, this);
+            // Only the latest message of each topic is of use, so they are kept at depth 1 on a
+            // separate queue served by sensor_spinner_threads threads instead of move_base's spinner.
+            // A cycle fails if its scan (pose) is older than scan_timeout (pose_timeout), <= 0 disables.
+            int sensorSpinnerThreads;
+            nh_.param("sensor_spinner_threads", sensorSpinnerThreads, 1);
+            nh_.param("scan_timeout", scanTimeout_, 0.5);
+            nh_.param("pose_timeout", poseTimeout_, 0.0);
+            cmdPtr_ = 0.0;
 
-            scanSub_ = nh_.subscribe("/scan", 100, &LocalPlanner::scanCallback, this); //scan move base içinde remap edildi buradaki scan scan_multi_filtered a yönlendiriliyor.
+            sensorNh_ = nh_;
+            sensorNh_.setCallbackQueue(&sensorQueue_);
+            ros::TransportHints hints = ros::TransportHints().tcpNoDelay();
 
-            poseSub_ = nh_.subscribe("/amcl_pose", 100, &LocalPlanner::poseCallback, this);
-            
-            cmdSub_ = nh_.subscribe("/cmd_vel_controller", 100, &LocalPlanner::cmdCallback, this);
+            odomSub_ = sensorNh_.subscribe("/odom", 1, &LocalPlanner::odomCallback, this, hints);
+
+            scanSub_ = sensorNh_.subscribe("/scan", 1, &LocalPlanner::scanCallback, this, hints); //scan move base içinde remap edildi buradaki scan scan_multi_filtered a yönlendiriliyor.
 
-            // nh_.getParam("/move_base/local_planner/look_ahead_dist", lookAheadDist_);
+            poseSub_ = sensorNh_.subscribe("/amcl_pose", 1, &LocalPlanner::poseCallback, this, hints);
+            
+            cmdSub_ = sensorNh_.subscribe("/cmd_vel_controller", 1, &LocalPlanner::cmdCallback, this, hints);
+
+            sensorSpinner_.reset(new ros::AsyncSpinner(std::max(sensorSpinnerThreads, 1), &sensorQueue_));
+            sensorSpinner_->start();
+
+            // Local goal: the waypoint look_ahead_dist (m) further along the global plan than the
+            // closest one, which is searched plan_search_window waypoints ahead of the last one
+            int planSearchWindow;
+            nh_.param("look_ahead_dist", lookAheadDist_, 10.0);
+            nh_.param("plan_search_window", planSearchWindow, 50);
+            planCursor_.configure(lookAheadDist_, planSearchWindow);
+
+            // Gap memory: capacity in midpoints, radius (m) under which midpoints are the same gap,
+            // and optional age (s) / distance from robot (m) limits, disabled when <= 0
+            int gapMemorySize;
+            double gapMergeRadius, gapMemoryMaxAge, gapMemoryMaxDistance;
+            nh_.param("gap_memory_size", gapMemorySize, 100);
+            nh_.param("gap_merge_radius", gapMergeRadius, 0.5);
+            nh_.param("gap_memory_max_age", gapMemoryMaxAge, 0.0);
+            nh_.param("gap_memory_max_distance", gapMemoryMaxDistance, 0.0);
+            gapMemory_.configure(gapMemorySize, gapMergeRadius, gapMemoryMaxAge, gapMemoryMaxDistance);
+            gapsInMemory_.reserve(gapMemorySize);
+
+            // Gap extraction workspaces, they only grow if a longer scan arrives
+            gapDetector_.reserve(1024);
+            gapIndices_.reserve(1024);
 
             // Publishers
             marker_pub_ = nh_.advertise<visualization_msgs::MarkerArray>("gap_markers", 10);
@@ -71,11 +101,11 @@ namespace local_planner
 
             wRefPub_ = nh_.advertise<std_msgs::Float32>("angular_vel_output", 1);
 
+            // Cycle timing: per-stage latency histograms on ~local_planner/cycle_stats
+            profiler_.initialize(nh_);
+
             ROS_INFO("Local planner has been initialized successfully.");
             initialized_ = true;
-            myfile.open("/home/otonom/wheelchair_ws/src/log/mylogs.txt", ios::out | ios::app);
-            myfile << "Navigation Started!  ||  ";
-            myfile.close();
 
         }
         else
@@ -93,6 +123,7 @@ namespace local_planner
         }
         globalPlan_.clear();
         globalPlan_ = orig_global_plan;
+        planCursor_.setPlan(globalPlan_);
         goalReached_ = false;
         ROS_INFO("Got new plan.");
 
@@ -108,82 +139,40 @@ namespace local_planner
         }
 
         ROS_INFO_ONCE("Computing velocity commands...");
-        startTime = ros::Time::now();
-
+        CycleProfiler::Timer cycleTimer(profiler_, CycleProfiler::CYCLE);
 
-        // Publish global plan for visualization
-        publishGlobalPlan(globalPlan_);
-        // ROS_INFO("global plan size is: %lu", globalPlan_.size());
-        for (int j = 0; j < globalPlan_.size(); j++)
+        if (globalPlan_.empty())
         {
-            // ROS_INFO("global plan is: %f and %f", globalPlan_[j].pose.position.x, globalPlan_[j].pose.position.y);
-            // ROS_INFO("j is: %u", j);
+            ROS_ERROR("The global plan is empty");
+            return false;
         }
 
-        // Find the local goal in the global plan considering look ahead distance
-        for (unsigned int i = 0; i < globalPlan_.size(); i++)
         {
-            currentPose_.position.x = posePtr_->pose.pose.position.x;
-            currentPose_.position.y = posePtr_->pose.pose.position.y;
-            currentPose_.position.z = posePtr_->pose.pose.position.z;
-            // ROS_INFO("currentpose_x is: %f", currentPose_.position.x);
-            // ROS_INFO("currentpose_y is: %f", currentPose_.position.y);
-
-            double waypointX = globalPlan_[i].pose.position.x;
-            double waypointY = globalPlan_[i].pose.position.y;
-
-            double diffX = waypointX - currentPose_.position.x;
-            double diffY = waypointY - currentPose_.position.y;
-
-            double lookAheadDist_ = 200; // index //global plan size ına göre farklı haritalarda güncellenmesi gereklidir.
-            goalDistTolerance_ = 0.55;
+            CycleProfiler::Timer snapshotTimer(profiler_, CycleProfiler::SCAN_COPY);
+            if (!takeSnapshot())
+                return false;
+        }
 
-            // ROS_INFO("global plan waypoint index: %u", i);
-            // ROS_INFO("hypot is: %f", hypot(diffX, diffY));
-            // ROS_INFO("distance to global goal is: %f", distanceToGlobalGoal());
-            // ROS_INFO("goaldisttolerance is: %f", goalDistTolerance_);
-            // ROS_INFO("lookaheaddist is: %f", lookAheadDist_);
+        // Publish global plan for visualization
+        publishGlobalPlan(globalPlan_);
 
-            if (globalPlan_.size()>lookAheadDist_)
-            {
-                currentGoalPoseIdx_ = lookAheadDist_;
-            }
-            else if (globalPlan_.size()<=lookAheadDist_ || distanceToGlobalGoal() < goalDistTolerance_)
-            {
-                currentGoalPoseIdx_ = globalPlan_.size()-1;
-            }
-            else
-            {
-                continue;
-            }
+        currentPose_.position.x = pose_->pose.pose.position.x;
+        currentPose_.position.y = pose_->pose.pose.position.y;
+        currentPose_.position.z = pose_->pose.pose.position.z;
+        goalDistTolerance_ = 0.55;
 
-            // if (hypot(diffX, diffY) > lookAheadDist_ && distanceToGlobalGoal() > goalDistTolerance_)
-            // {
-            //     currentGoalPoseIdx_ = i;
-            //     break;
-            // }
-            // else if (distanceToGlobalGoal() < goalDistTolerance_)
-            // {
-            //     ROS_INFO("else if e girdik");
-            //     currentGoalPoseIdx_ = globalPlan_.size() - 1;
-            //     break;
-            // }
-            // else
-            // {
-            //     continue;
-            // }
-        }
+        // Find the local goal in the global plan considering look ahead distance
+        currentGoalPoseIdx_ = planCursor_.update(currentPose_.position.x, currentPose_.position.y);
         // ROS_INFO_STREAM("Global plan size is:  " << globalPlan_.size());
         // ROS_INFO_STREAM("Current goal index: " << currentGoalPoseIdx_);
 
-        // ROS_INFO("patlamadi1");
-
         currentGoalPose_ = globalPlan_.at(currentGoalPoseIdx_).pose;
         // ROS_INFO("patlamadi2");
         // ROS_WARN_STREAM("Goal: " << currentGoalPose_.position.x);
         // ROS_INFO_STREAM("Current goal pose: " << currentGoalPose_);
 
         double phiFinal = LLCallback(); // LL Algorithm
+        CycleProfiler::Timer shapingTimer(profiler_, CycleProfiler::COMMAND_SHAPING);
 
         // Print and publish the distance to global goal
         double distToGlobGoal = distanceToGlobalGoal();
@@ -470,12 +459,6 @@ namespace local_planner
         //     }
             
         // }
-        endTime = ros::Time::now();
-
-        ros::Duration executionTime = endTime - startTime;
-
-        ROS_INFO("Execution time: %f seconds", executionTime.toSec());
-        executionTimes.push_back(executionTime);
         return true;
     }
 
@@ -495,18 +478,8 @@ namespace local_planner
 
         if (goalReached_)
         {
-            ROS_INFO("Goal reached!");
-            if(!executionTimes.empty())
-            {
-                for (const auto& time: executionTimes)
-                {
-                    totalExecutionTime += time;
-                }
-                averageExecTime = (totalExecutionTime.toSec() / executionTimes.size());
-            }
-            myfile.open("/home/otonom/wheelchair_ws/src/log/mylogs.txt", ios::out | ios::app);
-            myfile << "Goal Reached!  Total distance traveled is: " << dist_travelled << " || " << "Avg execution time per cycle is: " << averageExecTime << "\n";
-            myfile.close();
+            ROS_INFO("Goal Reached!  Total distance traveled is: %f || Avg execution time per cycle is: %f",
+                     dist_travelled, profiler_.meanCycleTime());
 
             return true;
         }
@@ -516,17 +489,17 @@ namespace local_planner
 
     void LocalPlanner::odomCallback(boost::shared_ptr<nav_msgs::Odometry const> msg)
     {
-        odomPtr_ = msg;
+        boost::atomic_store(&odomPtr_, msg);
     } // end function odomCallback
 
     void LocalPlanner::scanCallback(boost::shared_ptr<sensor_msgs::LaserScan const> msg)
     {
-        scanPtr_ = msg;
+        boost::atomic_store(&scanPtr_, msg);
         } // end function laserScanCallback
 
     void LocalPlanner::poseCallback(boost::shared_ptr<geometry_msgs::PoseWithCovarianceStamped const> msg)
     {
-        posePtr_ = msg;
+        boost::atomic_store(&posePtr_, msg);
     } // end function poseCallback
     
     void LocalPlanner::cmdCallback(const std_msgs::Float64::ConstPtr& msg)
@@ -535,11 +508,37 @@ namespace local_planner
     } // end function cmdCallback
 
 
+    bool LocalPlanner::takeSnapshot()
+    {
+        scan_ = boost::atomic_load(&scanPtr_);
+        pose_ = boost::atomic_load(&posePtr_);
+        if (!scan_ || !pose_)
+        {
+            ROS_WARN_THROTTLE(1.0, "Local planner is waiting for %s", !scan_ ? "/scan" : "/amcl_pose");
+            return false;
+        }
+
+        ros::Time now = ros::Time::now();
+        double scanAge = (now - scan_->header.stamp).toSec();
+        double poseAge = (now - pose_->header.stamp).toSec();
+        if (scanTimeout_ > 0.0 && scanAge > scanTimeout_)
+        {
+            ROS_WARN_THROTTLE(1.0, "Local planner scan is %.2f s old, timeout is %.2f s", scanAge, scanTimeout_);
+            return false;
+        }
+        if (poseTimeout_ > 0.0 && poseAge > poseTimeout_)
+        {
+            ROS_WARN_THROTTLE(1.0, "Local planner pose is %.2f s old, timeout is %.2f s", poseAge, poseTimeout_);
+            return false;
+        }
+        return true;
+    }
+
     double LocalPlanner::distanceToGlobalGoal()
     {
-        currentPose_.position.x = posePtr_->pose.pose.position.x;
-        currentPose_.position.y = posePtr_->pose.pose.position.y;
-        currentPose_.position.z = posePtr_->pose.pose.position.z;
+        currentPose_.position.x = pose_->pose.pose.position.x;
+        currentPose_.position.y = pose_->pose.pose.position.y;
+        currentPose_.position.z = pose_->pose.pose.position.z;
 
         geometry_msgs::PoseStamped globalGoal = globalPlan_.back();
         double xDist = globalGoal.pose.position.x - currentPose_.position.x;
@@ -549,13 +548,13 @@ namespace local_planner
     }
 
 
-    vector<vector<double>> midpoint_memory; //dış vektör koordinat olarak tutan
     double prev_odomRX = 0.0;
     double prev_odomRY = 0.0;
 
     double LocalPlanner::LLCallback()
     {
         ROS_INFO_STREAM("Local Planner started");
+        CycleProfiler::Timer stageTimer(profiler_, CycleProfiler::GAP_DETECTION);
         lastCallbackTime_ = ros::Time::now().toSec();
 
         // Get odometry informations
@@ -563,8 +562,8 @@ namespace local_planner
         // unchanged since the latest update. These are AMCL positions.
         
 
-        double odomRX = posePtr_->pose.pose.position.x;
-        double odomRY = posePtr_->pose.pose.position.y;
+        double odomRX = pose_->pose.pose.position.x;
+        double odomRY = pose_->pose.pose.position.y;
 
         dist_travelled += sqrt((odomRX - prev_odomRX)*(odomRX - prev_odomRX) +(odomRY - prev_odomRY)*(odomRY - prev_odomRY)) ;
         // ROS_INFO_STREAM("total distance traveled is: " << dist_travelled);
@@ -573,7 +572,7 @@ namespace local_planner
         prev_odomRY = odomRY;
 
 
-        currentPose_.orientation = posePtr_->pose.pose.orientation;
+        currentPose_.orientation = pose_->pose.pose.orientation;
         double robot_pose_theta_real = tf::getYaw(currentPose_.orientation);
         double robot_pose_theta_manipulated;
         robot_pose_theta_real = robot_pose_theta_real * 180 / M_PI;
@@ -585,77 +584,30 @@ namespace local_planner
 
 
         // Get laser ranges
-        std::vector<double> laserRanges;
-        std::vector<double> currRange;
-        // ROS_INFO_STREAM("Scan ptr size is: " << scanPtr_->ranges.size());
-
-        for (unsigned int i = 0; i < scanPtr_->ranges.size(); i++)
-        {
-            laserRanges.push_back(scanPtr_->ranges[i]);
-            // ROS_INFO_STREAM("this is laserRanges vector, at index: "<< i << " range is: " << laserRanges[i]);
-        }
-
-        currRange = laserRanges;
-        // currRange.erase(currRange.begin(), currRange.begin() + 190); //scanmulti filtrelenmiş verisi sandalyenin arkası 0 olacak şekilde saat yönü tersinde geliyor
-        // buradan arkadan ilk 90 ve son 90 derece kırpılarak field of view sadece öndeki 180 derece olacak şekilde ayarlanmıştır.
-        // ROS_INFO_STREAM("currrange size is now: "<< currRange.size());
-        // currRange.erase(currRange.begin() + 380, currRange.end());
-        // ROS_INFO_STREAM("currrange size is now: "<< currRange.size());
-
-        // ilk 90 veri soldan karşıya olan tarama, ikinci 90 veri
-        // karşıdan sağa olan tarama olacak şekilde ayarlandı. Turtlebot3 lidarı dönüş yönünden ötürü böyle. Sandalyeye geçildiğinde tarama yönünün teyit edilmesi gerekli.
-
-        reverse(currRange.begin(), currRange.end()); // kırpma işleminden sonra sağdan sola taranmış şekilde öndeki 180 derecelik veriler kalmıştı
-        // ters çevrilerek ilk indeksli olan nokta sol 90derecede kalan yer olmaktadır buradan sağa doğru taranmış hale gelir.
-
-        // her lazer ölçümünden 10cm çıkartıldı (obstacle inflation)
+        // Lazer verisi kopyalanmaz ve ters çevrilmez; gapDetector_ taramaya ters indeksle bakar,
+        // ilk indeksli nokta sol 90 derecede kalan yer olur, buradan sağa doğru taranmış hale gelir.
+        // Minimum mesafe ve 1.0 m'den büyük sıçramalar (gap başlangıç/bitişleri) tek geçişte bulunur.
+        GapDetector &currRange = gapDetector_;
+        currRange.detect(scan_->ranges, 1.0);
         ROS_INFO_STREAM("currange has elements: " << currRange.size());
 
-
-        // for (unsigned int i = 0; i < currRange.size() ; i++)
-        // {
-        //     ROS_INFO_STREAM("Currrange is: " << currRange[i] << " at "<< i);
-        // }
-
-        // auto dminIdxItr = std::min_element(currRange.begin(), currRange.end());
-        auto dminIdxItr = std::min_element(currRange.begin(), currRange.end());
-        // dminIdx = std::distance(currRange.begin(), dminIdxItr);
-        dminIdx = std::distance(currRange.begin(), dminIdxItr);
+        dminIdx = currRange.minIndex();
         ROS_ERROR_STREAM("dminidx is : " << dminIdx);
 
-        // dmin = currRange.at(dminIdx);
-        dmin = currRange.at(dminIdx);
+        dmin = currRange.minRange();
         if (dmin <= 0.01)
         {
             dmin = 0.01;
         }
-        // ROS_INFO_STREAM("curRangesize is " << currRange.size());
-        // for (unsigned int i = 0; i < currRange.size(); i++)
-        // {
-        //     ROS_INFO_STREAM("currrange vector is: "<< currRange[i] << "for index : " << i);
-        // }
         ROS_INFO_STREAM("dmin is : " << dmin);
 
 
-        std::vector<int> gap_starting_points;
-        std::vector<int> gap_ending_points;
-        std::vector<int> common_angles;
-        int gap_number;
-        int gap_validator;
+        // gap starting ve gap ending vektörlerinde ortak olan açı değerleri (MATLAB intersect fonksiyonunun common kısmı)
+        // detector tarafından ayrılıp common_angles'a konur
+        std::vector<int> &gap_starting_points = currRange.starts();
+        std::vector<int> &gap_ending_points = currRange.ends();
+        std::vector<int> &common_angles = currRange.common();
 
-        for (unsigned int i = 0; i < currRange.size() - 1; i++)
-        {
-            if (currRange[i + 1] > currRange[i] + 1.0)
-            {
-                gap_number = gap_number + 1;
-                gap_starting_points.push_back(i);
-            }
-            if (currRange[i] > currRange[i + 1] + 1.0)
-            {
-                gap_validator = gap_validator + 1;
-                gap_ending_points.push_back(i + 1);
-            }
-        }
         double phiGoal;
         double phiFinal;
         double xDiff;
@@ -691,12 +643,11 @@ namespace local_planner
         }
 
        
-        vector<vector<double>> same_gap_memory; //dış vektör ama sadece indeks olarak tutan
-        vector<double> same_gap_inner;
         double phi_gap = 0.0;
         
         //gap olmadığı durum için phifinal ayarlaması sadece
-        if (gap_starting_points.size()== 0 || gap_ending_points.size()==0)
+        // ortak açılar da hem başlangıç hem bitiş noktasıdır
+        if (gap_starting_points.size() + common_angles.size() == 0 || gap_ending_points.size() + common_angles.size() == 0)
         {
             isGapExist_ = false;
             // if (phiGoal > 270)
@@ -729,44 +680,6 @@ namespace local_planner
             //     ROS_INFO_STREAM("gap ending points are: " << gap_ending_points[i]);
             // }
 
-            // gap starting ve gap ending vektörlerinde ortak olan açı değerlerini bulma kısmı (MATLAB intersect fonksiyonunun, common kısmı)
-            std::vector<int> intersector(gap_starting_points.size() + gap_ending_points.size());
-            std::vector<int>::iterator it, end;
-
-            end = set_intersection(gap_starting_points.begin(), gap_starting_points.end(), gap_ending_points.begin(), gap_ending_points.end(), intersector.begin());
-
-            for (it = intersector.begin(); it != end; it++)
-            {
-                common_angles.push_back(*it);
-            }
-
-            // for (int i = 0; i < common_angles.size(); i++)
-            // {
-            //     ROS_INFO_STREAM("common angles are: " << common_angles[i]);
-            // }
-
-            // MATLAB intersect fonksiyonunun, her iki vektörde ortak olan elemanların indexlerini belirlediği kısım
-            for (auto x : common_angles)
-            {
-                int key = x;
-                vector<int>::iterator itr_start = std::find(gap_starting_points.begin(), gap_starting_points.end(), key);
-                vector<int>::iterator itr_end = std::find(gap_ending_points.begin(), gap_ending_points.end(), key);
-
-                if (itr_start != gap_starting_points.end())
-                {
-                    int index_of_common_angle = std::distance(gap_starting_points.begin(), itr_start);
-                    // ROS_INFO_STREAM("starting points vector indices are: " << index_of_common_angle);
-                    gap_starting_points.erase(gap_starting_points.begin() + index_of_common_angle);
-                }
-
-                if (itr_end != gap_ending_points.end())
-                {
-                    int index_of_common_angle = std::distance(gap_ending_points.begin(), itr_end);
-                    // ROS_INFO_STREAM("ending points vector indices are: " << std::distance(gap_ending_points.begin(), itr_end));
-                    gap_ending_points.erase(gap_ending_points.begin() + index_of_common_angle);
-                }
-            }
-
             // for (int i = 0; i < gap_starting_points.size(); i++)
             // {
             //     ROS_INFO_STREAM("gap starting points are: " << gap_starting_points[i]);
@@ -783,7 +696,8 @@ namespace local_planner
             int m = 1;
             int n = 0;
             int o = 1;
-            vector<int> indices;
+            vector<int> &indices = gapIndices_;
+            indices.clear();
 
             for (unsigned int i = 0; i < gap_starting_points.size(); i++)
             {
@@ -823,7 +737,7 @@ namespace local_planner
                     //     ROS_INFO_STREAM(" " << gap_starting_points[z]);
                     // }
                 }
-                indices = {};
+                indices.clear();
                 counter = 0;
 
                 if (i > 0)
@@ -877,7 +791,7 @@ namespace local_planner
                     //     ROS_INFO_STREAM(" " << gap_starting_points[z]);
                     // }
                 }
-                indices = {};
+                indices.clear();
                 l = 0;
 
                 if (i == gap_starting_points.size() - 1)
@@ -927,7 +841,7 @@ namespace local_planner
                 m = 1;
                 n = 0;
                 o = 1;
-                indices = {};
+                indices.clear();
             }
 
             // asagidaki donguler iki tane -99 olan eleman varsa patlıyor. i=0da ve i=1 de varsa önce i=0dakini siliyor, i=1deki sıfıra geçtiği için tekrar oraya bakmadan devam ediyor.
@@ -951,7 +865,7 @@ namespace local_planner
 
             gap_starting_points.erase(remove(gap_starting_points.begin(), gap_starting_points.end(), -99), gap_starting_points.end());
 
-            if (gap_ending_points[0] < gap_starting_points[0])
+            if (!gap_ending_points.empty() && (gap_starting_points.empty() || gap_ending_points[0] < gap_starting_points[0]))
             {
                 gap_starting_points.insert(gap_starting_points.begin(), 0);
             }
@@ -1141,23 +1055,14 @@ namespace local_planner
             //     }
             // }
             
+            stageTimer.next(CycleProfiler::MEMORY_UPDATE);
             for (int i=0; i<rows ;i++) //bu döngünün içince her gap midpointe ait x ve y koordinatları midpoint vektörüne pushlanır. midpoint vektörü hafıza vektörüne pushlanır. bir cycleda 2 gap görüldüyse yine teker teker pushlanır.
             {
                 // ROS_INFO_STREAM("midpoint x are: " << midpoint_coords[i][0]);
                 if(midpoint_coords[i][2] > 0.7) //genişliği 0.45'ten küçük olan gapler hafızaya atılmaz
                 {
-                    vector<double> midpoint_x_y; //iç vektör, koordinat olarak tutan
-
-                    // ROS_INFO_STREAM("rows is : " << rows);
-
-                    midpoint_x_y.push_back(midpoint_coords[i][0]); //içteki küçük vektöre x koordinatının pushlandığı yer
-                    midpoint_x_y.push_back(midpoint_coords[i][1]); //içteki küçük vektöre y koordinatının pushlandığı yer
-                    midpoint_x_y.push_back(midpoint_coords[i][2]); //içteki küçük vektöre gap genişliğinin pushlandığı yer
-                    midpoint_memory.push_back(midpoint_x_y);  //içteki küçük vektörü dıştaki büyük hafıza vektörüne pushlama
-                    // for (int i = 0; i < midpoint_x_y.size();i++)
-                    // {
-                    //     ROS_INFO_STREAM("midpoint_x_y has: " << midpoint_x_y[i]);
-                    // }
+                    // x, y koordinatı ve gap genişliği hafızaya eklenir, hafıza doluysa en eski eleman silinir
+                    gapMemory_.insert(midpoint_coords[i][0], midpoint_coords[i][1], midpoint_coords[i][2], lastCallbackTime_);
                 }
 
             }
@@ -1171,174 +1076,22 @@ namespace local_planner
 
         }
 
-        if (midpoint_memory.empty())
+        // yaşı veya robota uzaklığı sınırı aşan eski midpointler hafızadan silinir
+        stageTimer.next(CycleProfiler::MEMORY_UPDATE);
+        gapMemory_.evict(lastCallbackTime_, odomRX, odomRY);
+
+        if (gapMemory_.empty())
         {
             ROS_WARN("No gap in memory, heading to phiGoal");
             return (M_PI_2 - (M_PI*phiGoal)/180);
         }
 
-
-
-        if (midpoint_memory.size() >= 100) //memorydeki gap sayısını 30'da tutmak için 30'dan fazlalık olan ilk elemanlar silinir.
-        {
-            int elements_to_delete = midpoint_memory.size() - 100;
-            midpoint_memory.erase(midpoint_memory.begin(),midpoint_memory.begin()+elements_to_delete);
-        }
-
-        // ROS_INFO_STREAM("midpoint memory size is: " << midpoint_memory.size());
-        // for (int i = 0; i < midpoint_memory.size();i++)
-        // {
-        //     ROS_INFO_STREAM("midpoint memory has: X| " << midpoint_memory[i][0] << " Y | " << midpoint_memory[i][1] << " width | " << midpoint_memory[i][2]);
-        // }
-
-        for (int i = 0; i < midpoint_memory.size(); i++)
-        {
-            same_gap_inner.push_back(i); //aynı olup olmadığı kıyaslanan iki elemandan ilki iç vektörün başına pushlanır
-            for (int j = 0; j < midpoint_memory.size() ; j++)
-            {
-                if(j <= i)
-                {
-                    continue;
-                }
-                else
-                {
-                    if(sqrt(pow(midpoint_memory[i][0]-midpoint_memory[j][0],2) + pow(midpoint_memory[i][1]-midpoint_memory[j][1],2)) < 0.5)
-                    {
-                        same_gap_inner.push_back(j); //kıyaslanan ikinci eleman ilkiyla aynıysa sırayla bunlar da iç vektöre pushlanır.
-                        //ROS_INFO_STREAM("same gap detected for " << i << " and " << j);
-                    }
-                }
-            }
-            same_gap_memory.push_back(same_gap_inner);
-            same_gap_inner.clear();
-        }
-        // bu for döngüsü her i elemanı ile aynı gapi gösteren j elemanlarını yazdırmak için kullanılır.
-        for (int i = 0; i < same_gap_memory.size(); i++)
-        {
-            for (int j = 0; j < same_gap_memory[i].size(); j++)
-            {
-                // ROS_INFO_STREAM(" " << same_gap_memory[i][j]);
-            }
-            // ROS_INFO_STREAM("----");
-        }
-        //alttaki parça same_gap_memory i sadeleştirmek için yazılmıştır. İcindeki vektörlerde ortak eleman olanları tespit eder.
-        
-        vector<double> merged_vector;
-        vector<double>::iterator it_common, iter_end;
-        int no_of_common_elements = 0;
-
-        //silinecek sadece yazdırma for döngüsü
-        // for (int i = 0; i<same_gap_memory.size(); i++)
-        // {
-        //     ROS_INFO_STREAM("eleman " << i);
-        //     for (int j = 0; j < same_gap_memory[i].size(); j++)
-        //     {
-        //         ROS_INFO_STREAM(" " << same_gap_memory[i][j]);
-        //     }
-        // }
-
-        for (int i = 0; i < same_gap_memory.size(); i++)
-        {
-            for (int j = 0; j < same_gap_memory.size(); j++)
-            {
-                vector<double> common_elements_in_vectors(same_gap_memory[i].size()+same_gap_memory[j].size());
-                if (j <= i)
-                {
-                    continue;
-                }
-                else
-                {
-                    // ROS_INFO_STREAM("saglam2");
-                    // ROS_INFO_STREAM("i is " << i);
-                    // ROS_INFO_STREAM("j is " << j);
-                    iter_end = set_intersection(same_gap_memory[i].begin(), same_gap_memory[i].end(), same_gap_memory[j].begin(), same_gap_memory[j].end(), common_elements_in_vectors.begin());
-                    // ROS_INFO_STREAM("saglam3");
-
-                    for (it_common = common_elements_in_vectors.begin(); it_common != iter_end; it_common++)
-                    {
-                        // ROS_INFO_STREAM("saglam4");
-                        no_of_common_elements++;
-                    }
-                    if (no_of_common_elements > 0)
-                    {
-                        for (int k : same_gap_memory[i])
-                        {
-                            // ROS_INFO_STREAM("saglam4");
-                            if (find(merged_vector.begin(), merged_vector.end(), k) == merged_vector.end())
-                            {
-                                merged_vector.push_back(k);
-                            }
-                        }
-                        for (int l : same_gap_memory[j])
-                        {
-                            if (find(merged_vector.begin(), merged_vector.end(), l) == merged_vector.end())
-                            {
-                                merged_vector.push_back(l);
-                            }
-                        }
-                        same_gap_memory[i] = merged_vector;
-                        same_gap_memory[j] = merged_vector;
-                        merged_vector.clear();
-                    }
-                    else
-                    {
-                        continue;
-                    }
-                    no_of_common_elements = 0;
-
-                }
-
-            }
-        }
-        // en son ortak elemanlarla merge edilmiş vektörün yazdırıldığı kısım
-        for (int i = 0; i < same_gap_memory.size(); i++)
-        {
-            for (int j = 0; j < same_gap_memory[i].size(); j++)
-            {
-                // ROS_INFO_STREAM(same_gap_memory[i][j] << " ");
-            }
-            // ROS_INFO_STREAM("-----");
-        }
-        // bu kısım ortak elemanları olan merge edilmiş vektörden aynı iç vektörlerin çıkartıldığı sadece gap sayısı kadar iç vektör bırakıldığı kısım
-        std::sort(same_gap_memory.begin(), same_gap_memory.end());
-
-        auto last = std::unique(same_gap_memory.begin(), same_gap_memory.end());
-        same_gap_memory.erase(last, same_gap_memory.end());
-
-        vector<vector<double>> gaps_in_memory; //en son halinde gaplerin koordinatlarını tutacak olan vektör
-        double x_coord = 0.0;
-        double y_coord = 0.0;
-        double final_width = 0.0;
-        double weighted_average_param = 1.0;
-        double weighting_counter = 0.0;
-
-
-        // Aynı gapi işaret eden farklı ölçümlerin aritmetik ortalamaya göre veya ağırlıklı ortalamaya göre birleştirildiği yer
-        for (auto& innerVec : same_gap_memory)
-        {
-            weighted_average_param = 1.0;
-            weighting_counter = 0.0;
-
-            for (auto& element : innerVec)
-            {
-                x_coord = x_coord + midpoint_memory[element][0]*weighted_average_param;
-                y_coord = y_coord + midpoint_memory[element][1]*weighted_average_param;
-                final_width = final_width + midpoint_memory[element][2]*weighted_average_param;
-                weighted_average_param += 0.4;
-                weighting_counter += 1;
-                // ROS_INFO_STREAM(element << " ");
-            }
-            // ROS_INFO_STREAM("--");
-            x_coord = x_coord / (innerVec.size()+(weighting_counter-1)*weighting_counter*0.4/2);
-            y_coord = y_coord / (innerVec.size()+(weighting_counter-1)*weighting_counter*0.4/2);
-            final_width = final_width / (innerVec.size()+(weighting_counter-1)*weighting_counter*0.4/2);
-
-            gaps_in_memory.push_back({x_coord, y_coord, final_width});
-
-            x_coord = 0.0;
-            y_coord = 0.0;
-            final_width = 0.0;
-        }
+        // Aynı gapi işaret eden (birbirine gap_merge_radius'tan yakın) ölçümler tek gapte toplanır,
+        // koordinat ve genişlik yeni ölçümlere daha çok ağırlık veren ağırlıklı ortalamayla birleştirilir.
+        // Kümeler her eklemede/silmede artımlı güncellenir, burada sadece ortalamalar okunur.
+        vector<GapMemory::Cluster> &gaps_in_memory = gapsInMemory_;
+        gapMemory_.clusters(gaps_in_memory);
+        stageTimer.next(CycleProfiler::GAP_SELECTION);
 
         visualization_msgs::MarkerArray markers;
         //önceki markları silme bloğu
@@ -1364,11 +1117,11 @@ namespace local_planner
             marker.scale.z = 0.1;
             marker.color.a = 1.0;
             marker.color.r = 1.0;
-            marker.pose.position.x = gaps_in_memory[i][0];
-            marker.pose.position.y = gaps_in_memory[i][1];
+            marker.pose.position.x = gaps_in_memory[i].x;
+            marker.pose.position.y = gaps_in_memory[i].y;
             marker.pose.position.z = 0.05;
-            marker.scale.x = gaps_in_memory[i][2];
-            marker.scale.y = gaps_in_memory[i][2];
+            marker.scale.x = gaps_in_memory[i].width;
+            marker.scale.y = gaps_in_memory[i].width;
 
             markers.markers.push_back(marker);
         }
@@ -1408,8 +1161,8 @@ namespace local_planner
         ROS_WARN_STREAM("There are total of: " << gaps_in_memory.size() << " gaps in memory");
         for (int i = 0; i < gaps_in_memory.size(); i++)
         {
-            xDiff_new.push_back(gaps_in_memory[i][0] - odomRX);
-            yDiff_new.push_back(gaps_in_memory[i][1] - odomRY);
+            xDiff_new.push_back(gaps_in_memory[i].x - odomRX);
+            yDiff_new.push_back(gaps_in_memory[i].y - odomRY);
             phi_gap_calculator = atan2(yDiff_new[i], xDiff_new[i])*180/M_PI;
 
             phi_gap_calculator = robot_pose_theta_real - phi_gap_calculator + 90;
@@ -1429,42 +1182,42 @@ namespace local_planner
             phi_gap_temp[i] += 90; //gap ödüllendirmede 90 derece shift etmek için yapıldı ekseni. gerçek phigap ile alakası yok.
             diff_to_goal_new.push_back(min(fabs(phi_gap_temp[i] - phiGoal), 360-fabs(phi_gap_temp[i] - phiGoal)));
             // ROS_INFO_STREAM("diff to goal is : " << diff_to_goal_new[i]);
-            // ROS_INFO_STREAM("gaps are located at: X| " << gaps_in_memory[i][0] << " Y| " << gaps_in_memory[i][1] << " width| " << gaps_in_memory[i][2]);
+            // ROS_INFO_STREAM("gaps are located at: X| " << gaps_in_memory[i].x << " Y| " << gaps_in_memory[i].y << " width| " << gaps_in_memory[i].width);
         }
 
         // hafızadaki gapleri ödüllendirme
 
         for (int i=0; i < gaps_in_memory.size(); i++)
         {
-            if (gaps_in_memory[i][2] < 0.55) //0,45 ten kucuk olan gapler odullendirilmez.
+            if (gaps_in_memory[i].width < 0.55) //0,45 ten kucuk olan gapler odullendirilmez.
             {
-                gaps_in_memory[i][2] = 0.1;
+                gaps_in_memory[i].width = 0.1;
             }
             else if (diff_to_goal_new[i] <= 30)
             {
-                gaps_in_memory[i][2] = gaps_in_memory[i][2] * 12;
-                // gaps_in_memory[i][2] = gaps_in_memory[i][2] + gaps_in_memory[i][2] * (2/(exp(diff_to_goal_new[i]/20))+1); // 0.75'ten buyuk gaplerin hepsi bu ölçüte göre büyütülür.
+                gaps_in_memory[i].width = gaps_in_memory[i].width * 12;
+                // gaps_in_memory[i].width = gaps_in_memory[i].width + gaps_in_memory[i].width * (2/(exp(diff_to_goal_new[i]/20))+1); // 0.75'ten buyuk gaplerin hepsi bu ölçüte göre büyütülür.
             }
             else if (diff_to_goal_new[i] <= 60 && diff_to_goal_new[i] > 30)
             {
-                gaps_in_memory[i][2] = gaps_in_memory[i][2] * 4.5;
+                gaps_in_memory[i].width = gaps_in_memory[i].width * 4.5;
             }
             else if (diff_to_goal_new[i] <= 90 && diff_to_goal_new[i] > 60)
             {
-                gaps_in_memory[i][2] = gaps_in_memory[i][2] * 1.2;
+                gaps_in_memory[i].width = gaps_in_memory[i].width * 1.2;
             }
 
             else if (diff_to_goal_new[i] <= 120 && diff_to_goal_new[i] > 90)
             {
-                gaps_in_memory[i][2] = gaps_in_memory[i][2] * 0.3;
+                gaps_in_memory[i].width = gaps_in_memory[i].width * 0.3;
             }
             else if (diff_to_goal_new[i] <= 150 && diff_to_goal_new[i] > 120)
             {
-                gaps_in_memory[i][2] = gaps_in_memory[i][2] * 0.3;
+                gaps_in_memory[i].width = gaps_in_memory[i].width * 0.3;
             }
             else if (diff_to_goal_new[i] <= 180 && diff_to_goal_new[i] > 150)
             {
-                gaps_in_memory[i][2] = gaps_in_memory[i][2] * 0.3;
+                gaps_in_memory[i].width = gaps_in_memory[i].width * 0.3;
             }
             else
             {
@@ -1476,12 +1229,12 @@ namespace local_planner
         phiGoal -= 90; // ödüllendirme için eklenmiş olan 90 geri çıkarıldı.
 
         double largestWidthIndex = 0;
-        double largestWidth = gaps_in_memory[0][2];
+        double largestWidth = gaps_in_memory[0].width;
         for (int i = 0; i < gaps_in_memory.size(); i++)
         {
-            if (gaps_in_memory[i][2] > largestWidth)
+            if (gaps_in_memory[i].width > largestWidth)
             {
-                largestWidth = gaps_in_memory[i][2];
+                largestWidth = gaps_in_memory[i].width;
                 
                 largestWidthIndex = i;
             }
@@ -1500,8 +1253,8 @@ namespace local_planner
         selected_gap_marker.action = visualization_msgs::Marker::ADD;
         selected_gap_marker.pose.orientation.w = 1.0;
         selected_gap_marker.scale.z = 0.1;
-        selected_gap_marker.pose.position.x = gaps_in_memory[largestWidthIndex][0];
-        selected_gap_marker.pose.position.y = gaps_in_memory[largestWidthIndex][1];
+        selected_gap_marker.pose.position.x = gaps_in_memory[largestWidthIndex].x;
+        selected_gap_marker.pose.position.y = gaps_in_memory[largestWidthIndex].y;
         selected_gap_marker.pose.position.z = 0.3;
         selected_gap_marker.scale.x = 0.4;
         selected_gap_marker.scale.y = 0.4;
@@ -1514,7 +1267,6 @@ namespace local_planner
 
 
 
-        same_gap_memory.clear();
         gaps_in_memory.clear();
         phi_gap_temp.clear();
         diff_to_goal_new.clear();
@@ -0,0 +1,67 @@
+#include "local_planner/plan_cursor.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace local_planner
+{
+    PlanCursor::PlanCursor()
+        : lookahead_(10.0), window_(50), closest_(0), goal_(0)
+    {
+    }
+
+    void PlanCursor::configure(double lookahead, int search_window)
+    {
+        lookahead_ = std::max(lookahead, 0.0);
+        window_ = std::max(search_window, 1);
+    }
+
+    void PlanCursor::setPlan(const std::vector<geometry_msgs::PoseStamped>& plan)
+    {
+        const size_t n = plan.size();
+        x_.resize(n);
+        y_.resize(n);
+        s_.resize(n);
+
+        double s = 0.0;
+        for (size_t i = 0; i < n; i++)
+        {
+            x_[i] = plan[i].pose.position.x;
+            y_[i] = plan[i].pose.position.y;
+            if (i > 0)
+                s += hypot(x_[i] - x_[i - 1], y_[i] - y_[i - 1]);
+            s_[i] = s;
+        }
+
+        closest_ = 0;
+        goal_ = 0;
+    }
+
+    int PlanCursor::update(double x, double y)
+    {
+        const int n = s_.size();
+        if (n == 0)
+            return -1;
+
+        // closest waypoint, searched forward from the previous one
+        int end = std::min(closest_ + window_, n - 1);
+        double best = (x_[closest_] - x) * (x_[closest_] - x) + (y_[closest_] - y) * (y_[closest_] - y);
+        for (int i = closest_ + 1; i <= end; i++)
+        {
+            double d = (x_[i] - x) * (x_[i] - x) + (y_[i] - y) * (y_[i] - y);
+            if (d < best)
+            {
+                best = d;
+                closest_ = i;
+            }
+        }
+
+        // the target arc length never decreases, neither does the goal
+        const double target = s_[closest_] + lookahead_;
+        goal_ = std::max(goal_, closest_);
+        while (goal_ < n - 1 && s_[goal_] < target)
+            goal_++;
+
+        return goal_;
+    }
+};
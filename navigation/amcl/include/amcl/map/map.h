@@ -28,6 +28,7 @@
 #ifndef MAP_H
 #define MAP_H
 
+#include <stddef.h>
 #include <stdint.h>
 
 #ifdef __cplusplus
@@ -75,6 +76,23 @@ typedef struct
   // Max distance at which we care about obstacles, for constructing
   // likelihood field
   double max_occ_dist;
+
+  // Compact copy of the cells' occ_dist, filled in by map_update_cspace
+  // for the likelihood field models.  It has size_x * size_y + 1 entries;
+  // the last one holds max_occ_dist and stands in for off-map points.
+  float *occ_dist_field;
+
+  // The same distances coded for models that tabulate their likelihoods:
+  // the squared distance in cells, or occ_dist_code_count - 1 for
+  // max_occ_dist.  NULL if max_occ_dist spans too many cells to code in
+  // 16 bits.
+  unsigned short *occ_dist_code;
+  int occ_dist_code_count;
+
+  // Read-only mapping of the cspace cache file that occ_dist_field and
+  // occ_dist_code point into, or NULL if they were allocated
+  void *cspace_mapping;
+  size_t cspace_mapping_size;
   
 } map_t;
 
@@ -102,6 +120,19 @@ int map_load_occ(map_t *map, const char *filename, double scale, int negate);
 // Update the cspace distances
 void map_update_cspace(map_t *map, double max_occ_dist);
 
+// Release the cspace distances
+void map_free_cspace(map_t *map);
+
+// Load the cspace distances for max_occ_dist from the cache in dir;
+// returns -1 if the cache holds no valid entry for this map
+int map_load_cspace(map_t *map, double max_occ_dist, const char *dir);
+
+// Save the cspace distances to the cache in dir
+int map_save_cspace(map_t *map, const char *dir);
+
+// Get the distance represented by an occ_dist_code value
+double map_occ_dist_decode(map_t *map, int code);
+
 
 /**************************************************************************
  * Range functions
@@ -29,7 +29,7 @@
 #define PF_H
 
 #include "pf_vector.h"
-#include "pf_kdtree.h"
+#include "pf_hist.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -93,8 +93,8 @@ typedef struct _pf_sample_set_t
   int sample_count;
   pf_sample_t *samples;
 
-  // A kdtree encoding the histogram
-  pf_kdtree_t *kdtree;
+  // The histogram of the samples, for KLD sampling and clustering
+  pf_hist_t *hist;
 
   // Clusters
   int cluster_count, cluster_max_count;
@@ -184,7 +184,7 @@ void pf_cluster_stats(pf_t *pf, pf_sample_set_t *set);
 // Display the sample set
 void pf_draw_samples(pf_t *pf, struct _rtk_fig_t *fig, int max_samples);
 
-// Draw the histogram (kdtree)
+// Draw the histogram
 void pf_draw_hist(pf_t *pf, struct _rtk_fig_t *fig);
 
 // Draw the CEP statistics
@@ -0,0 +1,109 @@
+/*
+ *  Player - One Hell of a Robot Server
+ *  Copyright (C) 2000  Brian Gerkey   &  Kasper Stoy
+ *                      gerkey@usc.edu    kaspers@robotics.usc.edu
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+/**************************************************************************
+ * Desc: Pose histogram functions
+ *************************************************************************/
+
+#ifndef PF_HIST_H
+#define PF_HIST_H
+
+#include "pf_vector.h"
+
+#ifdef INCLUDE_RTKGUI
+#include "rtk.h"
+#endif
+
+
+// Info for an occupied bin of the histogram
+typedef struct
+{
+  // The key for this bin
+  int key[3];
+
+  // The value for this bin
+  double value;
+
+  // The cluster label
+  int cluster;
+
+  // Slot of this bin in the hash table
+  int slot;
+
+} pf_hist_bin_t;
+
+
+// A histogram over (x, y, theta), stored as a flat array of occupied bins
+// indexed by an open addressing hash table of their keys
+typedef struct
+{
+  // Bin size
+  double size[3];
+
+  // The occupied bins, in insertion order
+  int bin_count, bin_max_count;
+  pf_hist_bin_t *bins;
+
+  // Hash table of bin indices, -1 for an empty slot; its size is a power
+  // of two at least four times bin_max_count
+  int table_mask;
+  int *table;
+
+  // The number of clusters found by pf_hist_cluster
+  int cluster_count;
+
+  // Workspace for clustering
+  int *parent;
+
+} pf_hist_t;
+
+
+// Create a histogram with room for max_size occupied bins
+extern pf_hist_t *pf_hist_alloc(int max_size);
+
+// Destroy a histogram
+extern void pf_hist_free(pf_hist_t *self);
+
+// Clear all entries from the histogram
+extern void pf_hist_clear(pf_hist_t *self);
+
+// Add a pose to the histogram
+extern void pf_hist_insert(pf_hist_t *self, pf_vector_t pose, double value);
+
+// Label the connected groups of occupied bins; returns the number of
+// clusters
+extern int pf_hist_cluster(pf_hist_t *self);
+
+// Determine the probability estimate for the given pose
+extern double pf_hist_get_prob(pf_hist_t *self, pf_vector_t pose);
+
+// Determine the cluster label for the given pose, or -1 if its bin is
+// empty
+extern int pf_hist_get_cluster(pf_hist_t *self, pf_vector_t pose);
+
+
+#ifdef INCLUDE_RTKGUI
+
+// Draw the histogram
+extern void pf_hist_draw(pf_hist_t *self, rtk_fig_t *fig);
+
+#endif
+
+#endif
@@ -0,0 +1,29 @@
+/**************************************************************************
+ * Desc: Resampling on a kd-tree, as the filter did before pf_hist
+ *
+ * Kept so that amcl_benchmark can compare pf_update_resample against it;
+ * the filter itself does not use it.
+ *************************************************************************/
+
+#ifndef PF_RESAMPLE_KDTREE_H
+#define PF_RESAMPLE_KDTREE_H
+
+#include "pf.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// pf_kdtree.h has no C++ guards of its own
+#include "pf_kdtree.h"
+
+// Resample the distribution like pf_update_resample, drawing each sample
+// from the cumulative weight table and using the kd-tree, which must hold
+// 3 * max_samples nodes, for KLD sampling and clustering
+void pf_update_resample_kdtree(pf_t *pf, pf_kdtree_t *kdtree);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
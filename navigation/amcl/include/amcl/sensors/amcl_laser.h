@@ -29,7 +29,11 @@
 #ifndef AMCL_LASER_H
 #define AMCL_LASER_H
 
+#include <memory>
+#include <vector>
+
 #include "amcl_sensor.h"
+#include "amcl_thread_pool.h"
 #include "../map/map.h"
 
 namespace amcl
@@ -46,12 +50,17 @@ typedef enum
 class AMCLLaserData : public AMCLSensorData
 {
   public:
-    AMCLLaserData () {ranges=NULL;};
+    AMCLLaserData () {ranges=NULL; range_capacity=0;};
     virtual ~AMCLLaserData() {delete [] ranges;};
+  // Set range_count and make room for that many readings, keeping the
+  // current buffer if it is big enough
+  public: void SetRangeCount(int range_count);
   // Laser range data (range, bearing tuples)
   public: int range_count;
   public: double range_max;
   public: double (*ranges)[2];
+  // Number of readings the ranges buffer holds
+  private: int range_capacity;
 };
 
 
@@ -94,6 +103,28 @@ class AMCLLaser : public AMCLSensor
   public: void SetLaserPose(pf_vector_t& laser_pose) 
           {this->laser_pose = laser_pose;}
 
+  public: pf_vector_t GetLaserPose() const {return this->laser_pose;}
+
+  // Make the likelihood field models read the beam likelihoods from a table
+  // indexed by the map's occ_dist_code instead of evaluating the Gaussian
+  public: void SetModelLookupTable(bool use_table);
+
+  // Spread the likelihood field models over this many threads (0 for one
+  // per core).  Copies of this sensor share its threads.
+  public: void SetThreadCount(int threads);
+
+  // Once the samples are close together, make the likelihood field models use
+  // this many beams chosen by how much they constrain the pose instead of
+  // max_beams evenly spaced ones (0 to always space them evenly)
+  public: void SetAdaptiveBeams(int adaptive_beams);
+
+  // Make the likelihood field models use fewer beams when an update would
+  // otherwise take longer than this many seconds (0 for no limit)
+  public: void SetTimeBudget(double time_budget);
+
+  // Compute the map's cspace distances unless they are current
+  private: void UpdateCspace(double max_occ_dist);
+
   // Determine the probability for the given pose
   private: static double BeamModel(AMCLLaserData *data, 
                                    pf_sample_set_t* set);
@@ -105,7 +136,33 @@ class AMCLLaser : public AMCLSensor
   private: static double LikelihoodFieldModelProb(AMCLLaserData *data, 
 					     pf_sample_set_t* set);
 
-  private: void reallocTempData(int max_samples, int max_obs);
+  // Number of beams the likelihood field models should aim for in the next
+  // update of the given set, within the time budget
+  private: int BeamTarget(pf_sample_set_t *set) const;
+
+  // Fill the beam tables with the valid beams of every step-th reading, or
+  // with the adaptive selection when it applies; returns the number of beams
+  private: int SetupBeams(AMCLLaserData *data, int step);
+
+  // Set selection_pose to the laser pose at the mean of the set; returns
+  // true if the samples are close enough together to select beams for it
+  private: bool SelectionPose(pf_sample_set_t *set);
+
+  // Fill the beam tables with up to beam_target beams picked for
+  // selection_pose; returns the number of beams, or 0 if too few beams end
+  // near the map for the selection to be trusted
+  private: int SelectBeams(AMCLLaserData *data);
+
+  // Split the samples into chunks for the threads and size the per-chunk
+  // scratch space; returns the number of chunks
+  private: int SetupChunks(int sample_count, int beam_count);
+
+  // Build the likelihood table for the current model if it is stale
+  private: void SetupTable(double range_max);
+
+  // Index into map->occ_dist_field of each beam endpoint for the given
+  // laser pose, or the off-map entry
+  private: void CellIndices(const pf_vector_t& pose, int beam_count, int *cells) const;
 
   private: laser_model_t model_type;
 
@@ -121,6 +178,20 @@ class AMCLLaser : public AMCLSensor
   // Max beams to consider
   private: int max_beams;
 
+  // Beams to pick by content once localized, 0 to space them evenly
+  private: int adaptive_beams;
+
+  // Time budget of an update in seconds, 0 for none, and the measured cost
+  // of one beam of one sample
+  private: double time_budget;
+  private: double beam_cost;
+
+  // Beams aimed for in the current update, and whether they are picked by
+  // the adaptive selection, for the laser at selection_pose
+  private: int beam_target;
+  private: bool select_beams;
+  private: pf_vector_t selection_pose;
+
   // Beam skipping parameters (used by LikelihoodFieldModelProb model)
   private: bool do_beamskip; 
   private: double beam_skip_distance; 
@@ -130,9 +201,33 @@ class AMCLLaser : public AMCLSensor
   private: double beam_skip_error_threshold;
 
   //temp data that is kept before observations are integrated to each particle (requried for beam skipping)
-  private: int max_samples;
-  private: int max_obs;
-  private: double **temp_obs;
+  private: std::vector<double> temp_obs;
+
+  // Beam endpoints in the laser frame, in map cells, as separate x and y
+  // arrays so that the endpoint transform vectorizes
+  private: std::vector<double> beam_x;
+  private: std::vector<double> beam_y;
+
+  // Scratch for the adaptive selection: the candidate readings and the bins
+  // of the directions they constrain
+  private: std::vector<int> candidates;
+  private: std::vector<int> candidate_bin;
+
+  // Per-chunk scratch: endpoint cells, partial weight sums and the beam
+  // skipping agreement counts
+  private: std::vector<int> cell_index;
+  private: std::vector<double> chunk_weight;
+  private: std::vector<int> obs_count;
+
+  private: std::shared_ptr<AMCLThreadPool> pool;
+
+  // Per occ_dist_code: what a beam ending there adds to the sample (pz^3 for
+  // the likelihood field model, log(pz) for the _prob one), and whether it
+  // agrees with the map for beam skipping.  Built for table_range_max.
+  private: bool use_table;
+  private: std::vector<double> table;
+  private: std::vector<char> table_agrees;
+  private: double table_range_max;
 
   // Laser model params
   //
@@ -0,0 +1,93 @@
+///////////////////////////////////////////////////////////////////////////
+//
+// Desc: Global scan matcher for relocalization
+//
+///////////////////////////////////////////////////////////////////////////
+
+#ifndef AMCL_SCAN_MATCHER_H
+#define AMCL_SCAN_MATCHER_H
+
+#include <vector>
+
+#include "amcl_laser.h"
+#include "../map/map.h"
+#include "../pf/pf_vector.h"
+
+namespace amcl
+{
+
+// Finds the pose on the whole map that best explains a scan, by branch and
+// bound over a pyramid of the likelihood field.  Level h of the pyramid
+// holds, for each cell, the best score of the 2^h x 2^h block of cells
+// starting at it, so a scan scored against level h bounds the score of
+// every translation in such a block.  The search starts from blocks of
+// 2^depth cells at every rotation and only refines the blocks whose bound
+// beats the best pose found so far.
+class AMCLScanMatcher
+{
+  // The map must outlive the matcher.  Beams are scored with a Gaussian of
+  // sigma around the nearest obstacle, as in the likelihood field model,
+  // using the map's cspace distances; they are computed for max_occ_dist
+  // if the map has none.
+  public: AMCLScanMatcher(map_t *map, double max_occ_dist, double sigma);
+
+  // Use at most this many evenly spaced beams of a scan
+  public: void SetMaxBeams(int max_beams) {this->max_beams = max_beams;}
+
+  // Ignore poses whose score, the mean beam likelihood in [0, 1], is below
+  // this
+  public: void SetMinScore(double min_score) {this->min_score = min_score;}
+
+  // Find the robot pose for the scan, with the laser at laser_pose on the
+  // robot.  Returns the score of the pose, or -1 if no pose reached
+  // min_score.  The pyramid is built on the first call.
+  public: double Match(AMCLLaserData *data, const pf_vector_t& laser_pose,
+                       pf_vector_t *pose);
+
+  // A translation block of the search at one rotation, with the score of
+  // the scan against the pyramid level of its size
+  private: struct Candidate
+  {
+    int x, y;
+    int angle;
+    int score;
+  };
+
+  private: static bool HigherScore(const Candidate& a, const Candidate& b);
+
+  private: void BuildPyramid();
+
+  // Tabulate the beam endpoint offsets in cells for every rotation
+  private: void SetupBeams(AMCLLaserData *data, const pf_vector_t& laser_pose);
+
+  private: int Score(int level, int x, int y, int angle) const;
+
+  // Refine a candidate of the given level into the best pose beating
+  // best->score
+  private: void Search(const Candidate& candidate, int level, Candidate *best) const;
+
+  private: map_t *map;
+  private: double max_occ_dist;
+  private: double sigma;
+  private: int max_beams;
+  private: double min_score;
+
+  // Pyramid levels 0 .. depth, each padded by 2^depth cells below and to
+  // the left so that blocks hanging off the map keep their scores
+  private: int depth;
+  private: int pad;
+  private: int width, height;
+  private: std::vector<std::vector<unsigned char> > levels;
+
+  // Rotations searched and the endpoint offsets of each, beam_count per
+  // rotation
+  private: int angle_count;
+  private: double angle_step;
+  private: int beam_count;
+  private: std::vector<int> offset_x;
+  private: std::vector<int> offset_y;
+};
+
+}
+
+#endif
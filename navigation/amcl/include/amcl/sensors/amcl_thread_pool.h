@@ -0,0 +1,60 @@
+///////////////////////////////////////////////////////////////////////////
+//
+// Desc: Worker threads for the sensor models
+//
+///////////////////////////////////////////////////////////////////////////
+
+#ifndef AMCL_THREAD_POOL_H
+#define AMCL_THREAD_POOL_H
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace amcl
+{
+
+// A fixed set of worker threads that run the tasks of one job at a time.
+// The calling thread works on the job too, so a pool of size 1 has no
+// workers and runs everything inline.
+class AMCLThreadPool
+{
+  // Size 0 picks the number of hardware threads
+  public: explicit AMCLThreadPool(int size);
+
+  public: ~AMCLThreadPool();
+
+  // Number of threads working on a job, the caller included
+  public: int Size() const {return this->workers.size() + 1;}
+
+  // Run task(0) .. task(count - 1) and return when all have finished
+  public: void Run(int count, const std::function<void(int)>& task);
+
+  private: AMCLThreadPool(const AMCLThreadPool&);
+  private: AMCLThreadPool& operator=(const AMCLThreadPool&);
+
+  private: void Work();
+
+  // Take and run tasks of the current job until none is left
+  private: void Drain(std::unique_lock<std::mutex>& lock);
+
+  private: std::vector<std::thread> workers;
+
+  private: std::mutex mutex;
+  private: std::condition_variable job_ready;
+  private: std::condition_variable job_done;
+
+  // Current job; a new generation wakes the workers
+  private: const std::function<void(int)>* task;
+  private: int task_count;
+  private: int next_task;
+  private: int running;
+  private: unsigned long generation;
+  private: bool stop;
+};
+
+}
+
+#endif
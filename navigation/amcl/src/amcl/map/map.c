@@ -52,6 +52,11 @@ map_t *map_alloc(void)
   
   // Allocate storage for main map
   map->cells = (map_cell_t*) NULL;
+  map->occ_dist_field = (float*) NULL;
+  map->occ_dist_code = (unsigned short*) NULL;
+  map->occ_dist_code_count = 0;
+  map->cspace_mapping = NULL;
+  map->cspace_mapping_size = 0;
   
   return map;
 }
@@ -61,6 +66,7 @@ map_t *map_alloc(void)
 void map_free(map_t *map)
 {
   free(map->cells);
+  map_free_cspace(map);
   free(map);
   return;
 }
@@ -82,3 +88,11 @@ map_cell_t *map_get_cell(map_t *map, double ox, double oy, double oa)
   return cell;
 }
 
+
+// Get the distance represented by an occ_dist_code value
+double map_occ_dist_decode(map_t *map, int code)
+{
+  if (code >= map->occ_dist_code_count - 1)
+    return map->max_occ_dist;
+  return sqrt(code) * map->scale;
+}
@@ -0,0 +1,284 @@
+/*
+ *  Player - One Hell of a Robot Server
+ *  Copyright (C) 2000  Brian Gerkey   &  Kasper Stoy
+ *                      gerkey@usc.edu    kaspers@robotics.usc.edu
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+/**************************************************************************
+ * Desc: Cache of the cspace distances
+ *
+ * Each entry is a header followed by occ_dist_field and, if present,
+ * occ_dist_code, exactly as map_update_cspace lays them out, so a hit
+ * maps the file and points the map at it.  Entries are named after a
+ * hash of the occupancy grid and max_occ_dist, and carry a hash of their
+ * payload so that a torn or stale file is recomputed rather than used.
+**************************************************************************/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "amcl/map/map.h"
+#include "map_server/map_cache_hash.h"
+
+// Bump when the layout or the distances computed by map_update_cspace change
+#define MAP_CACHE_VERSION 1
+
+typedef struct
+{
+  char magic[8];
+  uint32_t version;
+  uint32_t header_size;
+  int32_t size_x, size_y;
+  double scale;
+  double max_occ_dist;
+  int32_t occ_dist_code_count;
+  int32_t reserved;
+  uint64_t occ_hash;
+  uint64_t data_hash;
+} map_cache_header_t;
+
+static const char map_cache_magic[8] = "AMCLCSP";
+
+
+// Hash the occupancy states, packed 32 to a word
+static uint64_t map_occ_hash(map_t *map)
+{
+  uint64_t hash = MAP_CACHE_HASH_SEED;
+  uint64_t word;
+  int n, i, k;
+
+  n = map->size_x * map->size_y;
+  for (i = 0; i < n; i += 32)
+  {
+    word = 0;
+    if (i + 32 <= n)
+    {
+      for (k = 0; k < 32; k++)
+        word |= (uint64_t) (map->cells[i + k].occ_state + 1) << (2 * k);
+    }
+    else
+    {
+      for (k = 0; k < n - i; k++)
+        word |= (uint64_t) (map->cells[i + k].occ_state + 1) << (2 * k);
+    }
+    hash = map_cache_hash(hash, &word, sizeof(word));
+  }
+  return hash;
+}
+
+
+// Hash the payload of an entry
+static uint64_t map_data_hash(uint64_t hash, const float *field,
+                              const unsigned short *code, int n)
+{
+  hash = map_cache_hash(hash, field, sizeof(float) * (n + 1));
+  if (code)
+    hash = map_cache_hash(hash, code, sizeof(unsigned short) * (n + 1));
+  return hash;
+}
+
+
+static size_t map_cache_data_size(int n, int code_count)
+{
+  size_t size = sizeof(float) * (n + 1);
+  if (code_count > 0)
+    size += sizeof(unsigned short) * (n + 1);
+  return size;
+}
+
+
+// Name the entry for the map's grid and max_occ_dist
+static void map_cache_filename(map_t *map, double max_occ_dist, uint64_t occ_hash,
+                               const char *dir, char *filename, size_t size)
+{
+  uint64_t key = occ_hash;
+  key = map_cache_hash(key, &map->size_x, sizeof(map->size_x));
+  key = map_cache_hash(key, &map->size_y, sizeof(map->size_y));
+  key = map_cache_hash(key, &map->scale, sizeof(map->scale));
+  key = map_cache_hash(key, &max_occ_dist, sizeof(max_occ_dist));
+  snprintf(filename, size, "%s/cspace-%016llx.bin", dir, (unsigned long long) key);
+}
+
+
+// Release the cspace distances
+void map_free_cspace(map_t *map)
+{
+  if (map->cspace_mapping)
+    munmap(map->cspace_mapping, map->cspace_mapping_size);
+  else
+  {
+    free(map->occ_dist_field);
+    free(map->occ_dist_code);
+  }
+  map->cspace_mapping = NULL;
+  map->cspace_mapping_size = 0;
+  map->occ_dist_field = NULL;
+  map->occ_dist_code = NULL;
+  map->occ_dist_code_count = 0;
+}
+
+
+////////////////////////////////////////////////////////////////////////////
+// Load the cspace distances from the cache
+int map_load_cspace(map_t *map, double max_occ_dist, const char *dir)
+{
+  char filename[4096];
+  uint64_t occ_hash;
+  const map_cache_header_t *header;
+  const float *field;
+  const unsigned short *code;
+  struct stat st;
+  void *mapping;
+  size_t size;
+  int fd, n, i;
+  double *dist;
+
+  n = map->size_x * map->size_y;
+  occ_hash = map_occ_hash(map);
+  map_cache_filename(map, max_occ_dist, occ_hash, dir, filename, sizeof(filename));
+
+  fd = open(filename, O_RDONLY);
+  if (fd < 0)
+    return -1;
+  if (fstat(fd, &st) < 0 || st.st_size < (off_t) sizeof(map_cache_header_t))
+  {
+    close(fd);
+    return -1;
+  }
+  size = st.st_size;
+  mapping = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (mapping == MAP_FAILED)
+    return -1;
+
+  header = (const map_cache_header_t*) mapping;
+  if (memcmp(header->magic, map_cache_magic, sizeof(map_cache_magic)) != 0 ||
+      header->version != MAP_CACHE_VERSION ||
+      header->header_size != sizeof(map_cache_header_t) ||
+      header->size_x != map->size_x || header->size_y != map->size_y ||
+      header->scale != map->scale || header->max_occ_dist != max_occ_dist ||
+      header->occ_dist_code_count < 0 || header->occ_dist_code_count > 0x10000 ||
+      header->occ_hash != occ_hash ||
+      size != sizeof(map_cache_header_t) + map_cache_data_size(n, header->occ_dist_code_count))
+  {
+    fprintf(stderr, "ignoring stale cspace cache %s\n", filename);
+    munmap(mapping, size);
+    return -1;
+  }
+
+  field = (const float*) (header + 1);
+  code = header->occ_dist_code_count > 0 ? (const unsigned short*) (field + n + 1) : NULL;
+  if (header->data_hash != map_data_hash(occ_hash, field, code, n))
+  {
+    fprintf(stderr, "ignoring stale cspace cache %s\n", filename);
+    munmap(mapping, size);
+    return -1;
+  }
+
+  map_free_cspace(map);
+  map->max_occ_dist = max_occ_dist;
+  map->cspace_mapping = mapping;
+  map->cspace_mapping_size = size;
+  map->occ_dist_field = (float*) field;
+  map->occ_dist_code = (unsigned short*) code;
+  map->occ_dist_code_count = header->occ_dist_code_count;
+
+  // The cells keep their own copy of the distances; the codes give them
+  // back exactly, the field to float precision
+  if (map->occ_dist_code)
+  {
+    dist = (double*) malloc(sizeof(double) * map->occ_dist_code_count);
+    for (i = 0; i < map->occ_dist_code_count; i++)
+      dist[i] = map_occ_dist_decode(map, i);
+    for (i = 0; i < n; i++)
+      map->cells[i].occ_dist = dist[map->occ_dist_code[i]];
+    free(dist);
+  }
+  else
+  {
+    for (i = 0; i < n; i++)
+      map->cells[i].occ_dist = map->occ_dist_field[i];
+  }
+
+  return 0;
+}
+
+
+////////////////////////////////////////////////////////////////////////////
+// Save the cspace distances to the cache
+int map_save_cspace(map_t *map, const char *dir)
+{
+  char filename[4096];
+  char tmpname[4096 + 32];
+  map_cache_header_t header;
+  FILE *file;
+  int n, ok;
+
+  if (map->occ_dist_field == NULL)
+    return -1;
+
+  if (mkdir(dir, 0755) < 0 && errno != EEXIST)
+  {
+    fprintf(stderr, "%s: %s\n", strerror(errno), dir);
+    return -1;
+  }
+
+  n = map->size_x * map->size_y;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, map_cache_magic, sizeof(map_cache_magic));
+  header.version = MAP_CACHE_VERSION;
+  header.header_size = sizeof(header);
+  header.size_x = map->size_x;
+  header.size_y = map->size_y;
+  header.scale = map->scale;
+  header.max_occ_dist = map->max_occ_dist;
+  header.occ_dist_code_count = map->occ_dist_code ? map->occ_dist_code_count : 0;
+  header.occ_hash = map_occ_hash(map);
+  header.data_hash = map_data_hash(header.occ_hash, map->occ_dist_field,
+                                   map->occ_dist_code, n);
+
+  map_cache_filename(map, map->max_occ_dist, header.occ_hash, dir, filename, sizeof(filename));
+  snprintf(tmpname, sizeof(tmpname), "%s.%d.tmp", filename, (int) getpid());
+
+  file = fopen(tmpname, "wb");
+  if (file == NULL)
+  {
+    fprintf(stderr, "%s: %s\n", strerror(errno), tmpname);
+    return -1;
+  }
+  ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+       fwrite(map->occ_dist_field, sizeof(float), n + 1, file) == (size_t) (n + 1);
+  if (ok && header.occ_dist_code_count > 0)
+    ok = fwrite(map->occ_dist_code, sizeof(unsigned short), n + 1, file) == (size_t) (n + 1);
+  ok = ok && fflush(file) == 0 && fsync(fileno(file)) == 0;
+  ok = (fclose(file) == 0) && ok;
+  if (!ok || rename(tmpname, filename) < 0)
+  {
+    fprintf(stderr, "%s: %s\n", strerror(errno), tmpname);
+    unlink(tmpname);
+    return -1;
+  }
+
+  return 0;
+}
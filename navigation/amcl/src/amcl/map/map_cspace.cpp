@@ -19,158 +19,170 @@
  *
  */
 
-#include <queue>
 #include <math.h>
 #include <stdlib.h>
 #include <string.h>
+#include <algorithm>
+#include <memory>
+#include <thread>
+#include <vector>
 #include "amcl/map/map.h"
 
-class CellData
-{
-  public:
-    map_t* map_;
-    unsigned int i_, j_;
-    unsigned int src_i_, src_j_;
-};
-
-class CachedDistanceMap
-{
-  public:
-    CachedDistanceMap(double scale, double max_dist) : 
-      distances_(NULL), scale_(scale), max_dist_(max_dist) 
-    {
-      cell_radius_ = max_dist / scale;
-      distances_ = new double *[cell_radius_+2];
-      for(int i=0; i<=cell_radius_+1; i++)
-      {
-	distances_[i] = new double[cell_radius_+2];
-        for(int j=0; j<=cell_radius_+1; j++)
-	{
-	  distances_[i][j] = sqrt(i*i + j*j);
-	}
-      }
-    }
-    ~CachedDistanceMap()
-    {
-      if(distances_)
-      {
-	for(int i=0; i<=cell_radius_+1; i++)
-	  delete[] distances_[i];
-	delete[] distances_;
-      }
-    }
-    double** distances_;
-    double scale_;
-    double max_dist_;
-    int cell_radius_;
-};
-
+// Squared distances, in cells, past the clipping radius
+static const int far_sq = 0x7fffffff;
 
-bool operator<(const CellData& a, const CellData& b)
+// Run body(begin, end) over [0, count) split across the hardware threads
+template <typename Body>
+static void parallel_for(int count, Body body)
 {
-  return a.map_->cells[MAP_INDEX(a.map_, a.i_, a.j_)].occ_dist > a.map_->cells[MAP_INDEX(b.map_, b.i_, b.j_)].occ_dist;
-}
-
-CachedDistanceMap*
-get_distance_map(double scale, double max_dist)
-{
-  static CachedDistanceMap* cdm = NULL;
-
-  if(!cdm || (cdm->scale_ != scale) || (cdm->max_dist_ != max_dist))
+  int threads = std::min<int>(std::thread::hardware_concurrency(), count / 64);
+  if(threads <= 1)
   {
-    if(cdm)
-      delete cdm;
-    cdm = new CachedDistanceMap(scale, max_dist);
+    body(0, count);
+    return;
   }
 
-  return cdm;
+  std::vector<std::thread> workers;
+  for(int t=1; t<threads; t++)
+    workers.push_back(std::thread(body, (long) count * t / threads, (long) count * (t + 1) / threads));
+  body(0, count / threads);
+  for(size_t t=0; t<workers.size(); t++)
+    workers[t].join();
 }
 
-void enqueue(map_t* map, int i, int j,
-	     int src_i, int src_j,
-	     std::priority_queue<CellData>& Q,
-	     CachedDistanceMap* cdm,
-	     unsigned char* marked)
+// Squared distance from each index to the nearest obstacle, given the
+// squared distances f to the nearest obstacle along the other axis (far_sq
+// for none), using Felzenszwalb and Huttenlocher's lower envelope of
+// parabolas.  v and z are scratch of n and n + 1 entries.
+static void distance_transform_1d(const int* f, int* d, int n, int* v, double* z)
 {
-  if(marked[MAP_INDEX(map, i, j)])
-    return;
-
-  int di = abs(i - src_i);
-  int dj = abs(j - src_j);
-  double distance = cdm->distances_[di][dj];
+  int k = -1;
+  for(int q=0; q<n; q++)
+  {
+    if(f[q] == far_sq)
+      continue;
+    double s = 0.0;
+    while(k >= 0)
+    {
+      s = ((f[q] + (double) q * q) - (f[v[k]] + (double) v[k] * v[k])) / (2.0 * (q - v[k]));
+      if(s > z[k])
+        break;
+      k--;
+    }
+    k++;
+    v[k] = q;
+    z[k] = k == 0 ? -HUGE_VAL : s;
+    z[k + 1] = HUGE_VAL;
+  }
 
-  if(distance > cdm->cell_radius_)
+  if(k < 0)
+  {
+    for(int q=0; q<n; q++)
+      d[q] = far_sq;
     return;
+  }
 
-  map->cells[MAP_INDEX(map, i, j)].occ_dist = distance * map->scale;
-
-  CellData cell;
-  cell.map_ = map;
-  cell.i_ = i;
-  cell.j_ = j;
-  cell.src_i_ = src_i;
-  cell.src_j_ = src_j;
-
-  Q.push(cell);
-
-  marked[MAP_INDEX(map, i, j)] = 1;
+  int j = 0;
+  for(int q=0; q<n; q++)
+  {
+    while(z[j + 1] < q)
+      j++;
+    long dq = q - v[j];
+    long sq = dq * dq + f[v[j]];
+    d[q] = sq < far_sq ? (int) sq : far_sq;
+  }
 }
 
-// Update the cspace distance values
+// Update the cspace distance values with an exact Euclidean distance
+// transform: a pass down the columns, then a lower envelope along each row.
+// Both passes walk the rows contiguously and are split across threads.
 void map_update_cspace(map_t *map, double max_occ_dist)
 {
-  unsigned char* marked;
-  std::priority_queue<CellData> Q;
-
-  marked = new unsigned char[map->size_x*map->size_y];
-  memset(marked, 0, sizeof(unsigned char) * map->size_x*map->size_y);
+  int size_x = map->size_x;
+  int size_y = map->size_y;
+  int n = size_x * size_y;
 
   map->max_occ_dist = max_occ_dist;
 
-  CachedDistanceMap* cdm = get_distance_map(map->scale, map->max_occ_dist);
+  // Cells farther than this many cells from an obstacle are at max_occ_dist
+  int cell_radius = max_occ_dist / map->scale;
+  long radius_sq = (long) cell_radius * cell_radius;
 
-  // Enqueue all the obstacle cells
-  CellData cell;
-  cell.map_ = map;
-  for(int i=0; i<map->size_x; i++)
+  // Squared distance to the nearest obstacle in the same column.  Each
+  // thread takes a band of columns and sweeps it down, noting obstacles in
+  // a byte mask, and back up over the mask.
+  std::unique_ptr<int[]> col_sq(new int[n]);
+  std::unique_ptr<unsigned char[]> occupied(new unsigned char[n]);
+  parallel_for(size_x, [&](int begin, int end)
   {
-    cell.src_i_ = cell.i_ = i;
-    for(int j=0; j<map->size_y; j++)
+    std::vector<int> last(size_x, -1);
+    for(int j=0; j<size_y; j++)
     {
-      if(map->cells[MAP_INDEX(map, i, j)].occ_state == +1)
+      const map_cell_t* row = map->cells + MAP_INDEX(map, 0, j);
+      unsigned char* occ = &occupied[(size_t) j * size_x];
+      int* sq = &col_sq[(size_t) j * size_x];
+      for(int i=begin; i<end; i++)
       {
-	map->cells[MAP_INDEX(map, i, j)].occ_dist = 0.0;
-	cell.src_j_ = cell.j_ = j;
-	marked[MAP_INDEX(map, i, j)] = 1;
-	Q.push(cell);
+        occ[i] = row[i].occ_state == +1;
+        if(occ[i])
+          last[i] = j;
+        long d = j - last[i];
+        sq[i] = last[i] < 0 || d > cell_radius ? far_sq : (int) (d * d);
       }
-      else
-	map->cells[MAP_INDEX(map, i, j)].occ_dist = max_occ_dist;
     }
-  }
+    std::fill(last.begin(), last.end(), -1);
+    for(int j=size_y-1; j>=0; j--)
+    {
+      const unsigned char* occ = &occupied[(size_t) j * size_x];
+      int* sq = &col_sq[(size_t) j * size_x];
+      for(int i=begin; i<end; i++)
+      {
+        if(occ[i])
+          last[i] = j;
+        long d = last[i] - j;
+        if(last[i] >= 0 && d <= cell_radius && d * d < sq[i])
+          sq[i] = d * d;
+      }
+    }
+  });
 
-  while(!Q.empty())
-  {
-    CellData current_cell = Q.top();
-    if(current_cell.i_ > 0)
-      enqueue(map, current_cell.i_-1, current_cell.j_, 
-	      current_cell.src_i_, current_cell.src_j_,
-	      Q, cdm, marked);
-    if(current_cell.j_ > 0)
-      enqueue(map, current_cell.i_, current_cell.j_-1, 
-	      current_cell.src_i_, current_cell.src_j_,
-	      Q, cdm, marked);
-    if((int)current_cell.i_ < map->size_x - 1)
-      enqueue(map, current_cell.i_+1, current_cell.j_, 
-	      current_cell.src_i_, current_cell.src_j_,
-	      Q, cdm, marked);
-    if((int)current_cell.j_ < map->size_y - 1)
-      enqueue(map, current_cell.i_, current_cell.j_+1, 
-	      current_cell.src_i_, current_cell.src_j_,
-	      Q, cdm, marked);
+  map_free_cspace(map);
+  map->occ_dist_field = (float*) malloc(sizeof(float) * (n + 1));
+  map->occ_dist_field[n] = max_occ_dist;
 
-    Q.pop();
+  // The distances below max_occ_dist are sqrt(i*i + j*j) cells for integer
+  // i, j, so their squares make exact codes
+  double max_cells = max_occ_dist / map->scale;
+  int max_code = (int) ceil(max_cells * max_cells) + 1;
+  if(max_code <= 0xffff)
+  {
+    map->occ_dist_code = (unsigned short*) malloc(sizeof(unsigned short) * (n + 1));
+    map->occ_dist_code_count = max_code + 1;
+    map->occ_dist_code[n] = max_code;
+  }
+  else
+  {
+    map->occ_dist_code = NULL;
+    map->occ_dist_code_count = 0;
   }
 
-  delete[] marked;
+  parallel_for(size_y, [&](int begin, int end)
+  {
+    std::vector<int> d(size_x), v(size_x);
+    std::vector<double> z(size_x + 1);
+    for(int j=begin; j<end; j++)
+    {
+      distance_transform_1d(&col_sq[(size_t) j * size_x], &d[0], size_x, &v[0], &z[0]);
+      for(int i=0; i<size_x; i++)
+      {
+        int index = MAP_INDEX(map, i, j);
+        bool near = d[i] <= radius_sq;
+        double dist = near ? sqrt((double) d[i]) * map->scale : max_occ_dist;
+        map->cells[index].occ_dist = dist;
+        map->occ_dist_field[index] = dist;
+        if(map->occ_dist_code)
+          map->occ_dist_code[index] = near && dist < max_occ_dist ? d[i] : max_code;
+      }
+    }
+  });
 }
@@ -32,7 +32,7 @@
 
 #include "amcl/pf/pf.h"
 #include "amcl/pf/pf_pdf.h"
-#include "amcl/pf/pf_kdtree.h"
+#include "amcl/pf/pf_hist.h"
 #include "portable_utils.hpp"
 
 
@@ -91,8 +91,8 @@ pf_t *pf_alloc(int min_samples, int max_samples,
       sample->weight = 1.0 / max_samples;
     }
 
-    // HACK: is 3 times max_samples enough?
-    set->kdtree = pf_kdtree_alloc(3 * max_samples);
+    // Every sample fills at most one new bin
+    set->hist = pf_hist_alloc(max_samples);
 
     set->cluster_count = 0;
     set->cluster_max_count = max_samples;
@@ -124,7 +124,7 @@ void pf_free(pf_t *pf)
   for (i = 0; i < 2; i++)
   {
     free(pf->sets[i].clusters);
-    pf_kdtree_free(pf->sets[i].kdtree);
+    pf_hist_free(pf->sets[i].hist);
     free(pf->sets[i].samples);
   }
   free(pf);
@@ -142,8 +142,8 @@ void pf_init(pf_t *pf, pf_vector_t mean, pf_matrix_t cov)
   
   set = pf->sets + pf->current_set;
   
-  // Create the kd tree for adaptive sampling
-  pf_kdtree_clear(set->kdtree);
+  // Create the histogram for adaptive sampling
+  pf_hist_clear(set->hist);
 
   set->sample_count = pf->max_samples;
 
@@ -157,7 +157,7 @@ void pf_init(pf_t *pf, pf_vector_t mean, pf_matrix_t cov)
     sample->pose = pf_pdf_gaussian_sample(pdf);
 
     // Add sample to histogram
-    pf_kdtree_insert(set->kdtree, sample->pose, sample->weight);
+    pf_hist_insert(set->hist, sample->pose, sample->weight);
   }
 
   pf->w_slow = pf->w_fast = 0.0;
@@ -183,8 +183,8 @@ void pf_init_model(pf_t *pf, pf_init_model_fn_t init_fn, void *init_data)
 
   set = pf->sets + pf->current_set;
 
-  // Create the kd tree for adaptive sampling
-  pf_kdtree_clear(set->kdtree);
+  // Create the histogram for adaptive sampling
+  pf_hist_clear(set->hist);
 
   set->sample_count = pf->max_samples;
 
@@ -196,7 +196,7 @@ void pf_init_model(pf_t *pf, pf_init_model_fn_t init_fn, void *init_data)
     sample->pose = (*init_fn) (init_data);
 
     // Add sample to histogram
-    pf_kdtree_insert(set->kdtree, sample->pose, sample->weight);
+    pf_hist_insert(set->hist, sample->pose, sample->weight);
   }
 
   pf->w_slow = pf->w_fast = 0.0;
@@ -324,8 +324,8 @@ void copy_set(pf_sample_set_t* set_a, pf_sample_set_t* set_b)
   double total;
   pf_sample_t *sample_a, *sample_b;
 
-  // Clean set b's kdtree
-  pf_kdtree_clear(set_b->kdtree);
+  // Clean set b's histogram
+  pf_hist_clear(set_b->hist);
 
   // Copy samples from set a to create set b
   total = 0;
@@ -346,7 +346,7 @@ void copy_set(pf_sample_set_t* set_a, pf_sample_set_t* set_b)
     total += sample_b->weight;
 
     // Add sample to histogram
-    pf_kdtree_insert(set_b->kdtree, sample_b->pose, sample_b->weight);
+    pf_hist_insert(set_b->hist, sample_b->pose, sample_b->weight);
   }
 
   // Normalize weights
@@ -362,15 +362,14 @@ void copy_set(pf_sample_set_t* set_a, pf_sample_set_t* set_b)
 // Resample the distribution
 void pf_update_resample(pf_t *pf)
 {
-  int i;
+  int i, k, m;
   double total;
   pf_sample_set_t *set_a, *set_b;
   pf_sample_t *sample_a, *sample_b;
 
-  //double r,c,U;
-  //int m;
-  //double count_inv;
-  double* c;
+  double r, c, U;
+  double count_inv;
+  int* index;
 
   double w_diff;
 
@@ -393,16 +392,26 @@ void pf_update_resample(pf_t *pf)
     }
   }
 
-  // Build up cumulative probability table for resampling.
-  // TODO: Replace this with a more efficient procedure
-  // (e.g., http://www.network-theory.co.uk/docs/gslref/GeneralDiscreteDistributions.html)
-  c = (double*)malloc(sizeof(double)*(set_a->sample_count+1));
-  c[0] = 0.0;
-  for(i=0;i<set_a->sample_count;i++)
-    c[i+1] = c[i]+set_a->samples[i].weight;
+  // Low-variance resampler, taken from Probabilistic Robotics, p110: one
+  // pass over the weights draws max_samples indices into set a.
+  index = (int*)malloc(sizeof(int)*pf->max_samples);
+  count_inv = 1.0/pf->max_samples;
+  r = drand48() * count_inv;
+  c = set_a->samples[0].weight;
+  i = 0;
+  for(m=0;m<pf->max_samples;m++)
+  {
+    U = r + m * count_inv;
+    while(U > c && i < set_a->sample_count - 1)
+    {
+      i++;
+      c += set_a->samples[i].weight;
+    }
+    index[m] = i;
+  }
 
-  // Create the kd tree for adaptive sampling
-  pf_kdtree_clear(set_b->kdtree);
+  // Create the histogram for adaptive sampling
+  pf_hist_clear(set_b->hist);
   
   // Draw samples from set a to create set b.
   total = 0;
@@ -413,62 +422,27 @@ void pf_update_resample(pf_t *pf)
     w_diff = 0.0;
   //printf("w_diff: %9.6f\n", w_diff);
 
-  // Can't (easily) combine low-variance sampler with KLD adaptive
-  // sampling, so we'll take the more traditional route.
-  /*
-  // Low-variance resampler, taken from Probabilistic Robotics, p110
-  count_inv = 1.0/set_a->sample_count;
-  r = drand48() * count_inv;
-  c = set_a->samples[0].weight;
-  i = 0;
-  m = 0;
-  */
   while(set_b->sample_count < pf->max_samples)
   {
+    m = set_b->sample_count;
     sample_b = set_b->samples + set_b->sample_count++;
 
-    if(drand48() < w_diff)
+    // KLD sampling may stop after any number of samples, so the drawn
+    // indices are taken in random order (a partial Fisher-Yates shuffle)
+    // to keep every prefix an unbiased draw from set a
+    k = m + (int)(drand48() * (pf->max_samples - m));
+    if(k >= pf->max_samples)
+      k = pf->max_samples - 1;
+    i = index[k];
+    index[k] = index[m];
+    index[m] = i;
+
+    if(w_diff > 0.0 && drand48() < w_diff)
       sample_b->pose = (pf->random_pose_fn)(pf->random_pose_data);
     else
     {
-      // Can't (easily) combine low-variance sampler with KLD adaptive
-      // sampling, so we'll take the more traditional route.
-      /*
-      // Low-variance resampler, taken from Probabilistic Robotics, p110
-      U = r + m * count_inv;
-      while(U>c)
-      {
-        i++;
-        // Handle wrap-around by resetting counters and picking a new random
-        // number
-        if(i >= set_a->sample_count)
-        {
-          r = drand48() * count_inv;
-          c = set_a->samples[0].weight;
-          i = 0;
-          m = 0;
-          U = r + m * count_inv;
-          continue;
-        }
-        c += set_a->samples[i].weight;
-      }
-      m++;
-      */
-
-      // Naive discrete event sampler
-      double r;
-      r = drand48();
-      for(i=0;i<set_a->sample_count;i++)
-      {
-        if((c[i] <= r) && (r < c[i+1]))
-          break;
-      }
-      assert(i<set_a->sample_count);
-
       sample_a = set_a->samples + i;
 
-      assert(sample_a->weight > 0);
-
       // Add sample to list
       sample_b->pose = sample_a->pose;
     }
@@ -477,10 +451,10 @@ void pf_update_resample(pf_t *pf)
     total += sample_b->weight;
 
     // Add sample to histogram
-    pf_kdtree_insert(set_b->kdtree, sample_b->pose, sample_b->weight);
+    pf_hist_insert(set_b->hist, sample_b->pose, sample_b->weight);
 
     // See if we have enough samples yet
-    if (set_b->sample_count > pf_resample_limit(pf, set_b->kdtree->leaf_count))
+    if (set_b->sample_count > pf_resample_limit(pf, set_b->hist->bin_count))
       break;
   }
   
@@ -505,7 +479,7 @@ void pf_update_resample(pf_t *pf)
 
   pf_update_converged(pf);
 
-  free(c);
+  free(index);
   return;
 }
 
@@ -564,16 +538,17 @@ void pf_cluster_stats(pf_t *pf, pf_sample_set_t *set)
   
   // Workspace
   double m[4], c[2][2];
+  double ca, sa;
   size_t count;
   double weight;
 
   // Cluster the samples
-  pf_kdtree_cluster(set->kdtree);
+  set->cluster_count = pf_hist_cluster(set->hist);
+  if (set->cluster_count > set->cluster_max_count)
+    set->cluster_count = set->cluster_max_count;
   
   // Initialize cluster stats
-  set->cluster_count = 0;
-
-  for (i = 0; i < set->cluster_max_count; i++)
+  for (i = 0; i < set->cluster_count; i++)
   {
     cluster = set->clusters + i;
     cluster->count = 0;
@@ -607,12 +582,10 @@ void pf_cluster_stats(pf_t *pf, pf_sample_set_t *set)
     //printf("%d %f %f %f\n", i, sample->pose.v[0], sample->pose.v[1], sample->pose.v[2]);
 
     // Get the cluster label for this sample
-    cidx = pf_kdtree_get_cluster(set->kdtree, sample->pose);
+    cidx = pf_hist_get_cluster(set->hist, sample->pose);
     assert(cidx >= 0);
-    if (cidx >= set->cluster_max_count)
+    if (cidx >= set->cluster_count)
       continue;
-    if (cidx + 1 > set->cluster_count)
-      set->cluster_count = cidx + 1;
     
     cluster = set->clusters + cidx;
 
@@ -623,15 +596,17 @@ void pf_cluster_stats(pf_t *pf, pf_sample_set_t *set)
     weight += sample->weight;
 
     // Compute mean
+    ca = cos(sample->pose.v[2]);
+    sa = sin(sample->pose.v[2]);
     cluster->m[0] += sample->weight * sample->pose.v[0];
     cluster->m[1] += sample->weight * sample->pose.v[1];
-    cluster->m[2] += sample->weight * cos(sample->pose.v[2]);
-    cluster->m[3] += sample->weight * sin(sample->pose.v[2]);
+    cluster->m[2] += sample->weight * ca;
+    cluster->m[3] += sample->weight * sa;
 
     m[0] += sample->weight * sample->pose.v[0];
     m[1] += sample->weight * sample->pose.v[1];
-    m[2] += sample->weight * cos(sample->pose.v[2]);
-    m[3] += sample->weight * sin(sample->pose.v[2]);
+    m[2] += sample->weight * ca;
+    m[3] += sample->weight * sa;
 
     // Compute covariance in linear components
     for (j = 0; j < 2; j++)
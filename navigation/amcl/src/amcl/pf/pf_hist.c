@@ -0,0 +1,313 @@
+/*
+ *  Player - One Hell of a Robot Server
+ *  Copyright (C) 2000  Brian Gerkey   &  Kasper Stoy
+ *                      gerkey@usc.edu    kaspers@robotics.usc.edu
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+/**************************************************************************
+ * Desc: Pose histogram functions
+ *
+ * The histogram the filter uses for KLD sampling and clustering.  It has
+ * the bins of the kd-tree it replaces, but finds them through a hash
+ * table, so an insert or a lookup is a few probes into flat arrays
+ * instead of a walk down the tree.
+ *************************************************************************/
+
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+#include "amcl/pf/pf_vector.h"
+#include "amcl/pf/pf_hist.h"
+
+
+// Compute the key of the bin holding a pose
+static void pf_hist_key(pf_hist_t *self, pf_vector_t pose, int key[]);
+
+// Find the bin with the given key; returns its index, or -1 with *slot
+// set to the empty slot where it would go
+static int pf_hist_find(pf_hist_t *self, int key[], int *slot);
+
+// Find the root of a bin in the union-find forest
+static int pf_hist_root(int *parent, int i);
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Create a histogram
+pf_hist_t *pf_hist_alloc(int max_size)
+{
+  pf_hist_t *self;
+  int table_size;
+
+  self = calloc(1, sizeof(pf_hist_t));
+
+  self->size[0] = 0.50;
+  self->size[1] = 0.50;
+  self->size[2] = (10 * M_PI / 180);
+
+  self->bin_count = 0;
+  self->bin_max_count = max_size;
+  self->bins = calloc(self->bin_max_count, sizeof(pf_hist_bin_t));
+
+  // Keep the table at most a quarter full so that probe sequences, and
+  // above all the misses of clustering, stay short
+  table_size = 1;
+  while (table_size < 4 * max_size)
+    table_size *= 2;
+  self->table_mask = table_size - 1;
+  self->table = malloc(table_size * sizeof(int));
+  memset(self->table, -1, table_size * sizeof(int));
+
+  self->cluster_count = 0;
+  self->parent = calloc(self->bin_max_count, sizeof(int));
+
+  return self;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Destroy a histogram
+void pf_hist_free(pf_hist_t *self)
+{
+  free(self->parent);
+  free(self->table);
+  free(self->bins);
+  free(self);
+  return;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Clear all entries from the histogram; only the used slots are reset
+void pf_hist_clear(pf_hist_t *self)
+{
+  int i;
+
+  for (i = 0; i < self->bin_count; i++)
+    self->table[self->bins[i].slot] = -1;
+  self->bin_count = 0;
+  self->cluster_count = 0;
+
+  return;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Add a pose to the histogram
+void pf_hist_insert(pf_hist_t *self, pf_vector_t pose, double value)
+{
+  int key[3];
+  int i, slot;
+  pf_hist_bin_t *bin;
+
+  pf_hist_key(self, pose, key);
+
+  i = pf_hist_find(self, key, &slot);
+  if (i >= 0)
+  {
+    self->bins[i].value += value;
+    return;
+  }
+
+  assert(self->bin_count < self->bin_max_count);
+  i = self->bin_count++;
+  bin = self->bins + i;
+  bin->key[0] = key[0];
+  bin->key[1] = key[1];
+  bin->key[2] = key[2];
+  bin->value = value;
+  bin->cluster = -1;
+  bin->slot = slot;
+  self->table[slot] = i;
+
+  return;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Determine the probability estimate for the given pose. TODO: this
+// should do a kernel density estimate rather than a simple histogram.
+double pf_hist_get_prob(pf_hist_t *self, pf_vector_t pose)
+{
+  int key[3];
+  int i, slot;
+
+  pf_hist_key(self, pose, key);
+
+  i = pf_hist_find(self, key, &slot);
+  if (i < 0)
+    return 0.0;
+  return self->bins[i].value;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Determine the cluster label for the given pose
+int pf_hist_get_cluster(pf_hist_t *self, pf_vector_t pose)
+{
+  int key[3];
+  int i, slot;
+
+  pf_hist_key(self, pose, key);
+
+  i = pf_hist_find(self, key, &slot);
+  if (i < 0)
+    return -1;
+  return self->bins[i].cluster;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Label the connected groups of occupied bins, where bins are connected
+// to the 26 bins around them.  Each bin is merged with the 13 neighbours
+// that precede it in key order, which visits every adjacent pair once,
+// using a union-find forest over the bin indices.
+int pf_hist_cluster(pf_hist_t *self)
+{
+  int i, j, n, root, slot;
+  int nkey[3];
+  int *parent;
+  pf_hist_bin_t *bin;
+
+  parent = self->parent;
+  for (i = 0; i < self->bin_count; i++)
+    parent[i] = i;
+
+  for (i = 0; i < self->bin_count; i++)
+  {
+    bin = self->bins + i;
+    for (j = 0; j < 13; j++)
+    {
+      nkey[0] = bin->key[0] + (j / 9) - 1;
+      nkey[1] = bin->key[1] + ((j % 9) / 3) - 1;
+      nkey[2] = bin->key[2] + ((j % 9) % 3) - 1;
+
+      n = pf_hist_find(self, nkey, &slot);
+      if (n < 0)
+        continue;
+
+      // Join the two trees, hanging the higher root under the lower one
+      root = pf_hist_root(parent, i);
+      n = pf_hist_root(parent, n);
+      if (n < root)
+        parent[root] = n;
+      else
+        parent[n] = root;
+    }
+  }
+
+  // Number the clusters in the order of their first bin
+  self->cluster_count = 0;
+  for (i = 0; i < self->bin_count; i++)
+  {
+    root = pf_hist_root(parent, i);
+    if (root == i)
+      self->bins[i].cluster = self->cluster_count++;
+    else
+      self->bins[i].cluster = self->bins[root].cluster;
+  }
+
+  return self->cluster_count;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Find the root of a bin in the union-find forest, halving the path
+int pf_hist_root(int *parent, int i)
+{
+  while (parent[i] != i)
+  {
+    parent[i] = parent[parent[i]];
+    i = parent[i];
+  }
+  return i;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Compute the key of the bin holding a pose
+void pf_hist_key(pf_hist_t *self, pf_vector_t pose, int key[])
+{
+  key[0] = floor(pose.v[0] / self->size[0]);
+  key[1] = floor(pose.v[1] / self->size[1]);
+  key[2] = floor(pose.v[2] / self->size[2]);
+  return;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Find the bin with the given key by linear probing
+int pf_hist_find(pf_hist_t *self, int key[], int *slot)
+{
+  unsigned int hash;
+  int i, s;
+  pf_hist_bin_t *bin;
+
+  hash = (unsigned int) key[0] * 73856093u ^
+         (unsigned int) key[1] * 19349663u ^
+         (unsigned int) key[2] * 83492791u;
+
+  for (s = hash & self->table_mask; ; s = (s + 1) & self->table_mask)
+  {
+    i = self->table[s];
+    if (i < 0)
+    {
+      *slot = s;
+      return -1;
+    }
+    bin = self->bins + i;
+    if (bin->key[0] == key[0] && bin->key[1] == key[1] && bin->key[2] == key[2])
+    {
+      *slot = s;
+      return i;
+    }
+  }
+}
+
+
+
+#ifdef INCLUDE_RTKGUI
+
+////////////////////////////////////////////////////////////////////////////////
+// Draw the histogram
+void pf_hist_draw(pf_hist_t *self, rtk_fig_t *fig)
+{
+  int i;
+  double ox, oy;
+  char text[64];
+  pf_hist_bin_t *bin;
+
+  for (i = 0; i < self->bin_count; i++)
+  {
+    bin = self->bins + i;
+
+    ox = (bin->key[0] + 0.5) * self->size[0];
+    oy = (bin->key[1] + 0.5) * self->size[1];
+
+    rtk_fig_rectangle(fig, ox, oy, 0.0, self->size[0], self->size[1], 0);
+
+    snprintf(text, sizeof(text), "%d", bin->cluster);
+    rtk_fig_text(fig, ox, oy, 0.0, text);
+  }
+
+  return;
+}
+
+#endif
@@ -0,0 +1,278 @@
+/**************************************************************************
+ * Desc: Resampling on a kd-tree, as the filter did before pf_hist
+ *
+ * This is pf_update_resample and pf_cluster_stats as they were before the
+ * low-variance draw and the hashed histogram, without selective
+ * resampling, for amcl_benchmark to compare against.
+ *************************************************************************/
+
+#include <assert.h>
+#include <float.h>
+#include <math.h>
+#include <stdlib.h>
+
+#include "amcl/pf/pf_resample_kdtree.h"
+#include "portable_utils.hpp"
+
+
+// Compute the required number of samples, given that there are k bins
+// with samples in them
+static int pf_resample_limit_kdtree(pf_t *pf, int k);
+
+// Re-compute the cluster statistics for a sample set
+static void pf_cluster_stats_kdtree(pf_sample_set_t *set, pf_kdtree_t *kdtree);
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Resample the distribution
+void pf_update_resample_kdtree(pf_t *pf, pf_kdtree_t *kdtree)
+{
+  int i;
+  double total;
+  pf_sample_set_t *set_a, *set_b;
+  pf_sample_t *sample_a, *sample_b;
+  double *c;
+  double w_diff;
+
+  set_a = pf->sets + pf->current_set;
+  set_b = pf->sets + (pf->current_set + 1) % 2;
+
+  // Build up cumulative probability table for resampling
+  c = (double*)malloc(sizeof(double)*(set_a->sample_count+1));
+  c[0] = 0.0;
+  for(i=0;i<set_a->sample_count;i++)
+    c[i+1] = c[i]+set_a->samples[i].weight;
+
+  // Create the kd tree for adaptive sampling
+  pf_kdtree_clear(kdtree);
+
+  // Draw samples from set a to create set b.
+  total = 0;
+  set_b->sample_count = 0;
+
+  w_diff = 1.0 - pf->w_fast / pf->w_slow;
+  if(w_diff < 0.0)
+    w_diff = 0.0;
+
+  while(set_b->sample_count < pf->max_samples)
+  {
+    sample_b = set_b->samples + set_b->sample_count++;
+
+    if(drand48() < w_diff)
+      sample_b->pose = (pf->random_pose_fn)(pf->random_pose_data);
+    else
+    {
+      // Naive discrete event sampler
+      double r;
+      r = drand48();
+      for(i=0;i<set_a->sample_count;i++)
+      {
+        if((c[i] <= r) && (r < c[i+1]))
+          break;
+      }
+      assert(i<set_a->sample_count);
+
+      sample_a = set_a->samples + i;
+
+      assert(sample_a->weight > 0);
+
+      // Add sample to list
+      sample_b->pose = sample_a->pose;
+    }
+
+    sample_b->weight = 1.0;
+    total += sample_b->weight;
+
+    // Add sample to histogram
+    pf_kdtree_insert(kdtree, sample_b->pose, sample_b->weight);
+
+    // See if we have enough samples yet
+    if (set_b->sample_count > pf_resample_limit_kdtree(pf, kdtree->leaf_count))
+      break;
+  }
+
+  // Reset averages, to avoid spiraling off into complete randomness.
+  if(w_diff > 0.0)
+    pf->w_slow = pf->w_fast = 0.0;
+
+  // Normalize weights
+  for (i = 0; i < set_b->sample_count; i++)
+  {
+    sample_b = set_b->samples + i;
+    sample_b->weight /= total;
+  }
+
+  // Re-compute cluster statistics
+  pf_cluster_stats_kdtree(set_b, kdtree);
+
+  // Use the newly created sample set
+  pf->current_set = (pf->current_set + 1) % 2;
+
+  pf_update_converged(pf);
+
+  free(c);
+  return;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Compute the required number of samples, given that there are k bins
+// with samples in them.  This is taken directly from Fox et al.
+int pf_resample_limit_kdtree(pf_t *pf, int k)
+{
+  double a, b, c, x;
+  int n;
+
+  if (k < 1 || k > pf->max_samples)
+      return pf->max_samples;
+
+  // The cache is shared with pf_update_resample, which computes the same
+  // limits
+  if (pf->limit_cache[k-1] > 0)
+    return pf->limit_cache[k-1];
+
+  if (k == 1)
+  {
+    pf->limit_cache[k-1] = pf->max_samples;
+    return pf->max_samples;
+  }
+
+  a = 1;
+  b = 2 / (9 * ((double) k - 1));
+  c = sqrt(2 / (9 * ((double) k - 1))) * pf->pop_z;
+  x = a - b + c;
+
+  n = (int) ceil((k - 1) / (2 * pf->pop_err) * x * x * x);
+
+  if (n < pf->min_samples)
+    n = pf->min_samples;
+  if (n > pf->max_samples)
+    n = pf->max_samples;
+  pf->limit_cache[k-1] = n;
+  return n;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Re-compute the cluster statistics for a sample set
+void pf_cluster_stats_kdtree(pf_sample_set_t *set, pf_kdtree_t *kdtree)
+{
+  int i, j, k, cidx;
+  pf_sample_t *sample;
+  pf_cluster_t *cluster;
+
+  // Workspace
+  double m[4], c[2][2];
+  double weight;
+
+  // Cluster the samples
+  pf_kdtree_cluster(kdtree);
+
+  // Initialize cluster stats
+  set->cluster_count = 0;
+
+  for (i = 0; i < set->cluster_max_count; i++)
+  {
+    cluster = set->clusters + i;
+    cluster->count = 0;
+    cluster->weight = 0;
+    cluster->mean = pf_vector_zero();
+    cluster->cov = pf_matrix_zero();
+
+    for (j = 0; j < 4; j++)
+      cluster->m[j] = 0.0;
+    for (j = 0; j < 2; j++)
+      for (k = 0; k < 2; k++)
+        cluster->c[j][k] = 0.0;
+  }
+
+  // Initialize overall filter stats
+  weight = 0.0;
+  set->mean = pf_vector_zero();
+  set->cov = pf_matrix_zero();
+  for (j = 0; j < 4; j++)
+    m[j] = 0.0;
+  for (j = 0; j < 2; j++)
+    for (k = 0; k < 2; k++)
+      c[j][k] = 0.0;
+
+  // Compute cluster stats
+  for (i = 0; i < set->sample_count; i++)
+  {
+    sample = set->samples + i;
+
+    // Get the cluster label for this sample
+    cidx = pf_kdtree_get_cluster(kdtree, sample->pose);
+    assert(cidx >= 0);
+    if (cidx >= set->cluster_max_count)
+      continue;
+    if (cidx + 1 > set->cluster_count)
+      set->cluster_count = cidx + 1;
+
+    cluster = set->clusters + cidx;
+
+    cluster->count += 1;
+    cluster->weight += sample->weight;
+
+    weight += sample->weight;
+
+    // Compute mean
+    cluster->m[0] += sample->weight * sample->pose.v[0];
+    cluster->m[1] += sample->weight * sample->pose.v[1];
+    cluster->m[2] += sample->weight * cos(sample->pose.v[2]);
+    cluster->m[3] += sample->weight * sin(sample->pose.v[2]);
+
+    m[0] += sample->weight * sample->pose.v[0];
+    m[1] += sample->weight * sample->pose.v[1];
+    m[2] += sample->weight * cos(sample->pose.v[2]);
+    m[3] += sample->weight * sin(sample->pose.v[2]);
+
+    // Compute covariance in linear components
+    for (j = 0; j < 2; j++)
+      for (k = 0; k < 2; k++)
+      {
+        cluster->c[j][k] += sample->weight * sample->pose.v[j] * sample->pose.v[k];
+        c[j][k] += sample->weight * sample->pose.v[j] * sample->pose.v[k];
+      }
+  }
+
+  // Normalize
+  for (i = 0; i < set->cluster_count; i++)
+  {
+    cluster = set->clusters + i;
+
+    cluster->mean.v[0] = cluster->m[0] / cluster->weight;
+    cluster->mean.v[1] = cluster->m[1] / cluster->weight;
+    cluster->mean.v[2] = atan2(cluster->m[3], cluster->m[2]);
+
+    cluster->cov = pf_matrix_zero();
+
+    // Covariance in linear components
+    for (j = 0; j < 2; j++)
+      for (k = 0; k < 2; k++)
+        cluster->cov.m[j][k] = cluster->c[j][k] / cluster->weight -
+          cluster->mean.v[j] * cluster->mean.v[k];
+
+    // Covariance in angular components
+    cluster->cov.m[2][2] = -2 * log(sqrt(cluster->m[2] * cluster->m[2] +
+                                         cluster->m[3] * cluster->m[3]) / cluster->weight);
+  }
+
+  if (fabs(weight) < DBL_EPSILON)
+    return;
+
+  // Compute overall filter stats
+  set->mean.v[0] = m[0] / weight;
+  set->mean.v[1] = m[1] / weight;
+  set->mean.v[2] = atan2(m[3], m[2]);
+
+  // Covariance in linear components
+  for (j = 0; j < 2; j++)
+    for (k = 0; k < 2; k++)
+      set->cov.m[j][k] = c[j][k] / weight - set->mean.v[j] * set->mean.v[k];
+
+  // Covariance in angular components
+  set->cov.m[2][2] = -2 * log(sqrt(m[2] * m[2] + m[3] * m[3]));
+
+  return;
+}
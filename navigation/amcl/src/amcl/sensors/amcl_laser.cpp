@@ -35,32 +35,75 @@
 #include <unistd.h>
 #endif
 
+#include <algorithm>
+#include <chrono>
+
 #include "amcl/sensors/amcl_laser.h"
 
 using namespace amcl;
 
+////////////////////////////////////////////////////////////////////////////////
+// Size the range buffer, reallocating only when it grows
+void AMCLLaserData::SetRangeCount(int range_count)
+{
+  if (range_count > this->range_capacity)
+  {
+    delete [] this->ranges;
+    this->ranges = new double[range_count][2];
+    this->range_capacity = range_count;
+  }
+  this->range_count = range_count;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // Default constructor
-AMCLLaser::AMCLLaser(size_t max_beams, map_t* map) : AMCLSensor(), 
-						     max_samples(0), max_obs(0), 
-						     temp_obs(NULL)
+AMCLLaser::AMCLLaser(size_t max_beams, map_t* map) : AMCLSensor(),
+						     pool(new AMCLThreadPool(1)),
+						     use_table(false),
+						     table_range_max(0.0)
 {
   this->time = 0.0;
 
   this->max_beams = max_beams;
+  this->adaptive_beams = 0;
+  this->time_budget = 0.0;
+  this->beam_cost = 0.0;
+  this->beam_target = max_beams;
+  this->select_beams = false;
   this->map = map;
+  this->do_beamskip = false;
+  this->beam_skip_distance = 0.0;
 
   return;
 }
 
 AMCLLaser::~AMCLLaser()
 {
-  if(temp_obs){
-	for(int k=0; k < max_samples; k++){
-	  delete [] temp_obs[k];
-	}
-	delete []temp_obs; 
-  }
+}
+
+void
+AMCLLaser::SetModelLookupTable(bool use_table)
+{
+  this->use_table = use_table;
+}
+
+void
+AMCLLaser::SetThreadCount(int threads)
+{
+  this->pool.reset(new AMCLThreadPool(threads));
+}
+
+void
+AMCLLaser::SetAdaptiveBeams(int adaptive_beams)
+{
+  this->adaptive_beams = adaptive_beams;
+}
+
+void
+AMCLLaser::SetTimeBudget(double time_budget)
+{
+  this->time_budget = time_budget;
+  this->beam_cost = 0.0;
 }
 
 void 
@@ -93,7 +136,8 @@ AMCLLaser::SetModelLikelihoodField(double z_hit,
   this->z_rand = z_rand;
   this->sigma_hit = sigma_hit;
 
-  map_update_cspace(this->map, max_occ_dist);
+  this->UpdateCspace(max_occ_dist);
+  this->table.clear();
 }
 
 void 
@@ -114,10 +158,22 @@ AMCLLaser::SetModelLikelihoodFieldProb(double z_hit,
   this->beam_skip_distance = beam_skip_distance;
   this->beam_skip_threshold = beam_skip_threshold;
   this->beam_skip_error_threshold = beam_skip_error_threshold;
-  map_update_cspace(this->map, max_occ_dist);
+  this->UpdateCspace(max_occ_dist);
+  this->table.clear();
 }
 
 
+////////////////////////////////////////////////////////////////////////////////
+// Compute the map's cspace distances unless it already holds them for
+// max_occ_dist, from an earlier model or the cspace cache
+void
+AMCLLaser::UpdateCspace(double max_occ_dist)
+{
+  if (this->map->occ_dist_field && this->map->max_occ_dist == max_occ_dist)
+    return;
+  map_update_cspace(this->map, max_occ_dist);
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // Apply the laser sensor model
 bool AMCLLaser::UpdateSensor(pf_t *pf, AMCLSensorData *data)
@@ -125,6 +181,13 @@ bool AMCLLaser::UpdateSensor(pf_t *pf, AMCLSensorData *data)
   if (this->max_beams < 2)
     return false;
 
+  pf_sample_set_t *set = pf->sets + pf->current_set;
+  this->select_beams = this->adaptive_beams > 0 &&
+                       this->model_type != LASER_MODEL_BEAM &&
+                       this->SelectionPose(set);
+  this->beam_target = this->BeamTarget(set);
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
   // Apply the laser sensor model
   if(this->model_type == LASER_MODEL_BEAM)
     pf_update_sensor(pf, (pf_sensor_model_fn_t) BeamModel, data);
@@ -135,6 +198,19 @@ bool AMCLLaser::UpdateSensor(pf_t *pf, AMCLSensorData *data)
   else
     pf_update_sensor(pf, (pf_sensor_model_fn_t) BeamModel, data);
 
+  // Track the cost of a beam for the time budget, smoothed over a few
+  // updates so that one slow scan does not halve the next
+  if (this->time_budget > 0.0 && this->model_type != LASER_MODEL_BEAM &&
+      !this->beam_x.empty())
+  {
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    double cost = elapsed / ((double) set->sample_count * this->beam_x.size());
+    if (this->beam_cost > 0.0)
+      this->beam_cost = 0.7 * this->beam_cost + 0.3 * cost;
+    else
+      this->beam_cost = cost;
+  }
+
   return true;
 }
 
@@ -212,92 +288,351 @@ double AMCLLaser::BeamModel(AMCLLaserData *data, pf_sample_set_t* set)
   return(total_weight);
 }
 
-double AMCLLaser::LikelihoodFieldModel(AMCLLaserData *data, pf_sample_set_t* set)
+////////////////////////////////////////////////////////////////////////////////
+// The likelihood field models evaluate the samples in chunks, one per thread.
+// The beam endpoints are tabulated once per scan in the laser frame, so a
+// sample costs one rotation per beam and a lookup in the compact distance
+// field instead of a cos/sin pair and a map_cell_t load.
+
+// Fewer samples than this are not worth waking a thread for
+static const int min_chunk_samples = 32;
+
+// The time budget never cuts an update below this many beams
+static const int min_budget_beams = 16;
+
+// Number of bins the adaptive selection sorts the constraint directions
+// into, over 180 degrees
+static const int direction_bin_count = 12;
+
+// The adaptive selection is only used while the samples are within this
+// standard deviation in x and y, in meters, of their mean
+static const double max_selection_spread = 0.5;
+
+int AMCLLaser::BeamTarget(pf_sample_set_t *set) const
 {
-  AMCLLaser *self;
-  int i, j, step;
-  double z, pz;
-  double p;
-  double obs_range, obs_bearing;
-  double total_weight;
-  pf_sample_t *sample;
-  pf_vector_t pose;
-  pf_vector_t hit;
+  int target = this->max_beams;
+  if (this->select_beams)
+    target = this->adaptive_beams;
 
-  self = (AMCLLaser*) data->sensor;
+  if (this->time_budget > 0.0 && this->beam_cost > 0.0 &&
+      this->model_type != LASER_MODEL_BEAM)
+  {
+    double affordable = this->time_budget / (this->beam_cost * set->sample_count);
+    if (affordable < target)
+      target = std::max((int) affordable, std::min(target, min_budget_beams));
+  }
+  return std::max(target, 2);
+}
 
-  total_weight = 0.0;
+int AMCLLaser::SetupBeams(AMCLLaserData *data, int step)
+{
+  double inv_scale = 1.0 / this->map->scale;
 
-  // Compute the sample weights
-  for (j = 0; j < set->sample_count; j++)
+  if (this->select_beams && this->SelectBeams(data) > 0)
+    return this->beam_x.size();
+
+  this->beam_x.clear();
+  this->beam_y.clear();
+  for (int i = 0; i < data->range_count; i += step)
   {
-    sample = set->samples + j;
-    pose = sample->pose;
+    double obs_range = data->ranges[i][0];
+    double obs_bearing = data->ranges[i][1];
 
-    // Take account of the laser pose relative to the robot
-    pose = pf_vector_coord_add(self->laser_pose, pose);
+    // This model ignores max range readings
+    if(obs_range >= data->range_max)
+      continue;
 
-    p = 1.0;
+    // Check for NaN
+    if(obs_range != obs_range)
+      continue;
+
+    this->beam_x.push_back(obs_range * cos(obs_bearing) * inv_scale);
+    this->beam_y.push_back(obs_range * sin(obs_bearing) * inv_scale);
+  }
+  return this->beam_x.size();
+}
 
-    // Pre-compute a couple of things
-    double z_hit_denom = 2 * self->sigma_hit * self->sigma_hit;
-    double z_rand_mult = 1.0/data->range_max;
+////////////////////////////////////////////////////////////////////////////////
+// The adaptive selection projects the scan from the mean pose and keeps the
+// beams that end near structure on mapped cells.  A beam ending near a wall
+// only says where the wall is along the wall's normal, so the candidates are
+// binned by the gradient direction of the distance field at their endpoints
+// and the beams are shared out over the directions as evenly as they allow:
+// a long corridor wall gives a handful of beams, not hundreds, and the door
+// frames and corners that fix the pose along the corridor are always kept.
+// Within a direction the beams are spread evenly over the scan.
+bool AMCLLaser::SelectionPose(pf_sample_set_t *set)
+{
+  // Mean pose of the samples; set->mean is only updated when resampling,
+  // so it would lag behind the odometry
+  double mx = 0.0, my = 0.0, mxx = 0.0, myy = 0.0, mc = 0.0, ms = 0.0;
+  double total = 0.0;
+  for (int j = 0; j < set->sample_count; j++)
+  {
+    pf_sample_t *sample = set->samples + j;
+    mx += sample->weight * sample->pose.v[0];
+    my += sample->weight * sample->pose.v[1];
+    mxx += sample->weight * sample->pose.v[0] * sample->pose.v[0];
+    myy += sample->weight * sample->pose.v[1] * sample->pose.v[1];
+    mc += sample->weight * cos(sample->pose.v[2]);
+    ms += sample->weight * sin(sample->pose.v[2]);
+    total += sample->weight;
+  }
+  if (total <= 0.0)
+    return false;
 
-    step = (data->range_count - 1) / (self->max_beams - 1);
+  pf_vector_t mean = pf_vector_zero();
+  mean.v[0] = mx / total;
+  mean.v[1] = my / total;
+  mean.v[2] = atan2(ms, mc);
+  this->selection_pose = pf_vector_coord_add(this->laser_pose, mean);
 
-    // Step size must be at least 1
-    if(step < 1)
-      step = 1;
+  double var_x = mxx / total - mean.v[0] * mean.v[0];
+  double var_y = myy / total - mean.v[1] * mean.v[1];
+  double max_var = max_selection_spread * max_selection_spread;
+  return var_x < max_var && var_y < max_var;
+}
 
-    for (i = 0; i < data->range_count; i += step)
+int AMCLLaser::SelectBeams(AMCLLaserData *data)
+{
+  const map_t *map = this->map;
+  const float *field = map->occ_dist_field;
+  double inv_scale = 1.0 / map->scale;
+  const pf_vector_t& pose = this->selection_pose;
+
+  // Collect the candidates with their direction bins; the last bin holds
+  // the endpoints where the field is flat or on the edge of the map
+  int bin_count[direction_bin_count + 1] = {0};
+  int valid_count = 0;
+  this->candidates.clear();
+  this->candidate_bin.clear();
+  for (int i = 0; i < data->range_count; i++)
+  {
+    double obs_range = data->ranges[i][0];
+    double obs_bearing = data->ranges[i][1];
+
+    // Max range and NaN readings are never used
+    if(obs_range >= data->range_max || obs_range != obs_range)
+      continue;
+    valid_count++;
+
+    double a = pose.v[2] + obs_bearing;
+    int gi = MAP_GXWX(map, pose.v[0] + obs_range * cos(a));
+    int gj = MAP_GYWY(map, pose.v[1] + obs_range * sin(a));
+    if (!MAP_VALID(map, gi, gj))
+      continue;
+    int k = MAP_INDEX(map, gi, gj);
+    if (map->cells[k].occ_state == 0 || field[k] >= map->max_occ_dist)
+      continue;
+
+    int bin = direction_bin_count;
+    if (gi > 0 && gi < map->size_x - 1 && gj > 0 && gj < map->size_y - 1)
     {
-      obs_range = data->ranges[i][0];
-      obs_bearing = data->ranges[i][1];
+      double dx = field[k + 1] - field[k - 1];
+      double dy = field[k + map->size_x] - field[k - map->size_x];
+      if (dx != 0.0 || dy != 0.0)
+      {
+        double dir = atan2(dy, dx);
+        if (dir < 0.0)
+          dir += M_PI;
+        bin = std::min((int) (dir / M_PI * direction_bin_count), direction_bin_count - 1);
+      }
+    }
+    this->candidates.push_back(i);
+    this->candidate_bin.push_back(bin);
+    bin_count[bin]++;
+  }
 
-      // This model ignores max range readings
-      if(obs_range >= data->range_max)
-        continue;
+  // If most of the scan does not fit the map around the mean, either the
+  // mean is off or the map is; leave it to the evenly spaced beams
+  int candidate_count = this->candidates.size();
+  if (candidate_count == 0 || candidate_count < valid_count / 2)
+    return 0;
 
-      // Check for NaN
-      if(obs_range != obs_range)
-        continue;
+  // Share the beams out over the bins, filling the sparse ones first
+  int quota[direction_bin_count + 1] = {0};
+  int left = std::min(this->beam_target, candidate_count);
+  while (left > 0)
+  {
+    int open = 0;
+    for (int b = 0; b <= direction_bin_count; b++)
+      open += quota[b] < bin_count[b];
+    int share = std::max(left / open, 1);
+    for (int b = 0; b <= direction_bin_count && left > 0; b++)
+    {
+      int add = std::min(std::min(share, bin_count[b] - quota[b]), left);
+      quota[b] += add;
+      left -= add;
+    }
+  }
 
-      pz = 0.0;
+  // Take every (bin_count / quota)-th candidate of each bin
+  int seen[direction_bin_count + 1] = {0};
+  this->beam_x.clear();
+  this->beam_y.clear();
+  for (int m = 0; m < candidate_count; m++)
+  {
+    int b = this->candidate_bin[m];
+    int r = seen[b]++;
+    if ((r + 1) * quota[b] / bin_count[b] == r * quota[b] / bin_count[b])
+      continue;
+
+    double obs_range = data->ranges[this->candidates[m]][0];
+    double obs_bearing = data->ranges[this->candidates[m]][1];
+    this->beam_x.push_back(obs_range * cos(obs_bearing) * inv_scale);
+    this->beam_y.push_back(obs_range * sin(obs_bearing) * inv_scale);
+  }
+  return this->beam_x.size();
+}
 
-      // Compute the endpoint of the beam
-      hit.v[0] = pose.v[0] + obs_range * cos(pose.v[2] + obs_bearing);
-      hit.v[1] = pose.v[1] + obs_range * sin(pose.v[2] + obs_bearing);
-
-      // Convert to map grid coords.
-      int mi, mj;
-      mi = MAP_GXWX(self->map, hit.v[0]);
-      mj = MAP_GYWY(self->map, hit.v[1]);
-      
-      // Part 1: Get distance from the hit to closest obstacle.
-      // Off-map penalized as max distance
-      if(!MAP_VALID(self->map, mi, mj))
-        z = self->map->max_occ_dist;
-      else
-        z = self->map->cells[MAP_INDEX(self->map,mi,mj)].occ_dist;
-      // Gaussian model
-      // NOTE: this should have a normalization of 1/(sqrt(2pi)*sigma)
-      pz += self->z_hit * exp(-(z * z) / z_hit_denom);
-      // Part 2: random measurements
-      pz += self->z_rand * z_rand_mult;
+int AMCLLaser::SetupChunks(int sample_count, int beam_count)
+{
+  int chunks = std::min(this->pool->Size(), sample_count / min_chunk_samples);
+  if (chunks < 1)
+    chunks = 1;
 
-      // TODO: outlier rejection for short readings
+  this->cell_index.resize(chunks * beam_count);
+  this->chunk_weight.assign(chunks, 0.0);
+  return chunks;
+}
 
-      assert(pz <= 1.0);
-      assert(pz >= 0.0);
-      //      p *= pz;
-      // here we have an ad-hoc weighting scheme for combining beam probs
-      // works well, though...
-      p += pz*pz*pz;
-    }
+void AMCLLaser::SetupTable(double range_max)
+{
+  if (!this->table.empty() && this->table_range_max == range_max)
+    return;
 
-    sample->weight *= p;
-    total_weight += sample->weight;
+  double z_hit_denom = 2 * this->sigma_hit * this->sigma_hit;
+  double z_rand_mult = 1.0/range_max;
+
+  this->table.resize(this->map->occ_dist_code_count);
+  this->table_agrees.resize(this->map->occ_dist_code_count);
+  for (int code = 0; code < this->map->occ_dist_code_count; code++)
+  {
+    double z = map_occ_dist_decode(this->map, code);
+    double pz = this->z_hit * exp(-(z * z) / z_hit_denom) + this->z_rand * z_rand_mult;
+    if (this->model_type == LASER_MODEL_LIKELIHOOD_FIELD_PROB)
+      this->table[code] = log(pz);
+    else
+      this->table[code] = pz*pz*pz;
+    this->table_agrees[code] = z < this->beam_skip_distance;
   }
+  this->table_range_max = range_max;
+}
+
+void AMCLLaser::CellIndices(const pf_vector_t& pose, int beam_count, int *cells) const
+{
+  const map_t *map = this->map;
+  const double *beam_x = this->beam_x.data();
+  const double *beam_y = this->beam_y.data();
+
+  // Laser origin in map cells, offset by half a cell so that truncating a
+  // non-negative coordinate rounds it like MAP_GXWX does
+  double ox = (pose.v[0] - map->origin_x) / map->scale + 0.5 + map->size_x / 2;
+  double oy = (pose.v[1] - map->origin_y) / map->scale + 0.5 + map->size_y / 2;
+  double c = cos(pose.v[2]);
+  double s = sin(pose.v[2]);
+
+  double size_x = map->size_x;
+  double size_y = map->size_y;
+  int stride = map->size_x;
+  int off_map = map->size_x * map->size_y;
+
+  // Branch free so that it vectorizes; coordinates are clamped before the
+  // conversion to stay in int range
+  for (int i = 0; i < beam_count; i++)
+  {
+    double gx = ox + c * beam_x[i] - s * beam_y[i];
+    double gy = oy + s * beam_x[i] + c * beam_y[i];
+    bool valid = (gx >= 0.0) & (gx < size_x) & (gy >= 0.0) & (gy < size_y);
+    gx = std::min(std::max(gx, 0.0), size_x);
+    gy = std::min(std::max(gy, 0.0), size_y);
+    int cell = (int) gx + (int) gy * stride;
+    cells[i] = valid ? cell : off_map;
+  }
+}
+
+double AMCLLaser::LikelihoodFieldModel(AMCLLaserData *data, pf_sample_set_t* set)
+{
+  AMCLLaser *self;
+  int step;
+  double total_weight;
+
+  self = (AMCLLaser*) data->sensor;
+
+  // Pre-compute a couple of things
+  double z_hit_denom = 2 * self->sigma_hit * self->sigma_hit;
+  double z_rand_mult = 1.0/data->range_max;
+
+  step = (data->range_count - 1) / (self->beam_target - 1);
+
+  // Step size must be at least 1
+  if(step < 1)
+    step = 1;
+
+  int beam_count = self->SetupBeams(data, step);
+  int chunks = self->SetupChunks(set->sample_count, beam_count);
+  const float *field = self->map->occ_dist_field;
+  const unsigned short *codes = self->map->occ_dist_code;
+  bool use_table = self->use_table && codes;
+  if (use_table)
+    self->SetupTable(data->range_max);
+  const double *table = self->table.data();
+
+  // Compute the sample weights
+  self->pool->Run(chunks, [&](int chunk)
+  {
+    int begin = (long) set->sample_count * chunk / chunks;
+    int end = (long) set->sample_count * (chunk + 1) / chunks;
+    int *cells = self->cell_index.data() + chunk * beam_count;
+    double weight = 0.0;
+
+    for (int j = begin; j < end; j++)
+    {
+      pf_sample_t *sample = set->samples + j;
+
+      // Take account of the laser pose relative to the robot
+      pf_vector_t pose = pf_vector_coord_add(self->laser_pose, sample->pose);
+
+      self->CellIndices(pose, beam_count, cells);
+
+      double p = 1.0;
+      if (use_table)
+      {
+        for (int i = 0; i < beam_count; i++)
+          p += table[codes[cells[i]]];
+        sample->weight *= p;
+        weight += sample->weight;
+        continue;
+      }
+
+      for (int i = 0; i < beam_count; i++)
+      {
+        // Part 1: distance from the hit to closest obstacle; off-map
+        // points read max_occ_dist from the last entry of the field
+        double z = field[cells[i]];
+        // Gaussian model
+        // NOTE: this should have a normalization of 1/(sqrt(2pi)*sigma)
+        double pz = self->z_hit * exp(-(z * z) / z_hit_denom);
+        // Part 2: random measurements
+        pz += self->z_rand * z_rand_mult;
+
+        // TODO: outlier rejection for short readings
+
+        //      p *= pz;
+        // here we have an ad-hoc weighting scheme for combining beam probs
+        // works well, though...
+        p += pz*pz*pz;
+      }
+
+      sample->weight *= p;
+      weight += sample->weight;
+    }
+    self->chunk_weight[chunk] = weight;
+  });
+
+  total_weight = 0.0;
+  for (int chunk = 0; chunk < chunks; chunk++)
+    total_weight += self->chunk_weight[chunk];
 
   return(total_weight);
 }
@@ -305,21 +640,13 @@ double AMCLLaser::LikelihoodFieldModel(AMCLLaserData *data, pf_sample_set_t* set
 double AMCLLaser::LikelihoodFieldModelProb(AMCLLaserData *data, pf_sample_set_t* set)
 {
   AMCLLaser *self;
-  int i, j, step;
-  double z, pz;
-  double log_p;
-  double obs_range, obs_bearing;
+  int step;
   double total_weight;
-  pf_sample_t *sample;
-  pf_vector_t pose;
-  pf_vector_t hit;
 
   self = (AMCLLaser*) data->sensor;
 
-  total_weight = 0.0;
+  step = ceil((data->range_count) / static_cast<double>(self->beam_target));
 
-  step = ceil((data->range_count) / static_cast<double>(self->max_beams)); 
-  
   // Step size must be at least 1
   if(step < 1)
     step = 1;
@@ -328,183 +655,162 @@ double AMCLLaser::LikelihoodFieldModelProb(AMCLLaserData *data, pf_sample_set_t*
   double z_hit_denom = 2 * self->sigma_hit * self->sigma_hit;
   double z_rand_mult = 1.0/data->range_max;
 
-  double max_dist_prob = exp(-(self->map->max_occ_dist * self->map->max_occ_dist) / z_hit_denom);
-
   //Beam skipping - ignores beams for which a majority of particles do not agree with the map
-  //prevents correct particles from getting down weighted because of unexpected obstacles 
-  //such as humans 
+  //prevents correct particles from getting down weighted because of unexpected obstacles
+  //such as humans
 
   bool do_beamskip = self->do_beamskip;
   double beam_skip_distance = self->beam_skip_distance;
   double beam_skip_threshold = self->beam_skip_threshold;
-  
-  //we only do beam skipping if the filter has converged 
+
+  //we only do beam skipping if the filter has converged
   if(do_beamskip && !set->converged){
     do_beamskip = false;
   }
 
-  //we need a count the no of particles for which the beam agreed with the map 
-  int *obs_count = new int[self->max_beams]();
-
-  //we also need a mask of which observations to integrate (to decide which beams to integrate to all particles) 
-  bool *obs_mask = new bool[self->max_beams]();
-  
-  int beam_ind = 0;
-  
-  //realloc indicates if we need to reallocate the temp data structure needed to do beamskipping 
-  bool realloc = false; 
+  int beam_count = self->SetupBeams(data, step);
+  int chunks = self->SetupChunks(set->sample_count, beam_count);
+  const float *field = self->map->occ_dist_field;
+  const unsigned short *codes = self->map->occ_dist_code;
+  const int off_map = self->map->size_x * self->map->size_y;
+  bool use_table = self->use_table && codes;
+  if (use_table)
+    self->SetupTable(data->range_max);
+  const double *table = self->table.data();
+  const char *agrees = self->table_agrees.data();
 
   if(do_beamskip){
-    if(self->max_obs < self->max_beams){
-      realloc = true;
-    }
-
-    if(self->max_samples < set->sample_count){
-      realloc = true;
-    }
-
-    if(realloc){
-      self->reallocTempData(set->sample_count, self->max_beams);     
-      fprintf(stderr, "Reallocing temp weights %d - %d\n", self->max_samples, self->max_obs);
-    }
+    //log observations are kept until we know which beams to integrate, along with a
+    //count per chunk of the particles for which each beam agreed with the map
+    self->temp_obs.resize(set->sample_count * beam_count);
+    self->obs_count.assign(chunks * beam_count, 0);
   }
 
   // Compute the sample weights
-  for (j = 0; j < set->sample_count; j++)
+  self->pool->Run(chunks, [&](int chunk)
   {
-    sample = set->samples + j;
-    pose = sample->pose;
-
-    // Take account of the laser pose relative to the robot
-    pose = pf_vector_coord_add(self->laser_pose, pose);
+    int begin = (long) set->sample_count * chunk / chunks;
+    int end = (long) set->sample_count * (chunk + 1) / chunks;
+    int *cells = self->cell_index.data() + chunk * beam_count;
+    int *obs_count = do_beamskip ? self->obs_count.data() + chunk * beam_count : NULL;
+    double weight = 0.0;
 
-    log_p = 0;
-    
-    beam_ind = 0;
-    
-    for (i = 0; i < data->range_count; i += step, beam_ind++)
+    for (int j = begin; j < end; j++)
     {
-      obs_range = data->ranges[i][0];
-      obs_bearing = data->ranges[i][1];
-
-      // This model ignores max range readings
-      if(obs_range >= data->range_max){
+      pf_sample_t *sample = set->samples + j;
+
+      // Take account of the laser pose relative to the robot
+      pf_vector_t pose = pf_vector_coord_add(self->laser_pose, sample->pose);
+
+      self->CellIndices(pose, beam_count, cells);
+
+      if(do_beamskip){
+        double *obs = self->temp_obs.data() + (long) j * beam_count;
+        if (use_table)
+        {
+          for (int i = 0; i < beam_count; i++)
+          {
+            int code = codes[cells[i]];
+            obs_count[i] += (cells[i] != off_map) & agrees[code];
+            obs[i] = table[code];
+          }
+          continue;
+        }
+        for (int i = 0; i < beam_count; i++)
+        {
+          // Off-map points read max_occ_dist and never agree with the map
+          double z = field[cells[i]];
+          obs_count[i] += (cells[i] != off_map) & (z < beam_skip_distance);
+          obs[i] = log(self->z_hit * exp(-(z * z) / z_hit_denom) + self->z_rand * z_rand_mult);
+        }
         continue;
       }
 
-      // Check for NaN
-      if(obs_range != obs_range){
+      double log_p = 0;
+      if (use_table)
+      {
+        for (int i = 0; i < beam_count; i++)
+          log_p += table[codes[cells[i]]];
+        sample->weight *= exp(log_p);
+        weight += sample->weight;
         continue;
       }
 
-      pz = 0.0;
+      for (int i = 0; i < beam_count; i++)
+      {
+        double z = field[cells[i]];
+        // Gaussian model
+        // NOTE: this should have a normalization of 1/(sqrt(2pi)*sigma)
+        double pz = self->z_hit * exp(-(z * z) / z_hit_denom);
+        // Part 2: random measurements
+        pz += self->z_rand * z_rand_mult;
 
-      // Compute the endpoint of the beam
-      hit.v[0] = pose.v[0] + obs_range * cos(pose.v[2] + obs_bearing);
-      hit.v[1] = pose.v[1] + obs_range * sin(pose.v[2] + obs_bearing);
-
-      // Convert to map grid coords.
-      int mi, mj;
-      mi = MAP_GXWX(self->map, hit.v[0]);
-      mj = MAP_GYWY(self->map, hit.v[1]);
-      
-      // Part 1: Get distance from the hit to closest obstacle.
-      // Off-map penalized as max distance
-      
-      if(!MAP_VALID(self->map, mi, mj)){
-	pz += self->z_hit * max_dist_prob;
-      }
-      else{
-	z = self->map->cells[MAP_INDEX(self->map,mi,mj)].occ_dist;
-	if(z < beam_skip_distance){
-	  obs_count[beam_ind] += 1;
-	}
-	pz += self->z_hit * exp(-(z * z) / z_hit_denom);
-      }
-       
-      // Gaussian model
-      // NOTE: this should have a normalization of 1/(sqrt(2pi)*sigma)
-      
-      // Part 2: random measurements
-      pz += self->z_rand * z_rand_mult;
-
-      assert(pz <= 1.0); 
-      assert(pz >= 0.0);
+        // TODO: outlier rejection for short readings
 
-      // TODO: outlier rejection for short readings
-            
-      if(!do_beamskip){
-	log_p += log(pz);
-      }
-      else{
-	self->temp_obs[j][beam_ind] = pz; 
+        log_p += log(pz);
       }
-    }
-    if(!do_beamskip){
+
       sample->weight *= exp(log_p);
-      total_weight += sample->weight;
+      weight += sample->weight;
     }
-  }
-  
+    self->chunk_weight[chunk] = weight;
+  });
+
   if(do_beamskip){
-    int skipped_beam_count = 0; 
-    for (beam_ind = 0; beam_ind < self->max_beams; beam_ind++){
-      if((obs_count[beam_ind] / static_cast<double>(set->sample_count)) > beam_skip_threshold){
-	obs_mask[beam_ind] = true;
-      }
-      else{
-	obs_mask[beam_ind] = false;
-	skipped_beam_count++; 
-      }
+    //a mask of which observations to integrate to all particles
+    std::vector<char> obs_mask(beam_count);
+    int integrated_beam_count = 0;
+    for (int i = 0; i < beam_count; i++){
+      int count = 0;
+      for (int chunk = 0; chunk < chunks; chunk++)
+        count += self->obs_count[chunk * beam_count + i];
+      obs_mask[i] = (count / static_cast<double>(set->sample_count)) > beam_skip_threshold;
+      integrated_beam_count += obs_mask[i];
     }
 
-    //we check if there is at least a critical number of beams that agreed with the map 
+    //max range and NaN readings count as skipped, as do beams beyond the end of a
+    //short scan
+    int skipped_beam_count = self->beam_target - integrated_beam_count;
+
+    //we check if there is at least a critical number of beams that agreed with the map
     //otherwise it probably indicates that the filter converged to a wrong solution
-    //if that's the case we integrate all the beams and hope the filter might converge to 
+    //if that's the case we integrate all the beams and hope the filter might converge to
     //the right solution
-    bool error = false; 
+    bool error = false;
 
-    if(skipped_beam_count >= (beam_ind * self->beam_skip_error_threshold)){
+    if(skipped_beam_count >= (self->beam_target * self->beam_skip_error_threshold)){
       fprintf(stderr, "Over %f%% of the observations were not in the map - pf may have converged to wrong pose - integrating all observations\n", (100 * self->beam_skip_error_threshold));
-      error = true; 
+      error = true;
     }
 
-    for (j = 0; j < set->sample_count; j++)
+    self->pool->Run(chunks, [&](int chunk)
+    {
+      int begin = (long) set->sample_count * chunk / chunks;
+      int end = (long) set->sample_count * (chunk + 1) / chunks;
+      double weight = 0.0;
+
+      for (int j = begin; j < end; j++)
       {
-	sample = set->samples + j;
-	pose = sample->pose;
-
-	log_p = 0;
-
-	for (beam_ind = 0; beam_ind < self->max_beams; beam_ind++){
-	  if(error || obs_mask[beam_ind]){
-	    log_p += log(self->temp_obs[j][beam_ind]);
-	  }
-	}
-	
-	sample->weight *= exp(log_p);
-	
-	total_weight += sample->weight;
-      }      
+        pf_sample_t *sample = set->samples + j;
+        const double *obs = self->temp_obs.data() + (long) j * beam_count;
+
+        double log_p = 0;
+        for (int i = 0; i < beam_count; i++){
+          if(error || obs_mask[i]){
+            log_p += obs[i];
+          }
+        }
+
+        sample->weight *= exp(log_p);
+        weight += sample->weight;
+      }
+      self->chunk_weight[chunk] = weight;
+    });
   }
 
-  delete [] obs_count; 
-  delete [] obs_mask;
-  return(total_weight);
-}
-
-void AMCLLaser::reallocTempData(int new_max_samples, int new_max_obs){
-  if(temp_obs){
-    for(int k=0; k < max_samples; k++){
-      delete [] temp_obs[k];
-    }
-    delete []temp_obs; 
-  }
-  max_obs = new_max_obs; 
-  max_samples = fmax(max_samples, new_max_samples); 
+  total_weight = 0.0;
+  for (int chunk = 0; chunk < chunks; chunk++)
+    total_weight += self->chunk_weight[chunk];
 
-  temp_obs = new double*[max_samples]();
-  for(int k=0; k < max_samples; k++){
-    temp_obs[k] = new double[max_obs]();
-  }
+  return(total_weight);
 }
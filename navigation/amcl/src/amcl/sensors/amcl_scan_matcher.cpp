@@ -0,0 +1,264 @@
+///////////////////////////////////////////////////////////////////////////
+//
+// Desc: Global scan matcher for relocalization
+//
+///////////////////////////////////////////////////////////////////////////
+
+#include <math.h>
+
+#include <algorithm>
+
+#include "amcl/sensors/amcl_scan_matcher.h"
+
+using namespace amcl;
+
+// Blocks at the top of the pyramid are 2^max_depth cells on a side
+static const int max_depth = 7;
+
+// Score of a beam ending on an obstacle
+static const int max_beam_score = 255;
+
+bool AMCLScanMatcher::HigherScore(const Candidate& a, const Candidate& b)
+{
+  return a.score > b.score;
+}
+
+AMCLScanMatcher::AMCLScanMatcher(map_t *map, double max_occ_dist, double sigma) :
+  map(map), max_occ_dist(max_occ_dist), sigma(sigma), max_beams(60), min_score(0.5),
+  depth(0), pad(0), width(0), height(0), angle_count(0), angle_step(0.0), beam_count(0)
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Build the pyramid from the map's distance field
+void AMCLScanMatcher::BuildPyramid()
+{
+  map_t *map = this->map;
+  // Use the distance field of the likelihood field models when there is one
+  if (map->occ_dist_field == NULL)
+    map_update_cspace(map, this->max_occ_dist);
+
+  this->depth = 0;
+  while (this->depth < max_depth &&
+         (1 << (this->depth + 1)) <= std::max(map->size_x, map->size_y))
+    this->depth++;
+  this->pad = 1 << this->depth;
+  this->width = map->size_x + this->pad;
+  this->height = map->size_y + this->pad;
+  this->levels.assign(this->depth + 1, std::vector<unsigned char>());
+
+  // Level 0: the beam likelihood of each cell, through the distance codes
+  // when the map has them
+  double denom = 2 * this->sigma * this->sigma;
+  std::vector<unsigned char> code_score(map->occ_dist_code_count);
+  for (int code = 0; code < map->occ_dist_code_count; code++)
+  {
+    double z = map_occ_dist_decode(map, code);
+    code_score[code] = (unsigned char) lround(max_beam_score * exp(-(z * z) / denom));
+  }
+  std::vector<unsigned char>& base = this->levels[0];
+  base.assign((size_t) this->width * this->height, 0);
+  for (int j = 0; j < map->size_y; j++)
+  {
+    unsigned char *row = &base[(size_t) (j + this->pad) * this->width + this->pad];
+    for (int i = 0; i < map->size_x; i++)
+    {
+      int index = MAP_INDEX(map, i, j);
+      if (map->occ_dist_code)
+        row[i] = code_score[map->occ_dist_code[index]];
+      else
+      {
+        double z = map->occ_dist_field[index];
+        row[i] = (unsigned char) lround(max_beam_score * exp(-(z * z) / denom));
+      }
+    }
+  }
+
+  // Level h is the max of four blocks of level h - 1; cells past the top
+  // or right edge of the map score 0
+  for (int h = 1; h <= this->depth; h++)
+  {
+    const std::vector<unsigned char>& prev = this->levels[h - 1];
+    std::vector<unsigned char>& level = this->levels[h];
+    level.assign((size_t) this->width * this->height, 0);
+    int s = 1 << (h - 1);
+    for (int y = 0; y < this->height; y++)
+    {
+      const unsigned char *row0 = &prev[(size_t) y * this->width];
+      const unsigned char *row1 = y + s < this->height ? row0 + (size_t) s * this->width : NULL;
+      unsigned char *out = &level[(size_t) y * this->width];
+      for (int x = 0; x < this->width; x++)
+      {
+        unsigned char v = row0[x];
+        if (x + s < this->width)
+          v = std::max(v, row0[x + s]);
+        if (row1)
+        {
+          v = std::max(v, row1[x]);
+          if (x + s < this->width)
+            v = std::max(v, row1[x + s]);
+        }
+        out[x] = v;
+      }
+    }
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Tabulate the endpoint offsets of up to max_beams valid beams at rotations
+// fine enough that the farthest endpoint moves by about a cell per step
+void AMCLScanMatcher::SetupBeams(AMCLLaserData *data, const pf_vector_t& laser_pose)
+{
+  std::vector<double> px, py;
+  int valid_count = 0;
+  for (int i = 0; i < data->range_count; i++)
+  {
+    double r = data->ranges[i][0];
+    if (r < data->range_max && r == r)
+      valid_count++;
+  }
+  int step = std::max(1, (int) ceil(valid_count / (double) std::max(this->max_beams, 1)));
+
+  double max_range = 0.0;
+  int k = 0;
+  for (int i = 0; i < data->range_count; i++)
+  {
+    double r = data->ranges[i][0];
+    double bearing = data->ranges[i][1] + laser_pose.v[2];
+    if (!(r < data->range_max && r == r))
+      continue;
+    if (k++ % step)
+      continue;
+
+    // Endpoint in the robot frame
+    px.push_back(laser_pose.v[0] + r * cos(bearing));
+    py.push_back(laser_pose.v[1] + r * sin(bearing));
+    max_range = std::max(max_range, hypot(px.back(), py.back()));
+  }
+  this->beam_count = px.size();
+
+  max_range = std::max(max_range, this->map->scale);
+  this->angle_count = (int) ceil(2 * M_PI * max_range / this->map->scale);
+  this->angle_step = 2 * M_PI / this->angle_count;
+
+  double inv_scale = 1.0 / this->map->scale;
+  this->offset_x.resize((size_t) this->angle_count * this->beam_count);
+  this->offset_y.resize((size_t) this->angle_count * this->beam_count);
+  for (int a = 0; a < this->angle_count; a++)
+  {
+    double c = cos(a * this->angle_step);
+    double s = sin(a * this->angle_step);
+    int *dx = &this->offset_x[(size_t) a * this->beam_count];
+    int *dy = &this->offset_y[(size_t) a * this->beam_count];
+    for (int b = 0; b < this->beam_count; b++)
+    {
+      // Rounded like MAP_GXWX, for a robot at a cell center
+      dx[b] = (int) floor((c * px[b] - s * py[b]) * inv_scale + 0.5);
+      dy[b] = (int) floor((s * px[b] + c * py[b]) * inv_scale + 0.5);
+    }
+  }
+}
+
+int AMCLScanMatcher::Score(int level, int x, int y, int angle) const
+{
+  const unsigned char *grid = this->levels[level].data();
+  const int *dx = &this->offset_x[(size_t) angle * this->beam_count];
+  const int *dy = &this->offset_y[(size_t) angle * this->beam_count];
+  int gx0 = x + this->pad;
+  int gy0 = y + this->pad;
+
+  int score = 0;
+  for (int b = 0; b < this->beam_count; b++)
+  {
+    int gx = gx0 + dx[b];
+    int gy = gy0 + dy[b];
+    if ((unsigned) gx < (unsigned) this->width && (unsigned) gy < (unsigned) this->height)
+      score += grid[(size_t) gy * this->width + gx];
+  }
+  return score;
+}
+
+void AMCLScanMatcher::Search(const Candidate& candidate, int level, Candidate *best) const
+{
+  if (candidate.score <= best->score)
+    return;
+
+  // The robot has to stand on free space
+  if (level == 0)
+  {
+    if (this->map->cells[MAP_INDEX(this->map, candidate.x, candidate.y)].occ_state == -1)
+      *best = candidate;
+    return;
+  }
+
+  Candidate children[4];
+  int child_count = 0;
+  int s = 1 << (level - 1);
+  for (int k = 0; k < 4; k++)
+  {
+    Candidate child = candidate;
+    child.x += (k & 1) * s;
+    child.y += (k >> 1) * s;
+    if (child.x >= this->map->size_x || child.y >= this->map->size_y)
+      continue;
+    child.score = this->Score(level - 1, child.x, child.y, child.angle);
+
+    // Keep the children sorted best first
+    int k2 = child_count++;
+    for (; k2 > 0 && children[k2 - 1].score < child.score; k2--)
+      children[k2] = children[k2 - 1];
+    children[k2] = child;
+  }
+  for (int k = 0; k < child_count; k++)
+    this->Search(children[k], level - 1, best);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Match a scan against the whole map
+double AMCLScanMatcher::Match(AMCLLaserData *data, const pf_vector_t& laser_pose,
+                              pf_vector_t *pose)
+{
+  if (this->levels.empty())
+    this->BuildPyramid();
+
+  this->SetupBeams(data, laser_pose);
+  if (this->beam_count == 0)
+    return -1;
+
+  // Score the top level blocks at every rotation and refine the most
+  // promising first, so that the bound tightens early
+  int size = 1 << this->depth;
+  std::vector<Candidate> roots;
+  for (int a = 0; a < this->angle_count; a++)
+  {
+    for (int y = 0; y < this->map->size_y; y += size)
+    {
+      for (int x = 0; x < this->map->size_x; x += size)
+      {
+        Candidate candidate;
+        candidate.x = x;
+        candidate.y = y;
+        candidate.angle = a;
+        candidate.score = this->Score(this->depth, x, y, a);
+        roots.push_back(candidate);
+      }
+    }
+  }
+  std::sort(roots.begin(), roots.end(), HigherScore);
+
+  Candidate best;
+  best.x = best.y = best.angle = 0;
+  best.score = (int) ceil(this->min_score * max_beam_score * this->beam_count) - 1;
+  int min_score = best.score;
+  for (size_t k = 0; k < roots.size() && roots[k].score > best.score; k++)
+    this->Search(roots[k], this->depth, &best);
+  if (best.score == min_score)
+    return -1;
+
+  pose->v[0] = MAP_WXGX(this->map, best.x);
+  pose->v[1] = MAP_WYGY(this->map, best.y);
+  pose->v[2] = best.angle * this->angle_step;
+  if (pose->v[2] > M_PI)
+    pose->v[2] -= 2 * M_PI;
+  return best.score / (double) (max_beam_score * this->beam_count);
+}
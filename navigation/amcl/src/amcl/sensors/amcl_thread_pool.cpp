@@ -0,0 +1,86 @@
+///////////////////////////////////////////////////////////////////////////
+//
+// Desc: Worker threads for the sensor models
+//
+///////////////////////////////////////////////////////////////////////////
+
+#include "amcl/sensors/amcl_thread_pool.h"
+
+using namespace amcl;
+
+////////////////////////////////////////////////////////////////////////////////
+// Start the workers
+AMCLThreadPool::AMCLThreadPool(int size) : task(NULL), task_count(0), next_task(0),
+                                           running(0), generation(0), stop(false)
+{
+  if (size <= 0)
+    size = std::thread::hardware_concurrency();
+  for (int i = 1; i < size; i++)
+    this->workers.push_back(std::thread(&AMCLThreadPool::Work, this));
+}
+
+AMCLThreadPool::~AMCLThreadPool()
+{
+  {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->stop = true;
+  }
+  this->job_ready.notify_all();
+  for (size_t i = 0; i < this->workers.size(); i++)
+    this->workers[i].join();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Run a job on the workers and the calling thread
+void AMCLThreadPool::Run(int count, const std::function<void(int)>& task)
+{
+  if (this->workers.empty() || count <= 1)
+  {
+    for (int i = 0; i < count; i++)
+      task(i);
+    return;
+  }
+
+  std::unique_lock<std::mutex> lock(this->mutex);
+  this->task = &task;
+  this->task_count = count;
+  this->next_task = 0;
+  this->generation++;
+  this->job_ready.notify_all();
+
+  this->Drain(lock);
+  while (this->next_task < this->task_count || this->running > 0)
+    this->job_done.wait(lock);
+  this->task = NULL;
+}
+
+void AMCLThreadPool::Work()
+{
+  std::unique_lock<std::mutex> lock(this->mutex);
+  unsigned long seen = this->generation;
+  while (true)
+  {
+    while (!this->stop && this->generation == seen)
+      this->job_ready.wait(lock);
+    if (this->stop)
+      return;
+    seen = this->generation;
+    this->Drain(lock);
+  }
+}
+
+void AMCLThreadPool::Drain(std::unique_lock<std::mutex>& lock)
+{
+  while (this->next_task < this->task_count)
+  {
+    int i = this->next_task++;
+    const std::function<void(int)>& task = *this->task;
+    this->running++;
+    lock.unlock();
+    task(i);
+    lock.lock();
+    this->running--;
+  }
+  if (this->running == 0)
+    this->job_done.notify_all();
+}
@@ -0,0 +1,687 @@
+/*
+ *  Copyright (c) 2008, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+// Offline benchmark of the AMCL sensor models on map_server maps.
+//
+// A trajectory is driven through the free space of each map and a laser scan
+// is ray cast from every pose. The filter is then run over the trajectory
+// once per laser model configuration and the time per sensor update and the
+// pose estimates are compared.  Resampling amplifies the smallest difference
+// in the weights, so each model is also run from a second seed to show how
+// far apart the estimates of two equally good runs drift.
+//
+//   amcl_benchmark [-p particles] [-b max_beams] [-t threads] [-n steps] [-c]
+//                  [-d cache_dir] [-a adaptive_beams] [-l budget_ms] [-g] [-r]
+//                  map.yaml...
+//
+// -c only times map_update_cspace.  -d also times saving the cspace to a
+// cache in cache_dir and loading it back.  -a adds runs with the adaptive
+// beam selection, and -l gives every run a time budget per update.  -g
+// also relocalizes from every tenth scan of the trajectory with the global
+// scan matcher.  -r also times pf_update_resample against the kd-tree
+// resampling it replaced, on the same weighted particle clouds.
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "amcl/map/map.h"
+#include "amcl/pf/pf.h"
+#include "amcl/pf/pf_resample_kdtree.h"
+#include "amcl/sensors/amcl_laser.h"
+#include "amcl/sensors/amcl_odom.h"
+#include "amcl/sensors/amcl_scan_matcher.h"
+
+using namespace amcl;
+
+namespace
+{
+
+struct Options
+{
+  int particles;
+  int max_beams;
+  int threads;
+  int steps;
+  bool cspace_only;
+  std::string cache_dir;
+  int adaptive_beams;
+  double time_budget;
+  bool relocalize;
+  bool resample;
+};
+
+// Scan geometry of the simulated lidar
+const int scan_beams = 720;
+const double scan_range_max = 12.0;
+const double scan_noise = 0.02;
+
+const double max_occ_dist = 2.0;
+
+double elapsedMs(std::chrono::steady_clock::time_point start)
+{
+  return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+double gaussian(double sigma)
+{
+  return sigma * sqrt(-2.0 * log(1.0 - drand48())) * cos(2.0 * M_PI * drand48());
+}
+
+double angleDiff(double a, double b)
+{
+  double d = fmod(a - b + M_PI, 2.0 * M_PI);
+  if (d < 0)
+    d += 2.0 * M_PI;
+  return d - M_PI;
+}
+
+// Reads a map_server yaml and its trinary pgm into a map_t the way
+// map_server and AmclNode::convertMap do
+map_t* loadMap(const std::string& yaml)
+{
+  FILE* file = fopen(yaml.c_str(), "r");
+  if (!file)
+    return NULL;
+
+  char image[256] = "";
+  double resolution = 0.0, origin_x = 0.0, origin_y = 0.0;
+  double occupied_thresh = 0.65, free_thresh = 0.196;
+  int negate = 0;
+  char line[512];
+  while (fgets(line, sizeof(line), file))
+  {
+    sscanf(line, "image: %255s", image);
+    sscanf(line, "resolution: %lf", &resolution);
+    sscanf(line, "origin: [%lf, %lf", &origin_x, &origin_y);
+    sscanf(line, "negate: %d", &negate);
+    sscanf(line, "occupied_thresh: %lf", &occupied_thresh);
+    sscanf(line, "free_thresh: %lf", &free_thresh);
+  }
+  fclose(file);
+
+  std::string path = image;
+  size_t slash = yaml.rfind('/');
+  if (path[0] != '/' && slash != std::string::npos)
+    path = yaml.substr(0, slash + 1) + path;
+
+  file = fopen(path.c_str(), "rb");
+  if (!file)
+    return NULL;
+  char magic[3];
+  int width, height, depth;
+  if (fscanf(file, "%2s ", magic) != 1 || strcmp(magic, "P5") != 0)
+  {
+    fclose(file);
+    return NULL;
+  }
+  int ch;
+  while ((ch = fgetc(file)) == '#')
+    while (fgetc(file) != '\n');
+  ungetc(ch, file);
+  if (fscanf(file, "%d %d %d", &width, &height, &depth) != 3 || depth > 255)
+  {
+    fclose(file);
+    return NULL;
+  }
+  fgetc(file);
+  std::vector<unsigned char> pixels(width * height);
+  size_t read = fread(pixels.data(), 1, pixels.size(), file);
+  fclose(file);
+  if (read != pixels.size())
+    return NULL;
+
+  map_t* map = map_alloc();
+  map->size_x = width;
+  map->size_y = height;
+  map->scale = resolution;
+  map->origin_x = origin_x + (map->size_x / 2) * map->scale;
+  map->origin_y = origin_y + (map->size_y / 2) * map->scale;
+  map->cells = (map_cell_t*) malloc(sizeof(map_cell_t) * map->size_x * map->size_y);
+  for (int j = 0; j < height; j++)
+  {
+    for (int i = 0; i < width; i++)
+    {
+      // The image is stored top row first
+      double value = pixels[(height - 1 - j) * width + i];
+      double occ = negate ? value / depth : (depth - value) / depth;
+      int state = 0;
+      if (occ > occupied_thresh)
+        state = +1;
+      else if (occ < free_thresh)
+        state = -1;
+      map->cells[MAP_INDEX(map, i, j)].occ_state = state;
+    }
+  }
+  return map;
+}
+
+double clearance(map_t* map, double x, double y)
+{
+  int i = MAP_GXWX(map, x);
+  int j = MAP_GYWY(map, y);
+  if (!MAP_VALID(map, i, j) || map->cells[MAP_INDEX(map, i, j)].occ_state != -1)
+    return 0.0;
+  return map->cells[MAP_INDEX(map, i, j)].occ_dist;
+}
+
+// A random walk at 0.1 m per step that keeps 0.4 m away from obstacles,
+// starting from the free cell farthest from any obstacle
+std::vector<pf_vector_t> makeTrajectory(map_t* map, int steps)
+{
+  int start = -1;
+  for (int k = 0; k < map->size_x * map->size_y; k++)
+    if (map->cells[k].occ_state == -1 &&
+        (start < 0 || map->cells[k].occ_dist > map->cells[start].occ_dist))
+      start = k;
+
+  pf_vector_t pose = pf_vector_zero();
+  pose.v[0] = MAP_WXGX(map, start % map->size_x);
+  pose.v[1] = MAP_WYGY(map, start / map->size_x);
+
+  std::vector<pf_vector_t> trajectory(1, pose);
+  while ((int) trajectory.size() < steps)
+  {
+    double heading = pose.v[2] + gaussian(0.05);
+    for (int attempt = 0; attempt < 50; attempt++)
+    {
+      if (clearance(map, pose.v[0] + 0.4 * cos(heading), pose.v[1] + 0.4 * sin(heading)) >= 0.4)
+        break;
+      heading += (drand48() < 0.5 ? -1 : 1) * (0.3 + drand48());
+    }
+    pose.v[0] += 0.1 * cos(heading);
+    pose.v[1] += 0.1 * sin(heading);
+    pose.v[2] = angleDiff(heading, 0.0);
+    trajectory.push_back(pose);
+  }
+  return trajectory;
+}
+
+void makeScan(map_t* map, const pf_vector_t& pose, std::vector<double>& ranges)
+{
+  ranges.resize(scan_beams);
+  for (int i = 0; i < scan_beams; i++)
+  {
+    double bearing = -M_PI + i * 2.0 * M_PI / scan_beams;
+    double range = map_calc_range(map, pose.v[0], pose.v[1], pose.v[2] + bearing, scan_range_max);
+    if (range < scan_range_max)
+      range = std::max(0.0, range + gaussian(scan_noise));
+    ranges[i] = range;
+  }
+}
+
+struct Config
+{
+  const char* name;
+  laser_model_t model;
+  bool lookup_table;
+  bool adaptive;
+  long seed;
+};
+
+struct Result
+{
+  double update_ms;
+  double mean_error;
+  double final_error;
+  std::vector<pf_vector_t> estimates;
+};
+
+pf_vector_t initialPose(void* data)
+{
+  return *(pf_vector_t*) data;
+}
+
+// A pose on a free cell drawn uniformly, as for global localization
+pf_vector_t freePose(void* data)
+{
+  map_t* map = (map_t*) data;
+  int i, j;
+  do
+  {
+    i = (int) (drand48() * map->size_x);
+    j = (int) (drand48() * map->size_y);
+  } while (map->cells[MAP_INDEX(map, i, j)].occ_state != -1);
+
+  pf_vector_t pose;
+  pose.v[0] = MAP_WXGX(map, i);
+  pose.v[1] = MAP_WYGY(map, j);
+  pose.v[2] = drand48() * 2 * M_PI - M_PI;
+  return pose;
+}
+
+Result run(map_t* map, const Options& options, const Config& config,
+           const std::vector<pf_vector_t>& trajectory,
+           const std::vector<std::vector<double> >& scans)
+{
+  Result result;
+  result.update_ms = result.mean_error = result.final_error = 0.0;
+  srand48(config.seed);
+
+  pf_vector_t start = trajectory[0];
+  pf_t* pf = pf_alloc(options.particles, options.particles, 0.0, 0.0, initialPose, &start);
+  pf_matrix_t cov = pf_matrix_zero();
+  cov.m[0][0] = cov.m[1][1] = 0.25 * 0.25;
+  cov.m[2][2] = 0.1 * 0.1;
+  pf_init(pf, start, cov);
+
+  AMCLOdom odom;
+  odom.SetModel(ODOM_MODEL_DIFF, 0.1, 0.1, 0.1, 0.1, 0.1);
+  AMCLLaser laser(options.max_beams, map);
+  if (config.model == LASER_MODEL_LIKELIHOOD_FIELD)
+    laser.SetModelLikelihoodField(0.5, 0.5, 0.2, max_occ_dist);
+  else
+    laser.SetModelLikelihoodFieldProb(0.95, 0.05, 0.2, max_occ_dist, false, 0.5, 0.3, 0.9);
+  laser.SetModelLookupTable(config.lookup_table);
+  laser.SetThreadCount(options.threads);
+  laser.SetAdaptiveBeams(config.adaptive ? options.adaptive_beams : 0);
+  laser.SetTimeBudget(options.time_budget);
+  pf_vector_t laser_pose = pf_vector_zero();
+  laser.SetLaserPose(laser_pose);
+
+  AMCLLaserData ldata;
+  ldata.sensor = &laser;
+  ldata.SetRangeCount(scan_beams);
+  ldata.range_max = scan_range_max;
+
+  for (size_t step = 1; step < trajectory.size(); step++)
+  {
+    AMCLOdomData odata;
+    odata.pose = trajectory[step];
+    odata.delta = pf_vector_sub(trajectory[step], trajectory[step - 1]);
+    odata.delta.v[2] = angleDiff(trajectory[step].v[2], trajectory[step - 1].v[2]);
+    odom.UpdateAction(pf, (AMCLSensorData*) &odata);
+
+    for (int i = 0; i < scan_beams; i++)
+    {
+      ldata.ranges[i][0] = scans[step][i];
+      ldata.ranges[i][1] = -M_PI + i * 2.0 * M_PI / scan_beams;
+    }
+
+    std::chrono::steady_clock::time_point start_time = std::chrono::steady_clock::now();
+    laser.UpdateSensor(pf, (AMCLSensorData*) &ldata);
+    result.update_ms += elapsedMs(start_time);
+
+    pf_update_resample(pf);
+
+    double best_weight = -1.0;
+    pf_vector_t estimate = pf_vector_zero();
+    for (int cluster = 0; cluster < pf->sets[pf->current_set].cluster_count; cluster++)
+    {
+      double weight;
+      pf_vector_t mean;
+      pf_matrix_t cluster_cov;
+      if (pf_get_cluster_stats(pf, cluster, &weight, &mean, &cluster_cov) && weight > best_weight)
+      {
+        best_weight = weight;
+        estimate = mean;
+      }
+    }
+    result.estimates.push_back(estimate);
+
+    double error = hypot(estimate.v[0] - trajectory[step].v[0], estimate.v[1] - trajectory[step].v[1]);
+    result.mean_error += error;
+    result.final_error = error;
+  }
+  pf_free(pf);
+
+  int updates = trajectory.size() - 1;
+  result.update_ms /= updates;
+  result.mean_error /= updates;
+  return result;
+}
+
+struct ResampleResult
+{
+  double ms;
+  long samples;
+  long clusters;
+  // Resampled sets that the kd-tree clusters differently
+  int mismatches;
+};
+
+// Cluster a sample set with the kd-tree; returns the number of clusters
+int kdtreeClusters(pf_kdtree_t* kdtree, pf_sample_set_t* set)
+{
+  pf_kdtree_clear(kdtree);
+  for (int i = 0; i < set->sample_count; i++)
+    pf_kdtree_insert(kdtree, set->samples[i].pose, set->samples[i].weight);
+  pf_kdtree_cluster(kdtree);
+  int clusters = 0;
+  for (int i = 0; i < set->sample_count; i++)
+    clusters = std::max(clusters, pf_kdtree_get_cluster(kdtree, set->samples[i].pose) + 1);
+  return clusters;
+}
+
+// Resample a copy of the weighted samples with both implementations, from
+// the same random seed.  The two draw different samples, so the clusters of
+// the histogram are also checked against the kd-tree on its own samples.
+void resampleBoth(pf_t* pf, pf_kdtree_t* kdtree, const std::vector<pf_sample_t>& samples,
+                  long seed, ResampleResult* hist, ResampleResult* tree)
+{
+  for (int k = 0; k < 2; k++)
+  {
+    pf_sample_set_t* set = pf->sets + pf->current_set;
+    std::copy(samples.begin(), samples.end(), set->samples);
+    set->sample_count = samples.size();
+    pf->w_slow = pf->w_fast = 0.0;
+
+    ResampleResult* result = k == 0 ? hist : tree;
+    srand48(seed);
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    if (k == 0)
+      pf_update_resample(pf);
+    else
+      pf_update_resample_kdtree(pf, kdtree);
+    result->ms += elapsedMs(start);
+    result->samples += pf->sets[pf->current_set].sample_count;
+    result->clusters += pf->sets[pf->current_set].cluster_count;
+    if (k == 0 && kdtreeClusters(kdtree, pf->sets + pf->current_set) != pf->sets[pf->current_set].cluster_count)
+      result->mismatches++;
+  }
+}
+
+void printResample(const char* name, int runs, const ResampleResult& hist, const ResampleResult& tree)
+{
+  printf("  %-30s hist %7.3f ms, kd-tree %7.3f ms; samples %ld / %ld, clusters %.1f / %.1f, "
+         "%d of %d clustered differently\n",
+         name, hist.ms / runs, tree.ms / runs, hist.samples / runs, tree.samples / runs,
+         hist.clusters / (double) runs, tree.clusters / (double) runs, hist.mismatches, runs);
+}
+
+// Time resampling on the weighted clouds of a filter tracking the
+// trajectory, and on clouds spread over the free space of the whole map,
+// weighted by a scan, as right after global localization
+void benchmarkResample(map_t* map, const Options& options, const std::vector<pf_vector_t>& trajectory,
+                       const std::vector<std::vector<double> >& scans)
+{
+  pf_vector_t start = trajectory[0];
+  pf_t* pf = pf_alloc(std::min(100, options.particles), options.particles, 0.0, 0.0, freePose, map);
+  pf_t* bench = pf_alloc(std::min(100, options.particles), options.particles, 0.0, 0.0, freePose, map);
+  pf_kdtree_t* kdtree = pf_kdtree_alloc(3 * options.particles);
+
+  AMCLOdom odom;
+  odom.SetModel(ODOM_MODEL_DIFF, 0.1, 0.1, 0.1, 0.1, 0.1);
+  AMCLLaser laser(options.max_beams, map);
+  laser.SetModelLikelihoodField(0.5, 0.5, 0.2, max_occ_dist);
+  laser.SetModelLookupTable(true);
+  laser.SetThreadCount(options.threads);
+  pf_vector_t laser_pose = pf_vector_zero();
+  laser.SetLaserPose(laser_pose);
+
+  AMCLLaserData ldata;
+  ldata.sensor = &laser;
+  ldata.SetRangeCount(scan_beams);
+  ldata.range_max = scan_range_max;
+
+  ResampleResult hist = {0.0, 0, 0, 0}, tree = {0.0, 0, 0, 0};
+  std::vector<pf_sample_t> samples;
+
+  srand48(42);
+  pf_matrix_t cov = pf_matrix_zero();
+  cov.m[0][0] = cov.m[1][1] = 0.25 * 0.25;
+  cov.m[2][2] = 0.1 * 0.1;
+  pf_init(pf, start, cov);
+  for (size_t step = 1; step < trajectory.size(); step++)
+  {
+    AMCLOdomData odata;
+    odata.pose = trajectory[step];
+    odata.delta = pf_vector_sub(trajectory[step], trajectory[step - 1]);
+    odata.delta.v[2] = angleDiff(trajectory[step].v[2], trajectory[step - 1].v[2]);
+    odom.UpdateAction(pf, (AMCLSensorData*) &odata);
+
+    for (int i = 0; i < scan_beams; i++)
+    {
+      ldata.ranges[i][0] = scans[step][i];
+      ldata.ranges[i][1] = -M_PI + i * 2.0 * M_PI / scan_beams;
+    }
+    laser.UpdateSensor(pf, (AMCLSensorData*) &ldata);
+
+    pf_sample_set_t* set = pf->sets + pf->current_set;
+    samples.assign(set->samples, set->samples + set->sample_count);
+    resampleBoth(bench, kdtree, samples, step, &hist, &tree);
+
+    srand48(step);
+    pf_update_resample(pf);
+  }
+  printResample("resample, tracking", trajectory.size() - 1, hist, tree);
+
+  // Global clouds, each drawn and weighted anew from a scan along the
+  // trajectory
+  const int global_runs = 10;
+  hist.ms = tree.ms = 0.0;
+  hist.samples = tree.samples = hist.clusters = tree.clusters = 0;
+  hist.mismatches = tree.mismatches = 0;
+  for (int r = 0; r < global_runs; r++)
+  {
+    size_t step = r * trajectory.size() / global_runs;
+    srand48(r);
+    pf_init_model(pf, freePose, map);
+    for (int i = 0; i < scan_beams; i++)
+    {
+      ldata.ranges[i][0] = scans[step][i];
+      ldata.ranges[i][1] = -M_PI + i * 2.0 * M_PI / scan_beams;
+    }
+    laser.UpdateSensor(pf, (AMCLSensorData*) &ldata);
+
+    pf_sample_set_t* set = pf->sets + pf->current_set;
+    samples.assign(set->samples, set->samples + set->sample_count);
+    resampleBoth(bench, kdtree, samples, r, &hist, &tree);
+  }
+  printResample("resample, global", global_runs, hist, tree);
+
+  pf_kdtree_free(kdtree);
+  pf_free(bench);
+  pf_free(pf);
+}
+
+// Relocalize from every tenth scan of the trajectory; a match within
+// 0.2 m and 0.1 rad of the true pose counts as found
+void benchmarkRelocalization(map_t* map, const std::vector<pf_vector_t>& trajectory,
+                             const std::vector<std::vector<double> >& scans)
+{
+  AMCLScanMatcher matcher(map, max_occ_dist, 0.2);
+  AMCLLaserData ldata;
+  ldata.SetRangeCount(scan_beams);
+  ldata.range_max = scan_range_max;
+  pf_vector_t laser_pose = pf_vector_zero();
+
+  int matches = 0, found = 0;
+  double total_ms = 0.0, first_ms = 0.0, worst_ms = 0.0;
+  for (size_t step = 0; step < trajectory.size(); step += 10)
+  {
+    for (int i = 0; i < scan_beams; i++)
+    {
+      ldata.ranges[i][0] = scans[step][i];
+      ldata.ranges[i][1] = -M_PI + i * 2.0 * M_PI / scan_beams;
+    }
+
+    pf_vector_t pose;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    double score = matcher.Match(&ldata, laser_pose, &pose);
+    double ms = elapsedMs(start);
+
+    // The first match also builds the pyramid
+    if (matches++ == 0)
+      first_ms = ms;
+    else
+    {
+      total_ms += ms;
+      worst_ms = std::max(worst_ms, ms);
+    }
+    if (score >= 0 &&
+        hypot(pose.v[0] - trajectory[step].v[0], pose.v[1] - trajectory[step].v[1]) < 0.2 &&
+        fabs(angleDiff(pose.v[2], trajectory[step].v[2])) < 0.1)
+      found++;
+  }
+  printf("  global scan match              first %.1f ms, then mean %.1f ms, worst %.1f ms, %d of %d found\n",
+         first_ms, matches > 1 ? total_ms / (matches - 1) : 0.0, worst_ms, found, matches);
+}
+
+void benchmarkMap(const std::string& yaml, const Options& options)
+{
+  map_t* map = loadMap(yaml);
+  if (!map)
+  {
+    fprintf(stderr, "could not load %s\n", yaml.c_str());
+    return;
+  }
+  printf("%s: %dx%d cells at %.3f m\n", yaml.c_str(), map->size_x, map->size_y, map->scale);
+
+  // Best and mean of a few runs, as on a map reload
+  const int cspace_runs = 5;
+  double best_ms = 0.0, total_ms = 0.0;
+  for (int r = 0; r < cspace_runs; r++)
+  {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    map_update_cspace(map, max_occ_dist);
+    double ms = elapsedMs(start);
+    best_ms = r == 0 ? ms : std::min(best_ms, ms);
+    total_ms += ms;
+  }
+  printf("  map_update_cspace              best %.1f ms, mean %.1f ms\n", best_ms, total_ms / cspace_runs);
+
+  if (!options.cache_dir.empty())
+  {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    if (map_save_cspace(map, options.cache_dir.c_str()) != 0)
+      fprintf(stderr, "could not save the cspace to %s\n", options.cache_dir.c_str());
+    printf("  map_save_cspace                %.1f ms\n", elapsedMs(start));
+
+    total_ms = 0.0;
+    for (int r = 0; r < cspace_runs; r++)
+    {
+      start = std::chrono::steady_clock::now();
+      if (map_load_cspace(map, max_occ_dist, options.cache_dir.c_str()) != 0)
+        fprintf(stderr, "could not load the cspace from %s\n", options.cache_dir.c_str());
+      double ms = elapsedMs(start);
+      best_ms = r == 0 ? ms : std::min(best_ms, ms);
+      total_ms += ms;
+    }
+    printf("  map_load_cspace                best %.1f ms, mean %.1f ms\n", best_ms, total_ms / cspace_runs);
+  }
+  if (options.cspace_only)
+  {
+    map_free(map);
+    return;
+  }
+
+  srand48(1);
+  std::vector<pf_vector_t> trajectory = makeTrajectory(map, options.steps);
+  std::vector<std::vector<double> > scans(trajectory.size());
+  for (size_t step = 0; step < trajectory.size(); step++)
+    makeScan(map, trajectory[step], scans[step]);
+
+  if (options.relocalize)
+    benchmarkRelocalization(map, trajectory, scans);
+  if (options.resample)
+    benchmarkResample(map, options, trajectory, scans);
+
+  const Config configs[] = {
+    {"likelihood_field", LASER_MODEL_LIKELIHOOD_FIELD, false, false, 42},
+    {"likelihood_field, seed 43", LASER_MODEL_LIKELIHOOD_FIELD, false, false, 43},
+    {"likelihood_field + table", LASER_MODEL_LIKELIHOOD_FIELD, true, false, 42},
+    {"likelihood_field + adaptive", LASER_MODEL_LIKELIHOOD_FIELD, true, true, 42},
+    {"likelihood_field_prob", LASER_MODEL_LIKELIHOOD_FIELD_PROB, false, false, 42},
+    {"likelihood_field_prob, seed 43", LASER_MODEL_LIKELIHOOD_FIELD_PROB, false, false, 43},
+    {"likelihood_field_prob + table", LASER_MODEL_LIKELIHOOD_FIELD_PROB, true, false, 42},
+    {"likelihood_field_prob + adaptive", LASER_MODEL_LIKELIHOOD_FIELD_PROB, true, true, 42},
+  };
+
+  printf("  %-30s %10s %11s %11s %11s\n", "", "update ms", "mean err m", "final err m", "vs first m");
+  Result first;
+  for (size_t c = 0; c < sizeof(configs) / sizeof(configs[0]); c++)
+  {
+    if (configs[c].adaptive && options.adaptive_beams <= 0)
+      continue;
+    Result result = run(map, options, configs[c], trajectory, scans);
+    if (c == 0 || configs[c].model != configs[c - 1].model)
+      first = result;
+
+    // Mean distance between the estimates of this run and of the first run
+    // of the same model
+    double deviation = 0.0;
+    for (size_t k = 0; k < result.estimates.size(); k++)
+      deviation += hypot(result.estimates[k].v[0] - first.estimates[k].v[0],
+                         result.estimates[k].v[1] - first.estimates[k].v[1]);
+    deviation /= result.estimates.size();
+
+    printf("  %-30s %10.3f %11.3f %11.3f %11.3f\n", configs[c].name,
+           result.update_ms, result.mean_error, result.final_error, deviation);
+  }
+
+  map_free(map);
+}
+
+}
+
+int main(int argc, char** argv)
+{
+  Options options;
+  options.particles = 2000;
+  options.max_beams = 360;
+  options.threads = 1;
+  options.steps = 100;
+  options.cspace_only = false;
+  options.adaptive_beams = 0;
+  options.time_budget = 0.0;
+  options.relocalize = false;
+  options.resample = false;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "p:b:t:n:cd:a:l:gr")) != -1)
+  {
+    switch (opt)
+    {
+      case 'p': options.particles = atoi(optarg); break;
+      case 'b': options.max_beams = atoi(optarg); break;
+      case 't': options.threads = atoi(optarg); break;
+      case 'n': options.steps = atoi(optarg); break;
+      case 'c': options.cspace_only = true; break;
+      case 'd': options.cache_dir = optarg; break;
+      case 'a': options.adaptive_beams = atoi(optarg); break;
+      case 'l': options.time_budget = atof(optarg) / 1000.0; break;
+      case 'g': options.relocalize = true; break;
+      case 'r': options.resample = true; break;
+      default:
+        fprintf(stderr, "usage: %s [-p particles] [-b max_beams] [-t threads] [-n steps] [-c] [-d cache_dir] [-a adaptive_beams] [-l budget_ms] [-g] [-r] map.yaml...\n", argv[0]);
+        return 1;
+    }
+  }
+  if (optind >= argc)
+  {
+    fprintf(stderr, "usage: %s [-p particles] [-b max_beams] [-t threads] [-n steps] [-c] [-d cache_dir] [-a adaptive_beams] [-l budget_ms] [-g] [-r] map.yaml...\n", argv[0]);
+    return 1;
+  }
+
+  if (!options.cspace_only)
+    printf("%d particles, %d of %d beams, %d threads, %d steps\n",
+           options.particles, options.max_beams, scan_beams, options.threads, options.steps);
+  for (int i = optind; i < argc; i++)
+    benchmarkMap(argv[i], options);
+  return 0;
+}
@@ -34,8 +34,10 @@
 
 #include "amcl/map/map.h"
 #include "amcl/pf/pf.h"
+#include "amcl/pf/pf_pdf.h"
 #include "amcl/sensors/amcl_odom.h"
 #include "amcl/sensors/amcl_laser.h"
+#include "amcl/sensors/amcl_scan_matcher.h"
 #include "portable_utils.hpp"
 
 #include "ros/assert.h"
@@ -159,6 +161,10 @@ class AmclNode
     // Pose-generating function used to uniformly distribute particles over
     // the map
     static pf_vector_t uniformPoseGenerator(void* arg);
+    // Pose-generating function for the samples injected on recovery: half
+    // of them around the last global scan match, if there is one, and the
+    // rest uniformly distributed
+    static pf_vector_t recoveryPoseGenerator(void* arg);
 #if NEW_UNIFORM_SAMPLING
     static std::vector<std::pair<int,int> > free_space_indices;
 #endif
@@ -167,6 +173,8 @@ class AmclNode
                                     std_srvs::Empty::Response& res);
     bool nomotionUpdateCallback(std_srvs::Empty::Request& req,
                                     std_srvs::Empty::Response& res);
+    bool relocalizeCallback(std_srvs::Empty::Request& req,
+                            std_srvs::Empty::Response& res);
     bool setMapCallback(nav_msgs::SetMap::Request& req,
                         nav_msgs::SetMap::Response& res);
 
@@ -178,6 +186,8 @@ class AmclNode
     void handleMapMessage(const nav_msgs::OccupancyGrid& msg);
     void freeMapDependentMemory();
     map_t* convertMap( const nav_msgs::OccupancyGrid& map_msg );
+    void loadCachedCspace();
+    bool matchScan(AMCLLaserData& ldata, int laser_index, pf_vector_t* pose);
     void updatePoseFromServer();
     void applyInitialPose();
 
@@ -211,6 +221,9 @@ class AmclNode
     std::vector< AMCLLaser* > lasers_;
     std::vector< bool > lasers_update_;
     std::map< std::string, int > frame_to_laser_;
+    // Scan handed to the sensor models, kept so that its range buffer is
+    // reused from one scan to the next
+    AMCLLaserData laser_data_;
 
     // Particle filter
     pf_t *pf_;
@@ -228,6 +241,20 @@ class AmclNode
 
     AMCLOdom* odom_;
     AMCLLaser* laser_;
+    // Global scan matcher, built on the first relocalization after a map
+    // or model change
+    AMCLScanMatcher* matcher_;
+    bool relocalize_requested_;
+    bool recovery_scan_match_;
+    double recovery_scan_match_interval_;
+    int relocalize_beams_;
+    double relocalize_min_score_;
+    // Last match found while the filter was injecting recovery samples, and
+    // the stamp of the scan it was matched from while the recovery lasts
+    bool recovery_seed_valid_;
+    pf_vector_t recovery_seed_;
+    bool recovery_matched_;
+    ros::Time recovery_match_stamp_;
 
     ros::Duration cloud_pub_interval;
     ros::Time last_cloud_pub_time;
@@ -253,6 +280,7 @@ class AmclNode
     ros::ServiceServer global_loc_srv_;
     ros::ServiceServer nomotion_update_srv_; //to let amcl update samples without requiring motion
     ros::ServiceServer set_map_srv_;
+    ros::ServiceServer relocalize_srv_;
     ros::Subscriber initial_pose_sub_old_;
     ros::Subscriber map_sub_;
 
@@ -279,6 +307,11 @@ class AmclNode
     bool do_beamskip_;
     double beam_skip_distance_, beam_skip_threshold_, beam_skip_error_threshold_;
     double laser_likelihood_max_dist_;
+    int laser_model_threads_;
+    bool laser_model_lookup_table_;
+    int laser_adaptive_beams_;
+    double laser_time_budget_;
+    std::string map_cache_dir_;
     odom_model_t odom_model_type_;
     double init_pose_[3];
     double init_cov_[3];
@@ -352,6 +385,10 @@ AmclNode::AmclNode() :
         resample_count_(0),
         odom_(NULL),
         laser_(NULL),
+        matcher_(NULL),
+        relocalize_requested_(false),
+        recovery_seed_valid_(false),
+        recovery_matched_(false),
 	      private_nh_("~"),
         initial_pose_hyp_(NULL),
         first_map_received_(false),
@@ -401,6 +438,15 @@ AmclNode::AmclNode() :
   private_nh_.param("laser_sigma_hit", sigma_hit_, 0.2);
   private_nh_.param("laser_lambda_short", lambda_short_, 0.1);
   private_nh_.param("laser_likelihood_max_dist", laser_likelihood_max_dist_, 2.0);
+  private_nh_.param("laser_model_threads", laser_model_threads_, 1);
+  private_nh_.param("laser_model_lookup_table", laser_model_lookup_table_, false);
+  private_nh_.param("laser_adaptive_beams", laser_adaptive_beams_, 0);
+  private_nh_.param("laser_time_budget", laser_time_budget_, 0.0);
+  private_nh_.param("relocalize_beams", relocalize_beams_, 60);
+  private_nh_.param("relocalize_min_score", relocalize_min_score_, 0.5);
+  private_nh_.param("recovery_scan_match", recovery_scan_match_, false);
+  private_nh_.param("recovery_scan_match_interval", recovery_scan_match_interval_, 5.0);
+  private_nh_.param("map_cache_dir", map_cache_dir_, std::string(""));
   std::string tmp_model_type;
   private_nh_.param("laser_model_type", tmp_model_type, std::string("likelihood_field"));
   if(tmp_model_type == "beam")
@@ -477,6 +523,7 @@ AmclNode::AmclNode() :
                                          this);
   nomotion_update_srv_= nh_.advertiseService("request_nomotion_update", &AmclNode::nomotionUpdateCallback, this);
   set_map_srv_= nh_.advertiseService("set_map", &AmclNode::setMapCallback, this);
+  relocalize_srv_= nh_.advertiseService("relocalize", &AmclNode::relocalizeCallback, this);
 
   laser_scan_sub_ = new message_filters::Subscriber<sensor_msgs::LaserScan>(nh_, scan_topic_, 100);
   laser_scan_filter_ = 
@@ -556,6 +603,14 @@ void AmclNode::reconfigureCB(AMCLConfig &config, uint32_t level)
   sigma_hit_ = config.laser_sigma_hit;
   lambda_short_ = config.laser_lambda_short;
   laser_likelihood_max_dist_ = config.laser_likelihood_max_dist;
+  laser_model_threads_ = config.laser_model_threads;
+  laser_model_lookup_table_ = config.laser_model_lookup_table;
+  laser_adaptive_beams_ = config.laser_adaptive_beams;
+  laser_time_budget_ = config.laser_time_budget;
+  relocalize_beams_ = config.relocalize_beams;
+  relocalize_min_score_ = config.relocalize_min_score;
+  recovery_scan_match_ = config.recovery_scan_match;
+  recovery_scan_match_interval_ = config.recovery_scan_match_interval;
 
   if(config.laser_model_type == "beam")
     laser_model_type_ = LASER_MODEL_BEAM;
@@ -601,8 +656,8 @@ void AmclNode::reconfigureCB(AMCLConfig &config, uint32_t level)
   }	
   pf_ = pf_alloc(min_particles_, max_particles_,
                  alpha_slow_, alpha_fast_,
-                 (pf_init_model_fn_t)AmclNode::uniformPoseGenerator,
-                 (void *)map_);
+                 (pf_init_model_fn_t)AmclNode::recoveryPoseGenerator,
+                 (void *)this);
   pf_set_selective_resampling(pf_, selective_resampling_);
   pf_err_ = config.kld_err; 
   pf_z_ = config.kld_z; 
@@ -627,10 +682,20 @@ void AmclNode::reconfigureCB(AMCLConfig &config, uint32_t level)
   odom_ = new AMCLOdom();
   ROS_ASSERT(odom_);
   odom_->SetModel( odom_model_type_, alpha1_, alpha2_, alpha3_, alpha4_, alpha5_ );
+  // The scan matcher scores beams like the laser model
+  delete matcher_;
+  matcher_ = NULL;
+  recovery_seed_valid_ = false;
+  recovery_matched_ = false;
   // Laser
+  loadCachedCspace();
   delete laser_;
   laser_ = new AMCLLaser(max_beams_, map_);
   ROS_ASSERT(laser_);
+  laser_->SetThreadCount(laser_model_threads_);
+  laser_->SetModelLookupTable(laser_model_lookup_table_);
+  laser_->SetAdaptiveBeams(laser_adaptive_beams_);
+  laser_->SetTimeBudget(laser_time_budget_);
   if(laser_model_type_ == LASER_MODEL_BEAM)
     laser_->SetModelBeam(z_hit_, z_short_, z_max_, z_rand_,
                          sigma_hit_, lambda_short_, 0.0);
@@ -903,8 +968,8 @@ AmclNode::handleMapMessage(const nav_msgs::OccupancyGrid& msg)
   // Create the particle filter
   pf_ = pf_alloc(min_particles_, max_particles_,
                  alpha_slow_, alpha_fast_,
-                 (pf_init_model_fn_t)AmclNode::uniformPoseGenerator,
-                 (void *)map_);
+                 (pf_init_model_fn_t)AmclNode::recoveryPoseGenerator,
+                 (void *)this);
   pf_set_selective_resampling(pf_, selective_resampling_);
   pf_->pop_err = pf_err_;
   pf_->pop_z = pf_z_;
@@ -929,9 +994,14 @@ AmclNode::handleMapMessage(const nav_msgs::OccupancyGrid& msg)
   ROS_ASSERT(odom_);
   odom_->SetModel( odom_model_type_, alpha1_, alpha2_, alpha3_, alpha4_, alpha5_ );
   // Laser
+  loadCachedCspace();
   delete laser_;
   laser_ = new AMCLLaser(max_beams_, map_);
   ROS_ASSERT(laser_);
+  laser_->SetThreadCount(laser_model_threads_);
+  laser_->SetModelLookupTable(laser_model_lookup_table_);
+  laser_->SetAdaptiveBeams(laser_adaptive_beams_);
+  laser_->SetTimeBudget(laser_time_budget_);
   if(laser_model_type_ == LASER_MODEL_BEAM)
     laser_->SetModelBeam(z_hit_, z_short_, z_max_, z_rand_,
                          sigma_hit_, lambda_short_, 0.0);
@@ -972,6 +1042,35 @@ AmclNode::freeMapDependentMemory()
   odom_ = NULL;
   delete laser_;
   laser_ = NULL;
+  delete matcher_;
+  matcher_ = NULL;
+  recovery_seed_valid_ = false;
+  recovery_matched_ = false;
+}
+
+/**
+ * Give the map the cspace distances of the likelihood field models from
+ * the cache in map_cache_dir, computing and caching them on a miss.
+ */
+void
+AmclNode::loadCachedCspace()
+{
+  if(map_cache_dir_.empty() || map_ == NULL || laser_model_type_ == LASER_MODEL_BEAM)
+    return;
+  if(map_->occ_dist_field && map_->max_occ_dist == laser_likelihood_max_dist_)
+    return;
+
+  if(map_load_cspace(map_, laser_likelihood_max_dist_, map_cache_dir_.c_str()) == 0)
+  {
+    ROS_INFO("Loaded the likelihood field from the cache in %s", map_cache_dir_.c_str());
+    return;
+  }
+
+  map_update_cspace(map_, laser_likelihood_max_dist_);
+  if(map_save_cspace(map_, map_cache_dir_.c_str()) == 0)
+    ROS_INFO("Saved the likelihood field to the cache in %s", map_cache_dir_.c_str());
+  else
+    ROS_WARN("Failed to save the likelihood field to the cache in %s", map_cache_dir_.c_str());
 }
 
 /**
@@ -1079,6 +1178,46 @@ AmclNode::uniformPoseGenerator(void* arg)
   return p;
 }
 
+pf_vector_t
+AmclNode::recoveryPoseGenerator(void* arg)
+{
+  AmclNode* node = (AmclNode*)arg;
+  if(!node->recovery_seed_valid_ || drand48() < 0.5)
+    return uniformPoseGenerator((void*)node->map_);
+
+  pf_vector_t p = node->recovery_seed_;
+  p.v[0] += pf_ran_gaussian(0.25);
+  p.v[1] += pf_ran_gaussian(0.25);
+  p.v[2] = angle_diff(p.v[2] + pf_ran_gaussian(0.1), 0.0);
+  return p;
+}
+
+/**
+ * Find the robot pose for the scan on the whole map; false if nothing
+ * scores relocalize_min_score.
+ */
+bool
+AmclNode::matchScan(AMCLLaserData& ldata, int laser_index, pf_vector_t* pose)
+{
+  if(matcher_ == NULL)
+    matcher_ = new AMCLScanMatcher(map_, laser_likelihood_max_dist_, sigma_hit_);
+  matcher_->SetMaxBeams(relocalize_beams_);
+  matcher_->SetMinScore(relocalize_min_score_);
+
+  ros::WallTime start = ros::WallTime::now();
+  double score = matcher_->Match(&ldata, lasers_[laser_index]->GetLaserPose(), pose);
+  double ms = (ros::WallTime::now() - start).toSec() * 1000.0;
+  if(score < 0)
+  {
+    ROS_WARN("Global scan match found no pose scoring %.2f (%.1f ms)",
+             relocalize_min_score_, ms);
+    return false;
+  }
+  ROS_INFO("Global scan match at %.3f %.3f %.3f, score %.2f (%.1f ms)",
+           pose->v[0], pose->v[1], pose->v[2], score, ms);
+  return true;
+}
+
 bool
 AmclNode::globalLocalizationCallback(std_srvs::Empty::Request& req,
                                      std_srvs::Empty::Response& res)
@@ -1105,6 +1244,17 @@ AmclNode::nomotionUpdateCallback(std_srvs::Empty::Request& req,
 	return true;
 }
 
+// relocalize from the next scan with the global scan matcher
+bool
+AmclNode::relocalizeCallback(std_srvs::Empty::Request& req,
+                             std_srvs::Empty::Response& res)
+{
+  boost::recursive_mutex::scoped_lock rl(configuration_mutex_);
+  relocalize_requested_ = true;
+  m_force_update = true;
+  return true;
+}
+
 bool
 AmclNode::setMapCallback(nav_msgs::SetMap::Request& req,
                          nav_msgs::SetMap::Response& res)
@@ -1244,9 +1394,9 @@ AmclNode::laserReceived(const sensor_msgs::LaserScanConstPtr& laser_scan)
   // If the robot has moved, update the filter
   if(lasers_update_[laser_index])
   {
-    AMCLLaserData ldata;
+    AMCLLaserData& ldata = laser_data_;
     ldata.sensor = lasers_[laser_index];
-    ldata.range_count = laser_scan->ranges.size();
+    ldata.SetRangeCount(laser_scan->ranges.size());
 
     // To account for lasers that are mounted upside-down, we determine the
     // min, max, and increment angles of the laser in the base frame.
@@ -1298,9 +1448,6 @@ AmclNode::laserReceived(const sensor_msgs::LaserScanConstPtr& laser_scan)
       return; // ignore this.
     }
 
-    // The AMCLLaserData destructor will free this memory
-    ldata.ranges = new double[ldata.range_count][2];
-    ROS_ASSERT(ldata.ranges);
     for(int i=0;i<ldata.range_count;i++)
     {
       // amcl doesn't (yet) have a concept of min range.  So we'll map short
@@ -1316,8 +1463,41 @@ AmclNode::laserReceived(const sensor_msgs::LaserScanConstPtr& laser_scan)
               (i * angle_increment);
     }
 
+    // Restart the filter around the global scan match of this scan
+    if(relocalize_requested_)
+    {
+      relocalize_requested_ = false;
+      pf_vector_t match_pose;
+      if(matchScan(ldata, laser_index, &match_pose))
+      {
+        pf_matrix_t match_cov = pf_matrix_zero();
+        match_cov.m[0][0] = 0.1 * 0.1;
+        match_cov.m[1][1] = 0.1 * 0.1;
+        match_cov.m[2][2] = 0.05 * 0.05;
+        pf_init(pf_, match_pose, match_cov);
+      }
+    }
+
     lasers_[laser_index]->UpdateSensor(pf_, (AMCLSensorData*)&ldata);
 
+    // While the filter is about to inject recovery samples, seed them with
+    // the global scan match of this scan.  A match blocks the scan callback
+    // for tens of milliseconds, so a recovery matches its first scan and
+    // then reuses that seed for recovery_scan_match_interval seconds
+    if(recovery_scan_match_ && pf_->w_slow > 0.0 && pf_->w_fast < pf_->w_slow)
+    {
+      if(!((resample_count_ + 1) % resample_interval_) &&
+         (!recovery_matched_ ||
+          (laser_scan->header.stamp - recovery_match_stamp_).toSec() >= recovery_scan_match_interval_))
+      {
+        recovery_seed_valid_ = matchScan(ldata, laser_index, &recovery_seed_);
+        recovery_matched_ = true;
+        recovery_match_stamp_ = laser_scan->header.stamp;
+      }
+    }
+    else
+      recovery_matched_ = false;
+
     lasers_update_[laser_index] = false;
 
     pf_odom_pose_ = pose;
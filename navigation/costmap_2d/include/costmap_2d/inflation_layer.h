@@ -44,6 +44,8 @@
 #include <costmap_2d/InflationPluginConfig.h>
 #include <dynamic_reconfigure/server.h>
 #include <boost/thread.hpp>
+#include <climits>
+#include <vector>
 
 namespace costmap_2d
 {
@@ -72,6 +74,15 @@ public:
   unsigned int src_x_, src_y_;
 };
 
+/**
+ * @class CellSource
+ * @brief Offset from a cell to the lethal cell it takes its inflation cost from
+ */
+struct CellSource
+{
+  short dx_, dy_;
+};
+
 class InflationLayer : public Layer
 {
 public:
@@ -82,8 +93,6 @@ public:
     deleteKernels();
     if (dsrv_)
         delete dsrv_;
-    if (seen_)
-        delete[] seen_;
   }
 
   virtual void onInitialize();
@@ -136,21 +145,6 @@ protected:
   bool inflate_unknown_;
 
 private:
-  /**
-   * @brief  Lookup pre-computed distances
-   * @param mx The x coordinate of the current cell
-   * @param my The y coordinate of the current cell
-   * @param src_x The x coordinate of the source cell
-   * @param src_y The y coordinate of the source cell
-   * @return
-   */
-  inline double distanceLookup(int mx, int my, int src_x, int src_y)
-  {
-    unsigned int dx = abs(mx - src_x);
-    unsigned int dy = abs(my - src_y);
-    return cached_distances_[dx][dy];
-  }
-
   /**
    * @brief  Lookup pre-computed costs
    * @param mx The x coordinate of the current cell
@@ -175,15 +169,49 @@ private:
     return layered_costmap_->getCostmap()->cellDistance(world_dist);
   }
 
-  inline void enqueue(unsigned int index, unsigned int mx, unsigned int my,
-                      unsigned int src_x, unsigned int src_y);
+  /**
+   * @brief  Give a cell the source at the given offset if that is closer than its current one
+   * @param  index The index of the cell
+   * @param  dx The x offset from the cell to the source
+   * @param  dy The y offset from the cell to the source
+   * @param  bin The bin being processed, lowered if the cell goes into an earlier one
+   */
+  inline void enqueue(unsigned int index, int dx, int dy, unsigned int& bin);
+
+  /**
+   * @brief  Clear the cells within the inflation radius of removed obstacles whose source is gone
+   * @param  size_x The width of the map
+   * @param  size_y The height of the map
+   */
+  void clearRemovedSources(unsigned int size_x, unsigned int size_y);
+
+  /**
+   * @brief  Spread the queued sources to the cells around them, closest first
+   * @param  size_x The width of the map
+   * @param  size_y The height of the map
+   */
+  void propagateSources(unsigned int size_x, unsigned int size_y);
+
+  static const short NO_SOURCE = SHRT_MAX;
 
   unsigned int cell_inflation_radius_;
   unsigned int cached_cell_inflation_radius_;
-  std::map<double, std::vector<CellData> > inflation_cells_;
 
-  bool* seen_;
-  int seen_size_;
+  // The source of every cell of the map, kept between updates so that only
+  // the cells around lethal cells that appeared or disappeared are revisited.
+  // Lethal cells are their own source; cells beyond the inflation radius of
+  // every obstacle have none.
+  std::vector<CellSource> sources_;
+  unsigned int sources_cell_radius_;
+  double sources_origin_x_, sources_origin_y_;
+
+  // Bucket queue of cell indices, by squared distance in cells to their source
+  std::vector<std::vector<unsigned int> > inflation_queue_;
+
+  std::vector<unsigned int> removed_cells_;
+  std::vector<unsigned int> cleared_cells_;
+  std::vector<unsigned int> seed_cells_;
+  std::vector<bool> seen_;
 
   unsigned char** cached_costs_;
   double** cached_distances_;
@@ -34,10 +34,28 @@
 
 #include <geometry_msgs/Point.h>
 #include <sensor_msgs/PointCloud2.h>
+#include <boost/shared_ptr.hpp>
+#include <vector>
 
 namespace costmap_2d
 {
 
+/**
+ * @brief A planar laser scan kept in polar form, with the pose of the scanner in the global frame
+ */
+class PolarScan
+{
+public:
+  PolarScan() :
+    x_(0.0), y_(0.0), z_(0.0), yaw_(0.0), angle_min_(0.0), angle_increment_(0.0)
+  {
+  }
+
+  double x_, y_, z_, yaw_;
+  double angle_min_, angle_increment_;
+  std::vector<float> ranges_;  ///< @brief The range of each beam, negative for beams that return no point
+};
+
 /**
  * @brief Stores an observation in terms of a point cloud and the origin of the source
  * @note Tried to make members and constructor arguments const but the compiler would not accept the default
@@ -79,7 +97,21 @@ public:
    */
   Observation(const Observation& obs) :
       origin_(obs.origin_), cloud_(new sensor_msgs::PointCloud2(*(obs.cloud_))),
-      obstacle_range_(obs.obstacle_range_), raytrace_range_(obs.raytrace_range_)
+      obstacle_range_(obs.obstacle_range_), raytrace_range_(obs.raytrace_range_), scan_(obs.scan_)
+  {
+  }
+
+  /**
+   * @brief  Creates an observation from an origin point and a laser scan kept in polar form
+   * @param origin The origin point of the observation
+   * @param scan The scan of the observation; the cloud only carries its header
+   * @param obstacle_range The range out to which an observation should be able to insert obstacles
+   * @param raytrace_range The range out to which an observation should be able to clear via raytracing
+   */
+  Observation(geometry_msgs::Point& origin, const boost::shared_ptr<const PolarScan>& scan,
+              double obstacle_range, double raytrace_range) :
+      origin_(origin), cloud_(new sensor_msgs::PointCloud2()),
+      obstacle_range_(obstacle_range), raytrace_range_(raytrace_range), scan_(scan)
   {
   }
 
@@ -96,6 +128,7 @@ public:
   geometry_msgs::Point origin_;
   sensor_msgs::PointCloud2* cloud_;
   double obstacle_range_, raytrace_range_;
+  boost::shared_ptr<const PolarScan> scan_;  ///< @brief Set instead of the cloud points for scans kept in polar form
 };
 
 }  // namespace costmap_2d
@@ -45,6 +45,7 @@
 #include <tf2_ros/buffer.h>
 
 #include <sensor_msgs/PointCloud2.h>
+#include <sensor_msgs/LaserScan.h>
 
 // Thread support
 #include <boost/thread.hpp>
@@ -98,6 +99,15 @@ public:
    */
   void bufferCloud(const sensor_msgs::PointCloud2& cloud);
 
+  /**
+   * @brief  Buffers a LaserScan in polar form, with the pose of the scanner in the global frame
+   * <b>Note: The burden is on the user to make sure the transform is available... ie they should use a MessageNotifier</b>
+   * @param  scan The scan to be buffered
+   * @param  inf_is_valid Whether Inf ranges are read as the maximum range rather than as no return
+   * @return False if the scanner is not level in the global frame, so the scan has to be buffered as a cloud
+   */
+  bool bufferScan(const sensor_msgs::LaserScan& scan, bool inf_is_valid);
+
   /**
    * @brief  Pushes copies of all current observations onto the end of the vector passed in
    * @param  observations The vector to be filled
@@ -62,7 +62,8 @@ namespace costmap_2d
 class ObstacleLayer : public CostmapLayer
 {
 public:
-  ObstacleLayer()
+  ObstacleLayer() :
+    beam_angle_min_(0.0), beam_angle_increment_(0.0)
   {
     costmap_ = NULL;  // this is the unsigned char* member of parent class Costmap2D.
   }
@@ -93,6 +94,15 @@ public:
   void laserScanValidInfCallback(const sensor_msgs::LaserScanConstPtr& message,
                                  const boost::shared_ptr<ObservationBuffer>& buffer);
 
+  /**
+   * @brief  A callback to handle buffering LaserScan messages in polar form, projecting those of tilted scanners
+   * @param message The message returned from a message notifier
+   * @param buffer A pointer to the observation buffer to update
+   * @param inf_is_valid Whether Inf ranges are read as the maximum range
+   */
+  void laserScanPolarCallback(const sensor_msgs::LaserScanConstPtr& message,
+                              const boost::shared_ptr<ObservationBuffer>& buffer, bool inf_is_valid);
+
   /**
    * @brief  A callback to handle buffering PointCloud messages
    * @param message The message returned from a message notifier
@@ -144,6 +154,31 @@ protected:
   void updateRaytraceBounds(double ox, double oy, double wx, double wy, double range, double* min_x, double* min_y,
                             double* max_x, double* max_y);
 
+  /**
+   * @brief  Whether the layer can use LaserScan observations kept in polar form
+   */
+  virtual bool supportsPolarScans() const
+  {
+    return true;
+  }
+
+  /**
+   * @brief  Clear freespace based on one observation kept in polar form
+   */
+  void raytracePolarScan(const costmap_2d::Observation& clearing_observation, double* min_x, double* min_y,
+                         double* max_x, double* max_y);
+
+  /**
+   * @brief  Mark the obstacles of one observation kept in polar form
+   */
+  void markPolarScan(const costmap_2d::Observation& marking_observation, double* min_x, double* min_y,
+                     double* max_x, double* max_y);
+
+  /**
+   * @brief  Compute the offsets from the scanner to the beam endpoints of a scan, unless they are those of the last one
+   */
+  void computeScanEndpoints(const boost::shared_ptr<const costmap_2d::PolarScan>& scan);
+
   std::vector<geometry_msgs::Point> transformed_footprint_;
   bool footprint_clearing_enabled_;
   void updateFootprint(double robot_x, double robot_y, double robot_yaw, double* min_x, double* min_y, 
@@ -154,6 +189,11 @@ protected:
 
   laser_geometry::LaserProjection projector_;  ///< @brief Used to project laser scans into point clouds
 
+  std::vector<float> beam_cos_, beam_sin_;  ///< @brief Beam directions in the scanner frame for the last scan angles
+  double beam_angle_min_, beam_angle_increment_;
+  boost::shared_ptr<const costmap_2d::PolarScan> endpoints_scan_;  ///< @brief The scan the endpoints were computed for
+  std::vector<float> endpoint_x_, endpoint_y_;  ///< @brief Offsets of the beam endpoints from the scanner
+
   std::vector<boost::shared_ptr<message_filters::SubscriberBase> > observation_subscribers_;  ///< @brief Used for the observation message filters
   std::vector<boost::shared_ptr<tf2_ros::MessageFilterBase> > observation_notifiers_;  ///< @brief Used to make sure that transforms are available for each sensor
   std::vector<boost::shared_ptr<costmap_2d::ObservationBuffer> > observation_buffers_;  ///< @brief Used to store observations from various sensors
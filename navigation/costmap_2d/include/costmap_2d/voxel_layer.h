@@ -85,6 +85,12 @@ public:
 protected:
   virtual void setupDynamicReconfigure(ros::NodeHandle& nh);
 
+  // voxels need the height of each point, which a scan in polar form does not keep
+  virtual bool supportsPolarScans() const
+  {
+    return false;
+  }
+
   virtual void resetMaps();
 
 private:
@@ -59,8 +59,10 @@ InflationLayer::InflationLayer()
   , inflate_unknown_(false)
   , cell_inflation_radius_(0)
   , cached_cell_inflation_radius_(0)
+  , sources_cell_radius_(0)
+  , sources_origin_x_(0)
+  , sources_origin_y_(0)
   , dsrv_(NULL)
-  , seen_(NULL)
   , cached_costs_(NULL)
   , cached_distances_(NULL)
   , last_min_x_(-std::numeric_limits<float>::max())
@@ -77,10 +79,8 @@ void InflationLayer::onInitialize()
     boost::unique_lock < boost::recursive_mutex > lock(*inflation_access_);
     ros::NodeHandle nh("~/" + name_), g_nh;
     current_ = true;
-    if (seen_)
-      delete[] seen_;
-    seen_ = NULL;
-    seen_size_ = 0;
+    sources_.clear();
+    seen_.clear();
     need_reinflation_ = false;
 
     dynamic_reconfigure::Server<costmap_2d::InflationPluginConfig>::CallbackType cb = boost::bind(
@@ -119,11 +119,9 @@ void InflationLayer::matchSize()
   cell_inflation_radius_ = cellDistance(inflation_radius_);
   computeCaches();
 
-  unsigned int size_x = costmap->getSizeInCellsX(), size_y = costmap->getSizeInCellsY();
-  if (seen_)
-    delete[] seen_;
-  seen_size_ = size_x * size_y;
-  seen_ = new bool[seen_size_];
+  // The sources are rebuilt on the next update
+  sources_.clear();
+  seen_.assign(costmap->getSizeInCellsX() * costmap->getSizeInCellsY(), false);
 }
 
 void InflationLayer::updateBounds(double robot_x, double robot_y, double robot_yaw, double* min_x,
@@ -179,30 +177,81 @@ void InflationLayer::updateCosts(costmap_2d::Costmap2D& master_grid, int min_i,
   if (cell_inflation_radius_ == 0)
     return;
 
-  // make sure the inflation list is empty at the beginning of the cycle (should always be true)
-  ROS_ASSERT_MSG(inflation_cells_.empty(), "The inflation list must be empty at the beginning of inflation");
-
   unsigned char* master_array = master_grid.getCharMap();
   unsigned int size_x = master_grid.getSizeInCellsX(), size_y = master_grid.getSizeInCellsY();
 
-  if (seen_ == NULL) {
-    ROS_WARN("InflationLayer::updateCosts(): seen_ array is NULL");
-    seen_size_ = size_x * size_y;
-    seen_ = new bool[seen_size_];
-  }
-  else if (seen_size_ != size_x * size_y)
+  if (seen_.size() != size_x * size_y)
   {
     ROS_WARN("InflationLayer::updateCosts(): seen_ array size is wrong");
-    delete[] seen_;
-    seen_size_ = size_x * size_y;
-    seen_ = new bool[seen_size_];
+    seen_.assign(size_x * size_y, false);
+  }
+
+  // The sources stay valid from one update to the next as long as the map
+  // keeps its size and origin and the inflation radius does not change.
+  // Otherwise they are rebuilt from every lethal cell of the map.
+  int scan_min_i = min_i, scan_min_j = min_j, scan_max_i = max_i, scan_max_j = max_j;
+  if (sources_.size() != size_x * size_y || sources_cell_radius_ != cell_inflation_radius_ ||
+      sources_origin_x_ != master_grid.getOriginX() || sources_origin_y_ != master_grid.getOriginY())
+  {
+    CellSource none = { NO_SOURCE, NO_SOURCE };
+    sources_.assign(size_x * size_y, none);
+    sources_cell_radius_ = cell_inflation_radius_;
+    sources_origin_x_ = master_grid.getOriginX();
+    sources_origin_y_ = master_grid.getOriginY();
+    inflation_queue_.resize(cell_inflation_radius_ * cell_inflation_radius_ + 1);
+
+    scan_min_i = scan_min_j = 0;
+    scan_max_i = size_x;
+    scan_max_j = size_y;
+    min_i = min_j = 0;
+    max_i = size_x;
+    max_j = size_y;
+  }
+
+  // make sure the inflation queue is empty at the beginning of the cycle (should always be true)
+  for (unsigned int bin = 0; bin < inflation_queue_.size(); ++bin)
+    ROS_ASSERT_MSG(inflation_queue_[bin].empty(), "The inflation queue must be empty at the beginning of inflation");
+
+  // Only cells in the bounding box can have changed since the last update.
+  // Find the lethal cells that appeared or disappeared there: new ones are
+  // their own source and start the inflation, removed ones take the sources
+  // that depended on them away.
+  scan_min_i = std::max(0, scan_min_i);
+  scan_min_j = std::max(0, scan_min_j);
+  scan_max_i = std::min(int(size_x), scan_max_i);
+  scan_max_j = std::min(int(size_y), scan_max_j);
+  for (int j = scan_min_j; j < scan_max_j; j++)
+  {
+    for (int i = scan_min_i; i < scan_max_i; i++)
+    {
+      int index = master_grid.getIndex(i, j);
+      CellSource& source = sources_[index];
+      bool lethal = master_array[index] == LETHAL_OBSTACLE;
+      if (lethal == (source.dx_ == 0 && source.dy_ == 0))
+        continue;
+
+      if (lethal)
+      {
+        source.dx_ = source.dy_ = 0;
+        inflation_queue_[0].push_back(index);
+      }
+      else
+      {
+        source.dx_ = source.dy_ = NO_SOURCE;
+        removed_cells_.push_back(index);
+        cleared_cells_.push_back(index);
+      }
+    }
   }
-  memset(seen_, false, size_x * size_y * sizeof(bool));
+
+  if (!removed_cells_.empty())
+    clearRemovedSources(size_x, size_y);
+  propagateSources(size_x, size_y);
 
   // We need to include in the inflation cells outside the bounding
   // box min_i...max_j, by the amount cell_inflation_radius_.  Cells
-  // up to that distance outside the box can still influence the costs
-  // stored in cells inside the box.
+  // up to that distance outside the box can take their costs from
+  // obstacles inside the box.
   min_i -= cell_inflation_radius_;
   min_j -= cell_inflation_radius_;
   max_i += cell_inflation_radius_;
@@ -213,96 +262,157 @@ void InflationLayer::updateCosts(costmap_2d::Costmap2D& master_grid, int min_i,
   max_i = std::min(int(size_x), max_i);
   max_j = std::min(int(size_y), max_j);
 
-  // Inflation list; we append cells to visit in a list associated with its distance to the nearest obstacle
-  // We use a map<distance, list> to emulate the priority queue used before, with a notable performance boost
-
-  // Start with lethal obstacles: by definition distance is 0.0
-  std::vector<CellData>& obs_bin = inflation_cells_[0.0];
   for (int j = min_j; j < max_j; j++)
   {
     for (int i = min_i; i < max_i; i++)
     {
       int index = master_grid.getIndex(i, j);
-      unsigned char cost = master_array[index];
-      if (cost == LETHAL_OBSTACLE)
-      {
-        obs_bin.push_back(CellData(index, i, j, i, j));
-      }
+      const CellSource& source = sources_[index];
+      if (source.dx_ == NO_SOURCE)
+        continue;
+
+      // assign the cost associated with the distance from an obstacle to the cell
+      unsigned char cost = cached_costs_[abs(source.dx_)][abs(source.dy_)];
+      unsigned char old_cost = master_array[index];
+      if (old_cost == NO_INFORMATION && (inflate_unknown_ ? (cost > FREE_SPACE) : (cost >= INSCRIBED_INFLATED_OBSTACLE)))
+        master_array[index] = cost;
+      else
+        master_array[index] = std::max(old_cost, cost);
     }
   }
+}
 
-  // Process cells by increasing distance; new cells are appended to the corresponding distance bin, so they
-  // can overtake previously inserted but farther away cells
-  std::map<double, std::vector<CellData> >::iterator bin;
-  for (bin = inflation_cells_.begin(); bin != inflation_cells_.end(); ++bin)
+/**
+ * @brief  Clear the source of every cell that took it from a lethal cell which is gone,
+ * then queue the cells next to the cleared ones so that their sources spread back into them
+ */
+void InflationLayer::clearRemovedSources(unsigned int size_x, unsigned int size_y)
+{
+  // A cell is never farther than the inflation radius from its source, so
+  // the cells that lost theirs are all in the boxes around removed cells
+  int radius = cell_inflation_radius_;
+  for (unsigned int k = 0; k < removed_cells_.size(); ++k)
   {
-    for (int i = 0; i < bin->second.size(); ++i)
+    int mx = removed_cells_[k] % size_x;
+    int my = removed_cells_[k] / size_x;
+    int x0 = std::max(0, mx - radius), x1 = std::min(int(size_x) - 1, mx + radius);
+    int y0 = std::max(0, my - radius), y1 = std::min(int(size_y) - 1, my + radius);
+    for (int y = y0; y <= y1; ++y)
     {
-      // process all cells at distance dist_bin.first
-      const CellData& cell = bin->second[i];
+      for (int x = x0; x <= x1; ++x)
+      {
+        unsigned int index = y * size_x + x;
+        CellSource& source = sources_[index];
+        if (source.dx_ == NO_SOURCE)
+          continue;
 
-      unsigned int index = cell.index_;
+        const CellSource& obstacle = sources_[(y + source.dy_) * size_x + x + source.dx_];
+        if (obstacle.dx_ == 0 && obstacle.dy_ == 0)
+          continue;
 
-      // ignore if already visited
-      if (seen_[index])
-      {
-        continue;
+        source.dx_ = source.dy_ = NO_SOURCE;
+        cleared_cells_.push_back(index);
       }
+    }
+  }
+  removed_cells_.clear();
 
-      seen_[index] = true;
+  for (unsigned int k = 0; k < cleared_cells_.size(); ++k)
+  {
+    unsigned int index = cleared_cells_[k];
+    unsigned int mx = index % size_x;
+    unsigned int my = index / size_x;
+    unsigned int neighbors[4];
+    int neighbor_count = 0;
+    if (mx > 0)
+      neighbors[neighbor_count++] = index - 1;
+    if (my > 0)
+      neighbors[neighbor_count++] = index - size_x;
+    if (mx < size_x - 1)
+      neighbors[neighbor_count++] = index + 1;
+    if (my < size_y - 1)
+      neighbors[neighbor_count++] = index + size_x;
+
+    for (int n = 0; n < neighbor_count; ++n)
+    {
+      unsigned int neighbor = neighbors[n];
+      const CellSource& source = sources_[neighbor];
+      if (source.dx_ == NO_SOURCE || seen_[neighbor])
+        continue;
 
-      unsigned int mx = cell.x_;
-      unsigned int my = cell.y_;
-      unsigned int sx = cell.src_x_;
-      unsigned int sy = cell.src_y_;
+      seen_[neighbor] = true;
+      seed_cells_.push_back(neighbor);
+      inflation_queue_[source.dx_ * source.dx_ + source.dy_ * source.dy_].push_back(neighbor);
+    }
+  }
+  cleared_cells_.clear();
 
-      // assign the cost associated with the distance from an obstacle to the cell
-      unsigned char cost = costLookup(mx, my, sx, sy);
-      unsigned char old_cost = master_array[index];
-      if (old_cost == NO_INFORMATION && (inflate_unknown_ ? (cost > FREE_SPACE) : (cost >= INSCRIBED_INFLATED_OBSTACLE)))
-        master_array[index] = cost;
-      else
-        master_array[index] = std::max(old_cost, cost);
+  // Only the seeded cells were marked
+  for (unsigned int k = 0; k < seed_cells_.size(); ++k)
+    seen_[seed_cells_[k]] = false;
+  seed_cells_.clear();
+}
 
-      // attempt to put the neighbors of the current cell onto the inflation list
-      if (mx > 0)
-        enqueue(index - 1, mx - 1, my, sx, sy);
-      if (my > 0)
-        enqueue(index - size_x, mx, my - 1, sx, sy);
-      if (mx < size_x - 1)
-        enqueue(index + 1, mx + 1, my, sx, sy);
-      if (my < size_y - 1)
-        enqueue(index + size_x, mx, my + 1, sx, sy);
+void InflationLayer::propagateSources(unsigned int size_x, unsigned int size_y)
+{
+  // Process cells by increasing distance; a cell may be queued again when a
+  // closer source reaches it, and only its latest entry is expanded
+  unsigned int bin = 0;
+  while (bin < inflation_queue_.size())
+  {
+    std::vector<unsigned int>& cells = inflation_queue_[bin];
+    if (cells.empty())
+    {
+      ++bin;
+      continue;
     }
-  }
 
-  inflation_cells_.clear();
+    unsigned int index = cells.back();
+    cells.pop_back();
+
+    CellSource source = sources_[index];
+    if (source.dx_ == NO_SOURCE || source.dx_ * source.dx_ + source.dy_ * source.dy_ != int(bin))
+      continue;
+
+    unsigned int mx = index % size_x;
+    unsigned int my = index / size_x;
+
+    // attempt to pass the source on to the neighbors of the current cell
+    if (mx > 0)
+      enqueue(index - 1, source.dx_ + 1, source.dy_, bin);
+    if (my > 0)
+      enqueue(index - size_x, source.dx_, source.dy_ + 1, bin);
+    if (mx < size_x - 1)
+      enqueue(index + 1, source.dx_ - 1, source.dy_, bin);
+    if (my < size_y - 1)
+      enqueue(index + size_x, source.dx_, source.dy_ - 1, bin);
+  }
 }
 
 /**
- * @brief  Given an index of a cell in the costmap, place it into a list pending for obstacle inflation
- * @param  grid The costmap
+ * @brief  Given an index of a cell in the costmap, give it the source at the given offset and
+ * queue it if that source is within the inflation radius and closer than its current one
  * @param  index The index of the cell
- * @param  mx The x coordinate of the cell (can be computed from the index, but saves time to store it)
- * @param  my The y coordinate of the cell (can be computed from the index, but saves time to store it)
- * @param  src_x The x index of the obstacle point inflation started at
- * @param  src_y The y index of the obstacle point inflation started at
+ * @param  dx The x offset from the cell to the source
+ * @param  dy The y offset from the cell to the source
+ * @param  bin The bin being processed, lowered to the bin of the cell if that comes first
  */
-inline void InflationLayer::enqueue(unsigned int index, unsigned int mx, unsigned int my,
-                                    unsigned int src_x, unsigned int src_y)
+inline void InflationLayer::enqueue(unsigned int index, int dx, int dy, unsigned int& bin)
 {
-  if (!seen_[index])
-  {
-    // we compute our distance table one cell further than the inflation radius dictates so we can make the check below
-    double distance = distanceLookup(mx, my, src_x, src_y);
+  // we only want to put the cell in the queue if it is within the inflation radius of the obstacle point
+  unsigned int distance = dx * dx + dy * dy;
+  if (distance >= inflation_queue_.size())
+    return;
 
-    // we only want to put the cell in the list if it is within the inflation radius of the obstacle point
-    if (distance > cell_inflation_radius_)
-      return;
+  CellSource& source = sources_[index];
+  if (source.dx_ != NO_SOURCE && int(distance) >= source.dx_ * source.dx_ + source.dy_ * source.dy_)
+    return;
 
-    // push the cell data onto the inflation list and mark
-    inflation_cells_[distance].push_back(CellData(index, mx, my, src_x, src_y));
-  }
+  source.dx_ = dx;
+  source.dy_ = dy;
+  inflation_queue_[distance].push_back(index);
+  if (distance < bin)
+    bin = distance;
 }
 
 void InflationLayer::computeCaches()
@@ -42,6 +42,9 @@
 #include <pluginlib/class_list_macros.h>
 #include <sensor_msgs/point_cloud2_iterator.h>
 
+#include <climits>
+#include <limits>
+
 PLUGINLIB_EXPORT_CLASS(costmap_2d::ObstacleLayer, costmap_2d::Layer)
 
 using costmap_2d::NO_INFORMATION;
@@ -89,7 +92,7 @@ void ObstacleLayer::onInitialize()
     // get the parameters for the specific topic
     double observation_keep_time, expected_update_rate, min_obstacle_height, max_obstacle_height;
     std::string topic, sensor_frame, data_type;
-    bool inf_is_valid, clearing, marking;
+    bool inf_is_valid, clearing, marking, polar_scan;
 
     source_node.param("topic", topic, source);
     source_node.param("sensor_frame", sensor_frame, std::string(""));
@@ -101,6 +104,13 @@ void ObstacleLayer::onInitialize()
     source_node.param("inf_is_valid", inf_is_valid, false);
     source_node.param("clearing", clearing, false);
     source_node.param("marking", marking, true);
+    source_node.param("polar_scan", polar_scan, false);
+
+    if (polar_scan && !supportsPolarScans())
+    {
+      ROS_WARN("obstacle_layer: %s does not support the polar_scan option, scans will be projected.", name_.c_str());
+      polar_scan = false;
+    }
 
     if (!(data_type == "PointCloud2" || data_type == "PointCloud" || data_type == "LaserScan"))
     {
@@ -156,7 +166,12 @@ void ObstacleLayer::onInitialize()
       boost::shared_ptr<tf2_ros::MessageFilter<sensor_msgs::LaserScan> > filter(
         new tf2_ros::MessageFilter<sensor_msgs::LaserScan>(*sub, *tf_, global_frame_, 50, g_nh));
 
-      if (inf_is_valid)
+      if (polar_scan)
+      {
+        filter->registerCallback(boost::bind(&ObstacleLayer::laserScanPolarCallback, this, _1,
+                                            observation_buffers_.back(), inf_is_valid));
+      }
+      else if (inf_is_valid)
       {
         filter->registerCallback(boost::bind(&ObstacleLayer::laserScanValidInfCallback, this, _1,
                                             observation_buffers_.back()));
@@ -181,6 +196,11 @@ void ObstacleLayer::onInitialize()
        ROS_WARN("obstacle_layer: inf_is_valid option is not applicable to PointCloud observations.");
       }
 
+      if (polar_scan)
+      {
+       ROS_WARN("obstacle_layer: polar_scan option is not applicable to PointCloud observations.");
+      }
+
         boost::shared_ptr < tf2_ros::MessageFilter<sensor_msgs::PointCloud>
         > filter(new tf2_ros::MessageFilter<sensor_msgs::PointCloud>(*sub, *tf_, global_frame_, 50, g_nh));
         filter->registerCallback(
@@ -199,6 +219,11 @@ void ObstacleLayer::onInitialize()
        ROS_WARN("obstacle_layer: inf_is_valid option is not applicable to PointCloud observations.");
       }
 
+      if (polar_scan)
+      {
+       ROS_WARN("obstacle_layer: polar_scan option is not applicable to PointCloud observations.");
+      }
+
       boost::shared_ptr < tf2_ros::MessageFilter<sensor_msgs::PointCloud2>
       > filter(new tf2_ros::MessageFilter<sensor_msgs::PointCloud2>(*sub, *tf_, global_frame_, 50, g_nh));
       filter->registerCallback(
@@ -314,6 +339,23 @@ void ObstacleLayer::laserScanValidInfCallback(const sensor_msgs::LaserScanConstP
   buffer->unlock();
 }
 
+void ObstacleLayer::laserScanPolarCallback(const sensor_msgs::LaserScanConstPtr& message,
+                                           const boost::shared_ptr<ObservationBuffer>& buffer, bool inf_is_valid)
+{
+  // buffer the scan as it is, with the pose of the scanner
+  buffer->lock();
+  bool buffered = buffer->bufferScan(*message, inf_is_valid);
+  buffer->unlock();
+  if (buffered)
+    return;
+
+  // the scanner is tilted, so its points are at different heights: project them
+  if (inf_is_valid)
+    laserScanValidInfCallback(message, buffer);
+  else
+    laserScanCallback(message, buffer);
+}
+
 void ObstacleLayer::pointCloudCallback(const sensor_msgs::PointCloudConstPtr& message,
                                                const boost::shared_ptr<ObservationBuffer>& buffer)
 {
@@ -370,6 +412,12 @@ void ObstacleLayer::updateBounds(double robot_x, double robot_y, double robot_ya
   {
     const Observation& obs = *it;
 
+    if (obs.scan_)
+    {
+      markPolarScan(obs, min_x, min_y, max_x, max_y);
+      continue;
+    }
+
     const sensor_msgs::PointCloud2& cloud = *(obs.cloud_);
 
     double sq_obstacle_range = obs.obstacle_range_ * obs.obstacle_range_;
@@ -500,6 +548,12 @@ bool ObstacleLayer::getClearingObservations(std::vector<Observation>& clearing_o
 void ObstacleLayer::raytraceFreespace(const Observation& clearing_observation, double* min_x, double* min_y,
                                               double* max_x, double* max_y)
 {
+  if (clearing_observation.scan_)
+  {
+    raytracePolarScan(clearing_observation, min_x, min_y, max_x, max_y);
+    return;
+  }
+
   double ox = clearing_observation.origin_.x;
   double oy = clearing_observation.origin_.y;
   const sensor_msgs::PointCloud2 &cloud = *(clearing_observation.cloud_);
@@ -580,6 +634,202 @@ void ObstacleLayer::raytraceFreespace(const Observation& clearing_observation, d
   }
 }
 
+void ObstacleLayer::computeScanEndpoints(const boost::shared_ptr<const PolarScan>& scan)
+{
+  // a scan that both marks and clears is only done once
+  if (scan == endpoints_scan_)
+    return;
+  endpoints_scan_ = scan;
+
+  // the directions of the beams only change with the angles of the scan
+  unsigned int count = scan->ranges_.size();
+  if (beam_cos_.size() != count || beam_angle_min_ != scan->angle_min_
+      || beam_angle_increment_ != scan->angle_increment_)
+  {
+    beam_cos_.resize(count);
+    beam_sin_.resize(count);
+    for (unsigned int i = 0; i < count; ++i)
+    {
+      double angle = scan->angle_min_ + i * scan->angle_increment_;
+      beam_cos_[i] = cos(angle);
+      beam_sin_[i] = sin(angle);
+    }
+    beam_angle_min_ = scan->angle_min_;
+    beam_angle_increment_ = scan->angle_increment_;
+  }
+
+  // rotate them by the heading of the scanner and scale them by the ranges,
+  // in a loop the compiler can vectorize
+  endpoint_x_.resize(count);
+  endpoint_y_.resize(count);
+  float c = cos(scan->yaw_), s = sin(scan->yaw_);
+  const float* ranges = scan->ranges_.data();
+  const float* beam_cos = beam_cos_.data();
+  const float* beam_sin = beam_sin_.data();
+  float* endpoint_x = endpoint_x_.data();
+  float* endpoint_y = endpoint_y_.data();
+  for (unsigned int i = 0; i < count; ++i)
+  {
+    endpoint_x[i] = ranges[i] * (beam_cos[i] * c - beam_sin[i] * s);
+    endpoint_y[i] = ranges[i] * (beam_sin[i] * c + beam_cos[i] * s);
+  }
+}
+
+void ObstacleLayer::markPolarScan(const Observation& obs, double* min_x, double* min_y,
+                                  double* max_x, double* max_y)
+{
+  const PolarScan& scan = *(obs.scan_);
+
+  // all the points of the scan are at the height of the scanner
+  if (scan.z_ > max_obstacle_height_)
+  {
+    ROS_DEBUG("The scan is too high");
+    return;
+  }
+
+  computeScanEndpoints(obs.scan_);
+
+  double sq_obstacle_range = obs.obstacle_range_ * obs.obstacle_range_;
+  double dz = scan.z_ - obs.origin_.z;
+
+  // the bounds are touched once with the corners of the marked points
+  double touch_min_x = std::numeric_limits<double>::max(), touch_min_y = touch_min_x;
+  double touch_max_x = -touch_min_x, touch_max_y = -touch_min_x;
+
+  for (unsigned int i = 0; i < scan.ranges_.size(); ++i)
+  {
+    if (scan.ranges_[i] < 0)
+      continue;
+
+    double px = scan.x_ + endpoint_x_[i], py = scan.y_ + endpoint_y_[i];
+
+    // if the point is far enough away from the origin... we won't consider it
+    double sq_dist = (px - obs.origin_.x) * (px - obs.origin_.x) + (py - obs.origin_.y) * (py - obs.origin_.y)
+        + dz * dz;
+    if (sq_dist >= sq_obstacle_range)
+      continue;
+
+    unsigned int mx, my;
+    if (!worldToMap(px, py, mx, my))
+      continue;
+
+    costmap_[getIndex(mx, my)] = LETHAL_OBSTACLE;
+    touch_min_x = std::min(touch_min_x, px);
+    touch_min_y = std::min(touch_min_y, py);
+    touch_max_x = std::max(touch_max_x, px);
+    touch_max_y = std::max(touch_max_y, py);
+  }
+
+  if (touch_min_x <= touch_max_x)
+  {
+    touch(touch_min_x, touch_min_y, min_x, min_y, max_x, max_y);
+    touch(touch_max_x, touch_max_y, min_x, min_y, max_x, max_y);
+  }
+}
+
+void ObstacleLayer::raytracePolarScan(const Observation& clearing_observation, double* min_x, double* min_y,
+                                      double* max_x, double* max_y)
+{
+  double ox = clearing_observation.origin_.x;
+  double oy = clearing_observation.origin_.y;
+  const PolarScan& scan = *(clearing_observation.scan_);
+
+  // get the map coordinates of the origin of the sensor
+  unsigned int x0, y0;
+  if (!worldToMap(ox, oy, x0, y0))
+  {
+    ROS_WARN_THROTTLE(
+        1.0, "The origin for the sensor at (%.2f, %.2f) is out of map bounds. So, the costmap cannot raytrace for it.",
+        ox, oy);
+    return;
+  }
+
+  // we can pre-compute the enpoints of the map outside of the inner loop... we'll need these later
+  double origin_x = origin_x_, origin_y = origin_y_;
+  double map_end_x = origin_x + size_x_ * resolution_;
+  double map_end_y = origin_y + size_y_ * resolution_;
+
+  computeScanEndpoints(clearing_observation.scan_);
+
+  double range = clearing_observation.raytrace_range_;
+  unsigned int cell_raytrace_range = cellDistance(range);
+  MarkCell marker(costmap_, FREE_SPACE);
+
+  // the bounds are touched once with the corners of the traced rays
+  double touch_min_x = ox, touch_min_y = oy, touch_max_x = ox, touch_max_y = oy;
+  unsigned int last_x1 = UINT_MAX, last_y1 = UINT_MAX;
+
+  for (unsigned int i = 0; i < scan.ranges_.size(); ++i)
+  {
+    if (scan.ranges_[i] < 0)
+      continue;
+
+    double wx = scan.x_ + endpoint_x_[i];
+    double wy = scan.y_ + endpoint_y_[i];
+
+    // now we also need to make sure that the enpoint we're raytracing
+    // to isn't off the costmap and scale if necessary
+    double a = wx - ox;
+    double b = wy - oy;
+
+    // the minimum value to raytrace from is the origin
+    if (wx < origin_x)
+    {
+      double t = (origin_x - ox) / a;
+      wx = origin_x;
+      wy = oy + b * t;
+    }
+    if (wy < origin_y)
+    {
+      double t = (origin_y - oy) / b;
+      wx = ox + a * t;
+      wy = origin_y;
+    }
+
+    // the maximum value to raytrace to is the end of the map
+    if (wx > map_end_x)
+    {
+      double t = (map_end_x - ox) / a;
+      wx = map_end_x - .001;
+      wy = oy + b * t;
+    }
+    if (wy > map_end_y)
+    {
+      double t = (map_end_y - oy) / b;
+      wx = ox + a * t;
+      wy = map_end_y - .001;
+    }
+
+    // now that the vector is scaled correctly... we'll get the map coordinates of its endpoint
+    unsigned int x1, y1;
+
+    // check for legality just in case
+    if (!worldToMap(wx, wy, x1, y1))
+      continue;
+
+    // the part of the ray within the raytrace range bounds the update
+    double dx = wx - ox, dy = wy - oy;
+    double scale = std::min(1.0, range / hypot(dx, dy));
+    double ex = ox + dx * scale, ey = oy + dy * scale;
+    touch_min_x = std::min(touch_min_x, ex);
+    touch_min_y = std::min(touch_min_y, ey);
+    touch_max_x = std::max(touch_max_x, ex);
+    touch_max_y = std::max(touch_max_y, ey);
+
+    // neighboring beams often end in the same cell, and then clear the same cells
+    if (x1 == last_x1 && y1 == last_y1)
+      continue;
+    last_x1 = x1;
+    last_y1 = y1;
+
+    // and finally... we can execute our trace to clear obstacles along that line
+    raytraceLine(marker, x0, y0, x1, y1, cell_raytrace_range);
+  }
+
+  touch(touch_min_x, touch_min_y, min_x, min_y, max_x, max_y);
+  touch(touch_max_x, touch_max_y, min_x, min_y, max_x, max_y);
+}
+
 void ObstacleLayer::activate()
 {
   // if we're stopped we need to re-subscribe to topics
@@ -39,6 +39,7 @@
 #include <tf2_geometry_msgs/tf2_geometry_msgs.h>
 #include <tf2_sensor_msgs/tf2_sensor_msgs.h>
 #include <sensor_msgs/point_cloud2_iterator.h>
+#include <cmath>
 
 using namespace std;
 using namespace tf2;
@@ -91,6 +92,29 @@ bool ObservationBuffer::setGlobalFrame(const std::string new_global_frame)
 
       // we also need to transform the cloud of the observation to the new global frame
       tf2_buffer_.transform(*(obs.cloud_), *(obs.cloud_), new_global_frame);
+
+      // and the pose of the scanner for scans kept in polar form
+      if (obs.scan_)
+      {
+        geometry_msgs::PointStamped position, heading;
+        position.header = origin.header;
+        position.header.frame_id = global_frame_;
+        position.point.x = obs.scan_->x_;
+        position.point.y = obs.scan_->y_;
+        position.point.z = obs.scan_->z_;
+        heading = position;
+        heading.point.x += cos(obs.scan_->yaw_);
+        heading.point.y += sin(obs.scan_->yaw_);
+        tf2_buffer_.transform(position, position, new_global_frame);
+        tf2_buffer_.transform(heading, heading, new_global_frame);
+
+        boost::shared_ptr<PolarScan> scan(new PolarScan(*obs.scan_));
+        scan->x_ = position.point.x;
+        scan->y_ = position.point.y;
+        scan->z_ = position.point.z;
+        scan->yaw_ = atan2(heading.point.y - position.point.y, heading.point.x - position.point.x);
+        obs.scan_ = scan;
+      }
     }
     catch (TransformException& ex)
     {
@@ -188,6 +212,77 @@ void ObservationBuffer::bufferCloud(const sensor_msgs::PointCloud2& cloud)
   purgeStaleObservations();
 }
 
+bool ObservationBuffer::bufferScan(const sensor_msgs::LaserScan& scan, bool inf_is_valid)
+{
+  // check whether the origin frame has been set explicitly or whether we should get it from the scan
+  string origin_frame = sensor_frame_ == "" ? scan.header.frame_id : sensor_frame_;
+
+  geometry_msgs::PointStamped global_origin;
+  geometry_msgs::TransformStamped scanner;
+  try
+  {
+    geometry_msgs::PointStamped local_origin;
+    local_origin.header.stamp = scan.header.stamp;
+    local_origin.header.frame_id = origin_frame;
+    local_origin.point.x = 0;
+    local_origin.point.y = 0;
+    local_origin.point.z = 0;
+    tf2_buffer_.transform(local_origin, global_origin, global_frame_);
+
+    scanner = tf2_buffer_.lookupTransform(global_frame_, scan.header.frame_id, scan.header.stamp);
+  }
+  catch (TransformException& ex)
+  {
+    ROS_ERROR("TF Exception that should never happen for sensor frame: %s, scan frame: %s, %s", sensor_frame_.c_str(),
+              scan.header.frame_id.c_str(), ex.what());
+    return true;
+  }
+
+  // The beams stay in the plane of the scanner, so the scanner has to be
+  // level and upright for the scan to be kept in polar form
+  const geometry_msgs::Quaternion& q = scanner.transform.rotation;
+  double tilt_x = 2 * (q.x * q.z - q.w * q.y);
+  double tilt_y = 2 * (q.y * q.z + q.w * q.x);
+  double up = 1 - 2 * (q.x * q.x + q.y * q.y);
+  if (fabs(tilt_x) > 1e-3 || fabs(tilt_y) > 1e-3 || up < 0)
+    return false;
+
+  boost::shared_ptr<PolarScan> polar(new PolarScan());
+  polar->x_ = scanner.transform.translation.x;
+  polar->y_ = scanner.transform.translation.y;
+  polar->z_ = scanner.transform.translation.z;
+  polar->yaw_ = atan2(2 * (q.w * q.z + q.x * q.y), 1 - 2 * (q.y * q.y + q.z * q.z));
+  polar->angle_min_ = scan.angle_min;
+  polar->angle_increment_ = scan.angle_increment;
+
+  // every point of the scan is at the height of the scanner, so they are
+  // all within our height bounds or none is
+  if (polar->z_ <= max_obstacle_height_ && polar->z_ >= min_obstacle_height_)
+  {
+    // keep the ranges that a projection of the scan would turn into points
+    float epsilon = 0.0001;  // a tenth of a millimeter
+    polar->ranges_.resize(scan.ranges.size());
+    for (size_t i = 0; i < scan.ranges.size(); ++i)
+    {
+      float range = scan.ranges[i];
+      if (inf_is_valid && !std::isfinite(range) && range > 0)
+        range = scan.range_max - epsilon;
+      polar->ranges_[i] = (range < scan.range_max && range >= scan.range_min) ? range : -1.0f;
+    }
+  }
+
+  observation_list_.push_front(Observation(global_origin.point, polar, obstacle_range_, raytrace_range_));
+  observation_list_.front().cloud_->header.stamp = scan.header.stamp;
+  observation_list_.front().cloud_->header.frame_id = global_frame_;
+
+  // if the update was successful, we want to update the last updated time
+  last_updated_ = ros::Time::now();
+
+  // we'll also remove any stale observations from the list
+  purgeStaleObservations();
+  return true;
+}
+
 // returns a copy of the observations
 void ObservationBuffer::getObservations(vector<Observation>& observations)
 {
@@ -409,6 +409,46 @@ TEST(costmap, testInflation3){
   ASSERT_EQ(countValues(*costmap, INSCRIBED_INFLATED_OBSTACLE), (unsigned int)4);
 }
 
+/**
+ * Test that the inflation around an obstacle goes away with it, and that
+ * the inflation of the other obstacles is kept
+ */
+TEST(costmap, testInflationOfRemovedObstacle){
+  tf2_ros::Buffer tf;
+  LayeredCostmap layers("frame", false, false);
+  layers.resizeMap(10, 10, 1, 0, 0);
+
+  // 1 2 3
+  std::vector<Point> polygon = setRadii(layers, 1, 1.75, 3);
+
+  ObstacleLayer* olayer = addObstacleLayer(layers, tf);
+  InflationLayer* ilayer = addInflationLayer(layers, tf);
+  layers.setFootprint(polygon);
+
+  addObservation(olayer, 5, 5, MAX_Z);
+  addObservation(olayer, 1, 8, MAX_Z);
+  layers.updateMap(0,0,0);
+
+  Costmap2D* costmap = layers.getCostmap();
+  ASSERT_EQ(countValues(*costmap, LETHAL_OBSTACLE), (unsigned int)2);
+  ASSERT_EQ(costmap->getCost(5, 6), INSCRIBED_INFLATED_OBSTACLE);
+
+  // Clear the diagonal through <5, 5>, marking <9, 9> instead
+  olayer->clearStaticObservations(true, true);
+  addObservation(olayer, 1, 8, MAX_Z);
+  addObservation(olayer, 9.5, 9.5, MAX_Z/2, 0.5, 0.5, MAX_Z/2);
+  layers.updateMap(0,0,0);
+
+  ASSERT_EQ(countValues(*costmap, LETHAL_OBSTACLE), (unsigned int)2);
+  ASSERT_EQ(costmap->getCost(5, 5), FREE_SPACE);
+  ASSERT_EQ(costmap->getCost(5, 6), FREE_SPACE);
+  ASSERT_EQ(costmap->getCost(4, 5), FREE_SPACE);
+  ASSERT_EQ(costmap->getCost(9, 9), LETHAL_OBSTACLE);
+  ASSERT_EQ(costmap->getCost(8, 9), INSCRIBED_INFLATED_OBSTACLE);
+  ASSERT_EQ(costmap->getCost(1, 8), LETHAL_OBSTACLE);
+  ASSERT_EQ(costmap->getCost(1, 7), INSCRIBED_INFLATED_OBSTACLE);
+  ASSERT_EQ(costmap->getCost(2, 8), INSCRIBED_INFLATED_OBSTACLE);
+}
 
 int main(int argc, char** argv){
   ros::init(argc, argv, "inflation_tests");
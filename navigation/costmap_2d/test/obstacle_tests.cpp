@@ -175,6 +175,46 @@ TEST(costmap, testWaveInterference){
   ASSERT_EQ(5, countValues(*costmap, costmap_2d::FREE_SPACE));
 }
 
+/**
+ * Test marking and clearing with a scan kept in polar form
+ */
+TEST(costmap, testPolarScan){
+  tf2_ros::Buffer tf;
+
+  // Start with an empty map, no rolling window, tracking unknown
+  LayeredCostmap layers("frame", false, true);
+  layers.resizeMap(10, 10, 1, 0, 0);
+  ObstacleLayer* olayer = addObstacleLayer(layers, tf);
+
+  // A scanner in the middle of <0,0> with a beam along each axis and one
+  // in between that returns nothing
+  boost::shared_ptr<PolarScan> scan(new PolarScan());
+  scan->x_ = 0.5;
+  scan->y_ = 0.5;
+  scan->z_ = MAX_Z/2;
+  scan->angle_increment_ = M_PI/4;
+  scan->ranges_.push_back(4.0);
+  scan->ranges_.push_back(-1.0);
+  scan->ranges_.push_back(4.0);
+
+  geometry_msgs::Point p;
+  p.x = 0.5;
+  p.y = 0.5;
+  p.z = MAX_Z/2;
+  Observation obs(p, scan, 100.0, 100.0);
+  olayer->addStaticObservation(obs, true, true);
+  layers.updateMap(0,0,0);
+
+  // <4,0> and <0,4> are filled, the cells from <0,0> to them are free
+  Costmap2D* costmap = layers.getCostmap();
+  //printMap(*costmap);
+  ASSERT_EQ(LETHAL_OBSTACLE, costmap->getCost(4, 0));
+  ASSERT_EQ(LETHAL_OBSTACLE, costmap->getCost(0, 4));
+  ASSERT_EQ(2, countValues(*costmap, costmap_2d::LETHAL_OBSTACLE));
+  ASSERT_EQ(7, countValues(*costmap, costmap_2d::FREE_SPACE));
+  ASSERT_EQ(91, countValues(*costmap, costmap_2d::NO_INFORMATION));
+}
+
 /**
  * Make sure we ignore points outside of our z threshold
  */
@@ -72,6 +72,23 @@ void loadMapFromFile(nav_msgs::GetMap::Response* resp,
                      const char* fname, double res, bool negate,
                      double occ_th, double free_th, double* origin,
                      MapMode mode=TRINARY);
+
+/** Read the map like loadMapFromFile, through a cache of decoded maps in
+ * cache_dir.  Cache entries are keyed by a hash of the image file and of
+ * the parameters that decode it, and are mapped and copied into resp, so
+ * a map that was loaded before is not decoded again.  A missing or stale
+ * entry is (re)written after decoding the image.
+ *
+ * @param cache_dir The directory holding the cache; it is created if
+ *                  needed
+ * @return True if the map was read from the cache
+ * @throws std::runtime_error If the image file can't be loaded
+ * */
+bool loadMapFromCachedFile(nav_msgs::GetMap::Response* resp,
+                           const char* fname, const char* cache_dir,
+                           double res, bool negate,
+                           double occ_th, double free_th, double* origin,
+                           MapMode mode=TRINARY);
 }
 
 #endif
@@ -0,0 +1,62 @@
+/*
+ * Copyright (c) 2008, Willow Garage, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef MAP_SERVER_MAP_CACHE_HASH_H
+#define MAP_SERVER_MAP_CACHE_HASH_H
+
+/*
+ * Hash used by the map caches of map_server and amcl to name entries and
+ * check their payload.  Both caches write an entry to a temporary file
+ * and rename it over the old one, so that readers never see a partial
+ * entry.  Plain C, so that amcl's map library can include it.
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+/** Initial value to start a hash from */
+#define MAP_CACHE_HASH_SEED 0xcbf29ce484222325ULL
+
+/** FNV-1a over 64-bit words, with a shift to fold the high bits back down */
+static inline uint64_t map_cache_hash(uint64_t hash, const void *data, size_t size)
+{
+  const unsigned char *p = (const unsigned char*) data;
+  uint64_t word;
+
+  for (; size >= 8; p += 8, size -= 8)
+  {
+    memcpy(&word, p, 8);
+    hash = (hash ^ word) * 0x100000001b3ULL;
+    hash ^= hash >> 32;
+  }
+  for (; size > 0; p++, size--)
+    hash = (hash ^ *p) * 0x100000001b3ULL;
+  return hash;
+}
+
+#endif
@@ -35,9 +35,16 @@
 
 #include <cstring>
 #include <stdexcept>
+#include <string>
 
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 // We use SDL_image to load the image from disk
 #include <SDL/SDL_image.h>
@@ -45,14 +52,128 @@
 // Use Bullet's Quaternion object to create one from Euler angles
 #include <LinearMath/btQuaternion.h>
 
+#include "ros/console.h"
 #include "map_server/image_loader.h"
+#include "map_server/map_cache_hash.h"
 
 // compute linear index for given map coords
 #define MAP_IDX(sx, i, j) ((sx) * (j) + (i))
 
+// Bump when the layout of the cache or the decoding of the images changes
+#define MAP_CACHE_VERSION 1
+
 namespace map_server
 {
 
+namespace
+{
+
+/** Header of a map cache entry, followed by the map data */
+struct MapCacheHeader
+{
+  char magic[8];
+  uint32_t version;
+  uint32_t header_size;
+  uint32_t width;
+  uint32_t height;
+  uint64_t source_hash;
+  uint64_t data_hash;
+};
+
+const char map_cache_magic[8] = "MAPGRID";
+
+/** A read-only mapping of a whole file, unmapped on destruction */
+class MappedFile
+{
+  public:
+    explicit MappedFile(const std::string& fname) : data_(NULL), size_(0)
+    {
+      int fd = open(fname.c_str(), O_RDONLY);
+      if (fd < 0)
+        return;
+      struct stat st;
+      if (fstat(fd, &st) == 0 && st.st_size > 0)
+      {
+        void* data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data != MAP_FAILED)
+        {
+          data_ = static_cast<const unsigned char*>(data);
+          size_ = st.st_size;
+        }
+      }
+      close(fd);
+    }
+
+    ~MappedFile()
+    {
+      if (data_)
+        munmap(const_cast<unsigned char*>(data_), size_);
+    }
+
+    const unsigned char* data() const { return data_; }
+    size_t size() const { return size_; }
+
+  private:
+    MappedFile(const MappedFile&);
+    MappedFile& operator=(const MappedFile&);
+
+    const unsigned char* data_;
+    size_t size_;
+};
+
+/** Fill out everything about the map but its data */
+void setMapInfo(nav_msgs::GetMap::Response* resp, unsigned int width,
+                unsigned int height, double res, double* origin)
+{
+  resp->map.info.width = width;
+  resp->map.info.height = height;
+  resp->map.info.resolution = res;
+  resp->map.info.origin.position.x = *(origin);
+  resp->map.info.origin.position.y = *(origin+1);
+  resp->map.info.origin.position.z = 0.0;
+  btQuaternion q;
+  // setEulerZYX(yaw, pitch, roll)
+  q.setEulerZYX(*(origin+2), 0, 0);
+  resp->map.info.origin.orientation.x = q.x();
+  resp->map.info.origin.orientation.y = q.y();
+  resp->map.info.origin.orientation.z = q.z();
+  resp->map.info.origin.orientation.w = q.w();
+}
+
+/** Store the map as the cache entry cache_fname, replacing any old one */
+bool saveMapToCache(const nav_msgs::GetMap::Response& resp,
+                    const std::string& cache_fname, uint64_t source_hash)
+{
+  MapCacheHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, map_cache_magic, sizeof(map_cache_magic));
+  header.version = MAP_CACHE_VERSION;
+  header.header_size = sizeof(header);
+  header.width = resp.map.info.width;
+  header.height = resp.map.info.height;
+  header.source_hash = source_hash;
+  header.data_hash = map_cache_hash(source_hash, resp.map.data.data(), resp.map.data.size());
+
+  char pid[32];
+  snprintf(pid, sizeof(pid), ".%d.tmp", (int) getpid());
+  std::string tmp_fname = cache_fname + pid;
+  FILE* file = fopen(tmp_fname.c_str(), "wb");
+  if (!file)
+    return false;
+  bool ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+            fwrite(resp.map.data.data(), 1, resp.map.data.size(), file) == resp.map.data.size() &&
+            fflush(file) == 0 && fsync(fileno(file)) == 0;
+  ok = (fclose(file) == 0) && ok;
+  if (!ok || rename(tmp_fname.c_str(), cache_fname.c_str()) != 0)
+  {
+    unlink(tmp_fname.c_str());
+    return false;
+  }
+  return true;
+}
+
+}
+
 void
 loadMapFromFile(nav_msgs::GetMap::Response* resp,
                 const char* fname, double res, bool negate,
@@ -81,19 +202,7 @@ loadMapFromFile(nav_msgs::GetMap::Response* resp,
   }
 
   // Copy the image data into the map structure
-  resp->map.info.width = img->w;
-  resp->map.info.height = img->h;
-  resp->map.info.resolution = res;
-  resp->map.info.origin.position.x = *(origin);
-  resp->map.info.origin.position.y = *(origin+1);
-  resp->map.info.origin.position.z = 0.0;
-  btQuaternion q;
-  // setEulerZYX(yaw, pitch, roll)
-  q.setEulerZYX(*(origin+2), 0, 0);
-  resp->map.info.origin.orientation.x = q.x();
-  resp->map.info.origin.orientation.y = q.y();
-  resp->map.info.origin.orientation.z = q.z();
-  resp->map.info.origin.orientation.w = q.w();
+  setMapInfo(resp, img->w, img->h, res, origin);
 
   // Allocate space to hold the data
   resp->map.data.resize(resp->map.info.width * resp->map.info.height);
@@ -162,4 +271,73 @@ loadMapFromFile(nav_msgs::GetMap::Response* resp,
   SDL_FreeSurface(img);
 }
 
+bool
+loadMapFromCachedFile(nav_msgs::GetMap::Response* resp,
+                      const char* fname, const char* cache_dir,
+                      double res, bool negate,
+                      double occ_th, double free_th, double* origin,
+                      MapMode mode)
+{
+  // The map data depends on the image and on how its pixels are read, not
+  // on where the map is placed
+  uint64_t source_hash = MAP_CACHE_HASH_SEED;
+  {
+    MappedFile image(fname);
+    if (!image.data())
+    {
+      loadMapFromFile(resp, fname, res, negate, occ_th, free_th, origin, mode);
+      return false;
+    }
+    source_hash = map_cache_hash(source_hash, image.data(), image.size());
+  }
+  int version = MAP_CACHE_VERSION;
+  int negate_flag = negate;
+  int mode_flag = mode;
+  source_hash = map_cache_hash(source_hash, &version, sizeof(version));
+  source_hash = map_cache_hash(source_hash, &negate_flag, sizeof(negate_flag));
+  source_hash = map_cache_hash(source_hash, &occ_th, sizeof(occ_th));
+  source_hash = map_cache_hash(source_hash, &free_th, sizeof(free_th));
+  source_hash = map_cache_hash(source_hash, &mode_flag, sizeof(mode_flag));
+
+  // Entries are named after the image and its hash, so a cache directory
+  // can hold several maps and versions of a map
+  std::string base(fname);
+  if (base.find('/') != std::string::npos)
+    base = base.substr(base.rfind('/') + 1);
+  char key[32];
+  snprintf(key, sizeof(key), "-%016llx.grid", (unsigned long long) source_hash);
+  std::string cache_fname = std::string(cache_dir) + "/" + base + key;
+
+  {
+    MappedFile cache(cache_fname);
+    const MapCacheHeader* header = reinterpret_cast<const MapCacheHeader*>(cache.data());
+    if (cache.size() >= sizeof(MapCacheHeader) &&
+        memcmp(header->magic, map_cache_magic, sizeof(map_cache_magic)) == 0 &&
+        header->version == MAP_CACHE_VERSION &&
+        header->header_size == sizeof(MapCacheHeader) &&
+        header->source_hash == source_hash &&
+        cache.size() == sizeof(MapCacheHeader) + (size_t) header->width * header->height)
+    {
+      const unsigned char* data = cache.data() + sizeof(MapCacheHeader);
+      size_t size = cache.size() - sizeof(MapCacheHeader);
+      if (header->data_hash == map_cache_hash(source_hash, data, size))
+      {
+        setMapInfo(resp, header->width, header->height, res, origin);
+        resp->map.data.assign(data, data + size);
+        return true;
+      }
+    }
+    if (cache.data())
+      ROS_WARN("Ignoring the stale map cache %s", cache_fname.c_str());
+  }
+
+  loadMapFromFile(resp, fname, res, negate, occ_th, free_th, origin, mode);
+
+  if (mkdir(cache_dir, 0755) != 0 && errno != EEXIST)
+    ROS_WARN("Could not create the map cache directory %s: %s", cache_dir, strerror(errno));
+  else if (!saveMapToCache(*resp, cache_fname, source_hash))
+    ROS_WARN("Could not write the map cache %s: %s", cache_fname.c_str(), strerror(errno));
+  return false;
+}
+
 }
@@ -70,6 +70,7 @@ class MapServer
       MapMode mode = TRINARY;
       ros::NodeHandle private_nh("~");
       private_nh.param("frame_id", frame_id_, std::string("map"));
+      private_nh.param("map_cache_dir", cache_dir_, std::string(""));
 
       //When called this service returns a copy of the current map
       get_map_service_ = nh_.advertiseService("static_map", &MapServer::mapCallback, this);
@@ -105,6 +106,7 @@ class MapServer
     ros::ServiceServer change_map_srv_;
     bool deprecated_;
     std::string frame_id_;
+    std::string cache_dir_;
 
     /** Callback invoked when someone requests our service */
     bool mapCallback(nav_msgs::GetMap::Request  &req,
@@ -143,9 +145,15 @@ class MapServer
     {
       ROS_INFO("Loading map from image \"%s\"", map_file_name.c_str());
       try {
-        map_server::loadMapFromFile(&map_resp_, map_file_name.c_str(),
-                                    resolution, negate, occ_th, free_th,
-                                    origin, mode);
+        if (cache_dir_.empty())
+          map_server::loadMapFromFile(&map_resp_, map_file_name.c_str(),
+                                      resolution, negate, occ_th, free_th,
+                                      origin, mode);
+        else if (map_server::loadMapFromCachedFile(&map_resp_, map_file_name.c_str(),
+                                                   cache_dir_.c_str(), resolution,
+                                                   negate, occ_th, free_th,
+                                                   origin, mode))
+          ROS_INFO("Read the map from the cache in %s", cache_dir_.c_str());
       } catch (std::runtime_error& e) {
         ROS_ERROR("%s", e.what());
         return false;
@@ -30,6 +30,10 @@
 /* Author: Brian Gerkey */
 
 #include <stdexcept> // for std::runtime_error
+#include <stdlib.h> // for mkdtemp
+#include <dirent.h> // for opendir
+#include <unistd.h> // for unlink, rmdir
+#include <string>
 #include <gtest/gtest.h>
 #include "map_server/image_loader.h"
 #include "test_constants.h"
@@ -101,6 +105,45 @@ TEST(MapServer, loadInvalidFile)
   ADD_FAILURE() << "Didn't throw exception as expected";
 }
 
+/* Load a valid PNG file through an empty cache and then again.  Succeeds
+ * if the first load decodes the image, the second one reads it from the
+ * cache, and both match the known content of the file. */
+TEST(MapServer, loadCachedPNG)
+{
+  char cache_dir[] = "/tmp/map_server_utest_XXXXXX";
+  ASSERT_TRUE(mkdtemp(cache_dir) != NULL);
+  double origin[3] = { 0.0, 0.0, 0.0 };
+  for (int pass = 0; pass < 2; pass++)
+  {
+    nav_msgs::GetMap::Response map_resp;
+    bool cached = map_server::loadMapFromCachedFile(&map_resp, g_valid_png_file, cache_dir,
+                                                    g_valid_image_res, false, 0.65, 0.1, origin);
+    EXPECT_EQ(pass == 1, cached);
+    EXPECT_FLOAT_EQ(map_resp.map.info.resolution, g_valid_image_res);
+    EXPECT_EQ(map_resp.map.info.width, g_valid_image_width);
+    EXPECT_EQ(map_resp.map.info.height, g_valid_image_height);
+    for(unsigned int i=0; i < map_resp.map.info.width * map_resp.map.info.height; i++)
+      EXPECT_EQ(g_valid_image_content[i], map_resp.map.data[i]);
+  }
+
+  // Other thresholds decode the image differently, so they miss the cache
+  nav_msgs::GetMap::Response map_resp;
+  EXPECT_FALSE(map_server::loadMapFromCachedFile(&map_resp, g_valid_png_file, cache_dir,
+                                                 g_valid_image_res, false, 0.5, 0.1, origin));
+
+  // Remove the cache entries and the directory
+  DIR* dir = opendir(cache_dir);
+  ASSERT_TRUE(dir != NULL);
+  while (struct dirent* entry = readdir(dir))
+  {
+    std::string name(entry->d_name);
+    if (name != "." && name != "..")
+      EXPECT_EQ(0, unlink((std::string(cache_dir) + "/" + name).c_str()));
+  }
+  closedir(dir);
+  EXPECT_EQ(0, rmdir(cache_dir));
+}
+
 std::vector<unsigned int> countValues(const nav_msgs::GetMap::Response& map_resp)
 {
   std::vector<unsigned int> counts(256, 0);
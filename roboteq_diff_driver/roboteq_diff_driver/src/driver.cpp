@@ -2,8 +2,18 @@
 #include <ros/console.h>
 #include <serial/serial.h>
 #include <signal.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include <sched.h>
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
 #include <string>
 #include <sstream>
+#include <boost/thread.hpp>
+#include <boost/atomic.hpp>
+#include <boost/lockfree/spsc_queue.hpp>
 
 
 #define DELTAT(_nowtime,_thentime) ((_thentime>_nowtime)?((0xffffffff-_thentime)+_nowtime):(_nowtime-_thentime))
@@ -50,12 +60,101 @@
 #include <std_msgs/Float32.h>
 #include <roboteq_diff_msgs/Duplex.h>
 #endif
+#include <roboteq_diff_msgs/StreamStats.h>
 #ifdef _ODOM_COVAR_SERVER
 #include "roboteq_diff_msgs/OdometryCovariances.h"
 #include "rogoteq_diff_msgs/RequestOdometryCovariances.h"
 #endif
 
 
+//
+// serial reader
+//
+
+// Maximum time (ms) the reader thread blocks waiting for serial data
+#define SERIAL_READ_WAIT_MS 100
+
+// Size of the chunk drained from the serial port per read
+#define SERIAL_READ_CHUNK 256
+
+// Number of parsed lines buffered between reader thread and publisher
+#define SERIAL_QUEUE_SIZE 256
+
+// Number of periodic tasks run by the deadline scheduler
+#define SCHED_TASKS 3
+
+// Number and width (s) of read-to-publish latency histogram buckets
+#define LATENCY_BUCKETS 40
+#define LATENCY_BUCKET_WIDTH 0.0005
+
+// One parsed line of the controller's sensor data stream, stamped with the
+// time its bytes were read from the port.
+struct odom_record
+{
+  enum type_t { ENCODER, CURRENT, VOLTAGE };
+  type_t type;
+  int32_t a;
+  int32_t b;
+  ros::Time stamp;
+};
+
+// Parse a signed decimal integer at *p, advancing *p past it.
+// Returns false if no digits were found.
+static inline bool parse_int(const char **p, int32_t *value)
+{
+  const char *s = *p;
+  bool neg = false;
+  if ( *s == '-' || *s == '+' )
+    neg = (*s++ == '-');
+  if ( *s < '0' || *s > '9' )
+    return false;
+  int32_t v = 0;
+  while ( *s >= '0' && *s <= '9' )
+    v = v * 10 + (*s++ - '0');
+  *value = neg ? -v : v;
+  *p = s;
+  return true;
+}
+
+static inline void timespec_add_ns(struct timespec *ts, long ns)
+{
+  ts->tv_nsec += ns;
+  while ( ts->tv_nsec >= 1000000000L )
+  {
+    ts->tv_nsec -= 1000000000L;
+    ts->tv_sec++;
+  }
+}
+
+static inline bool timespec_before(const struct timespec &a, const struct timespec &b)
+{
+  return (a.tv_sec < b.tv_sec) || (a.tv_sec == b.tv_sec && a.tv_nsec < b.tv_nsec);
+}
+
+// Format "<prefix><value>\r" into buf without allocating.
+// Returns the number of characters written (not null terminated).
+static inline size_t format_cmd(char *buf, const char *prefix, int32_t value)
+{
+  char *d = buf;
+  while ( *prefix )
+    *d++ = *prefix++;
+  uint32_t u = (value < 0) ? (uint32_t)(-(int64_t)value) : (uint32_t)value;
+  if ( value < 0 )
+    *d++ = '-';
+  char digits[10];
+  int n = 0;
+  do
+  {
+    digits[n++] = '0' + (u % 10);
+    u /= 10;
+  } while ( u );
+  while ( n )
+    *d++ = digits[--n];
+  *d++ = '\r';
+  return d - buf;
+}
+
+
 
 void mySigintHandler(int sig)
 {
@@ -77,6 +176,7 @@ class MainNode
 
 public:
   MainNode();
+  ~MainNode();
 
 public:
 
@@ -85,7 +185,6 @@ public:
   //
   void cmdvel_callback( const geometry_msgs::Twist& twist_msg);
   void cmdvel_setup();
-  void cmdvel_loop();
   void cmdvel_run();
 
   //
@@ -97,11 +196,30 @@ public:
   //void odom_hs_run();
   void odom_ms_run();
   void odom_ls_run();
-  void odom_publish();
+  void odom_publish(const ros::Time &stamp);
+  void odom_parse(const ros::Time &stamp);
+  void stats_publish();
 #ifdef _ODOM_COVAR_SERVER
   void odom_covar_callback(const roboteq_diff_msgs::RequestOdometryCovariancesRequest& req, roboteq_diff_msgs::RequestOdometryCovariancesResponse& res);
 #endif
 
+  //
+  // serial reader
+  //
+  void reader_start();
+  void reader_stop();
+  void reader_thread_main();
+  void reader_fail(const char *what, const char *msg);
+  void reader_notify();
+
+  //
+  // scheduler
+  //
+  void sched_add(void (MainNode::*fn)(), double rate);
+  void sched_realtime();
+  void sched_loop();
+  void ls_run();
+
   int run();
 
 protected:
@@ -109,10 +227,20 @@ protected:
 
   serial::Serial controller;
 
-  uint32_t starttime;
-  uint32_t hstimer;
-  uint32_t mstimer;
-  uint32_t lstimer;
+  //
+  // scheduler
+  //
+
+  // A periodic task released at absolute deadlines on CLOCK_MONOTONIC.
+  struct sched_task
+  {
+    void (MainNode::*fn)();
+    long period_ns;
+    struct timespec next;
+  };
+  sched_task sched_tasks[SCHED_TASKS];
+  int sched_count;
+  uint32_t sched_overruns;
 
   //
   // cmd_vel subscriber
@@ -138,10 +266,41 @@ protected:
   ros::Publisher temperature_pub;
 #endif
 
-  // buffer for reading encoder counts
+  //
+  // serial reader
+  //
+  boost::thread reader_thread;
+  boost::atomic<bool> reader_running;
+  boost::lockfree::spsc_queue<odom_record, boost::lockfree::capacity<SERIAL_QUEUE_SIZE> > odom_queue;
+  boost::atomic<uint32_t> odom_queue_drops;
+
+  // signalled by the reader thread when it has read from the port, so the
+  // scheduler thread drains odom_queue as soon as lines arrive
+  pthread_mutex_t odom_mutex;
+  pthread_cond_t odom_cond;
+  bool odom_ready;
+
+  // buffer for reading encoder counts (owned by reader thread)
   int odom_idx;
   char odom_buf[24];
 
+  // pre-formatted commands
+  char stream_cmd[32];
+  char cmd_buf[32];
+
+  //
+  // stream statistics
+  //
+  ros::Publisher stats_pub;
+  roboteq_diff_msgs::StreamStats stats_msg;
+  boost::atomic<uint32_t> stats_lines;
+  boost::atomic<uint32_t> stats_parse_errors;
+  uint32_t latency_histogram[LATENCY_BUCKETS];
+  uint32_t latency_count;
+  double latency_sum;
+  double latency_min;
+  double latency_max;
+
   // toss out initial encoder readings
   char odom_encoder_toss;
 
@@ -156,6 +315,7 @@ protected:
   float odom_last_yaw;
 
   uint32_t odom_last_time;
+  ros::Time odom_last_stamp;
 
 #ifdef _ODOM_SENSORS
   float voltage;
@@ -163,7 +323,7 @@ protected:
   float current_left;
   float energy;
   float temperature;
-  uint32_t current_last_time;
+  ros::Time current_last_stamp;
 #endif
 
   // settings
@@ -182,14 +342,24 @@ protected:
   double max_amps;
   int max_rpm;
   int gear_ratio;
+  double stream_rate;
+  int realtime_priority;
 
 };
 
 MainNode::MainNode() : 
-  starttime(0),
-  hstimer(0),
-  mstimer(0),
+  sched_count(0),
+  sched_overruns(0),
+  reader_running(false),
+  odom_queue_drops(0),
+  odom_ready(false),
   odom_idx(0),
+  stats_lines(0),
+  stats_parse_errors(0),
+  latency_count(0),
+  latency_sum(0.0),
+  latency_min(0.0),
+  latency_max(0.0),
   odom_encoder_toss(5),
   odom_encoder_left(0),
   odom_encoder_right(0),
@@ -206,7 +376,6 @@ MainNode::MainNode() :
   current_left(0.0),
   energy(0.0),
   temperature(0.0),
-  current_last_time(0),
 #endif
   pub_odom_tf(true),
   open_loop(false),
@@ -217,7 +386,9 @@ MainNode::MainNode() :
   encoder_cpr(0),
   max_amps(0.0),
   max_rpm(0),
-  gear_ratio(0)
+  gear_ratio(0),
+  stream_rate(30.0),
+  realtime_priority(0)
 {
 
 
@@ -253,7 +424,28 @@ MainNode::MainNode() :
   ROS_INFO_STREAM("max_rpm: " << max_rpm);
   nhLocal.param("gear_ratio", gear_ratio, 32);
   ROS_INFO_STREAM("gear_ratio: " << gear_ratio);
+  nhLocal.param("stream_rate", stream_rate, 30.0);
+  ROS_INFO_STREAM("stream_rate: " << stream_rate);
+  nhLocal.param("realtime_priority", realtime_priority, 0);
+  ROS_INFO_STREAM("realtime_priority: " << realtime_priority);
+
+  memset(stream_cmd, 0, sizeof(stream_cmd));
+  memset(latency_histogram, 0, sizeof(latency_histogram));
+
+  // the scheduler waits on odom_cond until absolute CLOCK_MONOTONIC deadlines
+  pthread_condattr_t attr;
+  pthread_condattr_init(&attr);
+  pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+  pthread_cond_init(&odom_cond, &attr);
+  pthread_condattr_destroy(&attr);
+  pthread_mutex_init(&odom_mutex, NULL);
+
+}
 
+MainNode::~MainNode()
+{
+  pthread_cond_destroy(&odom_cond);
+  pthread_mutex_destroy(&odom_mutex);
 }
 
 
@@ -271,8 +463,8 @@ void MainNode::cmdvel_callback( const geometry_msgs::Twist& twist_msg)
 ROS_DEBUG_STREAM("cmdvel speed right: " << right_speed << " left: " << left_speed);
 #endif
 
-  std::stringstream right_cmd;
-  std::stringstream left_cmd;
+  // both commands are formatted into one buffer and sent with a single write
+  size_t len;
 
   if (open_loop)
   {
@@ -282,8 +474,8 @@ ROS_DEBUG_STREAM("cmdvel speed right: " << right_speed << " left: " << left_spee
 #ifdef _CMDVEL_DEBUG
 ROS_DEBUG_STREAM("cmdvel power right: " << right_power << " left: " << left_power);
 #endif
-    right_cmd << "!G 1 " << right_power << "\r";
-    left_cmd << "!G 2 " << left_power << "\r";
+    len = format_cmd(cmd_buf, "!G 1 ", right_power);
+    len += format_cmd(cmd_buf + len, "!G 2 ", left_power);
   }
   else
   {
@@ -293,15 +485,16 @@ ROS_DEBUG_STREAM("cmdvel power right: " << right_power << " left: " << left_powe
 #ifdef _CMDVEL_DEBUG
 ROS_DEBUG_STREAM("cmdvel rpm right: " << right_rpm << " left: " << left_rpm);
 #endif
-    right_cmd << "!S 1 " << right_rpm << "\r";
-    left_cmd << "!S 2 " << left_rpm << "\r";
+    len = format_cmd(cmd_buf, "!S 1 ", right_rpm);
+    len += format_cmd(cmd_buf + len, "!S 2 ", left_rpm);
   }
 
 
 #ifndef _CMDVEL_FORCE_RUN
-  controller.write(right_cmd.str());
-  controller.write(left_cmd.str());
+  controller.write((const uint8_t*)cmd_buf, len);
   controller.flush();
+#else
+  (void)len;
 #endif
 }
 
@@ -382,15 +575,13 @@ void MainNode::cmdvel_setup()
 
   controller.flush();
 
+  // cmd_vel is served by an AsyncSpinner and written to the controller as soon
+  // as it arrives; a queue of one coalesces bursts to the latest command
   ROS_INFO_STREAM("Subscribing to topic " << cmdvel_topic);
-  cmdvel_sub = nh.subscribe(cmdvel_topic, 1000, &MainNode::cmdvel_callback, this);
+  cmdvel_sub = nh.subscribe(cmdvel_topic, 1, &MainNode::cmdvel_callback, this, ros::TransportHints().tcpNoDelay());
 
 }
 
-void MainNode::cmdvel_loop()
-{
-}
-
 void MainNode::cmdvel_run()
 {
 #ifdef _CMDVEL_FORCE_RUN
@@ -401,12 +592,11 @@ void MainNode::cmdvel_run()
   }
   else
   {
-    std::stringstream right_cmd;
-    std::stringstream left_cmd;
-    right_cmd << "!S 1 " << (int)(max_rpm * 0.1) << "\r";
-    left_cmd << "!S 2 " << (int)(max_rpm * 0.1) << "\r";
-    controller.write(right_cmd.str());
-    controller.write(left_cmd.str());
+    // local buffer, cmd_buf belongs to the cmd_vel callback thread
+    char buf[32];
+    size_t len = format_cmd(buf, "!S 1 ", (int32_t)(max_rpm * 0.1));
+    len += format_cmd(buf + len, "!S 2 ", (int32_t)(max_rpm * 0.1));
+    controller.write((const uint8_t*)buf, len);
   }
   controller.flush();
 #endif
@@ -493,6 +683,12 @@ void MainNode::odom_setup()
   temperature_pub = nh.advertise<std_msgs::Float32>("roboteq/temperature", 1000);
 #endif
 
+  ROS_INFO("Publishing to topic roboteq/stream_stats");
+  stats_pub = nh.advertise<roboteq_diff_msgs::StreamStats>("roboteq/stream_stats", 10);
+  stats_msg.stream_rate = stream_rate;
+  stats_msg.latency_bucket_width = LATENCY_BUCKET_WIDTH;
+  stats_msg.latency_histogram.resize(LATENCY_BUCKETS);
+
   tf_msg.header.seq = 0;
   tf_msg.header.frame_id = odom_frame;
   tf_msg.child_frame_id = base_frame;
@@ -528,33 +724,39 @@ void MainNode::odom_setup()
 //  temperature_msg.header.frame_id = 0;
 #endif
 
+  // pre-format the streaming query, the controller cycles through the listed
+  // queries one per period so the period is divided by the number of queries
+#ifdef _ODOM_SENSORS
+  // encoder, current and voltage output
+  const char *queries = "?CR_?BA_?V_";
+  const int query_count = 3;
+#else
+  // encoder output
+  const char *queries = "?CR_";
+  const int query_count = 1;
+#endif
+  int period = (stream_rate > 0.0) ? (int)(1000.0 / (stream_rate * query_count) + 0.5) : 33;
+  if ( period < 1 )
+    period = 1;
+  snprintf(stream_cmd, sizeof(stream_cmd), "# C_%s# %d\r", queries, period);
+  ROS_INFO_STREAM("Streaming queries every " << period << " ms");
+
   // start encoder streaming
   odom_stream();
 
   odom_last_time = millis();
+  odom_last_stamp = ros::Time::now();
 #ifdef _ODOM_SENSORS
-  current_last_time = millis();
+  current_last_stamp = ros::Time::now();
 #endif
 }
 
 void MainNode::odom_stream()
 {
-  
-#ifdef _ODOM_SENSORS
-  // start encoder and current output (30 hz)
-  // doubling frequency since one value is output at each cycle
-//  controller.write("# C_?CR_?BA_# 17\r");
-  // start encoder, current and voltage output (30 hz)
-  // tripling frequency since one value is output at each cycle
-  controller.write("# C_?CR_?BA_?V_# 11\r");
-#else
-//  // start encoder output (10 hz)
-//  controller.write("# C_?CR_# 100\r");
-  // start encoder output (30 hz)
-  controller.write("# C_?CR_# 33\r");
-//  // start encoder output (50 hz)
-//  controller.write("# C_?CR_# 20\r");
-#endif
+
+  // start encoder (and sensor) output at the configured stream_rate,
+  // e.g. "# C_?CR_?BA_?V_# 11" for 30 Hz with sensors enabled
+  controller.write(std::string(stream_cmd));
   controller.flush();
 
 }
@@ -571,111 +773,220 @@ void MainNode::odom_loop()
     odom_last_time = nowtime;
   }
 
-  // read sensor data stream from motor controller
-  if (controller.available())
+  // consume everything the reader thread has parsed since the last pass
+  odom_record rec;
+  while ( odom_queue.pop(rec) )
   {
-    char ch = 0;
-    if ( controller.read((uint8_t*)&ch, 1) == 0 )
-      return;
-    if (ch == '\r')
+    switch ( rec.type )
     {
-      odom_buf[odom_idx] = 0;
-#ifdef _ODOM_DEBUG
-//ROS_DEBUG_STREAM( "line: " << odom_buf );
-#endif
-      // CR= is encoder counts
-      if ( odom_buf[0] == 'C' && odom_buf[1] == 'R' && odom_buf[2] == '=' )
+    case odom_record::ENCODER:
       {
-        int delim;
-        for ( delim = 3; delim < odom_idx; delim++ )
-        {
-          if ( odom_encoder_toss > 0 )
-          {
-            --odom_encoder_toss;
-            break;
-          }
-          if (odom_buf[delim] == ':')
-          {
-            odom_buf[delim] = 0;
-            odom_encoder_left = (int32_t)strtol(odom_buf+3, NULL, 10);
-            odom_encoder_right = (int32_t)strtol(odom_buf+delim+1, NULL, 10);
+        odom_encoder_left = rec.a;
+        odom_encoder_right = rec.b;
 #ifdef _ODOM_DEBUG
 ROS_DEBUG_STREAM("encoder right: " << odom_encoder_right << " left: " << odom_encoder_left);
 #endif
-            odom_publish();
-            break;
-          }
-        }
+        odom_publish(rec.stamp);
+
+        // record read-to-publish latency
+        double latency = (ros::Time::now() - rec.stamp).toSec();
+        int bucket = (int)(latency / LATENCY_BUCKET_WIDTH);
+        if ( bucket < 0 )
+          bucket = 0;
+        else if ( bucket >= LATENCY_BUCKETS )
+          bucket = LATENCY_BUCKETS - 1;
+        latency_histogram[bucket]++;
+        if ( latency_count == 0 || latency < latency_min )
+          latency_min = latency;
+        if ( latency_count == 0 || latency > latency_max )
+          latency_max = latency;
+        latency_sum += latency;
+        latency_count++;
       }
+      break;
 #ifdef _ODOM_SENSORS
-      // V= is voltages
-      else if ( odom_buf[0] == 'V' && odom_buf[1] == '=' )
-      {
-        int count = 0;
-        int start = 2;
-        for ( int delim = 2; delim <= odom_idx; delim++ )
-        {
-          if (odom_buf[delim] == ':' || odom_buf[delim] == 0)
-          {
-            odom_buf[delim] = 0;
-/*
-            switch (count)
-            {
-            case 0:
-//              odom_internal_voltage = (float)strtol(odom_buf+start, NULL, 10) / 10.0;
-              break;
-            case 1:
-              voltage = (float)strtol(odom_buf+start, NULL, 10) / 10.0;
-              break;
-            case 2:
-//              odom_aux_voltage = (float)strtol(odom_buf+start, NULL, 1000.0);
-              break;
-            }
-*/
-            if ( count == 1 )
-            {
-              voltage = (float)strtol(odom_buf+start, NULL, 10) / 10.0;
+    case odom_record::VOLTAGE:
+      voltage = (float)rec.a / 10.0;
 #ifdef _ODOM_DEBUG
 //ROS_DEBUG_STREAM("voltage: " << voltage);
 #endif
-              break;
-            }
-            start = delim + 1;
-            count++;
-          }
-        }
-      }
-      // BA= is motor currents
-      else if ( odom_buf[0] == 'B' && odom_buf[1] == 'A' && odom_buf[2] == '=' )
+      break;
+    case odom_record::CURRENT:
       {
-        int delim;
-        for ( delim = 3; delim < odom_idx; delim++ )
-        {
-          if (odom_buf[delim] == ':')
-          {
-            odom_buf[delim] = 0;
-            current_right = (float)strtol(odom_buf+3, NULL, 10) / 10.0;
-            current_left = (float)strtol(odom_buf+delim+1, NULL, 10) / 10.0;
+        current_right = (float)rec.a / 10.0;
+        current_left = (float)rec.b / 10.0;
 #ifdef _ODOM_DEBUG
 //ROS_DEBUG_STREAM("current right: " << current_right << " left: " << current_left);
 #endif
 
-            // determine delta time in seconds
-            float dt = (float)DELTAT(nowtime,current_last_time) / 1000.0;
-            current_last_time = nowtime;
-            energy += (current_right + current_left) * dt / 3600.0;
-            break;
-          }
-        }
+        // determine delta time in seconds
+        float dt = (rec.stamp - current_last_stamp).toSec();
+        current_last_stamp = rec.stamp;
+        energy += (current_right + current_left) * dt / 3600.0;
       }
+      break;
 #endif
-      odom_idx = 0;
+    default:
+      break;
     }
-    else if ( odom_idx < (sizeof(odom_buf)-1) )
+  }
+}
+
+// Parse the complete line in odom_buf and queue the result for the publisher.
+// Called from the reader thread only.
+void MainNode::odom_parse(const ros::Time &stamp)
+{
+
+  odom_record rec;
+  rec.stamp = stamp;
+  rec.b = 0;
+  bool parsed = false;
+  bool error = false;
+  const char *p;
+
+  ++stats_lines;
+
+#ifdef _ODOM_DEBUG
+//ROS_DEBUG_STREAM( "line: " << odom_buf );
+#endif
+  // CR= is encoder counts
+  if ( odom_buf[0] == 'C' && odom_buf[1] == 'R' && odom_buf[2] == '=' )
+  {
+    if ( odom_encoder_toss > 0 )
     {
-      odom_buf[odom_idx++] = ch;
+      --odom_encoder_toss;
+      return;
     }
+    p = odom_buf + 3;
+    rec.type = odom_record::ENCODER;
+    parsed = parse_int(&p, &rec.a) && *p++ == ':' && parse_int(&p, &rec.b);
+    error = !parsed;
+  }
+#ifdef _ODOM_SENSORS
+  // V= is voltages
+  else if ( odom_buf[0] == 'V' && odom_buf[1] == '=' )
+  {
+    // second field is main battery voltage (V * 10)
+    int32_t internal;
+    p = odom_buf + 2;
+    rec.type = odom_record::VOLTAGE;
+    parsed = parse_int(&p, &internal) && *p++ == ':' && parse_int(&p, &rec.a);
+    error = !parsed;
   }
+  // BA= is motor currents
+  else if ( odom_buf[0] == 'B' && odom_buf[1] == 'A' && odom_buf[2] == '=' )
+  {
+    p = odom_buf + 3;
+    rec.type = odom_record::CURRENT;
+    parsed = parse_int(&p, &rec.a) && *p++ == ':' && parse_int(&p, &rec.b);
+    error = !parsed;
+  }
+#endif
+
+  if ( error )
+    ++stats_parse_errors;
+  else if ( parsed && !odom_queue.push(rec) )
+    ++odom_queue_drops;
+
+}
+
+
+//
+// serial reader
+//
+
+void MainNode::reader_start()
+{
+  odom_idx = 0;
+  reader_running = true;
+  reader_thread = boost::thread(&MainNode::reader_thread_main, this);
+}
+
+void MainNode::reader_stop()
+{
+  reader_running = false;
+  if ( reader_thread.joinable() )
+    reader_thread.join();
+}
+
+// A port that fails once keeps failing (the device is gone), so rather than
+// retrying in a loop end the node the way an uncaught exception used to and
+// leave the restart to whoever launched it. The scheduler is woken so that
+// it notices the shutdown at once.
+void MainNode::reader_fail(const char *what, const char *msg)
+{
+  ROS_ERROR_STREAM(what << msg);
+  reader_running = false;
+  ros::shutdown();
+  reader_notify();
+}
+
+// Block on the serial port until data arrives, drain everything available in
+// one read and split it into lines. Parsed lines are handed to the publisher
+// through odom_queue and the publisher is woken, so the main loop never
+// touches the port for reading.
+void MainNode::reader_thread_main()
+{
+
+  uint8_t chunk[SERIAL_READ_CHUNK];
+
+  while ( reader_running && ros::ok() )
+  {
+    size_t len = 0;
+    try
+    {
+      if ( !controller.waitReadable() )
+        continue;
+      size_t avail = controller.available();
+      if ( avail == 0 )
+        continue;
+      len = controller.read(chunk, std::min(avail, sizeof(chunk)));
+    }
+    catch (serial::SerialException &e)
+    {
+      reader_fail("serial::SerialException: ", e.what());
+      break;
+    }
+    catch (serial::IOException &e)
+    {
+      reader_fail("serial::IOException: ", e.what());
+      break;
+    }
+    catch (serial::PortNotOpenedException &e)
+    {
+      reader_fail("serial::PortNotOpenedException: ", e.what());
+      break;
+    }
+
+    // all lines completed by this read share its acquisition time
+    ros::Time stamp = ros::Time::now();
+    for ( size_t i = 0; i < len; i++ )
+    {
+      char ch = (char)chunk[i];
+      if (ch == '\r')
+      {
+        odom_buf[odom_idx] = 0;
+        odom_parse(stamp);
+        odom_idx = 0;
+      }
+      else if ( odom_idx < (sizeof(odom_buf)-1) )
+      {
+        odom_buf[odom_idx++] = ch;
+      }
+    }
+    if ( len > 0 )
+      reader_notify();
+  }
+
+}
+
+// Wake the scheduler thread to drain odom_queue.
+void MainNode::reader_notify()
+{
+  pthread_mutex_lock(&odom_mutex);
+  odom_ready = true;
+  pthread_cond_signal(&odom_cond);
+  pthread_mutex_unlock(&odom_mutex);
 }
 
 //void MainNode::odom_hs_run()
@@ -715,13 +1026,15 @@ void MainNode::odom_ls_run()
 
 }
 
-void MainNode::odom_publish()
+void MainNode::odom_publish(const ros::Time &stamp)
 {
 
-  // determine delta time in seconds
-  uint32_t nowtime = millis();
-  float dt = (float)DELTAT(nowtime,odom_last_time) / 1000.0;
-  odom_last_time = nowtime;
+  // determine delta time in seconds between encoder acquisitions
+  float dt = (stamp - odom_last_stamp).toSec();
+  odom_last_stamp = stamp;
+  odom_last_time = millis();
+  if ( dt <= 0.0 )
+    dt = 1.0 / stream_rate;
 
 #ifdef _ODOM_DEBUG
 /*
@@ -789,7 +1102,7 @@ ROS_DEBUG("");
   if ( pub_odom_tf )
   {
     tf_msg.header.seq++;
-    tf_msg.header.stamp = ros::Time::now();
+    tf_msg.header.stamp = stamp;
     tf_msg.transform.translation.x = odom_x;
     tf_msg.transform.translation.y = odom_y;
     tf_msg.transform.translation.z = 0.0;
@@ -798,7 +1111,7 @@ ROS_DEBUG("");
   }
 
   odom_msg.header.seq++;
-  odom_msg.header.stamp = ros::Time::now();
+  odom_msg.header.stamp = stamp;
   odom_msg.pose.pose.position.x = odom_x;
   odom_msg.pose.pose.position.y = odom_y;
   odom_msg.pose.pose.position.z = 0.0;
@@ -814,12 +1127,128 @@ ROS_DEBUG("");
 }
 
 
+void MainNode::stats_publish()
+{
+
+  stats_msg.header.seq++;
+  stats_msg.header.stamp = ros::Time::now();
+  stats_msg.lines = stats_lines.exchange(0);
+  stats_msg.parse_errors = stats_parse_errors.exchange(0);
+  stats_msg.queue_drops = odom_queue_drops.exchange(0);
+  stats_msg.latency_min = latency_min;
+  stats_msg.latency_mean = (latency_count > 0) ? latency_sum / latency_count : 0.0;
+  stats_msg.latency_max = latency_max;
+  for ( int i = 0; i < LATENCY_BUCKETS; i++ )
+    stats_msg.latency_histogram[i] = latency_histogram[i];
+  stats_pub.publish(stats_msg);
+
+  if ( stats_msg.queue_drops > 0 )
+    ROS_WARN_STREAM("Dropped " << stats_msg.queue_drops << " sensor lines, publisher falling behind");
+
+  memset(latency_histogram, 0, sizeof(latency_histogram));
+  latency_count = 0;
+  latency_sum = 0.0;
+  latency_min = 0.0;
+  latency_max = 0.0;
+
+}
+
+
+//
+// scheduler
+//
+
+void MainNode::sched_add(void (MainNode::*fn)(), double rate)
+{
+  if ( sched_count >= SCHED_TASKS || rate <= 0.0 )
+    return;
+  sched_task &task = sched_tasks[sched_count++];
+  task.fn = fn;
+  task.period_ns = (long)(1e9 / rate);
+  clock_gettime(CLOCK_MONOTONIC, &task.next);
+}
+
+void MainNode::sched_realtime()
+{
+  if ( realtime_priority <= 0 )
+    return;
+  struct sched_param param;
+  param.sched_priority = realtime_priority;
+  int err = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+  if ( err != 0 )
+    ROS_WARN_STREAM("Unable to set SCHED_FIFO priority " << realtime_priority << ": " << strerror(err));
+  else
+    ROS_INFO_STREAM("Running with SCHED_FIFO priority " << realtime_priority);
+}
+
+// Wait until the reader thread has read from the port or the earliest task
+// deadline passes, on an absolute CLOCK_MONOTONIC time. Odometry is then
+// published from whatever the reader queued, and every task that is due is
+// run and has its deadline advanced by one period. A task that overran its
+// next deadline skips the missed periods instead of running back to back.
+void MainNode::sched_loop()
+{
+
+  while ( ros::ok() && sched_count > 0 )
+  {
+    struct timespec wake = sched_tasks[0].next;
+    for ( int i = 1; i < sched_count; i++ )
+    {
+      if ( timespec_before(sched_tasks[i].next, wake) )
+        wake = sched_tasks[i].next;
+    }
+
+    pthread_mutex_lock(&odom_mutex);
+    while ( !odom_ready && ros::ok() )
+    {
+      if ( pthread_cond_timedwait(&odom_cond, &odom_mutex, &wake) == ETIMEDOUT )
+        break;
+    }
+    odom_ready = false;
+    pthread_mutex_unlock(&odom_mutex);
+
+    odom_loop();
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    for ( int i = 0; i < sched_count; i++ )
+    {
+      sched_task &task = sched_tasks[i];
+      if ( timespec_before(now, task.next) )
+        continue;
+      (this->*task.fn)();
+      timespec_add_ns(&task.next, task.period_ns);
+      if ( !timespec_before(now, task.next) )
+      {
+        ++sched_overruns;
+        task.next = now;
+        timespec_add_ns(&task.next, task.period_ns);
+      }
+    }
+  }
+
+}
+
+void MainNode::ls_run()
+{
+  odom_ls_run();
+  stats_publish();
+  if ( sched_overruns > 0 )
+  {
+    ROS_WARN_STREAM("Scheduler missed " << sched_overruns << " deadlines");
+    sched_overruns = 0;
+  }
+}
+
+
 int MainNode::run()
 {
 
 	ROS_INFO("Beginning setup...");
 
-	serial::Timeout timeout = serial::Timeout::simpleTimeout(1000);
+	// reads use a short constant timeout so the reader thread wakes up
+	// regularly to notice shutdown; writes keep the original 1000 ms
+	serial::Timeout timeout(serial::Timeout::max(), SERIAL_READ_WAIT_MS, 0, 1000, 0);
 	controller.setPort(port);
 	controller.setBaudrate(baud);
 	controller.setTimeout(timeout);
@@ -845,57 +1274,32 @@ int MainNode::run()
 		sleep( 5 );
 	}
 
+	// set before the reader thread and the spinner are started so they
+	// inherit the policy; the threads roscpp started with the node handle
+	// keep the default one
+	sched_realtime();
+
 	cmdvel_setup();
 	odom_setup();
+	reader_start();
 
-  starttime = millis();
-  hstimer = starttime;
-  mstimer = starttime;
-  lstimer = starttime;
+  // odometry is published as the reader delivers it, the 10 Hz current and
+  // 1 Hz housekeeping rates are fixed
+  sched_add(&MainNode::odom_ms_run, 10.0);
+  sched_add(&MainNode::ls_run, 1.0);
+#ifdef _CMDVEL_FORCE_RUN
+  sched_add(&MainNode::cmdvel_run, 10.0);
+#endif
 
-//  ros::Rate loop_rate(10);
+  ros::AsyncSpinner spinner(1);
+  spinner.start();
 
   ROS_INFO("Beginning looping...");
-	
-  while (ros::ok())
-  {
-
-    cmdvel_loop();
-    odom_loop();
 
-    uint32_t nowtime = millis();
-//ROS_INFO_STREAM("loop nowtime: " << nowtime << " lstimer: " << lstimer << " delta: " << DELTAT(nowtime,lstimer) << " / " << (nowtime-lstimer));
-//uint32_t delta = DELTAT(nowtime,lstimer);
-//ROS_INFO_STREAM("loop nowtime: " << nowtime << " lstimer: " << lstimer << " delta: " << delta << " / " << (nowtime-lstimer));
+  sched_loop();
 
-//    // Handle 50 Hz publishing
-//    if (DELTAT(nowtime,hstimer) >= 20)
-    // Handle 30 Hz publishing
-    if (DELTAT(nowtime,hstimer) >= 33)
-    {
-      hstimer = nowtime;
-//      odom_hs_run();
-    }
-
-    // Handle 10 Hz publishing
-    if (DELTAT(nowtime,mstimer) >= 100)
-    {
-      mstimer = nowtime;
-      cmdvel_run();
-      odom_ms_run();
-    }
-
-    // Handle 1 Hz publishing
-    if (DELTAT(nowtime,lstimer) >= 1000)
-    {
-      lstimer = nowtime;
-      odom_ls_run();
-    }
-
-    ros::spinOnce();
-
-//    loop_rate.sleep();
-  }
+  spinner.stop();
+  reader_stop();
 	
   if ( controller.isOpen() )
     controller.close();
@@ -0,0 +1,77 @@
+/*
+ *  RPLIDAR ROS NODE
+ *
+ *  Copyright (c) 2009 - 2014 RoboPeak Team
+ *  http://www.robopeak.com
+ *  Copyright (c) 2014 - 2016 Shanghai Slamtec Co., Ltd.
+ *  http://www.slamtec.com
+ *
+ */
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "rplidar_node.h"
+
+#include <nodelet/nodelet.h>
+#include <pluginlib/class_list_macros.h>
+
+#include <boost/scoped_ptr.hpp>
+#include <boost/thread/thread.hpp>
+
+namespace rplidar_ros {
+
+// Runs the lidar in a nodelet manager, so the filter chain and the scan
+// merger get its scans by pointer, without serialization.
+class RPLidarNodelet : public nodelet::Nodelet
+{
+public:
+    virtual ~RPLidarNodelet()
+    {
+        if (node_) {
+            node_->shutdown();
+            thread_.join();
+        }
+    }
+
+private:
+    virtual void onInit()
+    {
+        node_.reset(new RPLidarNode(getNodeHandle(), getPrivateNodeHandle()));
+        if (!node_->start()) {
+            NODELET_ERROR("could not start the lidar");
+            node_.reset();
+            return;
+        }
+        // the scan loop blocks on the lidar, keep it off the manager's threads
+        thread_ = boost::thread(&RPLidarNode::spin, node_.get());
+    }
+
+    boost::scoped_ptr<RPLidarNode> node_;
+    boost::thread thread_;
+};
+
+}
+
+PLUGINLIB_EXPORT_CLASS(rplidar_ros::RPLidarNodelet, nodelet::Nodelet)
@@ -0,0 +1,402 @@
+/*
+ *  RPLIDAR ROS NODE
+ *
+ *  Copyright (c) 2009 - 2014 RoboPeak Team
+ *  http://www.robopeak.com
+ *  Copyright (c) 2014 - 2016 Shanghai Slamtec Co., Ltd.
+ *  http://www.slamtec.com
+ *
+ */
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "rplidar_node.h"
+
+#include <algorithm>
+#include <cmath>
+
+#define DEG2RAD(x) ((x)*M_PI/180.)
+
+using namespace sl;
+
+namespace rplidar_ros {
+
+static float getAngle(const sl_lidar_response_measurement_node_hq_t& node)
+{
+    return node.angle_z_q14 * 90.f / 16384.f;
+}
+
+RPLidarNode::RPLidarNode(ros::NodeHandle nh, ros::NodeHandle nh_private)
+    : nh_(nh), nh_private_(nh_private),
+      tcp_port_(20108), udp_port_(8089), serial_baudrate_(115200),
+      inverted_(false), angle_compensate_(true), max_distance_(8.0),
+      scan_frequency_(10.0), scan_sectors_(0), stream_poll_period_(0.005),
+      sample_period_(0.0), drv_(NULL), channel_(NULL), scanning_(false),
+      running_(true), nodes_(8192), rotation_(8192)
+{
+    nh_private_.param<std::string>("channel_type", channel_type_, "serial");
+    nh_private_.param<std::string>("tcp_ip", tcp_ip_, "192.168.0.7"); 
+    nh_private_.param<int>("tcp_port", tcp_port_, 20108);
+    nh_private_.param<std::string>("udp_ip", udp_ip_, "192.168.11.2"); 
+    nh_private_.param<int>("udp_port", udp_port_, 8089);
+    nh_private_.param<std::string>("serial_port", serial_port_, "/dev/ttyUSB0"); 
+    nh_private_.param<int>("serial_baudrate", serial_baudrate_, 115200/*256000*/);//ros run for A1 A2, change to 256000 if A3
+    nh_private_.param<std::string>("frame_id", frame_id_, "laser_frame");
+    nh_private_.param<bool>("inverted", inverted_, false);
+    nh_private_.param<bool>("angle_compensate", angle_compensate_, false);
+    nh_private_.param<std::string>("scan_mode", scan_mode_, std::string());
+    if(channel_type_ == "udp"){
+        nh_private_.param<float>("scan_frequency", scan_frequency_, 20.0);
+    }
+    else{
+        nh_private_.param<float>("scan_frequency", scan_frequency_, 10.0);
+    }
+    nh_private_.param<int>("scan_sectors", scan_sectors_, 0);
+    nh_private_.param<double>("stream_poll_period", stream_poll_period_, 0.005);
+
+    scan_pub_ = nh_.advertise<sensor_msgs::LaserScan>("scan", 1000);
+}
+
+RPLidarNode::~RPLidarNode()
+{
+    if (drv_) {
+        drv_->setMotorSpeed(0);
+        drv_->stop();
+        delete drv_;
+    }
+    delete channel_;
+}
+
+bool RPLidarNode::getDeviceInfo()
+{
+    sl_result     op_result;
+    sl_lidar_response_device_info_t devinfo;
+
+    op_result = drv_->getDeviceInfo(devinfo);
+    if (SL_IS_FAIL(op_result)) {
+        if (op_result == SL_RESULT_OPERATION_TIMEOUT) {
+            ROS_ERROR("Error, operation time out. RESULT_OPERATION_TIMEOUT! ");
+        } else {
+            ROS_ERROR("Error, unexpected error, code: %x",op_result);
+        }
+        return false;
+    }
+
+    // print out the device serial number, firmware and hardware version number..
+    char sn_str[35] = {0}; 
+    for (int pos = 0; pos < 16 ;++pos) {
+        sprintf(sn_str + (pos * 2),"%02X", devinfo.serialnum[pos]);
+    }
+    ROS_INFO("RPLIDAR S/N: %s",sn_str);
+    ROS_INFO("Firmware Ver: %d.%02d",devinfo.firmware_version>>8, devinfo.firmware_version & 0xFF);
+    ROS_INFO("Hardware Rev: %d",(int)devinfo.hardware_version);
+    return true;
+}
+
+bool RPLidarNode::checkHealth()
+{
+    sl_result     op_result;
+    sl_lidar_response_device_health_t healthinfo;
+
+    op_result = drv_->getHealth(healthinfo);
+    if (SL_IS_OK(op_result)) { 
+        //ROS_INFO("RPLidar health status : %d", healthinfo.status);
+        switch (healthinfo.status) {
+			case SL_LIDAR_STATUS_OK:
+                ROS_INFO("RPLidar health status : OK.");
+				return true;
+			case SL_LIDAR_STATUS_WARNING:
+                ROS_INFO("RPLidar health status : Warning.");
+				return true;
+			case SL_LIDAR_STATUS_ERROR:
+                ROS_ERROR("Error, rplidar internal error detected. Please reboot the device to retry.");
+				return false;
+        }
+        return false;
+    } else {
+        ROS_ERROR("Error, cannot retrieve rplidar health code: %x", op_result);
+        return false;
+    }
+}
+
+bool RPLidarNode::stopMotor(std_srvs::Empty::Request &req,
+                            std_srvs::Empty::Response &res)
+{
+  if(!drv_)
+       return false;
+
+  ROS_DEBUG("Stop motor");
+  drv_->setMotorSpeed(0);
+  return true;
+}
+
+bool RPLidarNode::startMotor(std_srvs::Empty::Request &req,
+                             std_srvs::Empty::Response &res)
+{
+  if(!drv_)
+       return false;
+  if(drv_->isConnected())
+  {
+      ROS_DEBUG("Start motor");
+      sl_result ans=drv_->setMotorSpeed();
+  
+      ans=drv_->startScan(0,1);
+   }
+   else ROS_INFO("lost connection");
+  return true;
+}
+
+bool RPLidarNode::start()
+{
+    int ver_major = SL_LIDAR_SDK_VERSION_MAJOR;
+    int ver_minor = SL_LIDAR_SDK_VERSION_MINOR;
+    int ver_patch = SL_LIDAR_SDK_VERSION_PATCH;    
+    ROS_INFO("RPLIDAR running on ROS package rplidar_ros, SDK Version:%d.%d.%d",ver_major,ver_minor,ver_patch);
+
+    // create the driver instance
+    drv_ = *createLidarDriver();
+    if(channel_type_ == "tcp"){
+        channel_ = *createTcpChannel(tcp_ip_, tcp_port_);
+    }
+    else if(channel_type_ == "udp"){
+        channel_ = *createUdpChannel(udp_ip_, udp_port_);
+    }
+    else{
+        channel_ = *createSerialPortChannel(serial_port_, serial_baudrate_);
+    }
+    if (SL_IS_FAIL((drv_)->connect(channel_))) {
+		if(channel_type_ == "tcp"){
+            ROS_ERROR("Error, cannot connect to the ip addr  %s with the tcp port %s.",tcp_ip_.c_str(),std::to_string(tcp_port_).c_str());
+        }
+        else if(channel_type_ == "udp"){
+            ROS_ERROR("Error, cannot connect to the ip addr  %s with the udp port %s.",udp_ip_.c_str(),std::to_string(udp_port_).c_str());
+        }
+        else{
+            ROS_ERROR("Error, cannot bind to the specified serial port %s.",serial_port_.c_str());            
+        }
+        delete drv_;
+        drv_ = NULL;
+        return false;
+    }
+    // get rplidar device info
+    if(!getDeviceInfo() || !checkHealth()){
+       delete drv_;
+       drv_ = NULL;
+       return false;
+    }
+
+    //two service for start/stop lidar rotate
+    stop_motor_service_ = nh_.advertiseService("stop_motor", &RPLidarNode::stopMotor, this);
+    start_motor_service_ = nh_.advertiseService("start_motor", &RPLidarNode::startMotor, this);
+
+    //start lidar rotate
+    drv_->setMotorSpeed();
+
+    scanning_ = startScan();
+    return true;
+}
+
+bool RPLidarNode::startScan()
+{
+    sl_result  op_result;
+    LidarScanMode current_scan_mode;
+    if (scan_mode_.empty()) {
+        op_result = drv_->startScan(false /* not force scan */, true /* use typical scan mode */, 0, &current_scan_mode);
+    } else {
+        std::vector<LidarScanMode> allSupportedScanModes;
+        op_result = drv_->getAllSupportedScanModes(allSupportedScanModes);
+
+        if (SL_IS_OK(op_result)) {
+            sl_u16 selectedScanMode = sl_u16(-1);
+            for (std::vector<LidarScanMode>::iterator iter = allSupportedScanModes.begin(); iter != allSupportedScanModes.end(); iter++) {
+                if (iter->scan_mode == scan_mode_) {
+                    selectedScanMode = iter->id;
+                    break;
+                }
+            }
+
+            if (selectedScanMode == sl_u16(-1)) {
+                ROS_ERROR("scan mode `%s' is not supported by lidar, supported modes:", scan_mode_.c_str());
+                for (std::vector<LidarScanMode>::iterator iter = allSupportedScanModes.begin(); iter != allSupportedScanModes.end(); iter++) {
+                    ROS_ERROR("\t%s: max_distance: %.1f m, Point number: %.1fK",  iter->scan_mode,
+                            iter->max_distance, (1000/iter->us_per_sample));
+                }
+                op_result = SL_RESULT_OPERATION_FAIL;
+            } else {
+                op_result = drv_->startScanExpress(false /* not force scan */, selectedScanMode, 0, &current_scan_mode);
+            }
+        }
+    }
+
+    if(SL_IS_FAIL(op_result))
+    {
+        ROS_ERROR("Can not start scan: %08x!", op_result);
+        return false;
+    }
+
+    //default frequent is 10 hz (by motor pwm value),  current_scan_mode.us_per_sample is the number of scan point per us        
+    int points_per_circle = (int)(1000*1000/current_scan_mode.us_per_sample/scan_frequency_);
+    float angle_compensate_multiple = points_per_circle/360.0  + 1;
+    if(angle_compensate_multiple < 1) 
+      angle_compensate_multiple = 1.0;
+    max_distance_ = (float)current_scan_mode.max_distance;
+    sample_period_ = current_scan_mode.us_per_sample * 1e-6;
+    ROS_INFO("current scan mode: %s, sample rate: %d Khz, max_distance: %.1f m, scan frequency:%.1f Hz, ", current_scan_mode.scan_mode,(int)(1000/current_scan_mode.us_per_sample+0.5),max_distance_, scan_frequency_); 
+
+    // a node at angle a lands in bin a*multiple and covers the bins up to
+    // the next node, at most ceil(multiple) of them
+    builder_.configure(frame_id_, inverted_, max_distance_,
+                       angle_compensate_ ? (int)(360*angle_compensate_multiple) : 0,
+                       (int)std::ceil(angle_compensate_multiple));
+    return true;
+}
+
+void RPLidarNode::spin()
+{
+    if (!drv_)
+        return;
+
+    if (scan_sectors_ > 0 && scanning_ && sample_period_ > 0.0) {
+        sector_pub_ = nh_.advertise<sensor_msgs::LaserScan>("scan_sector", scan_sectors_ * 2);
+        ROS_INFO("streaming %d sectors per rotation on %s", scan_sectors_, sector_pub_.getTopic().c_str());
+        streamScans();
+    } else {
+        grabScans();
+    }
+}
+
+void RPLidarNode::shutdown()
+{
+    running_ = false;
+}
+
+void RPLidarNode::publishFullScan(sl_lidar_response_measurement_node_hq_t *nodes, size_t count,
+                                  ros::Time start, double scan_duration)
+{
+    sl_result op_result = drv_->ascendScanData(nodes, count);
+    if (op_result == SL_RESULT_OK) {
+        scan_pub_.publish(builder_.fullScan(nodes, count, start, scan_duration));
+    } else if (op_result == SL_RESULT_OPERATION_FAIL) {
+        // All the data is invalid, just publish them
+        scan_pub_.publish(builder_.scan(nodes, count, start, scan_duration, 0.0f, 359.0f));
+    }
+}
+
+void RPLidarNode::publishSector(sl_lidar_response_measurement_node_hq_t *nodes, size_t count,
+                                ros::Time start)
+{
+    if (count < 2)
+        return;
+    sector_pub_.publish(builder_.scan(nodes, count, start, (count - 1) * sample_period_,
+                                      getAngle(nodes[0]), getAngle(nodes[count - 1])));
+}
+
+void RPLidarNode::grabScans()
+{
+    ros::Time start_scan_time;
+    ros::Time end_scan_time;
+    double scan_duration;
+    while (ros::ok() && running_) {
+        size_t count = nodes_.size();
+
+        start_scan_time = ros::Time::now();
+        sl_result op_result = drv_->grabScanDataHq(nodes_.data(), count);
+        end_scan_time = ros::Time::now();
+        scan_duration = (end_scan_time - start_scan_time).toSec();
+
+        // grabScanDataHq returns once the rotation is complete, so the first
+        // beam was measured one rotation before it returned
+        if (count > 1 && sample_period_ > 0.0) {
+            scan_duration = (count - 1) * sample_period_;
+            start_scan_time = end_scan_time - ros::Duration(scan_duration);
+        }
+
+        if (op_result == SL_RESULT_OK) {
+            publishFullScan(nodes_.data(), count, start_scan_time, scan_duration);
+        }
+    }
+}
+
+// Streaming mode: publish every angular sector on scan_sector as soon as the
+// lidar has swept past it, and the whole rotation on scan at each sync.
+//
+// The driver does not keep a receive time per node, so every batch returned by
+// getScanDataWithIntervalHq is stamped when it is fetched and its nodes are
+// dated back from that time by the sample period of the scan mode.
+void RPLidarNode::streamScans()
+{
+    sl_lidar_response_measurement_node_hq_t *rotation = rotation_.data();
+    size_t rotation_count = 0;
+    size_t sector_begin = 0;
+    int sector = 0;
+    bool synced = false;
+    ros::Time rotation_start, sector_start;
+
+    while (ros::ok() && running_) {
+        size_t count = nodes_.size();
+        sl_result op_result = drv_->getScanDataWithIntervalHq(nodes_.data(), count);
+        ros::Time received = ros::Time::now();
+        if (op_result != SL_RESULT_OK || count == 0) {
+            ros::Duration(stream_poll_period_).sleep();
+            continue;
+        }
+
+        for (size_t i = 0; i < count; i++) {
+            const sl_lidar_response_measurement_node_hq_t &node = nodes_[i];
+            ros::Time stamp = received - ros::Duration((count - 1 - i) * sample_period_);
+
+            if (node.flag & SL_LIDAR_RESP_HQ_FLAG_SYNCBIT) {
+                // a new rotation begins: flush the last sector and the rotation
+                if (synced) {
+                    publishSector(&rotation[sector_begin], rotation_count - sector_begin, sector_start);
+                    if (rotation_count > 1)
+                        publishFullScan(rotation, rotation_count, rotation_start,
+                                        (rotation_count - 1) * sample_period_);
+                }
+                synced = true;
+                rotation_count = 0;
+                sector_begin = 0;
+                sector = 0;
+                rotation_start = stamp;
+                sector_start = stamp;
+            }
+
+            // nodes are assigned to sectors by angle; small angle jitter
+            // across a boundary never moves the sector backwards
+            int s = std::min((int)(getAngle(node) * scan_sectors_ / 360.f), scan_sectors_ - 1);
+            if (synced && s > sector) {
+                publishSector(&rotation[sector_begin], rotation_count - sector_begin, sector_start);
+                sector = s;
+                sector_begin = rotation_count;
+                sector_start = stamp;
+            }
+
+            if (rotation_count < rotation_.size())
+                rotation[rotation_count++] = node;
+        }
+    }
+}
+
+}
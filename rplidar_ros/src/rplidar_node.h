@@ -0,0 +1,119 @@
+/*
+ *  RPLIDAR ROS NODE
+ *
+ *  Copyright (c) 2009 - 2014 RoboPeak Team
+ *  http://www.robopeak.com
+ *  Copyright (c) 2014 - 2016 Shanghai Slamtec Co., Ltd.
+ *  http://www.slamtec.com
+ *
+ */
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef RPLIDAR_ROS_RPLIDAR_NODE_H
+#define RPLIDAR_ROS_RPLIDAR_NODE_H
+
+#include "ros/ros.h"
+#include "std_srvs/Empty.h"
+#include "sl_lidar.h"
+#include "scan_builder.h"
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+namespace rplidar_ros {
+
+// Drives one lidar and publishes its scans. Used by both rplidarNode and
+// the rplidar_ros/RPLidarNodelet nodelet; callbacks (the motor services)
+// are served by whoever spins the node handles.
+class RPLidarNode
+{
+public:
+    RPLidarNode(ros::NodeHandle nh, ros::NodeHandle nh_private);
+    ~RPLidarNode();
+
+    // Connect to the lidar, check its health and start the scan.
+    bool start();
+
+    // Publish scans until shutdown() or ROS shutdown.
+    void spin();
+
+    void shutdown();
+
+private:
+    bool getDeviceInfo();
+    bool checkHealth();
+    bool startScan();
+
+    bool stopMotor(std_srvs::Empty::Request &req, std_srvs::Empty::Response &res);
+    bool startMotor(std_srvs::Empty::Request &req, std_srvs::Empty::Response &res);
+
+    // Sort a complete rotation, angle-compensate it if requested, and publish it.
+    void publishFullScan(sl_lidar_response_measurement_node_hq_t *nodes, size_t count,
+                         ros::Time start, double scan_duration);
+    void publishSector(sl_lidar_response_measurement_node_hq_t *nodes, size_t count,
+                       ros::Time start);
+
+    void grabScans();
+    void streamScans();
+
+    ros::NodeHandle nh_;
+    ros::NodeHandle nh_private_;
+    ros::Publisher scan_pub_;
+    ros::Publisher sector_pub_;
+    ros::ServiceServer stop_motor_service_;
+    ros::ServiceServer start_motor_service_;
+
+    std::string channel_type_;
+    std::string tcp_ip_;
+    int tcp_port_;
+    std::string udp_ip_;
+    int udp_port_;
+    std::string serial_port_;
+    int serial_baudrate_;
+    std::string frame_id_;
+    bool inverted_;
+    bool angle_compensate_;
+    std::string scan_mode_;
+    float max_distance_;
+    float scan_frequency_;
+    int scan_sectors_;
+    double stream_poll_period_;
+    double sample_period_;
+
+    sl::ILidarDriver *drv_;
+    sl::IChannel *channel_;
+    bool scanning_;
+    std::atomic<bool> running_;
+
+    ScanBuilder builder_;
+    std::vector<sl_lidar_response_measurement_node_hq_t> nodes_;
+    std::vector<sl_lidar_response_measurement_node_hq_t> rotation_;
+};
+
+}
+
+#endif
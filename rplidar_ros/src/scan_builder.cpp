@@ -0,0 +1,207 @@
+/*
+ *  RPLIDAR ROS NODE
+ *
+ *  Copyright (c) 2009 - 2014 RoboPeak Team
+ *  http://www.robopeak.com
+ *  Copyright (c) 2014 - 2016 Shanghai Slamtec Co., Ltd.
+ *  http://www.slamtec.com
+ *
+ */
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "scan_builder.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#define DEG2RAD(x) ((x)*M_PI/180.)
+
+namespace rplidar_ros {
+
+static inline float getAngle(const sl_lidar_response_measurement_node_hq_t &node)
+{
+    return node.angle_z_q14 * 90.f / 16384.f;
+}
+
+// dist_mm_q2 is in quarter millimeters, 0 means no return.
+static inline float getRange(const sl_lidar_response_measurement_node_hq_t &node)
+{
+    float range = node.dist_mm_q2 * (1.f / 4000.f);
+    return node.dist_mm_q2 != 0 ? range : std::numeric_limits<float>::infinity();
+}
+
+ScanBuilder::ScanBuilder(size_t pool_size)
+    : pool_(std::max<size_t>(pool_size, 1)), next_(0),
+      inverted_(false), max_distance_(8.0), bins_(0), spread_(1)
+{
+    for (size_t i = 0; i < pool_.size(); i++)
+        pool_[i].reset(new sensor_msgs::LaserScan);
+}
+
+void ScanBuilder::configure(const std::string &frame_id, bool inverted,
+                            float max_distance, int compensate_bins, int spread)
+{
+    frame_id_ = frame_id;
+    inverted_ = inverted;
+    max_distance_ = max_distance;
+    bins_ = std::max(compensate_bins, 0);
+    spread_ = std::max(spread, 1);
+}
+
+sensor_msgs::LaserScanPtr ScanBuilder::acquire()
+{
+    for (size_t k = 0; k < pool_.size(); k++) {
+        size_t i = (next_ + k) % pool_.size();
+        if (pool_[i].unique()) {
+            next_ = (i + 1) % pool_.size();
+            return pool_[i];
+        }
+    }
+
+    // every message is still held by a subscriber, leave the oldest to them
+    sensor_msgs::LaserScanPtr &msg = pool_[next_];
+    msg.reset(new sensor_msgs::LaserScan);
+    next_ = (next_ + 1) % pool_.size();
+    return msg;
+}
+
+void ScanBuilder::setHeader(sensor_msgs::LaserScan &msg, ros::Time start, double scan_time,
+                            float angle_min, float angle_max, size_t count, bool &reverse)
+{
+    msg.header.stamp = start;
+    msg.header.frame_id = frame_id_;
+
+    bool reversed = (angle_max > angle_min);
+    if (reversed) {
+        msg.angle_min = M_PI - angle_max;
+        msg.angle_max = M_PI - angle_min;
+    } else {
+        msg.angle_min = M_PI - angle_min;
+        msg.angle_max = M_PI - angle_max;
+    }
+    msg.angle_increment = (msg.angle_max - msg.angle_min) / (double)(count - 1);
+
+    msg.scan_time = scan_time;
+    msg.time_increment = scan_time / (double)(count - 1);
+    msg.range_min = 0.15;
+    msg.range_max = max_distance_;
+
+    reverse = (inverted_ != reversed);
+}
+
+sensor_msgs::LaserScanPtr ScanBuilder::scan(const sl_lidar_response_measurement_node_hq_t *nodes,
+                                            size_t count, ros::Time start, double scan_time,
+                                            float angle_min, float angle_max)
+{
+    sensor_msgs::LaserScanPtr msg = acquire();
+    bool reverse;
+    setHeader(*msg, start, scan_time, DEG2RAD(angle_min), DEG2RAD(angle_max), count, reverse);
+
+    msg->ranges.resize(count);
+    msg->intensities.resize(count);
+    float *ranges = msg->ranges.data();
+    float *intensities = msg->intensities.data();
+    if (!reverse) {
+        for (size_t i = 0; i < count; i++) {
+            ranges[i] = getRange(nodes[i]);
+            intensities[i] = (float)(nodes[i].quality >> 2);
+        }
+    } else {
+        for (size_t i = 0; i < count; i++) {
+            ranges[count - 1 - i] = getRange(nodes[i]);
+            intensities[count - 1 - i] = (float)(nodes[i].quality >> 2);
+        }
+    }
+    return msg;
+}
+
+sensor_msgs::LaserScanPtr ScanBuilder::fullScan(const sl_lidar_response_measurement_node_hq_t *nodes,
+                                                size_t count, ros::Time start, double scan_time)
+{
+    if (bins_ > 1)
+        return compensatedScan(nodes, count, start, scan_time);
+
+    // publish from the first to the last valid node
+    size_t first = 0, last = count;
+    while (first < count && nodes[first].dist_mm_q2 == 0)
+        first++;
+    while (last > first && nodes[last - 1].dist_mm_q2 == 0)
+        last--;
+    if (last - first < 2)
+        return scan(nodes, count, start, scan_time, 0.0f, 359.0f);
+
+    return scan(&nodes[first], last - first, start, scan_time,
+                getAngle(nodes[first]), getAngle(nodes[last - 1]));
+}
+
+// Each valid node owns the bins from its own up to the next valid node's,
+// at most spread_ of them; bins nobody owns stay without a return. The bin
+// of a node is its 16 bit angle scaled to bins_ in fixed point.
+sensor_msgs::LaserScanPtr ScanBuilder::compensatedScan(const sl_lidar_response_measurement_node_hq_t *nodes,
+                                                       size_t count, ros::Time start, double scan_time)
+{
+    sensor_msgs::LaserScanPtr msg = acquire();
+    bool reverse;
+    setHeader(*msg, start, scan_time, DEG2RAD(0.0f), DEG2RAD(360.0f), bins_, reverse);
+
+    msg->ranges.assign(bins_, std::numeric_limits<float>::infinity());
+    msg->intensities.assign(bins_, 0.0f);
+    float *ranges = msg->ranges.data();
+    float *intensities = msg->intensities.data();
+
+    const sl_lidar_response_measurement_node_hq_t *owner = NULL;
+    int owner_bin = 0;
+    for (size_t i = 0; i <= count; i++) {
+        int bin = bins_;
+        if (i < count) {
+            if (nodes[i].dist_mm_q2 == 0)
+                continue;
+            bin = (int)(((sl_u32)nodes[i].angle_z_q14 * (sl_u32)bins_) >> 16);
+        }
+        if (owner) {
+            int end = std::min(owner_bin + spread_, bin);
+            float range = getRange(*owner);
+            float intensity = (float)(owner->quality >> 2);
+            for (int b = owner_bin; b < end; b++) {
+                ranges[b] = range;
+                intensities[b] = intensity;
+            }
+        }
+        if (i < count) {
+            owner = &nodes[i];
+            owner_bin = bin;
+        }
+    }
+
+    if (reverse) {
+        std::reverse(msg->ranges.begin(), msg->ranges.end());
+        std::reverse(msg->intensities.begin(), msg->intensities.end());
+    }
+    return msg;
+}
+
+}
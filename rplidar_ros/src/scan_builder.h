@@ -0,0 +1,92 @@
+/*
+ *  RPLIDAR ROS NODE
+ *
+ *  Copyright (c) 2009 - 2014 RoboPeak Team
+ *  http://www.robopeak.com
+ *  Copyright (c) 2014 - 2016 Shanghai Slamtec Co., Ltd.
+ *  http://www.slamtec.com
+ *
+ */
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef RPLIDAR_ROS_SCAN_BUILDER_H
+#define RPLIDAR_ROS_SCAN_BUILDER_H
+
+#include "sensor_msgs/LaserScan.h"
+#include "sl_lidar_cmd.h"
+
+#include <string>
+#include <vector>
+
+namespace rplidar_ros {
+
+// Turns lidar nodes into sensor_msgs::LaserScan messages.
+//
+// Messages come from a small pool and are reused once nobody else holds
+// them, so the ranges/intensities vectors keep their capacity and a steady
+// stream of scans does not allocate. A message handed out must be published
+// by pointer and not touched afterwards.
+class ScanBuilder
+{
+public:
+    explicit ScanBuilder(size_t pool_size = 4);
+
+    // compensate_bins > 0 resamples full rotations onto that many evenly
+    // spaced bins, each covering at most `spread' bins after its node.
+    void configure(const std::string &frame_id, bool inverted,
+                   float max_distance, int compensate_bins, int spread);
+
+    // A full rotation, sorted by angle.
+    sensor_msgs::LaserScanPtr fullScan(const sl_lidar_response_measurement_node_hq_t *nodes,
+                                       size_t count, ros::Time start, double scan_time);
+
+    // Consecutive nodes from angle_min to angle_max, in degrees.
+    sensor_msgs::LaserScanPtr scan(const sl_lidar_response_measurement_node_hq_t *nodes,
+                                   size_t count, ros::Time start, double scan_time,
+                                   float angle_min, float angle_max);
+
+private:
+    sensor_msgs::LaserScanPtr acquire();
+
+    void setHeader(sensor_msgs::LaserScan &msg, ros::Time start, double scan_time,
+                   float angle_min, float angle_max, size_t count, bool &reverse);
+
+    sensor_msgs::LaserScanPtr compensatedScan(const sl_lidar_response_measurement_node_hq_t *nodes,
+                                              size_t count, ros::Time start, double scan_time);
+
+    std::vector<sensor_msgs::LaserScanPtr> pool_;
+    size_t next_;
+
+    std::string frame_id_;
+    bool inverted_;
+    float max_distance_;
+    int bins_;
+    int spread_;
+};
+
+}
+
+#endif